@@ -4,6 +4,11 @@
 #include <strings.h>
 #include <assert.h>
 
+typedef struct dict_iter_t {
+    unsigned long iter_buck_id;
+    unsigned long iter_el_in_buck_id;
+} dict_iter_t;
+
 #endif
 
 #ifndef DICT_N_BUCKETS
@@ -168,5 +173,32 @@ static inline void glue(dict_free__,
     dict->size           = 0;
 }
 
+static inline void glue(dict_reset_iter__, DICT_DATA_T)(dict_iter_t* iter)
+{
+    iter->iter_buck_id       = 0;
+    iter->iter_el_in_buck_id = 0;
+}
+
+static inline int glue(dict_iter_next__,
+                       DICT_DATA_T)(glue(dict__, DICT_DATA_T) * dict,
+                                    dict_iter_t* iter, unsigned long* key,
+                                    DICT_DATA_T** res)
+{
+    while (iter->iter_buck_id < dict->filled_buckets_i) {
+        glue(da__, DICT_EL)* bucket =
+            &dict->buckets[dict->filled_buckets[iter->iter_buck_id]];
+        if (iter->iter_el_in_buck_id < bucket->size) {
+            DICT_EL* tmp = glue(da_get_ref_item__, DICT_EL)(
+                bucket, iter->iter_el_in_buck_id++);
+            *key = tmp->key;
+            *res = &tmp->el;
+            return 1;
+        }
+        iter->iter_buck_id++;
+        iter->iter_el_in_buck_id = 0;
+    }
+    return 0;
+}
+
 #undef DICT_DATA_T
 #undef DICT_N_BUCKETS
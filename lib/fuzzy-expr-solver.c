@@ -0,0 +1,636 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fuzzy-expr.h"
+#include "timer.h"
+
+#define FZ_ABORT(x...)                                                         \
+    do {                                                                       \
+        fprintf(stderr, "[fuzzy-expr ABORT] " x);                              \
+        fprintf(stderr, "\n");                                                 \
+        abort();                                                               \
+    } while (0)
+#define FZ_CHECK(x, mex...)                                                    \
+    if (!(x))                                                                  \
+        FZ_ABORT(mex);
+
+#define FZ_MAX_GROUP_SIZE 8
+#define FZ_MAX_GROUPS 64
+#define FZ_MAX_CONSTS 64
+#define FZ_ARITH_MAX 16
+#define FZ_BRUTE_FORCE_MAX_BYTES 2
+#define FZ_HAVOC_ITERATIONS 65536
+#define FZ_HAVOC_MAX_MUTATIONS 4
+#define FZ_OPT_MAX_PASSES 4
+#define FZ_TIMER_CHECK_MASK 63
+
+typedef unsigned long ulong;
+#define SET_N_BUCKETS 256
+#define SET_DATA_T ulong
+#include "set.h"
+
+// bytes of a concat of inputs, the most significant first
+typedef struct fz_group_t {
+    unsigned char n;
+    unsigned long indexes[FZ_MAX_GROUP_SIZE];
+} fz_group_t;
+
+struct fz_solver_t {
+    fz_builder_t*  builder;
+    unsigned char* seed;
+    unsigned char* input; // the candidate, equal to the seed between calls
+    unsigned char* proof;
+    unsigned char* frozen; // bytes fixed by the notified constraints
+    unsigned long  seed_len;
+
+    unsigned       timeout;
+    simple_timer_t timer;
+    unsigned long  num_evals;
+    int            timed_out;
+    uint64_t       rng;
+
+    int           has_fallback;
+    fz_fallback_t fallback;
+
+    // what the search mutates, filled by fz_analyze()
+    uint32_t*      visited;
+    uint32_t       visited_size;
+    uint32_t       visit_epoch;
+    set__ulong     bytes_set;
+    unsigned long* bytes; // the involved bytes that are not frozen
+    unsigned long  n_bytes;
+    fz_group_t     groups[FZ_MAX_GROUPS];
+    unsigned       n_groups;
+    uint64_t       consts[FZ_MAX_CONSTS];
+    unsigned       n_consts;
+};
+
+static const uint8_t fz_interesting_8[] = {0x00, 0x01, 0x7f, 0x80, 0xff};
+
+static unsigned long fz_index_hash(unsigned long* el) { return *el; }
+static unsigned int  fz_index_equals(unsigned long* el1, unsigned long* el2)
+{
+    return *el1 == *el2;
+}
+
+fz_solver_t* fz_solver_create(fz_builder_t* b, const unsigned char* seed,
+                              unsigned long seed_len, unsigned timeout)
+{
+    fz_solver_t* s = (fz_solver_t*)calloc(1, sizeof(fz_solver_t));
+    FZ_CHECK(s != NULL, "fz_solver_create(): calloc failed");
+    FZ_CHECK(seed_len > 0, "fz_solver_create(): empty seed");
+
+    s->builder  = b;
+    s->seed_len = seed_len;
+    s->seed     = (unsigned char*)malloc(seed_len);
+    s->input    = (unsigned char*)malloc(seed_len);
+    s->proof    = (unsigned char*)malloc(seed_len);
+    s->frozen   = (unsigned char*)calloc(seed_len, 1);
+    s->bytes    = (unsigned long*)malloc(sizeof(unsigned long) * seed_len);
+    FZ_CHECK(s->seed != NULL && s->input != NULL && s->proof != NULL &&
+                 s->frozen != NULL && s->bytes != NULL,
+             "fz_solver_create(): malloc failed");
+    memcpy(s->seed, seed, seed_len);
+    memcpy(s->input, seed, seed_len);
+
+    s->timeout = timeout;
+    init_timer(&s->timer, timeout);
+    s->rng = 0x2545f4914f6cdd1dUL;
+    set_init__ulong(&s->bytes_set, fz_index_hash, fz_index_equals);
+    return s;
+}
+
+void fz_solver_free(fz_solver_t* s)
+{
+    if (s->has_fallback && s->fallback.free != NULL)
+        s->fallback.free(s->fallback.data);
+    set_free__ulong(&s->bytes_set, NULL);
+    free(s->visited);
+    free(s->bytes);
+    free(s->frozen);
+    free(s->proof);
+    free(s->input);
+    free(s->seed);
+    free(s);
+}
+
+void fz_solver_set_fallback(fz_solver_t* s, const fz_fallback_t* fallback)
+{
+    if (s->has_fallback && s->fallback.free != NULL)
+        s->fallback.free(s->fallback.data);
+    s->has_fallback = fallback != NULL;
+    if (fallback != NULL)
+        s->fallback = *fallback;
+}
+
+fz_builder_t* fz_solver_builder(fz_solver_t* s) { return s->builder; }
+
+const unsigned char* fz_solver_seed(fz_solver_t* s, unsigned long* seed_len)
+{
+    *seed_len = s->seed_len;
+    return s->seed;
+}
+
+unsigned fz_solver_timeout(fz_solver_t* s) { return s->timeout; }
+
+// ********** analysis of the expressions **********
+
+static int fz_concat_leaves(fz_builder_t* b, fz_expr_t e, fz_group_t* g)
+{
+    const fz_node_t* n = fz_node(b, e);
+    if (n->op == FZ_OP_CONCAT)
+        return fz_concat_leaves(b, n->args[0], g) &&
+               fz_concat_leaves(b, n->args[1], g);
+    if (n->op != FZ_OP_INPUT || g->n == FZ_MAX_GROUP_SIZE)
+        return 0;
+    g->indexes[g->n++] = n->value;
+    return 1;
+}
+
+static void fz_add_group(fz_solver_t* s, const fz_group_t* g)
+{
+    unsigned i, j;
+    for (i = 0; i < g->n; ++i)
+        if (g->indexes[i] >= s->seed_len || s->frozen[g->indexes[i]])
+            return;
+    for (i = 0; i < s->n_groups; ++i) {
+        if (s->groups[i].n != g->n)
+            continue;
+        for (j = 0; j < g->n; ++j)
+            if (s->groups[i].indexes[j] != g->indexes[j])
+                break;
+        if (j == g->n)
+            return;
+    }
+    if (s->n_groups < FZ_MAX_GROUPS)
+        s->groups[s->n_groups++] = *g;
+}
+
+static void fz_add_const(fz_solver_t* s, uint64_t value)
+{
+    unsigned i;
+    for (i = 0; i < s->n_consts; ++i)
+        if (s->consts[i] == value)
+            return;
+    if (s->n_consts < FZ_MAX_CONSTS)
+        s->consts[s->n_consts++] = value;
+}
+
+static void fz_analyze_node(fz_solver_t* s, fz_expr_t e)
+{
+    if (s->visited[e] == s->visit_epoch)
+        return;
+    s->visited[e] = s->visit_epoch;
+
+    const fz_node_t* n = fz_node(s->builder, e);
+    switch (n->op) {
+        case FZ_OP_INPUT:
+            if (n->value < s->seed_len && !s->frozen[n->value] &&
+                !set_check__ulong(&s->bytes_set, n->value)) {
+                set_add__ulong(&s->bytes_set, n->value);
+                s->bytes[s->n_bytes++] = n->value;
+            }
+            return;
+        case FZ_OP_CONST:
+            if (n->width > 0)
+                fz_add_const(s, n->value);
+            return;
+        case FZ_OP_CONCAT: {
+            fz_group_t g;
+            g.n = 0;
+            if (fz_concat_leaves(s->builder, e, &g))
+                fz_add_group(s, &g);
+            break;
+        }
+        default:
+            break;
+    }
+
+    unsigned i;
+    for (i = 0; i < 3 && n->args[i] != FZ_INVALID; ++i)
+        fz_analyze_node(s, n->args[i]);
+}
+
+// collect the involved bytes, the groups and the constants of e
+static void fz_analyze(fz_solver_t* s, fz_expr_t e)
+{
+    FZ_CHECK(e != FZ_INVALID && e < s->builder->n_nodes,
+             "invalid expression %u", e);
+
+    if (s->visited_size < s->builder->n_nodes) {
+        s->visited = (uint32_t*)realloc(s->visited, sizeof(uint32_t) *
+                                                        s->builder->n_nodes);
+        FZ_CHECK(s->visited != NULL, "fz_analyze(): realloc failed");
+        memset(s->visited + s->visited_size, 0,
+               sizeof(uint32_t) * (s->builder->n_nodes - s->visited_size));
+        s->visited_size = s->builder->n_nodes;
+    }
+    if (++s->visit_epoch == 0) {
+        memset(s->visited, 0, sizeof(uint32_t) * s->visited_size);
+        s->visit_epoch = 1;
+    }
+
+    set_remove_all__ulong(&s->bytes_set, NULL);
+    s->n_bytes  = 0;
+    s->n_groups = 0;
+    s->n_consts = 0;
+    fz_analyze_node(s, e);
+}
+
+// ********** evaluation of the candidates **********
+
+static inline void fz_start(fz_solver_t* s)
+{
+    s->num_evals = 0;
+    s->timed_out = 0;
+    start_timer(&s->timer);
+}
+
+static inline uint64_t fz_solver_eval(fz_solver_t* s, fz_expr_t e)
+{
+    if (s->timeout > 0 && (++s->num_evals & FZ_TIMER_CHECK_MASK) == 0 &&
+        check_timer(&s->timer))
+        s->timed_out = 1;
+    return fz_eval(s->builder, e, s->input, s->seed_len);
+}
+
+static inline uint64_t fz_rand(fz_solver_t* s)
+{
+    s->rng ^= s->rng << 13;
+    s->rng ^= s->rng >> 7;
+    s->rng ^= s->rng << 17;
+    return s->rng;
+}
+
+static inline void fz_set_group(fz_solver_t* s, const fz_group_t* g,
+                                uint64_t value)
+{
+    unsigned i;
+    for (i = 0; i < g->n; ++i)
+        s->input[g->indexes[i]] = (value >> (8 * (g->n - 1 - i))) & 0xff;
+}
+
+static inline void fz_restore_group(fz_solver_t* s, const fz_group_t* g)
+{
+    unsigned i;
+    for (i = 0; i < g->n; ++i)
+        s->input[g->indexes[i]] = s->seed[g->indexes[i]];
+}
+
+typedef struct fz_query_t {
+    fz_expr_t pi;
+    fz_expr_t branch_condition;
+    int       found; // the proof satisfies the branch condition
+} fz_query_t;
+
+// 1 if the candidate satisfies both pi and the branch condition, the first
+// candidate that satisfies only the branch condition is kept as well
+static int fz_try(fz_solver_t* s, fz_query_t* q)
+{
+    if (!fz_solver_eval(s, q->branch_condition))
+        return 0;
+    int full = fz_solver_eval(s, q->pi) != 0;
+    if (full || !q->found)
+        memcpy(s->proof, s->input, s->seed_len);
+    q->found = 1;
+    return full;
+}
+
+// ********** check light **********
+
+static int fz_phase_input_to_state(fz_solver_t* s, fz_query_t* q)
+{
+    static const int64_t deltas[] = {0, 1, -1};
+
+    unsigned long i;
+    unsigned      j, k;
+    fz_group_t    g;
+    for (i = 0; i < s->n_groups + s->n_bytes; ++i) {
+        if (i < s->n_groups)
+            g = s->groups[i];
+        else {
+            g.n          = 1;
+            g.indexes[0] = s->bytes[i - s->n_groups];
+        }
+        uint64_t mask = g.n == 8 ? (uint64_t)-1 : (1UL << (8 * g.n)) - 1;
+        for (j = 0; j < s->n_consts; ++j) {
+            for (k = 0; k < sizeof(deltas) / sizeof(int64_t); ++k) {
+                fz_set_group(s, &g, (s->consts[j] + deltas[k]) & mask);
+                int res = fz_try(s, q);
+                fz_restore_group(s, &g);
+                if (res || s->timed_out)
+                    return res;
+            }
+        }
+    }
+    return 0;
+}
+
+static int fz_try_byte(fz_solver_t* s, fz_query_t* q, unsigned long idx,
+                       uint8_t value)
+{
+    s->input[idx] = value;
+    int res       = fz_try(s, q);
+    s->input[idx] = s->seed[idx];
+    return res;
+}
+
+static int fz_phase_deterministic(fz_solver_t* s, fz_query_t* q)
+{
+    unsigned long i;
+    unsigned      j;
+    for (i = 0; i < s->n_bytes; ++i) {
+        unsigned long idx  = s->bytes[i];
+        uint8_t       orig = s->seed[idx];
+        int res = 0;
+        for (j = 0; j < 8 && !res && !s->timed_out; ++j)
+            res = fz_try_byte(s, q, idx, orig ^ (1 << j));
+        for (j = 1; j <= FZ_ARITH_MAX && !res && !s->timed_out; ++j)
+            res = fz_try_byte(s, q, idx, orig + j) ||
+                  fz_try_byte(s, q, idx, orig - j);
+        for (j = 0; j < sizeof(fz_interesting_8) && !res && !s->timed_out; ++j)
+            res = fz_try_byte(s, q, idx, fz_interesting_8[j]);
+        if (res || s->timed_out)
+            return res;
+    }
+    return 0;
+}
+
+static int fz_phase_brute_force(fz_solver_t* s, fz_query_t* q)
+{
+    if (s->n_bytes == 0 || s->n_bytes > FZ_BRUTE_FORCE_MAX_BYTES)
+        return 0;
+
+    fz_group_t g;
+    g.n = s->n_bytes;
+    unsigned long i;
+    for (i = 0; i < s->n_bytes; ++i)
+        g.indexes[i] = s->bytes[i];
+
+    uint64_t v, n_values = 1UL << (8 * g.n);
+    for (v = 0; v < n_values; ++v) {
+        fz_set_group(s, &g, v);
+        int res = fz_try(s, q);
+        fz_restore_group(s, &g);
+        if (res || s->timed_out)
+            return res;
+    }
+    return 0;
+}
+
+static int fz_phase_havoc(fz_solver_t* s, fz_query_t* q)
+{
+    if (s->n_bytes == 0)
+        return 0;
+
+    unsigned long touched[FZ_HAVOC_MAX_MUTATIONS];
+    unsigned      i, j, n;
+    int           res = 0;
+    for (i = 0; i < FZ_HAVOC_ITERATIONS && !res && !s->timed_out; ++i) {
+        n = 1 + fz_rand(s) % FZ_HAVOC_MAX_MUTATIONS;
+        for (j = 0; j < n; ++j) {
+            unsigned long idx = s->bytes[fz_rand(s) % s->n_bytes];
+            uint64_t      r   = fz_rand(s);
+            touched[j]        = idx;
+            switch (r % 4) {
+                case 0:
+                    s->input[idx] = (r >> 8) & 0xff;
+                    break;
+                case 1:
+                    s->input[idx] ^= 1 << ((r >> 8) % 8);
+                    break;
+                case 2:
+                    s->input[idx] += 1 + (r >> 8) % FZ_ARITH_MAX;
+                    break;
+                default:
+                    s->input[idx] = s->n_consts > 0
+                                        ? s->consts[(r >> 8) % s->n_consts]
+                                        : fz_interesting_8[(r >> 8) % 5];
+                    break;
+            }
+        }
+        res = fz_try(s, q);
+        for (j = 0; j < n; ++j)
+            s->input[touched[j]] = s->seed[touched[j]];
+    }
+    return res;
+}
+
+int fz_query_check_light(fz_solver_t* s, fz_expr_t pi,
+                         fz_expr_t             branch_condition,
+                         unsigned char const** proof,
+                         unsigned long*        proof_size)
+{
+    fz_query_t q = {pi, branch_condition, 0};
+    *proof_size  = 0;
+
+    fz_start(s);
+    if (fz_try(s, &q))
+        goto SAT;
+
+    fz_analyze(s, branch_condition);
+    if (fz_phase_input_to_state(s, &q) || s->timed_out)
+        goto OUT;
+    if (fz_phase_deterministic(s, &q) || s->timed_out)
+        goto OUT;
+    if (fz_phase_brute_force(s, &q) || s->timed_out)
+        goto OUT;
+    if (!q.found)
+        fz_phase_havoc(s, &q);
+
+OUT:
+    if (!q.found && s->has_fallback && s->fallback.query_check_light != NULL)
+        return s->fallback.query_check_light(s->fallback.data, pi,
+                                             branch_condition, proof,
+                                             proof_size);
+    if (!q.found)
+        return 0;
+SAT:
+    *proof      = s->proof;
+    *proof_size = s->seed_len;
+    return 1;
+}
+
+// ********** notify **********
+
+static void fz_freeze(fz_solver_t* s, fz_expr_t e)
+{
+    const fz_node_t* n = fz_node(s->builder, e);
+    if (n->op == FZ_OP_BOOL_AND) {
+        fz_freeze(s, n->args[0]);
+        fz_freeze(s, n->args[1]);
+        return;
+    }
+    if (n->op != FZ_OP_EQ)
+        return;
+
+    fz_expr_t other;
+    if (fz_node(s->builder, n->args[0])->op == FZ_OP_CONST)
+        other = n->args[1];
+    else if (fz_node(s->builder, n->args[1])->op == FZ_OP_CONST)
+        other = n->args[0];
+    else
+        return;
+
+    fz_group_t g;
+    g.n = 0;
+    if (!fz_concat_leaves(s->builder, other, &g))
+        return;
+    unsigned i;
+    for (i = 0; i < g.n; ++i)
+        if (g.indexes[i] < s->seed_len)
+            s->frozen[g.indexes[i]] = 1;
+}
+
+void fz_notify_constraint(fz_solver_t* s, fz_expr_t constraint)
+{
+    FZ_CHECK(constraint != FZ_INVALID && constraint < s->builder->n_nodes,
+             "invalid expression %u", constraint);
+
+    // the constraints hold on the seed, the fixed bytes must not change
+    fz_freeze(s, constraint);
+    if (s->has_fallback && s->fallback.notify_constraint != NULL)
+        s->fallback.notify_constraint(s->fallback.data, constraint);
+}
+
+// ********** maximize, minimize and find all values **********
+
+static unsigned long fz_optimize(fz_solver_t* s, fz_expr_t pi, fz_expr_t e,
+                                 unsigned char const** out_values,
+                                 unsigned long* out_len, int maximize)
+{
+    FZ_CHECK(fz_node(s->builder, e)->width > 0,
+             "fz_maximize/minimize(): not a bitvector");
+
+    fz_start(s);
+    fz_analyze(s, e);
+
+    // coordinate ascent: each byte takes its best value under pi
+    uint64_t      best = fz_solver_eval(s, e);
+    unsigned long i;
+    unsigned      pass, v;
+    int           improved = 1;
+    for (pass = 0; pass < FZ_OPT_MAX_PASSES && improved && !s->timed_out;
+         ++pass) {
+        improved = 0;
+        for (i = 0; i < s->n_bytes && !s->timed_out; ++i) {
+            unsigned long idx    = s->bytes[i];
+            uint8_t       best_v = s->input[idx];
+            for (v = 0; v < 256; ++v) {
+                s->input[idx] = v;
+                uint64_t val  = fz_solver_eval(s, e);
+                if ((maximize ? val > best : val < best) &&
+                    fz_solver_eval(s, pi)) {
+                    best     = val;
+                    best_v   = v;
+                    improved = 1;
+                }
+            }
+            s->input[idx] = best_v;
+        }
+    }
+
+    memcpy(s->proof, s->input, s->seed_len);
+    memcpy(s->input, s->seed, s->seed_len);
+    *out_values = s->proof;
+    *out_len    = s->seed_len;
+    return best;
+}
+
+unsigned long fz_maximize(fz_solver_t* s, fz_expr_t pi, fz_expr_t e,
+                          unsigned char const** out_values,
+                          unsigned long*        out_len)
+{
+    return fz_optimize(s, pi, e, out_values, out_len, 1);
+}
+
+unsigned long fz_minimize(fz_solver_t* s, fz_expr_t pi, fz_expr_t e,
+                          unsigned char const** out_values,
+                          unsigned long*        out_len)
+{
+    return fz_optimize(s, pi, e, out_values, out_len, 0);
+}
+
+typedef struct fz_findall_t {
+    int (*callback)(unsigned char const*, unsigned long, unsigned long);
+    set__ulong    values;
+    int           just_last;
+    int           has_last;
+    unsigned long last;
+} fz_findall_t;
+
+// 1 if the enumeration must stop
+static int fz_findall_report(fz_solver_t* s, fz_findall_t* fa, fz_expr_t e)
+{
+    unsigned long val = fz_solver_eval(s, e);
+    if (set_check__ulong(&fa->values, val))
+        return 0;
+    set_add__ulong(&fa->values, val);
+
+    memcpy(s->proof, s->input, s->seed_len);
+    fa->has_last = 1;
+    fa->last     = val;
+    if (fa->just_last)
+        return 0;
+
+    int res = fa->callback(s->proof, s->seed_len, val);
+    if (res == FZ_JUST_LAST)
+        fa->just_last = 1;
+    return res == FZ_STOP;
+}
+
+void fz_find_all_values(fz_solver_t* s, fz_expr_t e, fz_expr_t pi,
+                        int (*callback)(unsigned char const* out_bytes,
+                                        unsigned long        out_bytes_len,
+                                        unsigned long        val))
+{
+    fz_findall_t fa;
+    fa.callback  = callback;
+    fa.just_last = 0;
+    fa.has_last  = 0;
+    set_init__ulong(&fa.values, fz_index_hash, fz_index_equals);
+
+    fz_start(s);
+    fz_analyze(s, e);
+
+    // the value in the seed first, then one byte at a time
+    if (fz_findall_report(s, &fa, e))
+        goto OUT;
+
+    unsigned long i;
+    unsigned      v;
+    for (i = 0; i < s->n_bytes && !s->timed_out; ++i) {
+        unsigned long idx = s->bytes[i];
+        for (v = 0; v < 256; ++v) {
+            s->input[idx] = v;
+            if (fz_solver_eval(s, pi) && fz_findall_report(s, &fa, e)) {
+                s->input[idx] = s->seed[idx];
+                goto OUT;
+            }
+        }
+        s->input[idx] = s->seed[idx];
+    }
+
+    // every combination of the bytes, if they are few
+    if (s->n_bytes > 1 && s->n_bytes <= FZ_BRUTE_FORCE_MAX_BYTES) {
+        fz_group_t g;
+        g.n = s->n_bytes;
+        for (i = 0; i < s->n_bytes; ++i)
+            g.indexes[i] = s->bytes[i];
+
+        uint64_t val, n_values = 1UL << (8 * g.n);
+        for (val = 0; val < n_values && !s->timed_out; ++val) {
+            fz_set_group(s, &g, val);
+            int stop = fz_solver_eval(s, pi) && fz_findall_report(s, &fa, e);
+            fz_restore_group(s, &g);
+            if (stop)
+                goto OUT;
+        }
+    }
+
+    if (fa.just_last && fa.has_last)
+        callback(s->proof, s->seed_len, fa.last);
+
+OUT:
+    set_free__ulong(&fa.values, NULL);
+}
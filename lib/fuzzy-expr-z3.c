@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "fuzzy-expr-z3.h"
+#include "z3-fuzzy.h"
+
+#define FZ_SOLVER_ABORT(mex)                                                   \
+    do {                                                                       \
+        fprintf(stderr, "[fuzzy-expr ABORT] " mex "\n");                       \
+        abort();                                                               \
+    } while (0)
+
+void fz_z3_translator_init(fz_z3_translator_t* t, fz_builder_t* b,
+                           Z3_context ctx, Z3_ast* symbols,
+                           unsigned long n_symbols)
+{
+    t->builder   = b;
+    t->ctx       = ctx;
+    t->symbols   = symbols;
+    t->n_symbols = n_symbols;
+    t->asts      = NULL;
+    t->asts_size = 0;
+}
+
+void fz_z3_translator_free(fz_z3_translator_t* t)
+{
+    uint32_t i;
+    for (i = 0; i < t->asts_size; ++i)
+        if (t->asts[i] != NULL)
+            Z3_dec_ref(t->ctx, t->asts[i]);
+    free(t->asts);
+    t->asts      = NULL;
+    t->asts_size = 0;
+}
+
+Z3_ast fz_z3_translate(fz_z3_translator_t* t, fz_expr_t e)
+{
+    if (e >= t->asts_size) {
+        uint32_t new_size = t->builder->n_nodes;
+        t->asts = (Z3_ast*)realloc(t->asts, sizeof(Z3_ast) * new_size);
+        if (t->asts == NULL)
+            FZ_SOLVER_ABORT("fz_z3_translate(): realloc failed");
+        uint32_t i;
+        for (i = t->asts_size; i < new_size; ++i)
+            t->asts[i] = NULL;
+        t->asts_size = new_size;
+    }
+    if (t->asts[e] != NULL)
+        return t->asts[e];
+
+    Z3_context       ctx = t->ctx;
+    const fz_node_t* n   = fz_node(t->builder, e);
+    Z3_ast           a = NULL, c = NULL, res = NULL;
+    if (n->op != FZ_OP_INPUT && n->op != FZ_OP_CONST) {
+        a = fz_z3_translate(t, n->args[0]);
+        if (n->args[1] != FZ_INVALID)
+            c = fz_z3_translate(t, n->args[1]);
+    }
+
+    switch (n->op) {
+        case FZ_OP_INPUT:
+            if (n->value >= t->n_symbols)
+                FZ_SOLVER_ABORT("fz_z3_translate(): input outside of the seed");
+            res = t->symbols[n->value];
+            break;
+        case FZ_OP_CONST:
+            if (n->width == 0)
+                res = n->value ? Z3_mk_true(ctx) : Z3_mk_false(ctx);
+            else
+                res = Z3_mk_unsigned_int64(ctx, n->value,
+                                           Z3_mk_bv_sort(ctx, n->width));
+            break;
+        case FZ_OP_NOT:
+            res = Z3_mk_bvnot(ctx, a);
+            break;
+        case FZ_OP_NEG:
+            res = Z3_mk_bvneg(ctx, a);
+            break;
+        case FZ_OP_ADD:
+            res = Z3_mk_bvadd(ctx, a, c);
+            break;
+        case FZ_OP_SUB:
+            res = Z3_mk_bvsub(ctx, a, c);
+            break;
+        case FZ_OP_MUL:
+            res = Z3_mk_bvmul(ctx, a, c);
+            break;
+        case FZ_OP_UDIV:
+            res = Z3_mk_bvudiv(ctx, a, c);
+            break;
+        case FZ_OP_SDIV:
+            res = Z3_mk_bvsdiv(ctx, a, c);
+            break;
+        case FZ_OP_UREM:
+            res = Z3_mk_bvurem(ctx, a, c);
+            break;
+        case FZ_OP_SREM:
+            res = Z3_mk_bvsrem(ctx, a, c);
+            break;
+        case FZ_OP_AND:
+            res = Z3_mk_bvand(ctx, a, c);
+            break;
+        case FZ_OP_OR:
+            res = Z3_mk_bvor(ctx, a, c);
+            break;
+        case FZ_OP_XOR:
+            res = Z3_mk_bvxor(ctx, a, c);
+            break;
+        case FZ_OP_SHL:
+            res = Z3_mk_bvshl(ctx, a, c);
+            break;
+        case FZ_OP_LSHR:
+            res = Z3_mk_bvlshr(ctx, a, c);
+            break;
+        case FZ_OP_ASHR:
+            res = Z3_mk_bvashr(ctx, a, c);
+            break;
+        case FZ_OP_CONCAT:
+            res = Z3_mk_concat(ctx, a, c);
+            break;
+        case FZ_OP_EXTRACT:
+            res = Z3_mk_extract(ctx, n->hi, n->lo, a);
+            break;
+        case FZ_OP_ZEXT:
+            res = Z3_mk_zero_ext(
+                ctx, n->width - fz_node(t->builder, n->args[0])->width, a);
+            break;
+        case FZ_OP_SEXT:
+            res = Z3_mk_sign_ext(
+                ctx, n->width - fz_node(t->builder, n->args[0])->width, a);
+            break;
+        case FZ_OP_ITE:
+            res = Z3_mk_ite(ctx, a, c, fz_z3_translate(t, n->args[2]));
+            break;
+        case FZ_OP_EQ:
+            res = Z3_mk_eq(ctx, a, c);
+            break;
+        case FZ_OP_ULT:
+            res = Z3_mk_bvult(ctx, a, c);
+            break;
+        case FZ_OP_ULE:
+            res = Z3_mk_bvule(ctx, a, c);
+            break;
+        case FZ_OP_SLT:
+            res = Z3_mk_bvslt(ctx, a, c);
+            break;
+        case FZ_OP_SLE:
+            res = Z3_mk_bvsle(ctx, a, c);
+            break;
+        case FZ_OP_BOOL_NOT:
+            res = Z3_mk_not(ctx, a);
+            break;
+        case FZ_OP_BOOL_AND: {
+            Z3_ast args[2] = {a, c};
+            res            = Z3_mk_and(ctx, 2, args);
+            break;
+        }
+        case FZ_OP_BOOL_OR: {
+            Z3_ast args[2] = {a, c};
+            res            = Z3_mk_or(ctx, 2, args);
+            break;
+        }
+        default:
+            FZ_SOLVER_ABORT("fz_z3_translate(): invalid op");
+    }
+
+    Z3_inc_ref(ctx, res);
+    t->asts[e] = res;
+    return res;
+}
+
+typedef struct fz_z3_fallback_t {
+    Z3_config          z3_cfg;
+    Z3_context         z3_ctx;
+    fuzzy_ctx_t*       fctx;
+    fz_z3_translator_t translator;
+} fz_z3_fallback_t;
+
+static void fz_z3_notify_constraint(void* data, fz_expr_t constraint)
+{
+    fz_z3_fallback_t* f = (fz_z3_fallback_t*)data;
+    z3fuzz_notify_constraint(f->fctx,
+                             fz_z3_translate(&f->translator, constraint));
+}
+
+static int fz_z3_query_check_light(void* data, fz_expr_t pi,
+                                   fz_expr_t             branch_condition,
+                                   unsigned char const** proof,
+                                   unsigned long*        proof_size)
+{
+    fz_z3_fallback_t* f = (fz_z3_fallback_t*)data;
+    return z3fuzz_query_check_light(
+        f->fctx, fz_z3_translate(&f->translator, pi),
+        fz_z3_translate(&f->translator, branch_condition), proof, proof_size);
+}
+
+static void fz_z3_free(void* data)
+{
+    fz_z3_fallback_t* f = (fz_z3_fallback_t*)data;
+    fz_z3_translator_free(&f->translator);
+    z3fuzz_free(f->fctx);
+    free(f->fctx);
+    Z3_del_context(f->z3_ctx);
+    Z3_del_config(f->z3_cfg);
+    free(f);
+}
+
+void fz_solver_attach_z3(fz_solver_t* s)
+{
+    fz_z3_fallback_t* f = (fz_z3_fallback_t*)malloc(sizeof(fz_z3_fallback_t));
+    if (f == NULL)
+        FZ_SOLVER_ABORT("fz_solver_attach_z3(): malloc failed");
+
+    unsigned long        seed_len;
+    const unsigned char* seed = fz_solver_seed(s, &seed_len);
+
+    f->z3_cfg = Z3_mk_config();
+    f->z3_ctx = Z3_mk_context(f->z3_cfg);
+    f->fctx   = z3fuzz_create_from_buffer(f->z3_ctx, seed, seed_len,
+                                        fz_solver_timeout(s));
+    fz_z3_translator_init(&f->translator, fz_solver_builder(s), f->z3_ctx,
+                          f->fctx->symbols, f->fctx->n_symbols);
+
+    fz_fallback_t fallback = {f, fz_z3_notify_constraint,
+                              fz_z3_query_check_light, fz_z3_free};
+    fz_solver_set_fallback(s, &fallback);
+}
@@ -0,0 +1,32 @@
+#ifndef FUZZY_EXPR_Z3_H
+#define FUZZY_EXPR_Z3_H
+
+#include <z3.h>
+#include "fuzzy-expr.h"
+
+// Optional Z3 side of the expression API: the translation of the
+// expressions to Z3 ASTs and the fallback of the native solver.
+
+// the input byte i is symbols[i], a 8-bit Z3 constant
+typedef struct fz_z3_translator_t {
+    fz_builder_t* builder;
+    Z3_context    ctx;
+    Z3_ast*       symbols;
+    unsigned long n_symbols;
+
+    // translation of the expressions of the builder, indexed by id
+    Z3_ast*  asts;
+    uint32_t asts_size;
+} fz_z3_translator_t;
+
+void   fz_z3_translator_init(fz_z3_translator_t* t, fz_builder_t* b,
+                             Z3_context ctx, Z3_ast* symbols,
+                             unsigned long n_symbols);
+void   fz_z3_translator_free(fz_z3_translator_t* t);
+Z3_ast fz_z3_translate(fz_z3_translator_t* t, fz_expr_t e);
+
+// the queries that the native search does not prove are run by the
+// z3fuzz_* solver, created on the seed and the timeout of s
+void fz_solver_attach_z3(fz_solver_t* s);
+
+#endif
@@ -0,0 +1,462 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fuzzy-expr.h"
+
+#define FZ_ABORT(x...)                                                         \
+    do {                                                                       \
+        fprintf(stderr, "[fuzzy-expr ABORT] " x);                              \
+        fprintf(stderr, "\n");                                                 \
+        abort();                                                               \
+    } while (0)
+#define FZ_CHECK(x, mex...)                                                    \
+    if (!(x))                                                                  \
+        FZ_ABORT(mex);
+
+#define FZ_INITIAL_TABLE_SIZE 1024
+
+static inline uint64_t fz_mask(unsigned width)
+{
+    return width >= 64 ? (uint64_t)-1 : (width == 0 ? 1 : (1UL << width) - 1);
+}
+
+static inline int64_t fz_signed(uint64_t v, unsigned width)
+{
+    if (width >= 64 || width == 0)
+        return (int64_t)v;
+    if ((v >> (width - 1)) & 1)
+        return (int64_t)(v | ~fz_mask(width));
+    return (int64_t)v;
+}
+
+static inline uint64_t fz_hash(const fz_node_t* n)
+{
+    uint64_t h = n->op | ((uint64_t)n->width << 8) | ((uint64_t)n->hi << 16) |
+                 ((uint64_t)n->lo << 24);
+    h ^= ((uint64_t)n->args[0] << 32) | n->args[1];
+    h *= 0x9e3779b97f4a7c15UL;
+    h ^= n->args[2] + (n->value * 0xbf58476d1ce4e5b9UL);
+    h ^= h >> 31;
+    h *= 0x94d049bb133111ebUL;
+    return h ^ (h >> 29);
+}
+
+static inline int fz_node_equals(const fz_node_t* a, const fz_node_t* b)
+{
+    return a->op == b->op && a->width == b->width && a->hi == b->hi &&
+           a->lo == b->lo && a->args[0] == b->args[0] &&
+           a->args[1] == b->args[1] && a->args[2] == b->args[2] &&
+           a->value == b->value;
+}
+
+void fz_builder_init(fz_builder_t* b)
+{
+    b->chunks    = (fz_node_t**)malloc(sizeof(fz_node_t*));
+    b->chunks[0] = (fz_node_t*)malloc(sizeof(fz_node_t) * FZ_CHUNK_SIZE);
+    FZ_CHECK(b->chunks != NULL && b->chunks[0] != NULL,
+             "fz_builder_init(): malloc failed");
+    b->n_chunks = 1;
+    b->n_nodes  = 1;
+
+    b->table_size = FZ_INITIAL_TABLE_SIZE;
+    b->table      = (fz_expr_t*)calloc(b->table_size, sizeof(fz_expr_t));
+    FZ_CHECK(b->table != NULL, "fz_builder_init(): calloc failed");
+
+    b->eval_values = NULL;
+    b->eval_epochs = NULL;
+    b->eval_size   = 0;
+    b->eval_epoch  = 0;
+}
+
+void fz_builder_free(fz_builder_t* b)
+{
+    uint32_t i;
+    for (i = 0; i < b->n_chunks; ++i)
+        free(b->chunks[i]);
+    free(b->chunks);
+    free(b->table);
+    free(b->eval_values);
+    free(b->eval_epochs);
+    memset(b, 0, sizeof(fz_builder_t));
+}
+
+static void fz_table_grow(fz_builder_t* b)
+{
+    uint32_t   new_size  = b->table_size * 2;
+    fz_expr_t* new_table = (fz_expr_t*)calloc(new_size, sizeof(fz_expr_t));
+    FZ_CHECK(new_table != NULL, "fz_table_grow(): calloc failed");
+
+    uint32_t i;
+    for (i = 0; i < b->table_size; ++i) {
+        fz_expr_t e = b->table[i];
+        if (e == FZ_INVALID)
+            continue;
+        uint32_t slot = fz_hash(fz_node(b, e)) & (new_size - 1);
+        while (new_table[slot] != FZ_INVALID)
+            slot = (slot + 1) & (new_size - 1);
+        new_table[slot] = e;
+    }
+    free(b->table);
+    b->table      = new_table;
+    b->table_size = new_size;
+}
+
+static fz_expr_t fz_intern(fz_builder_t* b, const fz_node_t* n)
+{
+    uint32_t slot = fz_hash(n) & (b->table_size - 1);
+    while (b->table[slot] != FZ_INVALID) {
+        if (fz_node_equals(fz_node(b, b->table[slot]), n))
+            return b->table[slot];
+        slot = (slot + 1) & (b->table_size - 1);
+    }
+
+    if (b->n_nodes == b->n_chunks * FZ_CHUNK_SIZE) {
+        b->chunks = (fz_node_t**)realloc(b->chunks, sizeof(fz_node_t*) *
+                                                        (b->n_chunks + 1));
+        FZ_CHECK(b->chunks != NULL, "fz_intern(): realloc failed");
+        b->chunks[b->n_chunks] =
+            (fz_node_t*)malloc(sizeof(fz_node_t) * FZ_CHUNK_SIZE);
+        FZ_CHECK(b->chunks[b->n_chunks] != NULL, "fz_intern(): malloc failed");
+        b->n_chunks++;
+    }
+
+    fz_expr_t e = b->n_nodes++;
+    *(fz_node_t*)fz_node(b, e) = *n;
+    b->table[slot]             = e;
+
+    // keep the load factor under 1/2
+    if (2 * b->n_nodes > b->table_size)
+        fz_table_grow(b);
+    return e;
+}
+
+static inline unsigned fz_width(fz_builder_t* b, fz_expr_t e)
+{
+    FZ_CHECK(e != FZ_INVALID && e < b->n_nodes, "invalid expression %u", e);
+    return fz_node(b, e)->width;
+}
+
+static inline fz_node_t fz_mk_node(fz_op_t op, unsigned width)
+{
+    fz_node_t n;
+    memset(&n, 0, sizeof(fz_node_t));
+    n.op    = op;
+    n.width = width;
+    return n;
+}
+
+fz_expr_t fz_input(fz_builder_t* b, uint64_t idx)
+{
+    fz_node_t n = fz_mk_node(FZ_OP_INPUT, 8);
+    n.value     = idx;
+    return fz_intern(b, &n);
+}
+
+fz_expr_t fz_const(fz_builder_t* b, uint64_t value, unsigned width)
+{
+    FZ_CHECK(width > 0 && width <= FZ_MAX_WIDTH, "invalid width %u", width);
+    fz_node_t n = fz_mk_node(FZ_OP_CONST, width);
+    n.value     = value & fz_mask(width);
+    return fz_intern(b, &n);
+}
+
+fz_expr_t fz_true(fz_builder_t* b)
+{
+    fz_node_t n = fz_mk_node(FZ_OP_CONST, 0);
+    n.value     = 1;
+    return fz_intern(b, &n);
+}
+
+fz_expr_t fz_false(fz_builder_t* b)
+{
+    fz_node_t n = fz_mk_node(FZ_OP_CONST, 0);
+    return fz_intern(b, &n);
+}
+
+fz_expr_t fz_unary(fz_builder_t* b, fz_op_t op, fz_expr_t a)
+{
+    unsigned width = fz_width(b, a);
+    switch (op) {
+        case FZ_OP_NOT:
+        case FZ_OP_NEG:
+            FZ_CHECK(width > 0, "fz_unary(): not a bitvector");
+            break;
+        case FZ_OP_BOOL_NOT:
+            FZ_CHECK(width == 0, "fz_unary(): not a boolean");
+            break;
+        default:
+            FZ_ABORT("fz_unary(): invalid op %d", op);
+    }
+
+    fz_node_t n = fz_mk_node(op, width);
+    n.args[0]   = a;
+    return fz_intern(b, &n);
+}
+
+fz_expr_t fz_binary(fz_builder_t* b, fz_op_t op, fz_expr_t a, fz_expr_t c)
+{
+    unsigned wa = fz_width(b, a);
+    unsigned wc = fz_width(b, c);
+    unsigned width;
+    switch (op) {
+        case FZ_OP_ADD:
+        case FZ_OP_SUB:
+        case FZ_OP_MUL:
+        case FZ_OP_UDIV:
+        case FZ_OP_SDIV:
+        case FZ_OP_UREM:
+        case FZ_OP_SREM:
+        case FZ_OP_AND:
+        case FZ_OP_OR:
+        case FZ_OP_XOR:
+        case FZ_OP_SHL:
+        case FZ_OP_LSHR:
+        case FZ_OP_ASHR:
+            FZ_CHECK(wa > 0 && wa == wc, "fz_binary(): invalid widths");
+            width = wa;
+            break;
+        case FZ_OP_CONCAT:
+            FZ_CHECK(wa > 0 && wc > 0 && wa + wc <= FZ_MAX_WIDTH,
+                     "fz_binary(): invalid widths");
+            width = wa + wc;
+            break;
+        case FZ_OP_EQ:
+            FZ_CHECK(wa == wc, "fz_binary(): invalid widths");
+            width = 0;
+            break;
+        case FZ_OP_ULT:
+        case FZ_OP_ULE:
+        case FZ_OP_SLT:
+        case FZ_OP_SLE:
+            FZ_CHECK(wa > 0 && wa == wc, "fz_binary(): invalid widths");
+            width = 0;
+            break;
+        case FZ_OP_BOOL_AND:
+        case FZ_OP_BOOL_OR:
+            FZ_CHECK(wa == 0 && wc == 0, "fz_binary(): not a boolean");
+            width = 0;
+            break;
+        default:
+            FZ_ABORT("fz_binary(): invalid op %d", op);
+    }
+
+    fz_node_t n = fz_mk_node(op, width);
+    n.args[0]   = a;
+    n.args[1]   = c;
+    return fz_intern(b, &n);
+}
+
+fz_expr_t fz_extract(fz_builder_t* b, fz_expr_t a, unsigned hi, unsigned lo)
+{
+    FZ_CHECK(lo <= hi && hi < fz_width(b, a), "fz_extract(): invalid bits");
+    fz_node_t n = fz_mk_node(FZ_OP_EXTRACT, hi - lo + 1);
+    n.args[0]   = a;
+    n.hi        = hi;
+    n.lo        = lo;
+    return fz_intern(b, &n);
+}
+
+static fz_expr_t fz_ext(fz_builder_t* b, fz_op_t op, fz_expr_t a, unsigned n)
+{
+    unsigned width = fz_width(b, a);
+    FZ_CHECK(width > 0 && width + n <= FZ_MAX_WIDTH,
+             "fz_zext/sext(): invalid width");
+    if (n == 0)
+        return a;
+
+    fz_node_t node = fz_mk_node(op, width + n);
+    node.args[0]   = a;
+    return fz_intern(b, &node);
+}
+
+fz_expr_t fz_zext(fz_builder_t* b, fz_expr_t a, unsigned n)
+{
+    return fz_ext(b, FZ_OP_ZEXT, a, n);
+}
+
+fz_expr_t fz_sext(fz_builder_t* b, fz_expr_t a, unsigned n)
+{
+    return fz_ext(b, FZ_OP_SEXT, a, n);
+}
+
+fz_expr_t fz_ite(fz_builder_t* b, fz_expr_t cond, fz_expr_t a, fz_expr_t c)
+{
+    FZ_CHECK(fz_width(b, cond) == 0, "fz_ite(): the condition is not boolean");
+    FZ_CHECK(fz_width(b, a) == fz_width(b, c), "fz_ite(): invalid widths");
+    fz_node_t n = fz_mk_node(FZ_OP_ITE, fz_width(b, a));
+    n.args[0]   = cond;
+    n.args[1]   = a;
+    n.args[2]   = c;
+    return fz_intern(b, &n);
+}
+
+static uint64_t fz_eval_node(fz_builder_t* b, fz_expr_t e,
+                             const unsigned char* input,
+                             unsigned long        input_size)
+{
+    if (b->eval_epochs[e] == b->eval_epoch)
+        return b->eval_values[e];
+
+    const fz_node_t* n  = fz_node(b, e);
+    unsigned         w  = n->width;
+    unsigned         wa = 0;
+    uint64_t         a = 0, c = 0, res = 0;
+    int64_t          sa, sc;
+
+    if (n->op == FZ_OP_ITE) {
+        // only the taken branch is evaluated
+        res = fz_eval_node(b, n->args[0], input, input_size)
+                  ? fz_eval_node(b, n->args[1], input, input_size)
+                  : fz_eval_node(b, n->args[2], input, input_size);
+        goto OUT;
+    }
+    if (n->op != FZ_OP_INPUT && n->op != FZ_OP_CONST) {
+        a  = fz_eval_node(b, n->args[0], input, input_size);
+        wa = fz_node(b, n->args[0])->width;
+        if (n->args[1] != FZ_INVALID)
+            c = fz_eval_node(b, n->args[1], input, input_size);
+    }
+    sa = fz_signed(a, wa);
+    sc = fz_signed(c, wa);
+
+    switch (n->op) {
+        case FZ_OP_INPUT:
+            res = n->value < input_size ? input[n->value] : 0;
+            break;
+        case FZ_OP_CONST:
+            res = n->value;
+            break;
+        case FZ_OP_NOT:
+            res = ~a;
+            break;
+        case FZ_OP_NEG:
+            res = -a;
+            break;
+        case FZ_OP_ADD:
+            res = a + c;
+            break;
+        case FZ_OP_SUB:
+            res = a - c;
+            break;
+        case FZ_OP_MUL:
+            res = a * c;
+            break;
+        case FZ_OP_UDIV:
+            // division by zero as in SMT-LIB
+            res = c == 0 ? (uint64_t)-1 : a / c;
+            break;
+        case FZ_OP_UREM:
+            res = c == 0 ? a : a % c;
+            break;
+        case FZ_OP_SDIV: {
+            uint64_t ua = sa < 0 ? -(uint64_t)sa : (uint64_t)sa;
+            uint64_t uc = sc < 0 ? -(uint64_t)sc : (uint64_t)sc;
+            if (c == 0)
+                res = sa < 0 ? 1 : (uint64_t)-1;
+            else {
+                res = ua / uc;
+                if ((sa < 0) != (sc < 0))
+                    res = -res;
+            }
+            break;
+        }
+        case FZ_OP_SREM: {
+            uint64_t ua = sa < 0 ? -(uint64_t)sa : (uint64_t)sa;
+            uint64_t uc = sc < 0 ? -(uint64_t)sc : (uint64_t)sc;
+            if (c == 0)
+                res = a;
+            else {
+                res = ua % uc;
+                if (sa < 0)
+                    res = -res;
+            }
+            break;
+        }
+        case FZ_OP_AND:
+            res = a & c;
+            break;
+        case FZ_OP_OR:
+            res = a | c;
+            break;
+        case FZ_OP_XOR:
+            res = a ^ c;
+            break;
+        case FZ_OP_SHL:
+            res = c >= w ? 0 : a << c;
+            break;
+        case FZ_OP_LSHR:
+            res = c >= w ? 0 : a >> c;
+            break;
+        case FZ_OP_ASHR:
+            res = c >= w ? (sa < 0 ? (uint64_t)-1 : 0) : (uint64_t)(sa >> c);
+            break;
+        case FZ_OP_CONCAT:
+            res = (a << fz_node(b, n->args[1])->width) | c;
+            break;
+        case FZ_OP_EXTRACT:
+            res = a >> n->lo;
+            break;
+        case FZ_OP_ZEXT:
+            res = a;
+            break;
+        case FZ_OP_SEXT:
+            res = (uint64_t)sa;
+            break;
+        case FZ_OP_EQ:
+            res = a == c;
+            break;
+        case FZ_OP_ULT:
+            res = a < c;
+            break;
+        case FZ_OP_ULE:
+            res = a <= c;
+            break;
+        case FZ_OP_SLT:
+            res = sa < sc;
+            break;
+        case FZ_OP_SLE:
+            res = sa <= sc;
+            break;
+        case FZ_OP_BOOL_NOT:
+            res = !a;
+            break;
+        case FZ_OP_BOOL_AND:
+            res = a && c;
+            break;
+        case FZ_OP_BOOL_OR:
+            res = a || c;
+            break;
+        default:
+            FZ_ABORT("fz_eval(): invalid op %d", n->op);
+    }
+
+OUT:
+    res &= fz_mask(w);
+    b->eval_values[e] = res;
+    b->eval_epochs[e] = b->eval_epoch;
+    return res;
+}
+
+uint64_t fz_eval(fz_builder_t* b, fz_expr_t e, const unsigned char* input,
+                 unsigned long input_size)
+{
+    FZ_CHECK(e != FZ_INVALID && e < b->n_nodes, "invalid expression %u", e);
+
+    // shared subexpressions are evaluated once per call
+    if (b->eval_size < b->n_nodes) {
+        b->eval_values =
+            (uint64_t*)realloc(b->eval_values, sizeof(uint64_t) * b->n_nodes);
+        b->eval_epochs =
+            (uint32_t*)realloc(b->eval_epochs, sizeof(uint32_t) * b->n_nodes);
+        FZ_CHECK(b->eval_values != NULL && b->eval_epochs != NULL,
+                 "fz_eval(): realloc failed");
+        memset(b->eval_epochs + b->eval_size, 0,
+               sizeof(uint32_t) * (b->n_nodes - b->eval_size));
+        b->eval_size = b->n_nodes;
+    }
+    if (++b->eval_epoch == 0) {
+        memset(b->eval_epochs, 0, sizeof(uint32_t) * b->eval_size);
+        b->eval_epoch = 1;
+    }
+    return fz_eval_node(b, e, input, input_size);
+}
@@ -0,0 +1,161 @@
+#ifndef FUZZY_EXPR_H
+#define FUZZY_EXPR_H
+
+#include <stdint.h>
+
+// Expression builder for clients that do not want to deal with Z3 ASTs.
+// Expressions are hash-consed bitvectors (up to 64 bits) or booleans
+// stored in an arena owned by the builder and referenced by id: building
+// the same expression twice gives the same id. Building, evaluating and
+// solving expressions does not use Z3: the fz_solver_* functions mutate the
+// seed and check the candidates with fz_eval(). A fallback (e.g. the Z3
+// based one of fuzzy-expr-z3.h) can be attached for the queries that the
+// native solver does not prove.
+//
+// The native solver is a reduced heuristic one, independent of the phases of
+// z3-fuzzy.h: it has no intervals, no optimistic solutions, no testcases to
+// reuse and no stats, so on the same queries its results differ from the
+// ones of z3fuzz_* (fuzzy-expr-test compare measures how much). Use the Z3
+// fallback when the full search is needed.
+
+#define FZ_INVALID 0
+#define FZ_MAX_WIDTH 64
+#define FZ_CHUNK_BITS 12
+#define FZ_CHUNK_SIZE (1 << FZ_CHUNK_BITS)
+
+// same values of fuzzy_findall_res_t
+#define FZ_GIVE_NEXT 0
+#define FZ_STOP 1
+#define FZ_JUST_LAST 2
+
+typedef uint32_t fz_expr_t;
+
+typedef enum fz_op_t {
+    FZ_OP_INPUT, // byte of the input, value is its index
+    FZ_OP_CONST,
+    // bitvector
+    FZ_OP_NOT,
+    FZ_OP_NEG,
+    FZ_OP_ADD,
+    FZ_OP_SUB,
+    FZ_OP_MUL,
+    FZ_OP_UDIV,
+    FZ_OP_SDIV,
+    FZ_OP_UREM,
+    FZ_OP_SREM,
+    FZ_OP_AND,
+    FZ_OP_OR,
+    FZ_OP_XOR,
+    FZ_OP_SHL,
+    FZ_OP_LSHR,
+    FZ_OP_ASHR,
+    FZ_OP_CONCAT,
+    FZ_OP_EXTRACT,
+    FZ_OP_ZEXT,
+    FZ_OP_SEXT,
+    FZ_OP_ITE,
+    // boolean
+    FZ_OP_EQ,
+    FZ_OP_ULT,
+    FZ_OP_ULE,
+    FZ_OP_SLT,
+    FZ_OP_SLE,
+    FZ_OP_BOOL_NOT,
+    FZ_OP_BOOL_AND,
+    FZ_OP_BOOL_OR,
+    FZ_OP_N
+} fz_op_t;
+
+typedef struct fz_node_t {
+    uint8_t   op;
+    uint8_t   width; // 0 for booleans
+    uint8_t   hi;    // extract
+    uint8_t   lo;
+    fz_expr_t args[3];
+    uint64_t  value; // constant, or index of the input byte
+} fz_node_t;
+
+typedef struct fz_builder_t {
+    fz_node_t** chunks;
+    uint32_t    n_chunks;
+    uint32_t    n_nodes; // id 0 is FZ_INVALID
+
+    // hash-consing table of ids, open addressing
+    fz_expr_t* table;
+    uint32_t   table_size;
+
+    // scratch space of fz_eval()
+    uint64_t* eval_values;
+    uint32_t* eval_epochs;
+    uint32_t  eval_size;
+    uint32_t  eval_epoch;
+} fz_builder_t;
+
+void fz_builder_init(fz_builder_t* b);
+void fz_builder_free(fz_builder_t* b);
+
+static inline const fz_node_t* fz_node(const fz_builder_t* b, fz_expr_t e)
+{
+    return &b->chunks[e >> FZ_CHUNK_BITS][e & (FZ_CHUNK_SIZE - 1)];
+}
+
+fz_expr_t fz_input(fz_builder_t* b, uint64_t idx);
+fz_expr_t fz_const(fz_builder_t* b, uint64_t value, unsigned width);
+fz_expr_t fz_true(fz_builder_t* b);
+fz_expr_t fz_false(fz_builder_t* b);
+fz_expr_t fz_unary(fz_builder_t* b, fz_op_t op, fz_expr_t a);
+fz_expr_t fz_binary(fz_builder_t* b, fz_op_t op, fz_expr_t a, fz_expr_t c);
+fz_expr_t fz_extract(fz_builder_t* b, fz_expr_t a, unsigned hi, unsigned lo);
+fz_expr_t fz_zext(fz_builder_t* b, fz_expr_t a, unsigned n);
+fz_expr_t fz_sext(fz_builder_t* b, fz_expr_t a, unsigned n);
+fz_expr_t fz_ite(fz_builder_t* b, fz_expr_t cond, fz_expr_t a, fz_expr_t c);
+
+// value of e on the input bytes, booleans are 0 or 1
+uint64_t fz_eval(fz_builder_t* b, fz_expr_t e, const unsigned char* input,
+                 unsigned long input_size);
+
+// the solver
+typedef struct fz_solver_t fz_solver_t;
+
+// called when the native search fails, data is owned by the fallback
+typedef struct fz_fallback_t {
+    void* data;
+    void (*notify_constraint)(void* data, fz_expr_t constraint);
+    int (*query_check_light)(void* data, fz_expr_t pi,
+                             fz_expr_t             branch_condition,
+                             unsigned char const** proof,
+                             unsigned long*        proof_size);
+    void (*free)(void* data);
+} fz_fallback_t;
+
+// the seed is copied, timeout is in milliseconds
+fz_solver_t* fz_solver_create(fz_builder_t* b, const unsigned char* seed,
+                              unsigned long seed_len, unsigned timeout);
+void         fz_solver_free(fz_solver_t* s);
+void fz_solver_set_fallback(fz_solver_t* s, const fz_fallback_t* fallback);
+
+fz_builder_t*        fz_solver_builder(fz_solver_t* s);
+const unsigned char* fz_solver_seed(fz_solver_t* s, unsigned long* seed_len);
+unsigned             fz_solver_timeout(fz_solver_t* s);
+
+// the bytes fixed to a constant by the constraint are not mutated anymore
+void fz_notify_constraint(fz_solver_t* s, fz_expr_t constraint);
+// 1 if the proof satisfies the branch condition, inputs satisfying pi too
+// are preferred (z3fuzz_query_check_light() requires both). The proof is
+// valid until the next call
+int           fz_query_check_light(fz_solver_t* s, fz_expr_t pi,
+                                   fz_expr_t             branch_condition,
+                                   unsigned char const** proof,
+                                   unsigned long*        proof_size);
+unsigned long fz_maximize(fz_solver_t* s, fz_expr_t pi, fz_expr_t e,
+                          unsigned char const** out_values,
+                          unsigned long*        out_len);
+unsigned long fz_minimize(fz_solver_t* s, fz_expr_t pi, fz_expr_t e,
+                          unsigned char const** out_values,
+                          unsigned long*        out_len);
+void          fz_find_all_values(fz_solver_t* s, fz_expr_t e, fz_expr_t pi,
+                                 int (*callback)(unsigned char const* out_bytes,
+                                        unsigned long        out_bytes_len,
+                                        unsigned long        val));
+
+#endif
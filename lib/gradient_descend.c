@@ -49,6 +49,8 @@
 #define EXIT_ERROR 0xffff
 #define EXIT_OK 1
 
+#define GD_CALL(f, x, should_exit) (f)->eval((f)->opaque, (x), (should_exit))
+
 static inline uint8_t saturating_add8(uint8_t a, uint8_t b)
 {
     return (a > 0xFF - b) ? 0xFF : a + b;
@@ -92,17 +94,17 @@ static __attribute__((unused)) void debug_dump_vector(char* name, uint64_t* v,
 }
 
 static int partial_derivative(gradient_el_t* out_grad_el,
-                              uint64_t (*function)(uint64_t*, int*), int64_t f0,
-                              uint64_t* x0, uint32_t i)
+                              gd_function_t* function, int64_t f0, uint64_t* x0,
+                              uint32_t i)
 {
     int      should_exit;
     uint64_t original_val = x0[i];
     x0[i]                 = original_val + 1;
-    int64_t f_plus        = (int64_t)function(x0, &should_exit);
+    int64_t f_plus        = (int64_t)GD_CALL(function, x0, &should_exit);
     if (unlikely(should_exit))
         return EXIT_ERROR;
     x0[i]           = original_val - 1;
-    int64_t f_minus = (int64_t)function(x0, &should_exit);
+    int64_t f_minus = (int64_t)GD_CALL(function, x0, &should_exit);
     if (unlikely(should_exit))
         return EXIT_ERROR;
     x0[i] = original_val;
@@ -147,9 +149,8 @@ static int partial_derivative(gradient_el_t* out_grad_el,
     ASSERT_OR_ABORT(0, "partial_derivative - should be unreachable");
 }
 
-static int compute_gradient(gradient_el_t* out_grad,
-                            uint64_t (*function)(uint64_t*, int*), int64_t f0,
-                            uint64_t* x0, uint32_t n)
+static int compute_gradient(gradient_el_t* out_grad, gd_function_t* function,
+                            int64_t f0, uint64_t* x0, uint32_t n)
 {
     uint32_t i;
     for (i = 0; i < n; ++i) {
@@ -225,9 +226,8 @@ static void compute_delta_all(uint64_t* x, gradient_el_t* grad, uint64_t step,
     }
 }
 
-static int descend(uint64_t (*function)(uint64_t*, int*), gradient_el_t* grad,
-                   uint64_t* x0, int64_t f0, uint64_t* out_x, int64_t* out_f,
-                   uint32_t n)
+static int descend(gd_function_t* function, gradient_el_t* grad, uint64_t* x0,
+                   int64_t f0, uint64_t* out_x, int64_t* out_f, uint32_t n)
 {
 #if DEBUG_DESCEND
     fprintf(stderr, ">>> DESCEND\n");
@@ -261,7 +261,7 @@ static int descend(uint64_t (*function)(uint64_t*, int*), gradient_el_t* grad,
                 x0_tmp[UR(n)] ^= (UR(256) + 1) << 24;
                 break;
         }
-        int64_t f_val = function(x0_tmp, &should_exit);
+        int64_t f_val = GD_CALL(function, x0_tmp, &should_exit);
         if (unlikely(should_exit)) {
             res = EXIT_ERROR;
             goto OUT;
@@ -283,7 +283,7 @@ static int descend(uint64_t (*function)(uint64_t*, int*), gradient_el_t* grad,
         memcpy(x_prev, x_next, sizeof(uint64_t) * n);
         compute_delta_all(x_next, grad, step, n, 1);
 
-        f_next = function(x_next, &should_exit);
+        f_next = GD_CALL(function, x_next, &should_exit);
         if (unlikely(should_exit)) {
             res = EXIT_ERROR;
             goto OUT;
@@ -326,7 +326,7 @@ static int descend(uint64_t (*function)(uint64_t*, int*), gradient_el_t* grad,
                 ASSERT_OR_ABORT(0, "descend - should be unreachable");
             }
 
-            f_next = function(x_next, &should_exit);
+            f_next = GD_CALL(function, x_next, &should_exit);
             if (unlikely(should_exit)) {
                 res = EXIT_ERROR;
                 goto OUT;
@@ -364,8 +364,8 @@ OUT:
     return res;
 }
 
-int gd_minimize(uint64_t (*function)(uint64_t*, int*), uint64_t* x0,
-                uint64_t* out_x_min, uint64_t* out_f_min, uint32_t n)
+static int minimize(gd_function_t* function, uint64_t* x0, uint64_t* out_x_min,
+                    uint64_t* out_f_min, uint32_t n)
 {
 #if DEBUG_MINIMIZE
     uint32_t j;
@@ -374,7 +374,7 @@ int gd_minimize(uint64_t (*function)(uint64_t*, int*), uint64_t* x0,
         fprintf(stderr, "x0[%u]: 0x%016lx\n", j, x0[j]);
     }
     int dummy;
-    fprintf(stderr, "f0: 0x%016lx\n", function(x0, &dummy));
+    fprintf(stderr, "f0: 0x%016lx\n", GD_CALL(function, x0, &dummy));
 
 #endif
     int            res = EXIT_OK;
@@ -385,7 +385,7 @@ int gd_minimize(uint64_t (*function)(uint64_t*, int*), uint64_t* x0,
     uint64_t* x_next = out_x_min;
     memcpy(x_next, x0, n * sizeof(uint64_t));
 
-    int64_t f_prev = (int64_t)function(x0, &should_exit);
+    int64_t f_prev = (int64_t)GD_CALL(function, x0, &should_exit);
     if (unlikely(should_exit)) {
         res = EXIT_ERROR;
         goto OUT;
@@ -408,7 +408,7 @@ int gd_minimize(uint64_t (*function)(uint64_t*, int*), uint64_t* x0,
         uint64_t max_grad = max_gradient(gradient, n);
         while (max_grad == 0 && i++ < MAX_RANDOM_INPUT) {
             x_prev[UR(n)] ^= UR(256);
-            f_prev = function(x0, &should_exit);
+            f_prev = GD_CALL(function, x0, &should_exit);
             if (unlikely(should_exit)) {
                 res = EXIT_ERROR;
                 goto OUT;
@@ -485,18 +485,19 @@ static void           init_tmp_gradient(uint32_t n)
     }
 }
 
-int gd_descend_transf(uint64_t (*function)(uint64_t*, int*), uint64_t* x0,
-                      uint64_t* out_x, uint64_t* out_f, uint32_t n)
+size_t gd_scratch_size(uint32_t n) { return n * sizeof(gradient_el_t); }
+
+int gd_descend_transf_r(gd_function_t* function, uint64_t* x0, uint64_t* out_x,
+                        uint64_t* out_f, uint32_t n, void* scratch)
 {
 #if DEBUG_DESC_TRANSF
     debug_dump_vector("x0 (desc)", x0, n);
 #endif
 
-    int should_exit;
-    init_tmp_gradient(n);
-    gradient_el_t* gradient = __tmp_gradient;
+    int            should_exit;
+    gradient_el_t* gradient = (gradient_el_t*)scratch;
 
-    int64_t f0 = function(x0, &should_exit);
+    int64_t f0 = GD_CALL(function, x0, &should_exit);
     if (unlikely(should_exit))
         return EXIT_ERROR;
 
@@ -520,18 +521,47 @@ int gd_descend_transf(uint64_t (*function)(uint64_t*, int*), uint64_t* x0,
     return 0;
 }
 
+// the functions without user data
+typedef struct gd_plain_function_t {
+    uint64_t (*function)(uint64_t*, int*);
+} gd_plain_function_t;
+
+static uint64_t gd_call_plain(void* opaque, uint64_t* x, int* should_exit)
+{
+    return ((gd_plain_function_t*)opaque)->function(x, should_exit);
+}
+
+int gd_minimize(uint64_t (*function)(uint64_t*, int*), uint64_t* x0,
+                uint64_t* out_x_min, uint64_t* out_f_min, uint32_t n)
+{
+    gd_plain_function_t plain = {function};
+    gd_function_t       f     = {gd_call_plain, &plain};
+    return minimize(&f, x0, out_x_min, out_f_min, n);
+}
+
+int gd_descend_transf(uint64_t (*function)(uint64_t*, int*), uint64_t* x0,
+                      uint64_t* out_x, uint64_t* out_f, uint32_t n)
+{
+    gd_plain_function_t plain = {function};
+    gd_function_t       f     = {gd_call_plain, &plain};
+    init_tmp_gradient(n);
+    return gd_descend_transf_r(&f, x0, out_x, out_f, n, __tmp_gradient);
+}
+
 int gd_max_gradient(uint64_t (*function)(uint64_t*, int*), uint64_t* x0,
                     uint32_t n, uint64_t* v)
 {
+    gd_plain_function_t plain = {function};
+    gd_function_t       f     = {gd_call_plain, &plain};
     init_tmp_gradient(n);
 
     int     should_exit;
-    int64_t f0 = function(x0, &should_exit);
+    int64_t f0 = GD_CALL(&f, x0, &should_exit);
     if (unlikely(should_exit))
         return 0;
 
     gradient_el_t* gradient = __tmp_gradient;
-    int            grad_res = compute_gradient(gradient, function, f0, x0, n);
+    int            grad_res = compute_gradient(gradient, &f, f0, x0, n);
     if (unlikely(grad_res == EXIT_ERROR))
         return 0;
 
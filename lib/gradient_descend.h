@@ -1,8 +1,15 @@
 #ifndef GRADIENT_DESCEND_H
 #define GRADIENT_DESCEND_H
 
+#include <stddef.h>
 #include <stdint.h>
 
+// function to minimize, with its user data
+typedef struct gd_function_t {
+    uint64_t (*eval)(void* opaque, uint64_t* x, int* should_exit);
+    void* opaque;
+} gd_function_t;
+
 void gd_init();
 void gd_free();
 
@@ -14,4 +21,10 @@ int gd_descend_transf(uint64_t (*function)(uint64_t*, int*), uint64_t* x0,
 int gd_max_gradient(uint64_t (*function)(uint64_t*, int*), uint64_t* x0,
                     uint32_t n, uint64_t* v);
 
+// reentrant gd_descend_transf, scratch is gd_scratch_size(n) bytes
+size_t gd_scratch_size(uint32_t n);
+int    gd_descend_transf_r(gd_function_t* function, uint64_t* x0,
+                           uint64_t* out_x, uint64_t* out_f, uint32_t n,
+                           void* scratch);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,296 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include "metrics.h"
+
+#define METRICS_LOG(x...) fprintf(stderr, "[metrics] " x)
+
+#define METRICS_PREFIX "z3fuzz_"
+#define METRICS_BUFFER_SIZE (METRICS_MAX_COUNTERS * 160 + 1024)
+
+static __thread int metrics_shard_id = -1;
+
+static uint64_t metrics_now_msec(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+static inline metrics_shard_t* metrics_shard(metrics_t* m)
+{
+    // threads beyond METRICS_MAX_SHARDS share a shard, the atomic adds keep
+    // the counters exact
+    if (metrics_shard_id < 0)
+        metrics_shard_id =
+            __atomic_fetch_add(&m->n_shards, 1, __ATOMIC_RELAXED) %
+            METRICS_MAX_SHARDS;
+    return &m->shards[metrics_shard_id];
+}
+
+void metrics_add(metrics_t* m, unsigned id, uint64_t v)
+{
+    if (id >= m->n_descs || v == 0)
+        return;
+    __atomic_fetch_add(&metrics_shard(m)->values[id], v, __ATOMIC_RELAXED);
+}
+
+void metrics_set(metrics_t* m, unsigned id, uint64_t v)
+{
+    if (id >= m->n_descs)
+        return;
+    __atomic_store_n(&metrics_shard(m)->values[id], v, __ATOMIC_RELAXED);
+}
+
+void metrics_snapshot(metrics_t* m, uint64_t* values)
+{
+    unsigned i, j;
+    unsigned n_shards = __atomic_load_n(&m->n_shards, __ATOMIC_RELAXED);
+    if (n_shards > METRICS_MAX_SHARDS)
+        n_shards = METRICS_MAX_SHARDS;
+
+    memset(values, 0, sizeof(uint64_t) * m->n_descs);
+    for (i = 0; i < n_shards; ++i)
+        for (j = 0; j < m->n_descs; ++j)
+            values[j] +=
+                __atomic_load_n(&m->shards[i].values[j], __ATOMIC_RELAXED);
+}
+
+typedef struct metrics_buffer_t {
+    char     data[METRICS_BUFFER_SIZE];
+    unsigned size;
+} metrics_buffer_t;
+
+static void metrics_append(metrics_buffer_t* b, const char* fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(b->data + b->size, sizeof(b->data) - b->size, fmt, ap);
+    va_end(ap);
+    if (n > 0)
+        b->size += n;
+    if (b->size >= sizeof(b->data))
+        b->size = sizeof(b->data) - 1;
+}
+
+static uint64_t metrics_resident_memory(void)
+{
+    unsigned long size, resident;
+    FILE*         fp = fopen("/proc/self/statm", "r");
+    if (fp == NULL)
+        return 0;
+    int n = fscanf(fp, "%lu %lu", &size, &resident);
+    fclose(fp);
+    if (n != 2)
+        return 0;
+    return (uint64_t)resident * sysconf(_SC_PAGESIZE);
+}
+
+static void metrics_append_value(metrics_t* m, metrics_buffer_t* b,
+                                 const char* name, int kind, uint64_t v,
+                                 int first)
+{
+    if (m->format == METRICS_FORMAT_JSON) {
+        metrics_append(b, "%s\n  \"%s\": %lu", first ? "" : ",", name, v);
+        return;
+    }
+
+    if (kind == METRICS_COUNTER) {
+        metrics_append(b, "# TYPE " METRICS_PREFIX "%s_total counter\n", name);
+        metrics_append(b, METRICS_PREFIX "%s_total %lu\n", name, v);
+    } else {
+        metrics_append(b, "# TYPE " METRICS_PREFIX "%s gauge\n", name);
+        metrics_append(b, METRICS_PREFIX "%s %lu\n", name, v);
+    }
+}
+
+int metrics_write(metrics_t* m, int fd)
+{
+    static __thread metrics_buffer_t b;
+    uint64_t                         values[METRICS_MAX_COUNTERS];
+    unsigned                         i;
+
+    metrics_snapshot(m, values);
+
+    b.size = 0;
+    if (m->format == METRICS_FORMAT_JSON)
+        metrics_append(&b, "{");
+    metrics_append_value(m, &b, "uptime_msec", METRICS_GAUGE,
+                         metrics_now_msec() - m->start_msec, 1);
+    metrics_append_value(m, &b, "resident_memory_bytes", METRICS_GAUGE,
+                         metrics_resident_memory(), 0);
+    for (i = 0; i < m->n_descs; ++i)
+        metrics_append_value(m, &b, m->descs[i].name, m->descs[i].kind,
+                             values[i], 0);
+    if (m->format == METRICS_FORMAT_JSON)
+        metrics_append(&b, "\n}\n");
+
+    const char* p    = b.data;
+    unsigned    size = b.size;
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return 0;
+        p += n;
+        size -= n;
+    }
+    return 1;
+}
+
+static void metrics_export_file(metrics_t* m)
+{
+    // readers never see a partial snapshot
+    char tmp_path[sizeof(m->path) + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", m->path);
+
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return;
+    int ok = metrics_write(m, fd);
+    close(fd);
+    if (!ok || rename(tmp_path, m->path) != 0)
+        unlink(tmp_path);
+}
+
+static void* metrics_exporter(void* arg)
+{
+    metrics_t* m = (metrics_t*)arg;
+
+    pthread_mutex_lock(&m->lock);
+    while (!m->closing) {
+        if (m->listen_fd >= 0) {
+            // a snapshot for every client that connects
+            pthread_mutex_unlock(&m->lock);
+            struct pollfd pfd = {.fd = m->listen_fd, .events = POLLIN};
+            if (poll(&pfd, 1, m->interval_msec) > 0 &&
+                (pfd.revents & POLLIN)) {
+                int client = accept(m->listen_fd, NULL, NULL);
+                if (client >= 0) {
+                    metrics_write(m, client);
+                    close(client);
+                }
+            }
+            pthread_mutex_lock(&m->lock);
+            continue;
+        }
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += m->interval_msec / 1000;
+        deadline.tv_nsec += (long)(m->interval_msec % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec += 1;
+            deadline.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&m->wakeup, &m->lock, &deadline);
+        if (m->closing)
+            break;
+
+        pthread_mutex_unlock(&m->lock);
+        metrics_export_file(m);
+        pthread_mutex_lock(&m->lock);
+    }
+    pthread_mutex_unlock(&m->lock);
+    return NULL;
+}
+
+static int metrics_listen(metrics_t* m)
+{
+    struct sockaddr_un addr;
+    if (strlen(m->path) >= sizeof(addr.sun_path)) {
+        METRICS_LOG("socket path too long: %s\n", m->path);
+        return 0;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        METRICS_LOG("socket() failed\n");
+        return 0;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, m->path);
+    unlink(m->path);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+        listen(fd, 8) != 0) {
+        METRICS_LOG("unable to listen on %s\n", m->path);
+        close(fd);
+        return 0;
+    }
+    m->listen_fd = fd;
+    return 1;
+}
+
+int metrics_open(metrics_t* m, const char* target, int format,
+                 unsigned interval_msec, const metrics_desc_t* descs,
+                 unsigned n_descs)
+{
+    memset(m->shards, 0, sizeof(m->shards));
+    m->n_shards      = 0;
+    m->descs         = descs;
+    m->n_descs       = n_descs < METRICS_MAX_COUNTERS ? n_descs
+                                                      : METRICS_MAX_COUNTERS;
+    m->listen_fd     = -1;
+    m->format        = format;
+    m->interval_msec = interval_msec > 0 ? interval_msec
+                                         : METRICS_DEFAULT_INTERVAL;
+    m->start_msec    = metrics_now_msec();
+    m->closing       = 0;
+
+    int is_socket = strncmp(target, "unix:", 5) == 0;
+    if (is_socket)
+        target += 5;
+    if (strlen(target) >= sizeof(m->path)) {
+        METRICS_LOG("path too long: %s\n", target);
+        return 0;
+    }
+    strcpy(m->path, target);
+    if (is_socket && !metrics_listen(m))
+        return 0;
+
+    pthread_mutex_init(&m->lock, NULL);
+    pthread_cond_init(&m->wakeup, NULL);
+    if (pthread_create(&m->exporter, NULL, metrics_exporter, m) != 0) {
+        METRICS_LOG("unable to start the exporter\n");
+        if (m->listen_fd >= 0)
+            close(m->listen_fd);
+        pthread_mutex_destroy(&m->lock);
+        pthread_cond_destroy(&m->wakeup);
+        return 0;
+    }
+    return 1;
+}
+
+void metrics_close(metrics_t* m)
+{
+    pthread_mutex_lock(&m->lock);
+    m->closing = 1;
+    pthread_cond_signal(&m->wakeup);
+    pthread_mutex_unlock(&m->lock);
+    if (m->listen_fd >= 0)
+        // wakes up the exporter blocked in poll()
+        shutdown(m->listen_fd, SHUT_RDWR);
+    pthread_join(m->exporter, NULL);
+
+    if (m->listen_fd >= 0) {
+        close(m->listen_fd);
+        unlink(m->path);
+        m->listen_fd = -1;
+    } else
+        // the last snapshot has the final numbers
+        metrics_export_file(m);
+
+    pthread_mutex_destroy(&m->lock);
+    pthread_cond_destroy(&m->wakeup);
+}
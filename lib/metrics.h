@@ -0,0 +1,61 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+// Process-wide counters and gauges, exported periodically by a background
+// thread. Each thread updates its own shard (relaxed atomics, no locks),
+// the exporter sums the shards. The snapshot is written in Prometheus text
+// or JSON format either to a file (replaced atomically with a rename) or
+// to every client that connects to a Unix socket ("unix:<path>").
+
+#define METRICS_MAX_COUNTERS 96
+#define METRICS_MAX_SHARDS 64
+#define METRICS_DEFAULT_INTERVAL 1000 // msec
+
+#define METRICS_COUNTER 0
+#define METRICS_GAUGE 1
+
+#define METRICS_FORMAT_PROMETHEUS 0
+#define METRICS_FORMAT_JSON 1
+
+typedef struct metrics_shard_t {
+    uint64_t values[METRICS_MAX_COUNTERS];
+} __attribute__((aligned(64))) metrics_shard_t;
+
+typedef struct metrics_desc_t {
+    const char* name;
+    int         kind;
+} metrics_desc_t;
+
+typedef struct metrics_t {
+    metrics_shard_t       shards[METRICS_MAX_SHARDS];
+    unsigned              n_shards;
+    const metrics_desc_t* descs;
+    unsigned              n_descs;
+
+    char            path[256];
+    int             listen_fd; // -1 when exporting to a file
+    int             format;
+    unsigned        interval_msec;
+    uint64_t        start_msec;
+    int             closing;
+    pthread_t       exporter;
+    pthread_mutex_t lock;
+    pthread_cond_t  wakeup;
+} metrics_t;
+
+int  metrics_open(metrics_t* m, const char* target, int format,
+                  unsigned interval_msec, const metrics_desc_t* descs,
+                  unsigned n_descs);
+void metrics_close(metrics_t* m);
+
+// a gauge is the sum of the values set by the threads
+void metrics_add(metrics_t* m, unsigned id, uint64_t v);
+void metrics_set(metrics_t* m, unsigned id, uint64_t v);
+
+void metrics_snapshot(metrics_t* m, uint64_t* values);
+int  metrics_write(metrics_t* m, int fd);
+
+#endif
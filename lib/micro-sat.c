@@ -0,0 +1,475 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "micro-sat.h"
+
+#ifndef likely
+#define likely(x) __builtin_expect(!!(x), 1)
+#endif
+#ifndef unlikely
+#define unlikely(x) __builtin_expect(!!(x), 0)
+#endif
+
+#define ASSERT_OR_ABORT(x, mex)                                                \
+    if (unlikely(!(x))) {                                                      \
+        fprintf(stderr, "[micro-sat ABORT] " mex "\n");                        \
+        abort();                                                               \
+    }
+
+#define MSAT_UNDEF 2
+#define MSAT_NO_REASON UINT32_MAX
+#define MSAT_NOT_IN_HEAP UINT32_MAX
+#define MSAT_VAR_DECAY 0.95
+#define MSAT_RESTART_UNIT 64
+#define MSAT_POLL_PERIOD 256
+
+static void* msat_realloc(void* p, size_t size)
+{
+    p = realloc(p, size);
+    ASSERT_OR_ABORT(p != NULL, "msat_realloc(): realloc failed");
+    return p;
+}
+
+void msat_init(msat_t* s)
+{
+    memset(s, 0, sizeof(msat_t));
+    s->var_inc = 1.0;
+}
+
+void msat_free(msat_t* s)
+{
+    uint32_t i;
+    for (i = 0; i < 2 * s->var_capacity; ++i)
+        free(s->watches[i].clauses);
+    free(s->watches);
+    free(s->db);
+    free(s->assigns);
+    free(s->phase);
+    free(s->seen);
+    free(s->level);
+    free(s->reason);
+    free(s->activity);
+    free(s->heap_pos);
+    free(s->heap);
+    free(s->trail);
+    free(s->trail_lim);
+    free(s->learnt);
+    memset(s, 0, sizeof(msat_t));
+}
+
+// **************
+// *** values ***
+// **************
+
+static inline int msat_lit_value(msat_t* s, msat_lit_t l)
+{
+    uint8_t a = s->assigns[MSAT_VAR(l)];
+    return a == MSAT_UNDEF ? MSAT_UNDEF : a ^ (l & 1);
+}
+
+static inline void msat_enqueue(msat_t* s, msat_lit_t l, uint32_t reason)
+{
+    uint32_t v                = MSAT_VAR(l);
+    s->assigns[v]             = !(l & 1);
+    s->level[v]               = s->n_levels;
+    s->reason[v]              = reason;
+    s->trail[s->trail_size++] = l;
+}
+
+// *************************
+// *** heap of decisions ***
+// *************************
+
+static void msat_heap_up(msat_t* s, uint32_t i)
+{
+    uint32_t v = s->heap[i];
+    while (i > 0) {
+        uint32_t p = (i - 1) / 2;
+        if (!(s->activity[v] > s->activity[s->heap[p]]))
+            break;
+        s->heap[i]              = s->heap[p];
+        s->heap_pos[s->heap[i]] = i;
+        i                       = p;
+    }
+    s->heap[i]     = v;
+    s->heap_pos[v] = i;
+}
+
+static void msat_heap_down(msat_t* s, uint32_t i)
+{
+    uint32_t v = s->heap[i];
+    while (2 * i + 1 < s->heap_size) {
+        uint32_t c = 2 * i + 1;
+        if (c + 1 < s->heap_size &&
+            s->activity[s->heap[c + 1]] > s->activity[s->heap[c]])
+            c++;
+        if (!(s->activity[s->heap[c]] > s->activity[v]))
+            break;
+        s->heap[i]              = s->heap[c];
+        s->heap_pos[s->heap[i]] = i;
+        i                       = c;
+    }
+    s->heap[i]     = v;
+    s->heap_pos[v] = i;
+}
+
+static void msat_heap_insert(msat_t* s, uint32_t v)
+{
+    if (s->heap_pos[v] != MSAT_NOT_IN_HEAP)
+        return;
+    s->heap[s->heap_size] = v;
+    s->heap_pos[v]        = s->heap_size;
+    msat_heap_up(s, s->heap_size++);
+}
+
+static uint32_t msat_heap_pop(msat_t* s)
+{
+    uint32_t v    = s->heap[0];
+    uint32_t last = s->heap[--s->heap_size];
+    if (s->heap_size > 0) {
+        s->heap[0]        = last;
+        s->heap_pos[last] = 0;
+        msat_heap_down(s, 0);
+    }
+    s->heap_pos[v] = MSAT_NOT_IN_HEAP;
+    return v;
+}
+
+static void msat_bump(msat_t* s, uint32_t v)
+{
+    s->activity[v] += s->var_inc;
+    if (unlikely(s->activity[v] > 1e100)) {
+        uint32_t i;
+        for (i = 1; i <= s->n_vars; ++i)
+            s->activity[i] *= 1e-100;
+        s->var_inc *= 1e-100;
+    }
+    if (s->heap_pos[v] != MSAT_NOT_IN_HEAP)
+        msat_heap_up(s, s->heap_pos[v]);
+}
+
+// *****************
+// *** variables ***
+// *****************
+
+static void msat_grow_vars(msat_t* s)
+{
+    uint32_t old = s->var_capacity;
+    uint32_t cap = old == 0 ? 64 : old * 2;
+
+    s->assigns  = (uint8_t*)msat_realloc(s->assigns, cap);
+    s->phase    = (uint8_t*)msat_realloc(s->phase, cap);
+    s->seen     = (uint8_t*)msat_realloc(s->seen, cap);
+    s->level    = (uint32_t*)msat_realloc(s->level, cap * sizeof(uint32_t));
+    s->reason   = (uint32_t*)msat_realloc(s->reason, cap * sizeof(uint32_t));
+    s->activity = (double*)msat_realloc(s->activity, cap * sizeof(double));
+    s->heap_pos = (uint32_t*)msat_realloc(s->heap_pos, cap * sizeof(uint32_t));
+    s->heap     = (uint32_t*)msat_realloc(s->heap, cap * sizeof(uint32_t));
+    s->trail  = (msat_lit_t*)msat_realloc(s->trail, cap * sizeof(msat_lit_t));
+    s->learnt = (msat_lit_t*)msat_realloc(s->learnt, cap * sizeof(msat_lit_t));
+    s->trail_lim =
+        (uint32_t*)msat_realloc(s->trail_lim, cap * sizeof(uint32_t));
+    s->watches = (msat_watches_t*)msat_realloc(
+        s->watches, 2 * cap * sizeof(msat_watches_t));
+    memset(&s->watches[2 * old], 0, 2 * (cap - old) * sizeof(msat_watches_t));
+    s->var_capacity = cap;
+}
+
+uint32_t msat_new_var(msat_t* s)
+{
+    uint32_t v = ++s->n_vars;
+    if (v >= s->var_capacity)
+        msat_grow_vars(s);
+
+    s->assigns[v]  = MSAT_UNDEF;
+    s->phase[v]    = 0;
+    s->seen[v]     = 0;
+    s->level[v]    = 0;
+    s->reason[v]   = MSAT_NO_REASON;
+    s->activity[v] = 0;
+    s->heap_pos[v] = MSAT_NOT_IN_HEAP;
+    msat_heap_insert(s, v);
+    return v;
+}
+
+void msat_set_phase(msat_t* s, uint32_t var, int value)
+{
+    s->phase[var] = value ? 1 : 0;
+}
+
+int msat_value(msat_t* s, uint32_t var) { return s->assigns[var] == 1; }
+
+// ***************
+// *** clauses ***
+// ***************
+
+static void msat_watch(msat_t* s, msat_lit_t l, uint32_t cref)
+{
+    msat_watches_t* ws = &s->watches[l];
+    if (ws->size == ws->capacity) {
+        ws->capacity = ws->capacity == 0 ? 4 : ws->capacity * 2;
+        ws->clauses  = (uint32_t*)msat_realloc(ws->clauses,
+                                              ws->capacity * sizeof(uint32_t));
+    }
+    ws->clauses[ws->size++] = cref;
+}
+
+static uint32_t msat_store_clause(msat_t* s, const msat_lit_t* lits,
+                                  uint32_t n)
+{
+    if (s->db_size + n + 1 > s->db_capacity) {
+        while (s->db_size + n + 1 > s->db_capacity)
+            s->db_capacity = s->db_capacity == 0 ? 1024 : s->db_capacity * 2;
+        s->db = (uint32_t*)msat_realloc(s->db,
+                                        s->db_capacity * sizeof(uint32_t));
+    }
+    uint32_t cref = s->db_size;
+    s->db[cref]   = n;
+    memcpy(&s->db[cref + 1], lits, n * sizeof(msat_lit_t));
+    s->db_size += n + 1;
+    msat_watch(s, lits[0], cref);
+    msat_watch(s, lits[1], cref);
+    return cref;
+}
+
+// the clauses watching a literal are visited when it becomes false. The
+// first two literals of a clause are the watched ones, when the clause is
+// the reason of an assignment the first is the implied literal
+static uint32_t msat_propagate(msat_t* s)
+{
+    while (s->qhead < s->trail_size) {
+        msat_lit_t      f  = MSAT_NEG(s->trail[s->qhead++]);
+        msat_watches_t* ws = &s->watches[f];
+        uint32_t        i = 0, j = 0, k;
+
+        s->propagations++;
+        while (i < ws->size) {
+            uint32_t    cref = ws->clauses[i++];
+            uint32_t    n    = s->db[cref];
+            msat_lit_t* c    = &s->db[cref + 1];
+
+            if (c[0] == f) {
+                c[0] = c[1];
+                c[1] = f;
+            }
+            if (msat_lit_value(s, c[0]) == 1) {
+                ws->clauses[j++] = cref;
+                continue;
+            }
+            for (k = 2; k < n; ++k)
+                if (msat_lit_value(s, c[k]) != 0) {
+                    c[1] = c[k];
+                    c[k] = f;
+                    msat_watch(s, c[1], cref);
+                    break;
+                }
+            if (k < n)
+                continue;
+
+            ws->clauses[j++] = cref;
+            if (msat_lit_value(s, c[0]) == 0) {
+                // conflict, keep the remaining watches
+                while (i < ws->size)
+                    ws->clauses[j++] = ws->clauses[i++];
+                ws->size = j;
+                s->qhead = s->trail_size;
+                return cref;
+            }
+            msat_enqueue(s, c[0], cref);
+        }
+        ws->size = j;
+    }
+    return MSAT_NO_REASON;
+}
+
+int msat_add_clause(msat_t* s, const msat_lit_t* lits, uint32_t n)
+{
+    ASSERT_OR_ABORT(s->n_levels == 0,
+                    "msat_add_clause(): clauses are added at level 0");
+    if (s->unsat)
+        return 0;
+
+    // drop the duplicated and the false literals, in the learnt buffer
+    uint32_t i, size = 0, satisfied = 0;
+    if (s->var_capacity < n + 1) {
+        s->learnt =
+            (msat_lit_t*)msat_realloc(s->learnt, (n + 1) * sizeof(msat_lit_t));
+    }
+    for (i = 0; i < n && !satisfied; ++i) {
+        msat_lit_t l = lits[i];
+        uint32_t   v = MSAT_VAR(l);
+        int        val = msat_lit_value(s, l);
+        if (val == 1 || s->seen[v] == 2 - (l & 1))
+            satisfied = 1; // true at level 0, or tautology
+        else if (val == MSAT_UNDEF && !s->seen[v]) {
+            s->seen[v]        = 1 + (l & 1);
+            s->learnt[size++] = l;
+        }
+    }
+    for (i = 0; i < size; ++i)
+        s->seen[MSAT_VAR(s->learnt[i])] = 0;
+    if (satisfied)
+        return 1;
+
+    if (size == 0) {
+        s->unsat = 1;
+        return 0;
+    }
+    if (size == 1) {
+        msat_enqueue(s, s->learnt[0], MSAT_NO_REASON);
+        if (msat_propagate(s) != MSAT_NO_REASON)
+            s->unsat = 1;
+        return !s->unsat;
+    }
+    msat_store_clause(s, s->learnt, size);
+    return 1;
+}
+
+// **************
+// *** search ***
+// **************
+
+static void msat_cancel_until(msat_t* s, uint32_t level)
+{
+    if (s->n_levels <= level)
+        return;
+
+    uint32_t i;
+    for (i = s->trail_size; i-- > s->trail_lim[level];) {
+        uint32_t v    = MSAT_VAR(s->trail[i]);
+        s->phase[v]   = s->assigns[v];
+        s->assigns[v] = MSAT_UNDEF;
+        s->reason[v]  = MSAT_NO_REASON;
+        msat_heap_insert(s, v);
+    }
+    s->trail_size = s->trail_lim[level];
+    s->qhead      = s->trail_size;
+    s->n_levels   = level;
+}
+
+// first UIP: the learnt clause is left in s->learnt, with the asserting
+// literal first and a literal of the backtrack level second
+static uint32_t msat_analyze(msat_t* s, uint32_t confl)
+{
+    uint32_t   idx = s->trail_size, k, bt_level = 0, max_k = 1;
+    int        path = 0, has_p = 0;
+    msat_lit_t p = 0;
+
+    s->learnt_size = 1;
+    do {
+        uint32_t    n = s->db[confl];
+        msat_lit_t* c = &s->db[confl + 1];
+        for (k = has_p ? 1 : 0; k < n; ++k) {
+            uint32_t v = MSAT_VAR(c[k]);
+            if (s->seen[v] || s->level[v] == 0)
+                continue;
+            msat_bump(s, v);
+            s->seen[v] = 1;
+            if (s->level[v] >= s->n_levels)
+                path++;
+            else
+                s->learnt[s->learnt_size++] = c[k];
+        }
+        while (!s->seen[MSAT_VAR(s->trail[--idx])])
+            ;
+        p                    = s->trail[idx];
+        has_p                = 1;
+        confl                = s->reason[MSAT_VAR(p)];
+        s->seen[MSAT_VAR(p)] = 0;
+        path--;
+    } while (path > 0);
+    s->learnt[0] = MSAT_NEG(p);
+
+    for (k = 1; k < s->learnt_size; ++k) {
+        uint32_t l = s->level[MSAT_VAR(s->learnt[k])];
+        if (l > bt_level) {
+            bt_level = l;
+            max_k    = k;
+        }
+        s->seen[MSAT_VAR(s->learnt[k])] = 0;
+    }
+    if (s->learnt_size > 1) {
+        msat_lit_t tmp   = s->learnt[1];
+        s->learnt[1]     = s->learnt[max_k];
+        s->learnt[max_k] = tmp;
+    }
+    return bt_level;
+}
+
+static unsigned long msat_luby(unsigned long i)
+{
+    unsigned long size = 1, seq = 0;
+    while (size < i + 1) {
+        seq++;
+        size = 2 * size + 1;
+    }
+    while (size - 1 != i) {
+        size = (size - 1) >> 1;
+        seq--;
+        i = i % size;
+    }
+    return 1UL << seq;
+}
+
+int msat_solve(msat_t* s, unsigned long max_conflicts,
+               int (*should_stop)(void*), void* opaque)
+{
+    unsigned long start_conflicts = s->conflicts;
+    unsigned long n_restarts = 0, restart_conflicts = 0;
+    unsigned long restart_limit = MSAT_RESTART_UNIT;
+
+    msat_cancel_until(s, 0);
+    if (s->unsat)
+        return MSAT_UNSAT;
+
+    while (1) {
+        uint32_t confl = msat_propagate(s);
+        if (confl != MSAT_NO_REASON) {
+            s->conflicts++;
+            restart_conflicts++;
+            if (s->n_levels == 0) {
+                s->unsat = 1;
+                return MSAT_UNSAT;
+            }
+
+            uint32_t bt_level = msat_analyze(s, confl);
+            msat_cancel_until(s, bt_level);
+            if (s->learnt_size == 1)
+                msat_enqueue(s, s->learnt[0], MSAT_NO_REASON);
+            else
+                msat_enqueue(s, s->learnt[0],
+                             msat_store_clause(s, s->learnt, s->learnt_size));
+            s->var_inc /= MSAT_VAR_DECAY;
+
+            if (s->conflicts - start_conflicts >= max_conflicts ||
+                ((s->conflicts % MSAT_POLL_PERIOD) == 0 &&
+                 should_stop != NULL && should_stop(opaque))) {
+                msat_cancel_until(s, 0);
+                return MSAT_UNKNOWN;
+            }
+            continue;
+        }
+
+        if (restart_conflicts >= restart_limit) {
+            msat_cancel_until(s, 0);
+            restart_conflicts = 0;
+            restart_limit     = MSAT_RESTART_UNIT * msat_luby(++n_restarts);
+            continue;
+        }
+
+        uint32_t v = 0;
+        while (s->heap_size > 0) {
+            v = msat_heap_pop(s);
+            if (s->assigns[v] == MSAT_UNDEF)
+                break;
+            v = 0;
+        }
+        if (v == 0)
+            // every variable is assigned
+            return MSAT_SAT;
+
+        s->decisions++;
+        s->trail_lim[s->n_levels++] = s->trail_size;
+        msat_enqueue(s, MSAT_LIT(v, !s->phase[v]), MSAT_NO_REASON);
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef MICRO_SAT_H
+#define MICRO_SAT_H
+
+#include <stdint.h>
+
+// Compact CDCL solver for the small bit-blasted problems of the library:
+// two watched literals, first-UIP learning, VSIDS, phase saving and Luby
+// restarts. Learnt clauses are never deleted, the search is bounded by a
+// budget of conflicts instead. Variables are numbered from 1, a literal is
+// (var << 1) | negated.
+
+#define MSAT_UNSAT 0
+#define MSAT_SAT 1
+#define MSAT_UNKNOWN 2
+
+#define MSAT_LIT(var, neg) (((var) << 1) | ((neg) ? 1 : 0))
+#define MSAT_NEG(lit) ((lit) ^ 1)
+#define MSAT_VAR(lit) ((lit) >> 1)
+
+typedef uint32_t msat_lit_t;
+
+typedef struct msat_watches_t {
+    uint32_t* clauses; // offsets in the clause db
+    uint32_t  size;
+    uint32_t  capacity;
+} msat_watches_t;
+
+typedef struct msat_t {
+    // clause db: the size of the clause, followed by its literals
+    uint32_t* db;
+    uint32_t  db_size;
+    uint32_t  db_capacity;
+
+    uint32_t n_vars;
+    uint32_t var_capacity;
+
+    // by variable
+    uint8_t*  assigns; // 0, 1 or MSAT_UNDEF
+    uint8_t*  phase;
+    uint8_t*  seen;
+    uint32_t* level;
+    uint32_t* reason;
+    double*   activity;
+    uint32_t* heap_pos;
+
+    // by literal
+    msat_watches_t* watches;
+
+    uint32_t* heap;
+    uint32_t  heap_size;
+
+    msat_lit_t* trail;
+    uint32_t    trail_size;
+    uint32_t    qhead;
+    uint32_t*   trail_lim;
+    uint32_t    n_levels;
+
+    msat_lit_t* learnt;
+    uint32_t    learnt_size;
+
+    double var_inc;
+    int    unsat; // the empty clause has been added
+
+    unsigned long conflicts;
+    unsigned long decisions;
+    unsigned long propagations;
+} msat_t;
+
+void msat_init(msat_t* s);
+void msat_free(msat_t* s);
+
+uint32_t msat_new_var(msat_t* s);
+// the polarity tried first when the variable is a decision
+void msat_set_phase(msat_t* s, uint32_t var, int value);
+// 0 if the formula is now trivially unsat
+int msat_add_clause(msat_t* s, const msat_lit_t* lits, uint32_t n);
+
+// should_stop is polled every few conflicts, it can be NULL
+int msat_solve(msat_t* s, unsigned long max_conflicts,
+               int (*should_stop)(void*), void* opaque);
+// value of a variable in the model found by msat_solve
+int msat_value(msat_t* s, uint32_t var);
+
+#endif
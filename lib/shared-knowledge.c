@@ -0,0 +1,111 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "shared-knowledge.h"
+
+#define SHARED_KNOWLEDGE_LOG(x...)                                             \
+    fprintf(stderr, "[shared-knowledge] " x)
+
+int shared_knowledge_open(shared_knowledge_t* sk, const char* name,
+                          uint64_t n_slots)
+{
+    sk->records     = NULL;
+    sk->n_slots     = 0;
+    sk->mapped_size = 0;
+
+    int fd = shm_open(name, O_CREAT | O_RDWR, 0600);
+    if (fd < 0) {
+        SHARED_KNOWLEDGE_LOG("shm_open(\"%s\") failed\n", name);
+        return 0;
+    }
+
+    // the first process sizes the segment, the others adopt its size
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return 0;
+    }
+    uint64_t size = st.st_size;
+    if (size == 0) {
+        size = n_slots * sizeof(shared_knowledge_record_t);
+        if (ftruncate(fd, size) != 0) {
+            SHARED_KNOWLEDGE_LOG("ftruncate() failed\n");
+            close(fd);
+            return 0;
+        }
+    }
+
+    void* mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        SHARED_KNOWLEDGE_LOG("mmap() failed\n");
+        return 0;
+    }
+
+    sk->records     = (shared_knowledge_record_t*)mem;
+    sk->n_slots     = size / sizeof(shared_knowledge_record_t);
+    sk->mapped_size = size;
+    return sk->n_slots > 0;
+}
+
+void shared_knowledge_close(shared_knowledge_t* sk)
+{
+    if (sk->records != NULL)
+        munmap(sk->records, sk->mapped_size);
+    sk->records     = NULL;
+    sk->n_slots     = 0;
+    sk->mapped_size = 0;
+}
+
+int shared_knowledge_publish(shared_knowledge_t* sk, uint64_t key,
+                             const void* payload)
+{
+    // key 0 marks a free slot
+    if (key == 0)
+        key = 1;
+
+    uint64_t i;
+    for (i = 0; i < SK_MAX_PROBES; ++i) {
+        shared_knowledge_record_t* r = &sk->records[(key + i) % sk->n_slots];
+
+        uint64_t expected = 0;
+        if (__atomic_compare_exchange_n(&r->key, &expected, key, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            memcpy(r->payload, payload, SK_PAYLOAD_SIZE);
+            __atomic_store_n(&r->ready, 1, __ATOMIC_RELEASE);
+            return 1;
+        }
+        if (expected == key)
+            // already published by someone else
+            return 0;
+    }
+    // the segment is (locally) full
+    return 0;
+}
+
+int shared_knowledge_lookup(shared_knowledge_t* sk, uint64_t key,
+                            void* payload)
+{
+    if (key == 0)
+        key = 1;
+
+    uint64_t i;
+    for (i = 0; i < SK_MAX_PROBES; ++i) {
+        shared_knowledge_record_t* r = &sk->records[(key + i) % sk->n_slots];
+
+        uint64_t k = __atomic_load_n(&r->key, __ATOMIC_ACQUIRE);
+        if (k == 0)
+            return 0;
+        if (k != key)
+            continue;
+        if (!__atomic_load_n(&r->ready, __ATOMIC_ACQUIRE))
+            // still being written
+            return 0;
+        memcpy(payload, r->payload, SK_PAYLOAD_SIZE);
+        return 1;
+    }
+    return 0;
+}
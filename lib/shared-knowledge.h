@@ -0,0 +1,36 @@
+#ifndef SHARED_KNOWLEDGE_H
+#define SHARED_KNOWLEDGE_H
+
+#include <stdint.h>
+
+// Append-only table of fixed-size facts, living in a POSIX shared memory
+// segment and shared by every process that opens it with the same name.
+// Slots are claimed with a CAS on the key and become visible once the
+// payload is written. Facts are never overwritten nor removed.
+
+#define SK_PAYLOAD_SIZE 112
+#define SK_DEFAULT_N_SLOTS (1 << 16)
+#define SK_MAX_PROBES 32
+
+typedef struct shared_knowledge_record_t {
+    uint64_t      key;
+    uint32_t      ready;
+    uint32_t      padding;
+    unsigned char payload[SK_PAYLOAD_SIZE];
+} shared_knowledge_record_t;
+
+typedef struct shared_knowledge_t {
+    shared_knowledge_record_t* records;
+    uint64_t                   n_slots;
+    uint64_t                   mapped_size;
+} shared_knowledge_t;
+
+int  shared_knowledge_open(shared_knowledge_t* sk, const char* name,
+                           uint64_t n_slots);
+void shared_knowledge_close(shared_knowledge_t* sk);
+int  shared_knowledge_publish(shared_knowledge_t* sk, uint64_t key,
+                              const void* payload);
+int  shared_knowledge_lookup(shared_knowledge_t* sk, uint64_t key,
+                             void* payload);
+
+#endif
@@ -36,42 +36,52 @@ void free_testcase_list(Z3_context ctx, testcase_list_t* t)
     da_free__testcase_t(t, NULL);
 }
 
-void load_testcase(testcase_list_t* t, char const* filename, Z3_context ctx)
+void load_testcase_from_buffer(testcase_list_t* t, unsigned char const* buf,
+                               unsigned long len, Z3_context ctx)
 {
-    ASSERT_OR_ABORT(t->size < t->max_size, "testcase_list is full");
-
-    // TESTCASE_LIB_LOG("Loading testcase \"%s\" \n", filename);
-
     testcase_t    tc = {0};
-    FILE*         fp = fopen(filename, "r");
-    int           res, i = 0;
-    unsigned char c;
-
-    ASSERT_OR_ABORT(fp != NULL, "fopen() failed");
-
-    fseek(fp, 0L, SEEK_END);
-    tc.testcase_len = ftell(fp);
-    tc.values_len   = tc.testcase_len;
-    fseek(fp, 0L, SEEK_SET);
+    unsigned long i;
 
+    tc.testcase_len = len;
+    tc.values_len   = len;
     tc.values = (unsigned long*)malloc(sizeof(unsigned long) * tc.values_len);
     tc.z3_values = (Z3_ast*)malloc(sizeof(Z3_ast) * tc.values_len);
     tc.value_sizes =
         (unsigned char*)malloc(sizeof(unsigned char) * tc.values_len);
+    ASSERT_OR_ABORT(len == 0 || (tc.values != NULL && tc.z3_values != NULL &&
+                                 tc.value_sizes != NULL),
+                    "load_testcase_from_buffer() failed malloc");
 
     Z3_sort bv_sort = Z3_mk_bv_sort(ctx, 8);
-    while (1) {
-        res = fread(&c, sizeof(char), 1, fp);
-        if (res != 1)
-            break;
-        tc.values[i]      = (unsigned long)c;
+    for (i = 0; i < len; ++i) {
+        tc.values[i]      = (unsigned long)buf[i];
         tc.value_sizes[i] = 8;
-        tc.z3_values[i]   = Z3_mk_unsigned_int(ctx, c, bv_sort);
+        tc.z3_values[i]   = Z3_mk_unsigned_int(ctx, buf[i], bv_sort);
         Z3_inc_ref(ctx, tc.z3_values[i]);
-        i++;
     }
     da_add_item__testcase_t(t, tc);
+}
+
+void load_testcase(testcase_list_t* t, char const* filename, Z3_context ctx)
+{
+    // TESTCASE_LIB_LOG("Loading testcase \"%s\" \n", filename);
+
+    FILE* fp = fopen(filename, "r");
+    ASSERT_OR_ABORT(fp != NULL, "fopen() failed");
+
+    fseek(fp, 0L, SEEK_END);
+    long len = ftell(fp);
+    fseek(fp, 0L, SEEK_SET);
+    ASSERT_OR_ABORT(len >= 0, "ftell() failed");
+
+    // read the whole file at once
+    unsigned char* buf = (unsigned char*)malloc(len > 0 ? len : 1);
+    ASSERT_OR_ABORT(buf != NULL, "load_testcase() failed malloc");
+    len = fread(buf, sizeof(unsigned char), len, fp);
     fclose(fp);
+
+    load_testcase_from_buffer(t, buf, len, ctx);
+    free(buf);
 }
 
 void load_testcase_folder(testcase_list_t* t, char* testcase_dir,
@@ -21,5 +21,8 @@ void free_testcase_list(Z3_context ctx, testcase_list_t* t);
 void load_testcase_folder(testcase_list_t* t, char* testcase_dir,
                           Z3_context ctx);
 void load_testcase(testcase_list_t* t, char const* filename, Z3_context ctx);
+// the bytes are copied, buf can be released after the call
+void load_testcase_from_buffer(testcase_list_t* t, unsigned char const* buf,
+                               unsigned long len, Z3_context ctx);
 
 #endif
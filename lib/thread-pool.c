@@ -0,0 +1,423 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "thread-pool.h"
+
+#define TP_LOG(x...) fprintf(stderr, "[thread-pool] " x)
+#define TP_INITIAL_DEQUE_CAPACITY 64
+
+static __thread tp_worker_t* tp_current_worker = NULL;
+
+tp_worker_t* thread_pool_current_worker(void) { return tp_current_worker; }
+
+// *************
+// *** deque ***
+// *************
+
+static void tp_deque_init(tp_deque_t* d)
+{
+    d->tasks    = (tp_task_t*)malloc(sizeof(tp_task_t) *
+                                  TP_INITIAL_DEQUE_CAPACITY);
+    d->capacity = TP_INITIAL_DEQUE_CAPACITY;
+    d->top      = 0;
+    d->size     = 0;
+    pthread_mutex_init(&d->lock, NULL);
+}
+
+static void tp_deque_free(tp_deque_t* d)
+{
+    free(d->tasks);
+    pthread_mutex_destroy(&d->lock);
+}
+
+static int tp_deque_push_bottom(tp_deque_t* d, tp_task_t t)
+{
+    pthread_mutex_lock(&d->lock);
+    if (d->size == d->capacity) {
+        tp_task_t* tasks =
+            (tp_task_t*)malloc(sizeof(tp_task_t) * d->capacity * 2);
+        if (tasks == NULL) {
+            pthread_mutex_unlock(&d->lock);
+            return 0;
+        }
+        unsigned i;
+        for (i = 0; i < d->size; ++i)
+            tasks[i] = d->tasks[(d->top + i) % d->capacity];
+        free(d->tasks);
+        d->tasks = tasks;
+        d->top   = 0;
+        d->capacity *= 2;
+    }
+    d->tasks[(d->top + d->size) % d->capacity] = t;
+    __atomic_store_n(&d->size, d->size + 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&d->lock);
+    return 1;
+}
+
+static int tp_deque_pop_bottom(tp_deque_t* d, tp_task_t* t)
+{
+    int res = 0;
+    pthread_mutex_lock(&d->lock);
+    if (d->size > 0) {
+        __atomic_store_n(&d->size, d->size - 1, __ATOMIC_RELAXED);
+        *t  = d->tasks[(d->top + d->size) % d->capacity];
+        res = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return res;
+}
+
+static int tp_deque_steal_top(tp_deque_t* d, tp_task_t* t)
+{
+    // a cheap look before taking the lock of another worker
+    if (__atomic_load_n(&d->size, __ATOMIC_RELAXED) == 0)
+        return 0;
+
+    int res = 0;
+    pthread_mutex_lock(&d->lock);
+    if (d->size > 0) {
+        *t     = d->tasks[d->top];
+        d->top = (d->top + 1) % d->capacity;
+        __atomic_store_n(&d->size, d->size - 1, __ATOMIC_RELAXED);
+        res = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return res;
+}
+
+// *************
+// *** arena ***
+// *************
+
+void* tp_arena_alloc(tp_worker_t* w, size_t size)
+{
+    tp_arena_t*       arena = &w->arena;
+    tp_arena_chunk_t* chunk = arena->chunks;
+
+    size = (size + 15) & ~(size_t)15;
+    if (chunk == NULL || chunk->size - chunk->used < size) {
+        size_t chunk_size =
+            size > TP_ARENA_CHUNK_SIZE ? size : TP_ARENA_CHUNK_SIZE;
+        chunk = (tp_arena_chunk_t*)malloc(sizeof(tp_arena_chunk_t) +
+                                          chunk_size);
+        if (chunk == NULL)
+            return NULL;
+        chunk->next   = arena->chunks;
+        chunk->size   = chunk_size;
+        chunk->used   = 0;
+        arena->chunks = chunk;
+    }
+
+    void* res = chunk->data + chunk->used;
+    chunk->used += size;
+    return res;
+}
+
+static void tp_arena_reset(tp_arena_t* arena)
+{
+    // keep the last chunk, big allocations are rare
+    tp_arena_chunk_t* chunk = arena->chunks;
+    if (chunk == NULL)
+        return;
+    while (chunk->next != NULL) {
+        tp_arena_chunk_t* next = chunk->next;
+        chunk->next            = next->next;
+        free(next);
+    }
+    chunk->used = 0;
+}
+
+static void tp_arena_free(tp_arena_t* arena)
+{
+    while (arena->chunks != NULL) {
+        tp_arena_chunk_t* next = arena->chunks->next;
+        free(arena->chunks);
+        arena->chunks = next;
+    }
+}
+
+// ***********
+// *** rng ***
+// ***********
+
+// the workers share a single xorshift64* sequence: worker i starts
+// 2^TP_RNG_JUMP_POW2 * i steps after worker 0, hence their streams never
+// overlap. The state transition is linear over GF(2), the jump is the
+// transition matrix raised to 2^TP_RNG_JUMP_POW2
+#define TP_RNG_JUMP_POW2 48
+
+static inline uint64_t tp_rng_step(uint64_t x)
+{
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    return x;
+}
+
+uint64_t tp_rand(tp_worker_t* w)
+{
+    // xorshift64*
+    w->rng_state = tp_rng_step(w->rng_state);
+    return w->rng_state * 0x2545f4914f6cdd1dUL;
+}
+
+// column i of the matrix is the image of bit i
+static uint64_t tp_matrix_apply(const uint64_t* m, uint64_t x)
+{
+    uint64_t res = 0;
+    unsigned i;
+    for (i = 0; i < 64; ++i)
+        if ((x >> i) & 1)
+            res ^= m[i];
+    return res;
+}
+
+static void tp_rng_jump_matrix(uint64_t* m)
+{
+    uint64_t tmp[64];
+    unsigned i, j;
+    for (i = 0; i < 64; ++i)
+        m[i] = tp_rng_step(1UL << i);
+    for (j = 0; j < TP_RNG_JUMP_POW2; ++j) {
+        for (i = 0; i < 64; ++i)
+            tmp[i] = tp_matrix_apply(m, m[i]);
+        memcpy(m, tmp, sizeof(tmp));
+    }
+}
+
+static uint64_t tp_seed(void)
+{
+    uint64_t seed = 0;
+    int      fd   = open("/dev/urandom", O_RDONLY);
+    if (fd >= 0) {
+        if (read(fd, &seed, sizeof(seed)) != sizeof(seed))
+            seed = 0;
+        close(fd);
+    }
+    if (seed == 0) {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        seed = ((uint64_t)tv.tv_sec << 20) ^ tv.tv_usec;
+    }
+    return seed != 0 ? seed : 1;
+}
+
+// ************
+// *** pool ***
+// ************
+
+static int tp_get_task(tp_worker_t* w, tp_task_t* t)
+{
+    thread_pool_t* p = w->pool;
+    if (tp_deque_pop_bottom(&w->deque, t))
+        return 1;
+
+    unsigned i;
+    for (i = 1; i < p->n_workers; ++i)
+        if (tp_deque_steal_top(&p->workers[(w->id + i) % p->n_workers].deque,
+                               t))
+            return 1;
+    return 0;
+}
+
+static void* tp_worker_main(void* arg)
+{
+    tp_worker_t*   w = (tp_worker_t*)arg;
+    thread_pool_t* p = w->pool;
+    tp_task_t      t;
+
+    tp_current_worker = w;
+    while (1) {
+        if (tp_get_task(w, &t)) {
+            __atomic_sub_fetch(&p->queued, 1, __ATOMIC_ACQ_REL);
+            t.fn(w, t.arg);
+            tp_arena_reset(&w->arena);
+
+            if (__atomic_sub_fetch(&p->outstanding, 1, __ATOMIC_ACQ_REL) ==
+                0) {
+                pthread_mutex_lock(&p->lock);
+                pthread_cond_broadcast(&p->all_done);
+                pthread_mutex_unlock(&p->lock);
+            }
+            continue;
+        }
+
+        pthread_mutex_lock(&p->lock);
+        while (__atomic_load_n(&p->queued, __ATOMIC_ACQUIRE) <= 0 &&
+               !p->shutdown)
+            pthread_cond_wait(&p->work_available, &p->lock);
+        int stop =
+            p->shutdown && __atomic_load_n(&p->queued, __ATOMIC_ACQUIRE) <= 0;
+        pthread_mutex_unlock(&p->lock);
+        if (stop)
+            break;
+    }
+    tp_current_worker = NULL;
+    return NULL;
+}
+
+static int tp_alloc_buffers(tp_worker_t* w, unsigned long input_size)
+{
+    if (input_size <= w->input_size)
+        return 1;
+
+    unsigned long* input =
+        (unsigned long*)realloc(w->input, sizeof(unsigned long) * input_size);
+    if (input == NULL)
+        return 0;
+    w->input = input;
+    unsigned char* proof =
+        (unsigned char*)realloc(w->proof, sizeof(unsigned char) * input_size);
+    if (proof == NULL)
+        return 0;
+    w->proof      = proof;
+    w->input_size = input_size;
+    return 1;
+}
+
+static void tp_release_workers(thread_pool_t* p, unsigned n_started)
+{
+    pthread_mutex_lock(&p->lock);
+    p->shutdown = 1;
+    pthread_cond_broadcast(&p->work_available);
+    pthread_mutex_unlock(&p->lock);
+
+    // a running worker may still steal from any deque
+    unsigned i;
+    for (i = 0; i < n_started; ++i)
+        pthread_join(p->workers[i].thread, NULL);
+    for (i = 0; i < p->n_workers; ++i) {
+        tp_worker_t* w = &p->workers[i];
+        tp_deque_free(&w->deque);
+        tp_arena_free(&w->arena);
+        free(w->input);
+        free(w->proof);
+    }
+    free(p->workers);
+    p->workers   = NULL;
+    p->n_workers = 0;
+
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->work_available);
+    pthread_cond_destroy(&p->all_done);
+}
+
+int thread_pool_init(thread_pool_t* p, unsigned n_workers,
+                     unsigned long input_size, int pin_workers)
+{
+    long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n_cpus <= 0)
+        n_cpus = 1;
+    if (n_workers == 0)
+        n_workers = (unsigned)n_cpus;
+    if (n_workers > TP_MAX_WORKERS)
+        n_workers = TP_MAX_WORKERS;
+
+    p->workers = (tp_worker_t*)calloc(n_workers, sizeof(tp_worker_t));
+    if (p->workers == NULL) {
+        TP_LOG("calloc failed\n");
+        abort();
+    }
+    p->n_workers   = n_workers;
+    p->next_worker = 0;
+    p->queued      = 0;
+    p->outstanding = 0;
+    p->cancelled   = 0;
+    p->shutdown    = 0;
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->work_available, NULL);
+    pthread_cond_init(&p->all_done, NULL);
+
+    uint64_t jump[64];
+    uint64_t rng_state = tp_seed();
+    tp_rng_jump_matrix(jump);
+
+    // the deques must be ready before any worker starts stealing
+    unsigned i;
+    for (i = 0; i < n_workers; ++i) {
+        tp_worker_t* w = &p->workers[i];
+        w->id          = i;
+        w->pool        = p;
+        w->rng_state   = rng_state;
+        rng_state      = tp_matrix_apply(jump, rng_state);
+        tp_deque_init(&w->deque);
+        if (!tp_alloc_buffers(w, input_size)) {
+            TP_LOG("unable to allocate the buffers of worker %u\n", i);
+            abort();
+        }
+    }
+
+    for (i = 0; i < n_workers; ++i) {
+        tp_worker_t* w = &p->workers[i];
+        if (pthread_create(&w->thread, NULL, tp_worker_main, w) != 0) {
+            TP_LOG("unable to start worker %u\n", i);
+            tp_release_workers(p, i);
+            return 0;
+        }
+        if (pin_workers) {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(i % n_cpus, &cpus);
+            if (pthread_setaffinity_np(w->thread, sizeof(cpus), &cpus) != 0)
+                TP_LOG("unable to pin worker %u\n", i);
+        }
+    }
+    return 1;
+}
+
+void thread_pool_free(thread_pool_t* p)
+{
+    if (p->workers != NULL)
+        tp_release_workers(p, p->n_workers);
+}
+
+void thread_pool_set_input_size(thread_pool_t* p, unsigned long input_size)
+{
+    unsigned i;
+    for (i = 0; i < p->n_workers; ++i)
+        if (!tp_alloc_buffers(&p->workers[i], input_size)) {
+            TP_LOG("unable to grow the buffers of worker %u\n", i);
+            abort();
+        }
+}
+
+void thread_pool_submit(thread_pool_t* p, tp_task_fn_t fn, void* arg)
+{
+    tp_task_t    t = {.fn = fn, .arg = arg};
+    tp_worker_t* w = tp_current_worker;
+    if (w == NULL || w->pool != p)
+        w = &p->workers[__atomic_fetch_add(&p->next_worker, 1,
+                                           __ATOMIC_RELAXED) %
+                        p->n_workers];
+
+    __atomic_add_fetch(&p->outstanding, 1, __ATOMIC_ACQ_REL);
+    if (!tp_deque_push_bottom(&w->deque, t)) {
+        TP_LOG("unable to grow the deque of worker %u\n", w->id);
+        abort();
+    }
+
+    pthread_mutex_lock(&p->lock);
+    __atomic_add_fetch(&p->queued, 1, __ATOMIC_ACQ_REL);
+    pthread_cond_signal(&p->work_available);
+    pthread_mutex_unlock(&p->lock);
+}
+
+void thread_pool_wait(thread_pool_t* p)
+{
+    // must not be called by a worker: its own task would never complete
+    pthread_mutex_lock(&p->lock);
+    while (__atomic_load_n(&p->outstanding, __ATOMIC_ACQUIRE) > 0)
+        pthread_cond_wait(&p->all_done, &p->lock);
+    pthread_mutex_unlock(&p->lock);
+    __atomic_store_n(&p->cancelled, 0, __ATOMIC_RELEASE);
+}
+
+void thread_pool_cancel(thread_pool_t* p)
+{
+    __atomic_store_n(&p->cancelled, 1, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,109 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+// Fixed set of worker threads for the parallel modes of the solver. Every
+// worker owns a deque of tasks: it pops from the bottom of its own deque
+// and, when it is empty, steals from the top of the others. Tasks
+// submitted by a worker go to its own deque, the others are spread round
+// robin. Each worker has its own scratch space (input/proof buffers, a
+// bump arena reset after every task and an RNG stream disjoint from the
+// ones of the other workers), so that tasks never touch the globals of the
+// solver. Cancellation is cooperative: tasks poll thread_pool_cancelled()
+// between evaluations.
+
+#define TP_MAX_WORKERS 64
+#define TP_ARENA_CHUNK_SIZE (64 * 1024)
+
+struct thread_pool_t;
+struct tp_worker_t;
+
+typedef void (*tp_task_fn_t)(struct tp_worker_t* w, void* arg);
+
+typedef struct tp_task_t {
+    tp_task_fn_t fn;
+    void*        arg;
+} tp_task_t;
+
+typedef struct tp_deque_t {
+    tp_task_t*      tasks; // ring buffer
+    unsigned        capacity;
+    unsigned        top;
+    unsigned        size;
+    pthread_mutex_t lock;
+} tp_deque_t;
+
+typedef struct tp_arena_chunk_t {
+    struct tp_arena_chunk_t* next;
+    size_t                   size;
+    size_t                   used;
+    unsigned char            data[];
+} tp_arena_chunk_t;
+
+typedef struct tp_arena_t {
+    tp_arena_chunk_t* chunks;
+} tp_arena_t;
+
+typedef struct tp_worker_t {
+    unsigned              id;
+    pthread_t             thread;
+    struct thread_pool_t* pool;
+    tp_deque_t            deque;
+
+    // scratch space of the worker
+    unsigned long* input;
+    unsigned char* proof;
+    unsigned long  input_size;
+    tp_arena_t     arena;
+    uint64_t       rng_state;
+} tp_worker_t;
+
+typedef struct thread_pool_t {
+    tp_worker_t* workers;
+    unsigned     n_workers;
+    unsigned     next_worker; // round robin of external submissions
+
+    long            queued;      // tasks in the deques
+    long            outstanding; // tasks submitted and not completed
+    int             cancelled;
+    int             shutdown;
+    pthread_mutex_t lock;
+    pthread_cond_t  work_available;
+    pthread_cond_t  all_done;
+} thread_pool_t;
+
+// n_workers == 0 uses one worker per online CPU. With pin_workers, worker
+// i is bound to CPU i (modulo the number of CPUs)
+int  thread_pool_init(thread_pool_t* p, unsigned n_workers,
+                      unsigned long input_size, int pin_workers);
+void thread_pool_free(thread_pool_t* p);
+
+// grow the input/proof buffers of the (idle) workers
+void thread_pool_set_input_size(thread_pool_t* p, unsigned long input_size);
+
+void thread_pool_submit(thread_pool_t* p, tp_task_fn_t fn, void* arg);
+// wait for the completion of every submitted task, then clear the
+// cancellation flag
+void thread_pool_wait(thread_pool_t* p);
+void thread_pool_cancel(thread_pool_t* p);
+
+static inline int thread_pool_cancelled(tp_worker_t* w)
+{
+    return __atomic_load_n(&w->pool->cancelled, __ATOMIC_RELAXED);
+}
+
+// NULL when the caller is not a worker
+tp_worker_t* thread_pool_current_worker(void);
+
+void*    tp_arena_alloc(tp_worker_t* w, size_t size);
+uint64_t tp_rand(tp_worker_t* w);
+
+static inline unsigned tp_rand_below(tp_worker_t* w, unsigned limit)
+{
+    return limit == 0 ? 0 : (unsigned)(tp_rand(w) % limit);
+}
+
+#endif
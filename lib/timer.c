@@ -7,8 +7,6 @@
 #define unlikely(x) __builtin_expect(!!(x), 0)
 #endif
 
-static struct timeval stop;
-
 static inline unsigned long compute_time_msec(struct timeval* start,
                                               struct timeval* end)
 {
@@ -31,8 +29,10 @@ void init_timer(simple_timer_t* t, uint64_t time_max_msec)
 
 void start_timer(simple_timer_t* t) { gettimeofday(&t->start, 0); }
 
+// reentrant: the workers of the parallel phases check the timer too
 int check_timer(simple_timer_t* t)
 {
+    struct timeval stop;
     gettimeofday(&stop, 0);
     unsigned long delta_time = compute_time_msec(&t->start, &stop);
     if (delta_time > t->time_max_msec)
@@ -42,6 +42,7 @@ int check_timer(simple_timer_t* t)
 
 unsigned long get_elapsed_time(simple_timer_t* t)
 {
+    struct timeval stop;
     gettimeofday(&stop, 0);
     unsigned long delta_time = compute_time_usec(&t->start, &stop);
     return delta_time;
@@ -145,6 +145,46 @@ static inline void add_item_to_conflicting(dict__conflicting_ptr* dict,
     set_add__ast_ptr(el, v);
 }
 // ******** end conflicting dict *********
+// ********* seed eval dict **************
+typedef struct seed_eval_t {
+    ast_ptr       ast;
+    unsigned long value;
+} seed_eval_t;
+#define DICT_DATA_T seed_eval_t
+#include "dict.h"
+
+static void seed_eval_free(seed_eval_t* el) { ast_ptr_free(&el->ast); }
+// ******** end seed eval dict ***********
+// ********* lookup table dict ***********
+typedef struct lookup_table_t {
+    ast_ptr        ast;
+    unsigned long* table; // NULL if the subterm is not worth a table
+    unsigned long  size;
+    unsigned       support[2]; // input bytes, the first is the LSB of the key
+    unsigned       n_support;
+} lookup_table_t;
+#define DICT_DATA_T lookup_table_t
+#include "dict.h"
+
+static void lookup_table_free(lookup_table_t* el)
+{
+    ast_ptr_free(&el->ast);
+    free(el->table);
+}
+
+typedef struct lookup_tables_t {
+    dict__lookup_table_t tables;
+    unsigned long        bytes;
+} lookup_tables_t;
+// ******** end lookup table dict ********
+// ********* blasted term dict ***********
+typedef struct blasted_term_t {
+    unsigned long offset; // first literal of the term in the blaster
+    unsigned      width;
+} blasted_term_t;
+#define DICT_DATA_T blasted_term_t
+#include "dict.h"
+// ******** end blasted term dict ********
 // ********** interval group *************
 typedef struct interval_group_t {
     wrapped_interval_t interval;
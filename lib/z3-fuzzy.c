@@ -3,8 +3,13 @@
 #include <fcntl.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <pthread.h>
 #include "gradient_descend.h"
 #include "wrapped_interval.h"
+#include "shared-knowledge.h"
+#include "metrics.h"
+#include "thread-pool.h"
+#include "micro-sat.h"
 #include "timer.h"
 #include "z3-fuzzy.h"
 
@@ -34,6 +39,10 @@
 #define HAVOC_STACK_POW2 7
 #define HAVOC_C 20
 #define RANGE_MAX_WIDTH_BRUTE_FORCE 2048
+#define RANGE_BOX_MAX_DIMS 16
+#define RANGE_BOX_MAX_CORNER_DIMS 6
+#define RANGE_BOX_BATCH_SIZE 32
+#define RANGE_BOX_MAX_SAMPLES 1024
 #define Z3_UNIQUE Z3_get_ast_hash // Z3_get_ast_id
 
 // #define PRINT_SAT
@@ -56,10 +65,12 @@ static int skip_notify     = 0;
 static int skip_reuse                   = 1;
 static int skip_input_to_state          = 0;
 static int skip_simple_math             = 0;
+static int skip_input_to_input          = 0;
 static int skip_input_to_state_extended = 0;
 static int skip_brute_force             = 0;
 static int skip_range_brute_force       = 0;
 static int skip_range_brute_force_opt   = 0;
+static int skip_range_box               = 0;
 static int skip_gradient_descend        = 0;
 
 static int skip_afl_deterministic          = 0;
@@ -83,8 +94,128 @@ static int skip_freeze_neighbours = 1;
 static int skip_afl_havoc         = 0;
 static int use_greedy_mamin       = 0;
 static int check_unnecessary_eval = 1;
+static int skip_fast_eval         = 0;
+static int check_fast_eval        = 0;
+static int skip_lookup_tables     = 0;
+static int skip_range_pruning     = 0;
+static int skip_micro_sat         = 0;
+static int skip_div_mod           = 0;
 
 static int max_ast_info_cache_size = 14000;
+static int max_seed_eval_cache_size = 14000;
+static int skip_seed_eval_cache     = 0;
+static int max_branch_checkpoints   = 1024;
+static int max_checkpoint_digests   = 1 << 16;
+static int skip_branch_checkpoints  = 0;
+static int use_shared_ast_info_cache = 0;
+
+static shared_knowledge_t shared_knowledge;
+static int                use_shared_knowledge = 0;
+
+// counters of fuzzy_stats_t exported by the metrics subsystem. The ones
+// updated by the queries are published as a delta at the end of each query
+#define METRICS_STATS(X)                                                       \
+    X(num_evaluate)                                                            \
+    X(num_fast_evaluate)                                                       \
+    X(aggressive_opt_evaluate)                                                 \
+    X(num_sat)                                                                 \
+    X(opt_sat)                                                                 \
+    X(reuse)                                                                   \
+    X(input_to_state)                                                          \
+    X(simple_math)                                                             \
+    X(div_mod)                                                                 \
+    X(input_to_input)                                                          \
+    X(input_to_state_ext)                                                      \
+    X(brute_force)                                                             \
+    X(range_brute_force)                                                       \
+    X(range_brute_force_opt)                                                   \
+    X(range_box)                                                               \
+    X(micro_sat)                                                               \
+    X(micro_sat_unsat)                                                         \
+    X(gradient_descend)                                                        \
+    X(flip1)                                                                   \
+    X(flip2)                                                                   \
+    X(flip4)                                                                   \
+    X(flip8)                                                                   \
+    X(arith8_sum)                                                              \
+    X(arith8_sub)                                                              \
+    X(int8)                                                                    \
+    X(flip16)                                                                  \
+    X(arith16_sum_LE)                                                          \
+    X(arith16_sum_BE)                                                          \
+    X(arith16_sub_LE)                                                          \
+    X(arith16_sub_BE)                                                          \
+    X(int16)                                                                   \
+    X(flip32)                                                                  \
+    X(arith32_sum_LE)                                                          \
+    X(arith32_sum_BE)                                                          \
+    X(arith32_sub_LE)                                                          \
+    X(arith32_sub_BE)                                                          \
+    X(int32)                                                                   \
+    X(flip64)                                                                  \
+    X(arith64_sum_LE)                                                          \
+    X(arith64_sum_BE)                                                          \
+    X(arith64_sub_LE)                                                          \
+    X(arith64_sub_BE)                                                          \
+    X(int64)                                                                   \
+    X(havoc)                                                                   \
+    X(multigoal)                                                               \
+    X(sat_in_seed)                                                             \
+    X(conflicting_fallbacks)                                                   \
+    X(conflicting_fallbacks_same_inputs)                                       \
+    X(conflicting_fallbacks_no_true)                                           \
+    X(ast_info_cache_hits)                                                     \
+    X(seed_eval_cache_hits)                                                    \
+    X(branch_checkpoint_resumes)                                               \
+    X(ast_info_shared_cache_hits)                                              \
+    X(shared_knowledge_hits)                                                   \
+    X(num_lookup_tables)                                                       \
+    X(num_unhashed_evaluate)                                                   \
+    X(num_timeouts)
+
+// ... while the ones updated by z3fuzz_notify_constraint are published as
+// soon as they change
+#define METRICS_NOTIFY_STATS(X)                                                \
+    X(num_univocally_defined)                                                  \
+    X(num_range_constraints)                                                   \
+    X(num_conflicting)
+
+typedef enum metric_id_t {
+#define X(field) METRIC_##field,
+    METRICS_STATS(X)
+    METRICS_NOTIFY_STATS(X)
+#undef X
+    METRIC_queries,
+    METRIC_query_time_msec,
+    METRIC_ast_info_cache_size,
+    METRIC_seed_eval_cache_size,
+    METRIC_branch_checkpoints_size,
+    METRIC_conflicting_ast_size,
+    METRIC_N
+} metric_id_t;
+
+static const metrics_desc_t metrics_descs[METRIC_N] = {
+#define X(field) {#field, METRICS_COUNTER},
+    METRICS_STATS(X)
+    METRICS_NOTIFY_STATS(X)
+#undef X
+    {"queries", METRICS_COUNTER},
+    {"query_time_msec", METRICS_COUNTER},
+    {"ast_info_cache_size", METRICS_GAUGE},
+    {"seed_eval_cache_size", METRICS_GAUGE},
+    {"branch_checkpoints_size", METRICS_GAUGE},
+    {"conflicting_ast_size", METRICS_GAUGE}};
+
+static metrics_t metrics;
+static int       use_metrics = 0;
+
+// workers of the parallel phases, Z3FUZZ_THREADS > 1 enables them
+static thread_pool_t thread_pool;
+static int           use_thread_pool = 0;
+
+// the workers are not duplicated by fork(): a child process (e.g., a worker
+// of the fork server of fuzzy-solver) runs the sequential phases
+static void __thread_pool_atfork_child(void) { use_thread_pool = 0; }
 
 static int performing_aggressive_optimistic = 0;
 
@@ -113,6 +244,9 @@ typedef struct ast_info_t {
     da__index_group_t index_groups_ud;
     da__ulong         indexes_ud;
     da__ite_its_t     inp_to_state_ite;
+
+    // the info depends on the assignments of the context
+    unsigned uses_assignments;
 } ast_info_t;
 
 typedef struct ast_data_t {
@@ -133,6 +267,64 @@ typedef ast_info_t* ast_info_ptr;
 #define DICT_DATA_T ast_info_ptr
 #include "dict.h"
 
+typedef enum search_phase_t {
+    SEARCH_PHASE_REUSE,
+    SEARCH_PHASE_INPUT_TO_STATE,
+    SEARCH_PHASE_SIMPLE_MATH,
+    SEARCH_PHASE_DIV_MOD,
+    SEARCH_PHASE_INPUT_TO_INPUT,
+    SEARCH_PHASE_RANGE_BRUTEFORCE,
+    SEARCH_PHASE_RANGE_BRUTEFORCE_OPT,
+    SEARCH_PHASE_RANGE_BOX,
+    SEARCH_PHASE_INPUT_TO_STATE_EXT,
+    SEARCH_PHASE_BRUTE_FORCE,
+    SEARCH_PHASE_MICRO_SAT,
+    SEARCH_PHASE_GRADIENT_DESCEND,
+    SEARCH_PHASE_AFL_DETERMINISTIC,
+    SEARCH_PHASE_AFL_HAVOC
+} search_phase_t;
+
+typedef struct branch_checkpoint_t {
+    // search state left by the last failed attempt on a branch condition
+    ast_ptr        branch_condition;
+    ast_ptr        query;
+    unsigned long  knowledge_digest;
+    unsigned       phase;
+    da__digest_t   processed;
+    unsigned long  values_len;
+    unsigned long* opt_input;
+    unsigned long* gd_input;
+    unsigned       gd_input_size;
+    unsigned long* havoc_input;
+} branch_checkpoint_t;
+
+typedef branch_checkpoint_t* branch_checkpoint_ptr;
+#define DICT_DATA_T branch_checkpoint_ptr
+#include "dict.h"
+
+static void branch_checkpoint_reset(branch_checkpoint_t* cp)
+{
+    da_remove_all__digest_t(&cp->processed, NULL);
+    free(cp->opt_input);
+    free(cp->gd_input);
+    free(cp->havoc_input);
+    cp->phase         = 0;
+    cp->opt_input     = NULL;
+    cp->gd_input      = NULL;
+    cp->gd_input_size = 0;
+    cp->havoc_input   = NULL;
+}
+
+static void branch_checkpoint_ptr_free(branch_checkpoint_ptr* el)
+{
+    branch_checkpoint_t* cp = *el;
+    branch_checkpoint_reset(cp);
+    da_free__digest_t(&cp->processed, NULL);
+    ast_ptr_free(&cp->branch_condition);
+    ast_ptr_free(&cp->query);
+    free(cp);
+}
+
 static unsigned long* tmp_input           = NULL;
 static unsigned long* tmp_opt_input       = NULL;
 static unsigned char* tmp_proof           = NULL;
@@ -141,6 +333,20 @@ static int            opt_found           = 0;
 static unsigned       opt_num_sat         = 0;
 static ast_data_t     ast_data            = {0};
 static char           notify_count        = 0;
+
+static branch_checkpoint_t* active_checkpoint = NULL;
+static unsigned             current_phase     = 0;
+
+// progressive mode: the caller is notified of every strictly better
+// optimistic solution, and can stop the search from the callback. The
+// parallel phases report from the workers, stop_requested is atomic
+typedef fuzzy_findall_res_t (*progress_callback_t)(unsigned char const*,
+                                                   unsigned long, unsigned,
+                                                   int);
+static progress_callback_t progress_callback = NULL;
+static int                 progress_reported = 0;
+static unsigned            progress_depth    = 0;
+static int                 stop_requested    = 0;
 static unsigned long  g_prev_num_evaluate = 0;
 
 static char* query_log_filename = "/home/clustfuzz/Documents/fuzzy-sat/fuzzy-log-info.csv";
@@ -258,6 +464,9 @@ static long interesting64[] = {
 
 static inline int timer_check_wrapper(fuzzy_ctx_t* ctx)
 {
+    // a stop requested by the progress callback behaves like a timeout
+    if (unlikely(__atomic_load_n(&stop_requested, __ATOMIC_RELAXED)))
+        return 1;
     if (ctx->timer == NULL)
         return 0;
     static int i = 0;
@@ -324,6 +533,7 @@ static inline void ast_info_init(ast_info_ptr ptr)
     ptr->input_extract_ops               = 0;
     ptr->query_size                      = 0;
     ptr->approximated_groups             = 0;
+    ptr->uses_assignments                = 0;
 }
 
 static inline void ast_info_reset(ast_info_ptr ptr)
@@ -338,6 +548,7 @@ static inline void ast_info_reset(ast_info_ptr ptr)
     ptr->input_extract_ops               = 0;
     ptr->query_size                      = 0;
     ptr->approximated_groups             = 0;
+    ptr->uses_assignments                = 0;
 }
 
 static inline void ast_info_ptr_free(ast_info_ptr* ptr)
@@ -350,6 +561,234 @@ static inline void ast_info_ptr_free(ast_info_ptr* ptr)
     free(*ptr);
 }
 
+static inline unsigned long __mix_index(unsigned long v)
+{
+    // splitmix64 finalizer
+    v = (v ^ (v >> 30)) * 0xbf58476d1ce4e5b9UL;
+    v = (v ^ (v >> 27)) * 0x94d049bb133111ebUL;
+    return v ^ (v >> 31);
+}
+
+// ******** shared ast_info cache ********
+// Process-wide cache of the ast_info of the roots, shared by the contexts of
+// the process (e.g., the ones living in different Z3 contexts, used one at a
+// time). The key is a 64-bit structural hash of the whole AST, mixed with a
+// digest of the context state the info depends on (seed size and univocally
+// defined inputs): the match is probabilistic, the ASTs are not compared.
+// Entries are copied in and out, since the sets in ast_info_t keep their
+// iteration state inline.
+
+typedef struct shared_ast_info_t {
+    unsigned long hash;
+    unsigned long ctx_digest;
+    ast_info_ptr  info;
+} shared_ast_info_t;
+
+typedef shared_ast_info_t* shared_ast_info_ptr;
+#define DICT_N_BUCKETS 256
+#define DICT_DATA_T shared_ast_info_ptr
+#include "dict.h"
+
+#define DICT_N_BUCKETS 256
+#define DICT_DATA_T ulong
+#include "dict.h"
+
+#define SHARED_AST_INFO_N_SHARDS 64
+
+typedef struct shared_ast_info_shard_t {
+    pthread_mutex_t           lock;
+    dict__shared_ast_info_ptr cache;
+} shared_ast_info_shard_t;
+
+static shared_ast_info_shard_t shared_ast_info_shards[SHARED_AST_INFO_N_SHARDS];
+static pthread_once_t          shared_ast_info_once        = PTHREAD_ONCE_INIT;
+static int                     shared_ast_info_initialized = 0;
+
+static void __union_ast_info(ast_info_ptr dst, ast_info_ptr src);
+
+static void shared_ast_info_ptr_free(shared_ast_info_ptr* ptr)
+{
+    ast_info_ptr_free(&(*ptr)->info);
+    free(*ptr);
+}
+
+static void shared_ast_info_init()
+{
+    unsigned i;
+    for (i = 0; i < SHARED_AST_INFO_N_SHARDS; ++i) {
+        pthread_mutex_init(&shared_ast_info_shards[i].lock, NULL);
+        dict_init__shared_ast_info_ptr(&shared_ast_info_shards[i].cache,
+                                       shared_ast_info_ptr_free);
+    }
+    shared_ast_info_initialized = 1;
+}
+
+static void shared_ast_info_free()
+{
+    if (!shared_ast_info_initialized)
+        return;
+
+    unsigned i;
+    for (i = 0; i < SHARED_AST_INFO_N_SHARDS; ++i) {
+        dict_free__shared_ast_info_ptr(&shared_ast_info_shards[i].cache);
+        pthread_mutex_destroy(&shared_ast_info_shards[i].lock);
+    }
+    shared_ast_info_initialized = 0;
+}
+
+static unsigned long __ast_shape(fuzzy_ctx_t* ctx, Z3_ast v)
+{
+    Z3_ast_kind   kind  = Z3_get_ast_kind(ctx->z3_ctx, v);
+    unsigned long shape = __mix_index(kind);
+
+    Z3_sort sort = Z3_get_sort(ctx->z3_ctx, v);
+    if (Z3_get_sort_kind(ctx->z3_ctx, sort) == Z3_BV_SORT)
+        shape = __mix_index(shape ^ Z3_get_bv_sort_size(ctx->z3_ctx, sort));
+
+    if (kind == Z3_NUMERAL_AST) {
+        uint64_t n;
+        if (Z3_get_numeral_uint64(ctx->z3_ctx, v, &n))
+            shape = __mix_index(shape ^ n);
+    } else if (kind == Z3_APP_AST) {
+        Z3_app       app  = Z3_to_app(ctx->z3_ctx, v);
+        Z3_func_decl decl = Z3_get_app_decl(ctx->z3_ctx, app);
+        shape = __mix_index(shape ^ Z3_get_decl_kind(ctx->z3_ctx, decl));
+
+        unsigned i, num_args = Z3_get_app_num_args(ctx->z3_ctx, app);
+        for (i = 0; i < num_args; ++i)
+            shape = __mix_index(
+                shape ^ Z3_UNIQUE(ctx->z3_ctx,
+                                  Z3_get_app_arg(ctx->z3_ctx, app, i)));
+    }
+    return shape;
+}
+
+static unsigned long __ast_structural_hash_rec(fuzzy_ctx_t* ctx, Z3_ast v,
+                                               dict__ulong* memo)
+{
+    unsigned long  id = Z3_get_ast_id(ctx->z3_ctx, v);
+    unsigned long* cached;
+    if ((cached = dict_get_ref__ulong(memo, id)) != NULL)
+        return *cached;
+
+    Z3_ast_kind   kind = Z3_get_ast_kind(ctx->z3_ctx, v);
+    unsigned long hash = __mix_index(kind);
+
+    Z3_sort sort = Z3_get_sort(ctx->z3_ctx, v);
+    hash         = __mix_index(hash ^ Z3_get_sort_kind(ctx->z3_ctx, sort));
+    if (Z3_get_sort_kind(ctx->z3_ctx, sort) == Z3_BV_SORT)
+        hash = __mix_index(hash ^ Z3_get_bv_sort_size(ctx->z3_ctx, sort));
+
+    if (kind == Z3_NUMERAL_AST) {
+        uint64_t    n;
+        const char* p;
+        if (Z3_get_numeral_uint64(ctx->z3_ctx, v, &n))
+            hash = __mix_index(hash ^ n);
+        else
+            for (p = Z3_get_numeral_string(ctx->z3_ctx, v); *p; ++p)
+                hash = __mix_index(hash ^ (unsigned char)*p);
+    } else if (kind == Z3_APP_AST) {
+        Z3_app       app  = Z3_to_app(ctx->z3_ctx, v);
+        Z3_func_decl decl = Z3_get_app_decl(ctx->z3_ctx, app);
+        Z3_symbol    name = Z3_get_decl_name(ctx->z3_ctx, decl);
+        hash = __mix_index(hash ^ Z3_get_decl_kind(ctx->z3_ctx, decl));
+
+        // the inputs are told apart by name, extract and the extensions by
+        // their parameters
+        if (Z3_get_symbol_kind(ctx->z3_ctx, name) == Z3_INT_SYMBOL)
+            hash = __mix_index(hash ^ Z3_get_symbol_int(ctx->z3_ctx, name));
+        else {
+            const char* p = Z3_get_symbol_string(ctx->z3_ctx, name);
+            for (; *p; ++p)
+                hash = __mix_index(hash ^ (unsigned char)*p);
+        }
+        unsigned i, n = Z3_get_decl_num_parameters(ctx->z3_ctx, decl);
+        for (i = 0; i < n; ++i)
+            if (Z3_get_decl_parameter_kind(ctx->z3_ctx, decl, i) ==
+                Z3_PARAMETER_INT)
+                hash = __mix_index(
+                    hash ^ Z3_get_decl_int_parameter(ctx->z3_ctx, decl, i));
+
+        n = Z3_get_app_num_args(ctx->z3_ctx, app);
+        for (i = 0; i < n; ++i)
+            hash = __mix_index(
+                hash ^ __ast_structural_hash_rec(
+                           ctx, Z3_get_app_arg(ctx->z3_ctx, app, i), memo));
+    }
+
+    dict_set__ulong(memo, id, hash);
+    return hash;
+}
+
+static unsigned long __ast_structural_hash(fuzzy_ctx_t* ctx, Z3_ast v)
+{
+    // the memo keeps the visit linear in the size of the DAG
+    dict__ulong memo;
+    dict_init__ulong(&memo, NULL);
+    unsigned long hash = __ast_structural_hash_rec(ctx, v, &memo);
+    dict_free__ulong(&memo);
+    return hash;
+}
+
+static inline unsigned long __shared_ast_info_ctx_digest(fuzzy_ctx_t* ctx)
+{
+    return ctx->univocally_defined_digest ^
+           __mix_index(ctx->testcases.data[0].testcase_len);
+}
+
+static int __shared_ast_info_lookup(fuzzy_ctx_t* ctx, unsigned long hash,
+                                    ast_info_ptr* data)
+{
+    pthread_once(&shared_ast_info_once, shared_ast_info_init);
+
+    unsigned long ctx_digest = __shared_ast_info_ctx_digest(ctx);
+    unsigned long key        = hash ^ ctx_digest;
+    shared_ast_info_shard_t* shard =
+        &shared_ast_info_shards[key % SHARED_AST_INFO_N_SHARDS];
+
+    int res = 0;
+    pthread_mutex_lock(&shard->lock);
+    shared_ast_info_ptr* el =
+        dict_get_ref__shared_ast_info_ptr(&shard->cache, key);
+    if (el != NULL && (*el)->ctx_digest == ctx_digest &&
+        (*el)->hash == hash) {
+        *data = (ast_info_ptr)malloc(sizeof(ast_info_t));
+        ASSERT_OR_ABORT(*data, "__shared_ast_info_lookup() failed malloc");
+        ast_info_init(*data);
+        __union_ast_info(*data, (*el)->info);
+        res = 1;
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return res;
+}
+
+static void __shared_ast_info_publish(fuzzy_ctx_t* ctx, unsigned long hash,
+                                      ast_info_ptr src)
+{
+    pthread_once(&shared_ast_info_once, shared_ast_info_init);
+
+    shared_ast_info_ptr el =
+        (shared_ast_info_ptr)malloc(sizeof(shared_ast_info_t));
+    ASSERT_OR_ABORT(el, "__shared_ast_info_publish() failed malloc");
+    el->ctx_digest = __shared_ast_info_ctx_digest(ctx);
+    el->hash       = hash;
+    el->info       = (ast_info_ptr)malloc(sizeof(ast_info_t));
+    ASSERT_OR_ABORT(el->info, "__shared_ast_info_publish() failed malloc");
+    ast_info_init(el->info);
+    __union_ast_info(el->info, src);
+
+    unsigned long            key = hash ^ el->ctx_digest;
+    shared_ast_info_shard_t* shard =
+        &shared_ast_info_shards[key % SHARED_AST_INFO_N_SHARDS];
+
+    pthread_mutex_lock(&shard->lock);
+    if (unlikely(shard->cache.size > max_ast_info_cache_size))
+        dict_remove_all__shared_ast_info_ptr(&shard->cache);
+    dict_set__shared_ast_info_ptr(&shard->cache, key, el);
+    pthread_mutex_unlock(&shard->lock);
+}
+// ****** end shared ast_info cache ******
+
 static inline void ast_data_init(ast_data_t* ast_data)
 {
     set_init__digest_t(&ast_data->processed_set, &digest_64bit_hash,
@@ -394,19 +833,25 @@ static eval_wapper_ctx_t* eval_ctx;
 
 void eval_set_ctx(eval_wapper_ctx_t* c) { eval_ctx = c; }
 
-static void __gd_fix_tmp_input(unsigned long* x)
+static void __gd_fix_input(eval_wapper_ctx_t* ew, unsigned long* x,
+                           unsigned long* input)
 {
     unsigned i, j;
-    for (i = 0; i < eval_ctx->mapping_size; ++i) {
-        mapping_el_t* mel = &eval_ctx->mapping[i];
+    for (i = 0; i < ew->mapping_size; ++i) {
+        mapping_el_t* mel = &ew->mapping[i];
         for (j = 0; j < mel->n; ++j) {
             mapping_subel_t* sel   = &mel->subels[j];
             unsigned long    value = (x[i] & sel->mask) >> sel->shift;
-            tmp_input[sel->idx]    = value & 0xff;
+            input[sel->idx]        = value & 0xff;
         }
     }
 }
 
+static void __gd_fix_tmp_input(unsigned long* x)
+{
+    __gd_fix_input(eval_ctx, x, tmp_input);
+}
+
 static void __gd_restore_tmp_input(testcase_t* t)
 {
     unsigned i, j;
@@ -848,6 +1293,8 @@ static void init_config_params()
     env_get_or_die(&skip_reuse, getenv("Z3FUZZ_SKIP_REUSE"));
     env_get_or_die(&skip_input_to_state, getenv("Z3FUZZ_SKIP_INPUT_TO_STATE"));
     env_get_or_die(&skip_simple_math, getenv("Z3FUZZ_SKIP_SIMPLE_MATH"));
+    env_get_or_die(&skip_input_to_input,
+                   getenv("Z3FUZZ_SKIP_INPUT_TO_INPUT"));
     env_get_or_die(&skip_input_to_state_extended,
                    getenv("Z3FUZZ_SKIP_INPUT_TO_STATE_EXTENDED"));
     env_get_or_die(&skip_brute_force, getenv("Z3FUZZ_SKIP_BRUTE_FORCE"));
@@ -855,6 +1302,7 @@ static void init_config_params()
                    getenv("Z3FUZZ_SKIP_RANGE_BRUTE_FORCE"));
     env_get_or_die(&skip_range_brute_force_opt,
                    getenv("Z3FUZZ_SKIP_RANGE_BRUTE_FORCE_OPT"));
+    env_get_or_die(&skip_range_box, getenv("Z3FUZZ_SKIP_RANGE_BOX"));
     env_get_or_die(&skip_afl_deterministic,
                    getenv("Z3FUZZ_SKIP_DETERMINISTIC"));
     env_get_or_die(&skip_afl_det_single_walking_bit,
@@ -881,6 +1329,18 @@ static void init_config_params()
     env_get_or_die(&use_greedy_mamin, getenv("Z3FUZZ_USE_GREEDY_MAMIN"));
     env_get_or_die(&check_unnecessary_eval,
                    getenv("Z3FUZZ_CHECK_UNNECESSARY_EVAL"));
+    env_get_or_die(&use_shared_ast_info_cache,
+                   getenv("Z3FUZZ_USE_SHARED_AST_INFO_CACHE"));
+    env_get_or_die(&skip_fast_eval, getenv("Z3FUZZ_SKIP_FAST_EVAL"));
+    env_get_or_die(&check_fast_eval, getenv("Z3FUZZ_CHECK_FAST_EVAL"));
+    env_get_or_die(&skip_lookup_tables, getenv("Z3FUZZ_SKIP_LOOKUP_TABLES"));
+    env_get_or_die(&skip_range_pruning, getenv("Z3FUZZ_SKIP_RANGE_PRUNING"));
+    env_get_or_die(&skip_micro_sat, getenv("Z3FUZZ_SKIP_MICRO_SAT"));
+    env_get_or_die(&skip_div_mod, getenv("Z3FUZZ_SKIP_DIV_MOD"));
+    env_get_or_die(&skip_seed_eval_cache,
+                   getenv("Z3FUZZ_SKIP_SEED_EVAL_CACHE"));
+    env_get_or_die(&skip_branch_checkpoints,
+                   getenv("Z3FUZZ_SKIP_BRANCH_CHECKPOINTS"));
 }
 
 static int  g_global_ctx_initialized = 0;
@@ -906,6 +1366,9 @@ static void init_global_context(size_t input_size)
                 tmp_opt_proof, sizeof(unsigned char) * input_size);
             ASSERT_OR_ABORT(tmp_opt_proof,
                             "init_global_context(): realloc failed");
+            if (use_thread_pool)
+                thread_pool_set_input_size(&thread_pool, input_size);
+            current_input_size = input_size;
         }
         return;
     }
@@ -935,16 +1398,298 @@ static void init_global_context(size_t input_size)
     ast_data_init(&ast_data);
     gd_init();
 
+    char* shared_knowledge_name = getenv("Z3FUZZ_SHARED_KNOWLEDGE");
+    if (shared_knowledge_name != NULL)
+        use_shared_knowledge =
+            shared_knowledge_open(&shared_knowledge, shared_knowledge_name,
+                                  SK_DEFAULT_N_SLOTS);
+
+    char* metrics_target = getenv("Z3FUZZ_METRICS");
+    if (metrics_target != NULL) {
+        // Z3FUZZ_METRICS is a file or unix:<socket path>
+        char*    metrics_format     = getenv("Z3FUZZ_METRICS_FORMAT");
+        char*    metrics_interval_s = getenv("Z3FUZZ_METRICS_INTERVAL");
+        unsigned metrics_interval   = METRICS_DEFAULT_INTERVAL;
+        if (metrics_interval_s != NULL)
+            metrics_interval = strtoul(metrics_interval_s, NULL, 10);
+        use_metrics = metrics_open(
+            &metrics, metrics_target,
+            metrics_format != NULL && strcmp(metrics_format, "json") == 0
+                ? METRICS_FORMAT_JSON
+                : METRICS_FORMAT_PROMETHEUS,
+            metrics_interval, metrics_descs, METRIC_N);
+    }
+
+    char* n_threads_s = getenv("Z3FUZZ_THREADS");
+    if (n_threads_s != NULL) {
+        unsigned n_threads   = strtoul(n_threads_s, NULL, 10);
+        int      pin_threads = 0;
+        env_get_or_die(&pin_threads, getenv("Z3FUZZ_PIN_THREADS"));
+        if (n_threads > 1)
+            use_thread_pool = thread_pool_init(&thread_pool, n_threads,
+                                               input_size, pin_threads);
+        if (use_thread_pool)
+            pthread_atfork(NULL, NULL, __thread_pool_atfork_child);
+    }
+
     g_global_ctx_initialized = 1;
 }
 
-void z3fuzz_init(fuzzy_ctx_t* fctx, Z3_context ctx, char* seed_filename,
-                 char* testcase_path,
-                 uint64_t (*model_eval)(Z3_context, Z3_ast, uint64_t*, uint8_t*,
-                                        size_t, uint32_t*),
-                 unsigned timeout)
+// ***************************************************
+// **** ASSIGNMENTS - lazy concretization support ****
+// ***************************************************
+
+typedef struct pending_assignments_t {
+    // indexes of the assignments registered but not yet concretized in every
+    // testcase. The first sorted_size entries are in dependency order
+    da__ulong indexes;
+    unsigned  sorted_size;
+    // for each testcase, the first entry of indexes not yet concretized
+    unsigned* testcase_cursors;
+} pending_assignments_t;
+
+#define ASSIGNMENT_NOT_PENDING 0
+#define ASSIGNMENT_PENDING 1
+#define ASSIGNMENT_VISITING 2
+#define ASSIGNMENT_SORTED 3
+
+static void __sort_pending_assignment(fuzzy_ctx_t* ctx, unsigned long idx,
+                                      set__ulong* visited, unsigned char* state,
+                                      da__ulong* out);
+
+static void __sort_pending_assignments_visit_ast(fuzzy_ctx_t* ctx, Z3_ast e,
+                                                 set__ulong*    visited,
+                                                 unsigned char* state,
+                                                 da__ulong*     out)
+{
+    if (Z3_get_ast_kind(ctx->z3_ctx, e) != Z3_APP_AST)
+        return;
+
+    unsigned long ast_id = Z3_get_ast_id(ctx->z3_ctx, e);
+    if (set_check__ulong(visited, ast_id))
+        return;
+    set_add__ulong(visited, ast_id);
+
+    Z3_app       app       = Z3_to_app(ctx->z3_ctx, e);
+    Z3_func_decl decl      = Z3_get_app_decl(ctx->z3_ctx, app);
+    Z3_decl_kind decl_kind = Z3_get_decl_kind(ctx->z3_ctx, decl);
+    if (decl_kind == Z3_OP_UNINTERPRETED) {
+        Z3_symbol s = Z3_get_decl_name(ctx->z3_ctx, decl);
+        if (Z3_get_symbol_kind(ctx->z3_ctx, s) != Z3_INT_SYMBOL)
+            return;
+
+        unsigned long symbol_index = Z3_get_symbol_int(ctx->z3_ctx, s);
+        if (symbol_index < ctx->size_assignments &&
+            state[symbol_index] != ASSIGNMENT_NOT_PENDING)
+            __sort_pending_assignment(ctx, symbol_index, visited, state, out);
+        return;
+    }
+
+    unsigned i;
+    for (i = 0; i < Z3_get_app_num_args(ctx->z3_ctx, app); ++i)
+        __sort_pending_assignments_visit_ast(
+            ctx, Z3_get_app_arg(ctx->z3_ctx, app, i), visited, state, out);
+}
+
+static void __sort_pending_assignment(fuzzy_ctx_t* ctx, unsigned long idx,
+                                      set__ulong* visited, unsigned char* state,
+                                      da__ulong* out)
+{
+    if (state[idx] == ASSIGNMENT_SORTED)
+        return;
+    ASSERT_OR_ABORT(state[idx] != ASSIGNMENT_VISITING,
+                    "__sort_pending_assignment() cyclic assignment");
+
+    // an assignment must be concretized after the assignments it refers to
+    state[idx] = ASSIGNMENT_VISITING;
+    __sort_pending_assignments_visit_ast(ctx, ctx->assignments[idx], visited,
+                                         state, out);
+    state[idx] = ASSIGNMENT_SORTED;
+    da_add_item__ulong(out, idx);
+}
+
+static void __sort_pending_assignments(fuzzy_ctx_t* ctx)
+{
+    pending_assignments_t* pending =
+        (pending_assignments_t*)ctx->pending_assignments;
+
+    unsigned char* state = (unsigned char*)calloc(ctx->size_assignments, 1);
+    ASSERT_OR_ABORT(state, "__sort_pending_assignments() failed calloc");
+
+    unsigned i;
+    for (i = pending->sorted_size; i < pending->indexes.size; ++i)
+        state[pending->indexes.data[i]] = ASSIGNMENT_PENDING;
+
+    set__ulong visited;
+    da__ulong  out;
+    set_init__ulong(&visited, &index_hash, &index_equals);
+    da_init__ulong(&out);
+
+    for (i = pending->sorted_size; i < pending->indexes.size; ++i)
+        __sort_pending_assignment(ctx, pending->indexes.data[i], &visited,
+                                  state, &out);
+
+    // replace the unsorted tail (duplicates are dropped)
+    pending->indexes.size = pending->sorted_size;
+    for (i = 0; i < out.size; ++i)
+        da_add_item__ulong(&pending->indexes, out.data[i]);
+    pending->sorted_size = pending->indexes.size;
+
+    da_free__ulong(&out, NULL);
+    set_free__ulong(&visited, NULL);
+    free(state);
+}
+
+static void __concretize_pending_assignments(fuzzy_ctx_t* ctx,
+                                             unsigned     testcase_idx)
+{
+    pending_assignments_t* pending =
+        (pending_assignments_t*)ctx->pending_assignments;
+    if (likely(pending->testcase_cursors[testcase_idx] ==
+               pending->indexes.size))
+        return;
+
+    if (pending->sorted_size < pending->indexes.size)
+        __sort_pending_assignments(ctx);
+
+    testcase_t* testcase = &ctx->testcases.data[testcase_idx];
+    unsigned    i;
+    for (i = pending->testcase_cursors[testcase_idx];
+         i < pending->indexes.size; ++i) {
+        unsigned long idx = pending->indexes.data[i];
+        if (testcase->z3_values[idx] != NULL)
+            continue;
+
+        unsigned long assignment_value_concrete = ctx->model_eval(
+            ctx->z3_ctx, ctx->assignments[idx], testcase->values,
+            testcase->value_sizes, testcase->values_len, NULL);
+
+        testcase->values[idx]    = assignment_value_concrete;
+        testcase->z3_values[idx] = Z3_mk_unsigned_int64(
+            ctx->z3_ctx, assignment_value_concrete,
+            Z3_mk_bv_sort(ctx->z3_ctx, testcase->value_sizes[idx]));
+        Z3_inc_ref(ctx->z3_ctx, testcase->z3_values[idx]);
+    }
+    pending->testcase_cursors[testcase_idx] = pending->indexes.size;
+
+    for (i = 0; i < ctx->testcases.size; ++i)
+        if (pending->testcase_cursors[i] != pending->indexes.size)
+            return;
+
+    // every testcase is up to date
+    da_remove_all__ulong(&pending->indexes, NULL);
+    pending->sorted_size = 0;
+    memset(pending->testcase_cursors, 0,
+           sizeof(unsigned) * ctx->testcases.size);
+}
+
+static void __register_assignments(fuzzy_ctx_t* ctx, int* idxs,
+                                   Z3_ast* assignment_values, unsigned n)
+{
+    if (n == 0)
+        return;
+
+    unsigned i, j;
+    int      max_idx = idxs[0];
+    for (i = 1; i < n; ++i)
+        if (idxs[i] > max_idx)
+            max_idx = idxs[i];
+    ASSERT_OR_ABORT(max_idx >= ctx->testcases.data[0].testcase_len,
+                    "__register_assignments() index overlaps the input");
+
+    // grow everything once, for the whole batch
+    if (max_idx >= ctx->size_assignments) {
+        unsigned old_size     = ctx->size_assignments;
+        ctx->size_assignments = (max_idx + 1) * 3 / 2;
+        ctx->assignments      = (Z3_ast*)realloc(
+            ctx->assignments, sizeof(Z3_ast) * ctx->size_assignments);
+        ASSERT_OR_ABORT(
+            ctx->assignments != NULL,
+            "__register_assignments() ctx->assignments - failed realloc");
+
+        // set to zero the new memory
+        memset(ctx->assignments + old_size, 0,
+               sizeof(Z3_ast) * (ctx->size_assignments - old_size));
+    }
+
+    unsigned    old_len = ctx->testcases.data[0].values_len;
+    testcase_t* testcase;
+    for (i = 0; i < ctx->testcases.size; ++i) {
+        testcase = &ctx->testcases.data[i];
+        if (testcase->values_len > max_idx)
+            continue;
+
+        unsigned old_values_len = testcase->values_len;
+        testcase->values_len    = (max_idx + 1) * 3 / 2;
+        testcase->values        = (unsigned long*)realloc(
+            testcase->values, sizeof(unsigned long) * testcase->values_len);
+        ASSERT_OR_ABORT(
+            testcase->values != 0,
+            "__register_assignments() testcase->values - failed realloc");
+        testcase->value_sizes = (unsigned char*)realloc(
+            testcase->value_sizes,
+            sizeof(unsigned char) * testcase->values_len);
+        ASSERT_OR_ABORT(
+            testcase->value_sizes != 0,
+            "__register_assignments() testcase->value_sizes - failed realloc");
+        testcase->z3_values = (Z3_ast*)realloc(
+            testcase->z3_values, sizeof(Z3_ast) * testcase->values_len);
+        ASSERT_OR_ABORT(
+            testcase->z3_values != 0,
+            "__register_assignments() testcase->z3_values - failed realloc");
+
+        unsigned n_new = testcase->values_len - old_values_len;
+        memset(testcase->values + old_values_len, 0,
+               sizeof(unsigned long) * n_new);
+        memset(testcase->value_sizes + old_values_len, 0,
+               sizeof(unsigned char) * n_new);
+        memset(testcase->z3_values + old_values_len, 0, sizeof(Z3_ast) * n_new);
+    }
+
+    pending_assignments_t* pending =
+        (pending_assignments_t*)ctx->pending_assignments;
+    for (i = 0; i < n; ++i) {
+        int idx = idxs[i];
+
+        Z3_inc_ref(ctx->z3_ctx, assignment_values[i]);
+        if (ctx->assignments[idx] != NULL) {
+            // redefinition: drop the stale concrete values
+            Z3_dec_ref(ctx->z3_ctx, ctx->assignments[idx]);
+            dict_remove_all__seed_eval_t(
+                (dict__seed_eval_t*)ctx->seed_eval_cache);
+            dict_remove_all__branch_checkpoint_ptr(
+                (dict__branch_checkpoint_ptr*)ctx->branch_checkpoints);
+            for (j = 0; j < ctx->testcases.size; ++j) {
+                testcase = &ctx->testcases.data[j];
+                if (testcase->z3_values[idx] != NULL) {
+                    Z3_dec_ref(ctx->z3_ctx, testcase->z3_values[idx]);
+                    testcase->z3_values[idx] = NULL;
+                }
+            }
+        }
+        ctx->assignments[idx] = assignment_values[i];
+
+        // im assuming that assignment_value is a BV
+        unsigned char assignment_size = Z3_get_bv_sort_size(
+            ctx->z3_ctx, Z3_get_sort(ctx->z3_ctx, assignment_values[i]));
+        for (j = 0; j < ctx->testcases.size; ++j)
+            ctx->testcases.data[j].value_sizes[idx] = assignment_size;
+
+        da_add_item__ulong(&pending->indexes, (unsigned long)idx);
+    }
+
+    if (old_len < ctx->testcases.data[0].values_len) {
+        init_global_context(ctx->testcases.data[0].values_len);
+    }
+}
+
+// fctx->testcases must be already loaded, the seed is the first testcase
+static void __z3fuzz_init(fuzzy_ctx_t* fctx, Z3_context ctx,
+                          char* testcase_path,
+                          uint64_t (*model_eval)(Z3_context, Z3_ast, uint64_t*,
+                                                 uint8_t*, size_t, uint32_t*),
+                          unsigned timeout)
 {
-    printf("[log] call z3fuzz_init(...)\n");
     memset((void*)&fctx->stats, 0, sizeof(fuzzy_stats_t));
 
     if (timeout != 0) {
@@ -958,8 +1703,6 @@ void z3fuzz_init(fuzzy_ctx_t* fctx, Z3_context ctx, char* seed_filename,
     fctx->model_eval = model_eval != NULL ? model_eval : Z3_custom_eval_depth;
     fctx->z3_ctx     = ctx;
     fctx->testcase_path = testcase_path;
-    init_testcase_list(&fctx->testcases);
-    load_testcase(&fctx->testcases, seed_filename, ctx);
     if (testcase_path != NULL)
         load_testcase_folder(&fctx->testcases, testcase_path, ctx);
     ASSERT_OR_ABORT(fctx->testcases.size > 0, "no testcase");
@@ -978,6 +1721,8 @@ void z3fuzz_init(fuzzy_ctx_t* fctx, Z3_context ctx, char* seed_filename,
     set__ulong* univocally_defined_inputs =
         (set__ulong*)fctx->univocally_defined_inputs;
     set_init__ulong(univocally_defined_inputs, &index_hash, &index_equals);
+    fctx->univocally_defined_digest = 0;
+    fctx->intervals_version         = 0;
 
     fctx->group_intervals = (void*)malloc(sizeof(set__interval_group_ptr));
     set__interval_group_ptr* group_intervals =
@@ -997,6 +1742,20 @@ void z3fuzz_init(fuzzy_ctx_t* fctx, Z3_context ctx, char* seed_filename,
         (dict__ast_info_ptr*)fctx->ast_info_cache;
     dict_init__ast_info_ptr(ast_info_cache, ast_info_ptr_free);
 
+    fctx->seed_eval_cache = malloc(sizeof(dict__seed_eval_t));
+    dict_init__seed_eval_t((dict__seed_eval_t*)fctx->seed_eval_cache,
+                           seed_eval_free);
+
+    fctx->lookup_tables = malloc(sizeof(lookup_tables_t));
+    dict_init__lookup_table_t(
+        &((lookup_tables_t*)fctx->lookup_tables)->tables, lookup_table_free);
+    ((lookup_tables_t*)fctx->lookup_tables)->bytes = 0;
+
+    fctx->branch_checkpoints = malloc(sizeof(dict__branch_checkpoint_ptr));
+    dict_init__branch_checkpoint_ptr(
+        (dict__branch_checkpoint_ptr*)fctx->branch_checkpoints,
+        branch_checkpoint_ptr_free);
+
     fctx->conflicting_asts =
         (dict__conflicting_ptr*)malloc(sizeof(dict__conflicting_ptr));
     dict__conflicting_ptr* conflicting_asts =
@@ -1007,6 +1766,41 @@ void z3fuzz_init(fuzzy_ctx_t* fctx, Z3_context ctx, char* seed_filename,
     set__ulong* processed_constraints =
         (set__ulong*)fctx->processed_constraints;
     set_init__ulong(processed_constraints, index_hash, index_equals);
+
+    fctx->pending_assignments = malloc(sizeof(pending_assignments_t));
+    pending_assignments_t* pending_assignments =
+        (pending_assignments_t*)fctx->pending_assignments;
+    da_init__ulong(&pending_assignments->indexes);
+    pending_assignments->sorted_size = 0;
+    pending_assignments->testcase_cursors =
+        (unsigned*)calloc(fctx->testcases.size, sizeof(unsigned));
+}
+
+void z3fuzz_init(fuzzy_ctx_t* fctx, Z3_context ctx, char* seed_filename,
+                 char* testcase_path,
+                 uint64_t (*model_eval)(Z3_context, Z3_ast, uint64_t*, uint8_t*,
+                                        size_t, uint32_t*),
+                 unsigned timeout)
+{
+    printf("[log] call z3fuzz_init(...)\n");
+
+    init_testcase_list(&fctx->testcases);
+    load_testcase(&fctx->testcases, seed_filename, ctx);
+    __z3fuzz_init(fctx, ctx, testcase_path, model_eval, timeout);
+}
+
+void z3fuzz_init_from_buffer(
+    fuzzy_ctx_t* fctx, Z3_context ctx, unsigned char const* seed,
+    unsigned long seed_len, char* testcase_path,
+    uint64_t (*model_eval)(Z3_context, Z3_ast, uint64_t*, uint8_t*, size_t,
+                           uint32_t*),
+    unsigned timeout)
+{
+    printf("[log] call z3fuzz_init_from_buffer(...)\n");
+
+    init_testcase_list(&fctx->testcases);
+    load_testcase_from_buffer(&fctx->testcases, seed, seed_len, ctx);
+    __z3fuzz_init(fctx, ctx, testcase_path, model_eval, timeout);
 }
 
 fuzzy_ctx_t* z3fuzz_create(Z3_context ctx, char* seed_filename,
@@ -1020,6 +1814,168 @@ fuzzy_ctx_t* z3fuzz_create(Z3_context ctx, char* seed_filename,
     return res;
 }
 
+fuzzy_ctx_t* z3fuzz_create_from_buffer(Z3_context           ctx,
+                                       unsigned char const* seed,
+                                       unsigned long seed_len, unsigned timeout)
+{
+    printf("[log] call z3fuzz_create_from_buffer(...)\n");
+    fuzzy_ctx_t* res = (fuzzy_ctx_t*)malloc(sizeof(fuzzy_ctx_t));
+    ASSERT_OR_ABORT(res, "z3fuzz_create_from_buffer(): failed malloc");
+
+    z3fuzz_init_from_buffer(res, ctx, seed, seed_len, NULL, NULL, timeout);
+    return res;
+}
+
+void z3fuzz_add_testcase(fuzzy_ctx_t* ctx, unsigned char const* testcase,
+                         unsigned long testcase_len)
+{
+    // the global buffers (e.g., tmp_proof) are sized on the seed, and the
+    // derived symbols live right after its bytes
+    ASSERT_OR_ABORT(testcase_len <= ctx->testcases.data[0].testcase_len,
+                    "z3fuzz_add_testcase() the testcase is longer than the "
+                    "seed");
+
+    unsigned long i;
+    load_testcase_from_buffer(&ctx->testcases, testcase, testcase_len,
+                              ctx->z3_ctx);
+
+    // make room for the derived symbols, as __register_assignments does for
+    // the other testcases
+    testcase_t*   tc         = &ctx->testcases.data[ctx->testcases.size - 1];
+    unsigned long values_len = ctx->testcases.data[0].values_len;
+    if (values_len > tc->values_len) {
+        tc->values = (unsigned long*)realloc(
+            tc->values, sizeof(unsigned long) * values_len);
+        ASSERT_OR_ABORT(tc->values != 0,
+                        "z3fuzz_add_testcase() values - failed realloc");
+        tc->value_sizes = (unsigned char*)realloc(
+            tc->value_sizes, sizeof(unsigned char) * values_len);
+        ASSERT_OR_ABORT(tc->value_sizes != 0,
+                        "z3fuzz_add_testcase() value_sizes - failed realloc");
+        tc->z3_values =
+            (Z3_ast*)realloc(tc->z3_values, sizeof(Z3_ast) * values_len);
+        ASSERT_OR_ABORT(tc->z3_values != 0,
+                        "z3fuzz_add_testcase() z3_values - failed realloc");
+        for (i = tc->values_len; i < values_len; ++i) {
+            tc->values[i]      = 0;
+            tc->value_sizes[i] = 0;
+            tc->z3_values[i]   = NULL;
+        }
+        tc->values_len = values_len;
+    }
+
+    // the assignments are concretized (lazily) also on the new testcase
+    pending_assignments_t* pending =
+        (pending_assignments_t*)ctx->pending_assignments;
+    pending->testcase_cursors = (unsigned*)realloc(
+        pending->testcase_cursors, sizeof(unsigned) * ctx->testcases.size);
+    ASSERT_OR_ABORT(pending->testcase_cursors != 0,
+                    "z3fuzz_add_testcase() testcase_cursors - failed realloc");
+    pending->testcase_cursors[ctx->testcases.size - 1] = 0;
+    for (i = testcase_len; i < ctx->size_assignments && i < tc->values_len;
+         ++i)
+        if (ctx->assignments[i] != NULL) {
+            tc->value_sizes[i] = Z3_get_bv_sort_size(
+                ctx->z3_ctx, Z3_get_sort(ctx->z3_ctx, ctx->assignments[i]));
+            da_add_item__ulong(&pending->indexes, i);
+        }
+}
+
+void z3fuzz_set_seed(fuzzy_ctx_t* ctx, unsigned char const* seed,
+                     unsigned long seed_len)
+{
+    printf("[log] call z3fuzz_set_seed(...)\n");
+
+    // derived symbols live after the input bytes, they must not overlap
+    unsigned long i;
+    for (i = 0; i < ctx->size_assignments && i < seed_len; ++i)
+        ASSERT_OR_ABORT(ctx->assignments[i] == NULL,
+                        "z3fuzz_set_seed() the seed overlaps an assignment");
+
+    testcase_t*   seed_testcase = &ctx->testcases.data[0];
+    unsigned long old_len       = seed_testcase->values_len;
+    unsigned long values_len    = seed_len;
+    for (i = seed_len; i < ctx->size_assignments; ++i)
+        if (ctx->assignments[i] != NULL) {
+            // keep the slots of the derived symbols
+            values_len = old_len > seed_len ? old_len : seed_len;
+            break;
+        }
+
+    for (i = 0; i < old_len; ++i)
+        if (seed_testcase->z3_values[i] != NULL)
+            Z3_dec_ref(ctx->z3_ctx, seed_testcase->z3_values[i]);
+
+    if (values_len != old_len) {
+        seed_testcase->values = (unsigned long*)realloc(
+            seed_testcase->values, sizeof(unsigned long) * values_len);
+        ASSERT_OR_ABORT(seed_testcase->values != 0,
+                        "z3fuzz_set_seed() values - failed realloc");
+        seed_testcase->value_sizes = (unsigned char*)realloc(
+            seed_testcase->value_sizes, sizeof(unsigned char) * values_len);
+        ASSERT_OR_ABORT(seed_testcase->value_sizes != 0,
+                        "z3fuzz_set_seed() value_sizes - failed realloc");
+        seed_testcase->z3_values = (Z3_ast*)realloc(
+            seed_testcase->z3_values, sizeof(Z3_ast) * values_len);
+        ASSERT_OR_ABORT(seed_testcase->z3_values != 0,
+                        "z3fuzz_set_seed() z3_values - failed realloc");
+    }
+    seed_testcase->values_len   = values_len;
+    seed_testcase->testcase_len = seed_len;
+
+    Z3_sort bv_sort = Z3_mk_bv_sort(ctx->z3_ctx, 8);
+    for (i = 0; i < seed_len; ++i) {
+        seed_testcase->values[i]      = (unsigned long)seed[i];
+        seed_testcase->value_sizes[i] = 8;
+        seed_testcase->z3_values[i] =
+            Z3_mk_unsigned_int(ctx->z3_ctx, seed[i], bv_sort);
+        Z3_inc_ref(ctx->z3_ctx, seed_testcase->z3_values[i]);
+    }
+
+    // the assignments are concretized again (lazily) on the new seed
+    pending_assignments_t* pending =
+        (pending_assignments_t*)ctx->pending_assignments;
+    for (i = seed_len; i < values_len; ++i) {
+        seed_testcase->values[i]    = 0;
+        seed_testcase->z3_values[i] = NULL;
+        if (i < ctx->size_assignments && ctx->assignments[i] != NULL) {
+            seed_testcase->value_sizes[i] = Z3_get_bv_sort_size(
+                ctx->z3_ctx, Z3_get_sort(ctx->z3_ctx, ctx->assignments[i]));
+            da_add_item__ulong(&pending->indexes, i);
+        } else
+            seed_testcase->value_sizes[i] = 0;
+    }
+
+    __symbol_init(ctx, values_len);
+    init_global_context(values_len);
+
+    // drop the state that depends on the seed (i.e., on the path constraints
+    // notified so far). The structural info in ast_info_cache is kept, unless
+    // it refers to univocally defined inputs
+    set__ulong* univocally_defined_inputs =
+        (set__ulong*)ctx->univocally_defined_inputs;
+    if (univocally_defined_inputs->size > 0) {
+        set_remove_all__ulong(univocally_defined_inputs, NULL);
+        ctx->univocally_defined_digest = 0;
+        dict_remove_all__ast_info_ptr(
+            (dict__ast_info_ptr*)ctx->ast_info_cache);
+    }
+    dict_remove_all__seed_eval_t((dict__seed_eval_t*)ctx->seed_eval_cache);
+    dict_remove_all__branch_checkpoint_ptr(
+        (dict__branch_checkpoint_ptr*)ctx->branch_checkpoints);
+    dict_remove_all__conflicting_ptr(
+        (dict__conflicting_ptr*)ctx->conflicting_asts);
+    set_remove_all__ulong((set__ulong*)ctx->processed_constraints, NULL);
+    dict_remove_all__da__interval_group_ptr(
+        (dict__da__interval_group_ptr*)ctx->index_to_group_intervals);
+    set_remove_all__interval_group_ptr(
+        (set__interval_group_ptr*)ctx->group_intervals,
+        interval_group_set_el_free);
+
+    opt_found   = 0;
+    opt_num_sat = 0;
+}
+
 __attribute__((destructor)) static void release_global_context()
 {
     if (!g_global_ctx_initialized)
@@ -1042,6 +1998,19 @@ __attribute__((destructor)) static void release_global_context()
 
     ast_data_free(&ast_data);
     gd_free();
+    shared_ast_info_free();
+
+    if (use_shared_knowledge)
+        shared_knowledge_close(&shared_knowledge);
+    use_shared_knowledge = 0;
+
+    if (use_metrics)
+        metrics_close(&metrics);
+    use_metrics = 0;
+
+    if (use_thread_pool)
+        thread_pool_free(&thread_pool);
+    use_thread_pool = 0;
 }
 
 void z3fuzz_free(fuzzy_ctx_t* ctx)
@@ -1063,11 +2032,28 @@ void z3fuzz_free(fuzzy_ctx_t* ctx)
     ctx->assignments      = NULL;
     ctx->size_assignments = 0;
 
+    pending_assignments_t* pending_assignments =
+        (pending_assignments_t*)ctx->pending_assignments;
+    da_free__ulong(&pending_assignments->indexes, NULL);
+    free(pending_assignments->testcase_cursors);
+    free(ctx->pending_assignments);
+
     dict__ast_info_ptr* ast_info_cache =
         (dict__ast_info_ptr*)ctx->ast_info_cache;
     dict_free__ast_info_ptr(ast_info_cache);
     free(ctx->ast_info_cache);
 
+    dict_free__seed_eval_t((dict__seed_eval_t*)ctx->seed_eval_cache);
+    free(ctx->seed_eval_cache);
+
+    dict_free__lookup_table_t(
+        &((lookup_tables_t*)ctx->lookup_tables)->tables);
+    free(ctx->lookup_tables);
+
+    dict_free__branch_checkpoint_ptr(
+        (dict__branch_checkpoint_ptr*)ctx->branch_checkpoints);
+    free(ctx->branch_checkpoints);
+
     dict__conflicting_ptr* conflicting_asts =
         (dict__conflicting_ptr*)ctx->conflicting_asts;
     dict_free__conflicting_ptr(conflicting_asts);
@@ -1149,6 +2135,42 @@ static int __check_or_add_digest(set__digest_t* set, unsigned char* values,
     return 0;
 }
 
+// filter of the candidates shared by the workers of a parallel phase: an
+// open addressing table of fingerprints (CANDIDATE_FILTER_SIZE entries)
+#define CANDIDATE_FILTER_SIZE (1 << 16)
+#define CANDIDATE_FILTER_PROBES 8
+
+static inline uint64_t __candidate_fingerprint(unsigned long* values,
+                                               unsigned long  n)
+{
+    uint64_t      h = 0xcbf29ce484222325UL;
+    unsigned long i;
+    for (i = 0; i < n; ++i)
+        h = (h ^ values[i]) * 0x100000001b3UL;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdUL;
+    h ^= h >> 33;
+    return h != 0 ? h : 1;
+}
+
+// lock-free, 1 if the candidate has already been generated by some worker.
+// When all the probed slots are taken, the candidate is considered new
+static int __candidate_filter_check_or_add(uint64_t* filter, uint64_t fp)
+{
+    unsigned i;
+    for (i = 0; i < CANDIDATE_FILTER_PROBES; ++i) {
+        uint64_t* slot = &filter[(fp + i) & (CANDIDATE_FILTER_SIZE - 1)];
+        uint64_t  cur  = __atomic_load_n(slot, __ATOMIC_RELAXED);
+        if (cur == 0 &&
+            __atomic_compare_exchange_n(slot, &cur, fp, 0, __ATOMIC_RELAXED,
+                                        __ATOMIC_RELAXED))
+            return 0;
+        if (cur == fp)
+            return 1;
+    }
+    return 0;
+}
+
 static __always_inline unsigned long index_group_to_value(index_group_t* ig,
                                                           unsigned long* values)
 {
@@ -1214,2189 +2236,4653 @@ is_valid_eval_group(fuzzy_ctx_t* ctx, index_group_t* ig, unsigned long* values,
 #endif
 }
 
-static inline int __evaluate_branch_query(fuzzy_ctx_t* ctx, Z3_ast query,
-                                          Z3_ast         branch_condition,
-                                          unsigned long* values,
-                                          unsigned char* value_sizes,
-                                          unsigned long  n_values)
+// *************************************************
+// ****************** FAST EVAL ********************
+// *************************************************
+
+// Branch conditions coming from binary tracing are dominated by a few shapes:
+// multi-byte loads (concat of input bytes), extensions of loads, ite chains
+// selecting constants and comparisons against an immediate. They are
+// compiled once per query into a short postfix program of fused operations,
+// so that evaluating a candidate does not walk the AST.
+
+#define FAST_EVAL_MAX_OPS 64
+
+typedef enum fast_eval_opcode_t {
+    FE_CONST,      // push imm
+    FE_LOAD,       // push symbol arg0, masked to width
+    FE_LOAD_BE,    // push arg1 bytes starting at arg0, first is the MSB
+    FE_LOAD_LE,    // push arg1 bytes starting at arg0, first is the LSB
+    FE_LUT8,       // push lut[symbol arg0]
+    FE_LUT16,      // push lut[symbol arg0 | symbol imm << 8]
+    FE_EXTRACT,    // top = (top >> arg0) & mask(width)
+    FE_SEXT,       // sign extend top from arg0 bits to width
+    FE_CONCAT,     // concat the two topmost, the top is arg0 bits wide
+    FE_CMP,        // compare the two topmost
+    FE_CMP_IMM,    // compare top with imm
+    FE_SELECT,     // ite with three operands
+    FE_SELECT_IMM, // top ? imm : imm2
+    FE_NOT,
+    FE_AND,
+    FE_OR,
+    FE_BVADD,
+    FE_BVSUB,
+    FE_BVMUL,
+    FE_BVAND,
+    FE_BVOR,
+    FE_BVXOR,
+    FE_BVNOT,
+    FE_BVNEG,
+    FE_BVSHL,
+    FE_BVLSHR,
+    FE_BVASHR
+} fast_eval_opcode_t;
+
+typedef enum fast_eval_cmp_t {
+    FE_EQ,
+    FE_NE,
+    FE_ULT,
+    FE_ULE,
+    FE_UGT,
+    FE_UGE,
+    FE_SLT,
+    FE_SLE,
+    FE_SGT,
+    FE_SGE
+} fast_eval_cmp_t;
+
+typedef struct fast_eval_op_t {
+    unsigned char opcode;
+    unsigned char cmp;
+    unsigned char width;
+    unsigned char arg1;
+    unsigned      arg0;
+    unsigned long imm;
+    unsigned long imm2;
+
+    const unsigned long* lut;
+} fast_eval_op_t;
+
+typedef struct fast_eval_t {
+    Z3_ast         ast;
+    int            valid;
+    unsigned       n_ops;
+    fast_eval_op_t ops[FAST_EVAL_MAX_OPS];
+} fast_eval_t;
+
+static fast_eval_t fast_eval = {0};
+
+static __always_inline unsigned long __fe_mask(unsigned width)
 {
-    if (timer_check_wrapper(ctx)) {
-        ctx->stats.num_timeouts++;
-        return TIMEOUT_V;
-    }
+    return width >= 64 ? 0xffffffffffffffffUL : (1UL << width) - 1;
+}
 
-    ctx->stats.num_evaluate++;
+static __always_inline long __fe_sext(unsigned long v, unsigned width)
+{
+    return width >= 64 ? (long)v : ((long)(v << (64 - width))) >> (64 - width);
+}
 
-    if (check_unnecessary_eval)
-        if (__check_or_add_digest(&ast_data.processed_set,
-                                  (unsigned char*)values,
-                                  ctx->n_symbols * sizeof(unsigned long))) {
-            return 0;
-        }
+static __always_inline int __fe_cmp(unsigned cmp, unsigned long a,
+                                    unsigned long b, unsigned width)
+{
+    switch (cmp) {
+        case FE_EQ:
+            return a == b;
+        case FE_NE:
+            return a != b;
+        case FE_ULT:
+            return a < b;
+        case FE_ULE:
+            return a <= b;
+        case FE_UGT:
+            return a > b;
+        case FE_UGE:
+            return a >= b;
+        case FE_SLT:
+            return __fe_sext(a, width) < __fe_sext(b, width);
+        case FE_SLE:
+            return __fe_sext(a, width) <= __fe_sext(b, width);
+        case FE_SGT:
+            return __fe_sext(a, width) > __fe_sext(b, width);
+        case FE_SGE:
+            return __fe_sext(a, width) >= __fe_sext(b, width);
+    }
+    return 0;
+}
 
-    int      res;
-    uint32_t depth;
-    res = (int)ctx->model_eval(ctx->z3_ctx, branch_condition, values,
-                               value_sizes, n_values, NULL);
-    if (res) {
-#if 0
-        unsigned num_sat;
-        res = evaluate_pi(ctx, query, values, value_sizes, n_values, &num_sat);
-        if (!opt_found || num_sat > opt_num_sat) {
-            testcase_t* t = &ctx->testcases.data[0];
-            opt_found     = 1;
-            opt_num_sat   = num_sat;
-            memcpy(tmp_opt_input, values,
-                   t->values_len * sizeof(unsigned long));
-            __vals_long_to_char(values, tmp_opt_proof, t->testcase_len);
-        }
-#else
-        res = (int)ctx->model_eval(ctx->z3_ctx, query, values, value_sizes,
-                                   n_values, &depth);
-        if (!opt_found || depth > opt_num_sat) {
-            testcase_t* t = &ctx->testcases.data[0];
-            opt_found     = 1;
-            opt_num_sat   = depth;
-            memcpy(tmp_opt_input, values,
-                   t->values_len * sizeof(unsigned long));
-            __vals_long_to_char(values, tmp_opt_proof, t->testcase_len);
+static __always_inline unsigned long __fast_eval_run(fast_eval_t*   fe,
+                                                     unsigned long* values)
+{
+    unsigned long stack[FAST_EVAL_MAX_OPS];
+    unsigned      sp = 0;
+    unsigned      i, j;
+
+    for (i = 0; i < fe->n_ops; ++i) {
+        fast_eval_op_t* op = &fe->ops[i];
+        unsigned long   a, b, mask = __fe_mask(op->width);
+        switch (op->opcode) {
+            case FE_CONST:
+                stack[sp++] = op->imm;
+                break;
+            case FE_LOAD:
+                stack[sp++] = values[op->arg0] & mask;
+                break;
+            case FE_LOAD_BE:
+                a = 0;
+                for (j = 0; j < op->arg1; ++j)
+                    a = (a << 8) | (values[op->arg0 + j] & 0xff);
+                stack[sp++] = a;
+                break;
+            case FE_LOAD_LE:
+                a = 0;
+                for (j = op->arg1; j > 0; --j)
+                    a = (a << 8) | (values[op->arg0 + j - 1] & 0xff);
+                stack[sp++] = a;
+                break;
+            case FE_LUT8:
+                stack[sp++] = op->lut[values[op->arg0] & 0xff];
+                break;
+            case FE_LUT16:
+                a = (values[op->arg0] & 0xff) | ((values[op->imm] & 0xff) << 8);
+                stack[sp++] = op->lut[a];
+                break;
+            case FE_EXTRACT:
+                stack[sp - 1] = (stack[sp - 1] >> op->arg0) & mask;
+                break;
+            case FE_SEXT:
+                stack[sp - 1] =
+                    (unsigned long)__fe_sext(stack[sp - 1], op->arg0) & mask;
+                break;
+            case FE_CONCAT:
+                b             = stack[--sp];
+                stack[sp - 1] = ((stack[sp - 1] << op->arg0) | b) & mask;
+                break;
+            case FE_CMP:
+                b             = stack[--sp];
+                stack[sp - 1] = __fe_cmp(op->cmp, stack[sp - 1], b, op->width);
+                break;
+            case FE_CMP_IMM:
+                stack[sp - 1] =
+                    __fe_cmp(op->cmp, stack[sp - 1], op->imm, op->width);
+                break;
+            case FE_SELECT:
+                b             = stack[--sp];
+                a             = stack[--sp];
+                stack[sp - 1] = stack[sp - 1] ? a : b;
+                break;
+            case FE_SELECT_IMM:
+                stack[sp - 1] = stack[sp - 1] ? op->imm : op->imm2;
+                break;
+            case FE_NOT:
+                stack[sp - 1] = !stack[sp - 1];
+                break;
+            case FE_AND:
+                b             = stack[--sp];
+                stack[sp - 1] = stack[sp - 1] && b;
+                break;
+            case FE_OR:
+                b             = stack[--sp];
+                stack[sp - 1] = stack[sp - 1] || b;
+                break;
+            case FE_BVADD:
+                b             = stack[--sp];
+                stack[sp - 1] = (stack[sp - 1] + b) & mask;
+                break;
+            case FE_BVSUB:
+                b             = stack[--sp];
+                stack[sp - 1] = (stack[sp - 1] - b) & mask;
+                break;
+            case FE_BVMUL:
+                b             = stack[--sp];
+                stack[sp - 1] = (stack[sp - 1] * b) & mask;
+                break;
+            case FE_BVAND:
+                b = stack[--sp];
+                stack[sp - 1] &= b;
+                break;
+            case FE_BVOR:
+                b = stack[--sp];
+                stack[sp - 1] |= b;
+                break;
+            case FE_BVXOR:
+                b = stack[--sp];
+                stack[sp - 1] ^= b;
+                break;
+            case FE_BVNOT:
+                stack[sp - 1] = ~stack[sp - 1] & mask;
+                break;
+            case FE_BVNEG:
+                stack[sp - 1] = -stack[sp - 1] & mask;
+                break;
+            case FE_BVSHL:
+                b             = stack[--sp];
+                stack[sp - 1] =
+                    b >= op->width ? 0 : (stack[sp - 1] << b) & mask;
+                break;
+            case FE_BVLSHR:
+                b             = stack[--sp];
+                stack[sp - 1] = b >= op->width ? 0 : stack[sp - 1] >> b;
+                break;
+            case FE_BVASHR:
+                b = stack[--sp];
+                a = (unsigned long)__fe_sext(stack[sp - 1], op->width);
+                stack[sp - 1] =
+                    (unsigned long)((long)a >> (b >= op->width ? 63 : b)) &
+                    mask;
+                break;
         }
-#endif
     }
-    res = res != 0 ? 1 : 0;
-    return res;
+    return stack[0];
 }
 
-// *************************************************
-// **** HEURISTICS - POPULATE ast_data_t struct ****
-// *************************************************
+// The same programs are run on abstract values: an interval (never wrapping
+// here) and the bits known to be zero or one. The symbols of an input group
+// are abstracted from a range of values of the group, the others are the
+// concrete values. The result tells whether a boolean program is false (or
+// true) for every value of the range, so that the enumeration phases can
+// split and discard whole sub-ranges instead of evaluating each candidate.
 
-static inline int is_bor_constraint(fuzzy_ctx_t* ctx, Z3_ast branch_condition)
+#define FE_ABS_FALSE 0
+#define FE_ABS_TRUE 1
+#define FE_ABS_UNKNOWN 2
+#define FE_ABS_MAX_LUT_ENTRIES 4096
+
+typedef struct fe_abs_t {
+    wrapped_interval_t wi;
+    uint64_t           zeros; // bits known to be 0
+    uint64_t           ones;  // bits known to be 1
+} fe_abs_t;
+
+typedef struct fe_abs_inputs_t {
+    unsigned long* values;
+    index_group_t* ig;
+    fe_abs_t       bytes[MAX_GROUP_SIZE]; // the first is the LSB of the group
+} fe_abs_inputs_t;
+
+static inline fe_abs_t __fe_abs_top(unsigned width)
 {
-    Z3_ast_kind node_kind = Z3_get_ast_kind(ctx->z3_ctx, branch_condition);
-    if (node_kind != Z3_APP_AST)
-        return 0;
+    fe_abs_t r;
+    r.wi.min  = 0;
+    r.wi.max  = __fe_mask(width);
+    r.wi.size = width;
+    r.zeros   = 0;
+    r.ones    = 0;
+    return r;
+}
 
-    Z3_app       node_app       = Z3_to_app(ctx->z3_ctx, branch_condition);
-    Z3_func_decl node_decl      = Z3_get_app_decl(ctx->z3_ctx, node_app);
-    Z3_decl_kind node_decl_kind = Z3_get_decl_kind(ctx->z3_ctx, node_decl);
+static inline fe_abs_t __fe_abs_const(uint64_t c, unsigned width)
+{
+    fe_abs_t r;
+    c         = c & __fe_mask(width);
+    r.wi.min  = c;
+    r.wi.max  = c;
+    r.wi.size = width;
+    r.zeros   = ~c & __fe_mask(width);
+    r.ones    = c;
+    return r;
+}
 
-    if (node_decl_kind == Z3_OP_BOR)
-        return 1;
-    return 0;
+static inline int __fe_abs_is_const(const fe_abs_t* v)
+{
+    return v->wi.min == v->wi.max;
 }
 
-static inline void flatten_bor_args(fuzzy_ctx_t* ctx, Z3_ast node,
-                                    da__Z3_ast* args)
+// make the interval and the known bits agree
+static inline void __fe_abs_reduce(fe_abs_t* v)
 {
-    Z3_app   app        = Z3_to_app(ctx->z3_ctx, node);
-    unsigned num_fields = Z3_get_app_num_args(ctx->z3_ctx, app);
+    uint64_t mask = __fe_mask(v->wi.size), diff, prefix;
+
+    v->zeros &= mask;
+    v->ones &= mask;
+    if (v->wi.min < v->ones)
+        v->wi.min = v->ones;
+    if (v->wi.max > (mask & ~v->zeros))
+        v->wi.max = mask & ~v->zeros;
+    if (unlikely(v->wi.min > v->wi.max)) {
+        // it cannot happen with a sound transfer function
+        *v = __fe_abs_top(v->wi.size);
+        return;
+    }
 
-    unsigned i;
-    for (i = 0; i < num_fields; ++i) {
-        Z3_ast child = Z3_get_app_arg(ctx->z3_ctx, app, i);
-        if (is_bor_constraint(ctx, child))
-            flatten_bor_args(ctx, child, args);
-        else {
-            Z3_inc_ref(ctx->z3_ctx, child);
-            da_add_item__Z3_ast(args, child);
+    diff = v->wi.min ^ v->wi.max;
+    prefix =
+        diff == 0 ? mask : mask & ~((2UL << (63 - __builtin_clzl(diff))) - 1);
+    v->ones |= v->wi.min & prefix;
+    v->zeros |= ~v->wi.min & prefix;
+}
+
+static inline fe_abs_t __fe_abs_range(uint64_t min, uint64_t max,
+                                      unsigned width)
+{
+    fe_abs_t r;
+    r.wi.min  = min;
+    r.wi.max  = max;
+    r.wi.size = width;
+    r.zeros   = 0;
+    r.ones    = 0;
+    __fe_abs_reduce(&r);
+    return r;
+}
+
+static inline fe_abs_t __fe_abs_bool(int may_be_false, int may_be_true)
+{
+    return __fe_abs_range(may_be_false ? 0 : 1, may_be_true ? 1 : 0, 1);
+}
+
+static inline fe_abs_t __fe_abs_input(fe_abs_inputs_t* in, unsigned idx)
+{
+    unsigned k;
+    for (k = 0; k < in->ig->n; ++k)
+        if (in->ig->indexes[in->ig->n - k - 1] == idx)
+            return in->bytes[k];
+    return __fe_abs_const(in->values[idx], 64);
+}
+
+static inline fe_abs_t __fe_abs_extract(const fe_abs_t* v, unsigned shift,
+                                        unsigned width)
+{
+    uint64_t mask = __fe_mask(width);
+    uint64_t high = shift + width >= 64 ? 0 : (v->wi.min ^ v->wi.max) >>
+                                                  (shift + width);
+    fe_abs_t r    = high == 0 ? __fe_abs_range((v->wi.min >> shift) & mask,
+                                               (v->wi.max >> shift) & mask,
+                                               width)
+                              : __fe_abs_top(width);
+
+    r.ones |= v->ones >> shift;
+    r.zeros |= (v->zeros >> shift) | (mask & ~(__fe_mask(v->wi.size) >> shift));
+    __fe_abs_reduce(&r);
+    return r;
+}
+
+// b is the low part, b_width bits wide
+static inline fe_abs_t __fe_abs_concat(const fe_abs_t* a, const fe_abs_t* b,
+                                       unsigned b_width, unsigned width)
+{
+    uint64_t mask = __fe_mask(width);
+    fe_abs_t r    = __fe_abs_range(((a->wi.min << b_width) | b->wi.min) & mask,
+                                   ((a->wi.max << b_width) | b->wi.max) & mask,
+                                   width);
+
+    r.ones |= (a->ones << b_width) | b->ones;
+    r.zeros |= (a->zeros << b_width) | (b->zeros & __fe_mask(b_width));
+    __fe_abs_reduce(&r);
+    return r;
+}
+
+// zero extension is not compiled (values are kept masked): the operands
+// may be narrower than the operation
+static inline fe_abs_t __fe_abs_zext(const fe_abs_t* v, unsigned width)
+{
+    fe_abs_t r = *v;
+    if (r.wi.size < width) {
+        r.zeros |= __fe_mask(width) & ~__fe_mask(r.wi.size);
+        r.wi.size = width;
+    }
+    return r;
+}
+
+static inline fe_abs_t __fe_abs_join(const fe_abs_t* a, const fe_abs_t* b,
+                                     unsigned width)
+{
+    fe_abs_t r =
+        __fe_abs_range(a->wi.min < b->wi.min ? a->wi.min : b->wi.min,
+                       a->wi.max > b->wi.max ? a->wi.max : b->wi.max, width);
+
+    r.ones |= a->ones & b->ones;
+    r.zeros |= a->zeros & b->zeros;
+    __fe_abs_reduce(&r);
+    return r;
+}
+
+static inline fe_abs_t __fe_abs_lut(const unsigned long* lut,
+                                    const fe_abs_t* lo, const fe_abs_t* hi,
+                                    unsigned width)
+{
+    uint64_t i, j, v, min = -1UL, max = 0, and_v = -1UL, or_v = 0;
+
+    if ((lo->wi.max - lo->wi.min + 1) * (hi->wi.max - hi->wi.min + 1) >
+        FE_ABS_MAX_LUT_ENTRIES)
+        return __fe_abs_top(width);
+
+    for (j = hi->wi.min; j <= hi->wi.max; ++j) {
+        if ((j & hi->ones) != hi->ones || (j & hi->zeros) != 0)
+            continue;
+        for (i = lo->wi.min; i <= lo->wi.max; ++i) {
+            if ((i & lo->ones) != lo->ones || (i & lo->zeros) != 0)
+                continue;
+            v = lut[i | (j << 8)];
+            min   = v < min ? v : min;
+            max   = v > max ? v : max;
+            and_v &= v;
+            or_v |= v;
         }
     }
+    if (unlikely(min > max))
+        return __fe_abs_top(width);
+
+    fe_abs_t r = __fe_abs_range(min, max, width);
+    r.ones |= and_v;
+    r.zeros |= ~or_v;
+    __fe_abs_reduce(&r);
+    return r;
 }
 
-static int __detect_single_byte(fuzzy_ctx_t* ctx, Z3_ast node, int* idx)
+// signed comparisons are unsigned comparisons of the values with the sign
+// bit flipped
+static inline void __fe_abs_bias(const fe_abs_t* v, unsigned width,
+                                 uint64_t* min, uint64_t* max)
 {
-    if (Z3_get_ast_kind(ctx->z3_ctx, node) != Z3_APP_AST)
-        return 0;
+    uint64_t sign = 1UL << (width - 1);
 
-    int          res        = 0;
-    Z3_app       app        = Z3_to_app(ctx->z3_ctx, node);
-    unsigned     num_fields = Z3_get_app_num_args(ctx->z3_ctx, app);
-    Z3_func_decl decl       = Z3_get_app_decl(ctx->z3_ctx, app);
-    Z3_decl_kind decl_kind  = Z3_get_decl_kind(ctx->z3_ctx, decl);
-    if (num_fields > 1) {
-        return 0;
+    if ((v->wi.min & sign) == (v->wi.max & sign)) {
+        *min = v->wi.min ^ sign;
+        *max = v->wi.max ^ sign;
+    } else {
+        *min = 0;
+        *max = __fe_mask(width);
     }
+}
 
-    switch (decl_kind) {
-        case Z3_OP_EXTRACT:
-        case Z3_OP_ZERO_EXT:
-        case Z3_OP_SIGN_EXT: {
-            Z3_ast child = Z3_get_app_arg(ctx->z3_ctx, app, 0);
-            res          = __detect_single_byte(ctx, child, idx);
-            break;
+static inline fe_abs_t __fe_abs_cmp(unsigned cmp, const fe_abs_t* a,
+                                    const fe_abs_t* b, unsigned width)
+{
+    uint64_t a0 = a->wi.min, a1 = a->wi.max, b0 = b->wi.min, b1 = b->wi.max;
+
+    switch (cmp) {
+        case FE_EQ:
+        case FE_NE: {
+            int always = a0 == a1 && b0 == b1 && a0 == b0;
+            int never  = a1 < b0 || b1 < a0 || (a->ones & b->zeros) != 0 ||
+                        (a->zeros & b->ones) != 0;
+            return cmp == FE_EQ ? __fe_abs_bool(!always, !never)
+                                : __fe_abs_bool(!never, !always);
         }
-        case Z3_OP_UNINTERPRETED: {
-            Z3_symbol s            = Z3_get_decl_name(ctx->z3_ctx, decl);
-            int       symbol_index = Z3_get_symbol_int(ctx->z3_ctx, s);
-            if (symbol_index >= ctx->testcases.data[0].testcase_len)
-                // it is an assignment
-                res = 0;
-            else {
-                *idx = symbol_index;
-                res  = 1;
+        case FE_SLT:
+        case FE_SLE:
+        case FE_SGT:
+        case FE_SGE:
+            __fe_abs_bias(a, width, &a0, &a1);
+            __fe_abs_bias(b, width, &b0, &b1);
+            cmp = cmp - FE_SLT + FE_ULT;
+            break;
+    }
+    switch (cmp) {
+        case FE_ULT:
+            return __fe_abs_bool(a1 >= b0, a0 < b1);
+        case FE_ULE:
+            return __fe_abs_bool(a1 > b0, a0 <= b1);
+        case FE_UGT:
+            return __fe_abs_bool(b1 >= a0, b0 < a1);
+        case FE_UGE:
+            return __fe_abs_bool(b1 > a0, b0 <= a1);
+    }
+    return __fe_abs_top(1);
+}
+
+static inline fe_abs_t __fe_abs_arith(unsigned char   opcode,
+                                      const fe_abs_t* a_op,
+                                      const fe_abs_t* b_op, unsigned width)
+{
+    uint64_t        mask  = __fe_mask(width), lo, hi;
+    fe_abs_t        a_ext = __fe_abs_zext(a_op, width);
+    fe_abs_t        b_ext = __fe_abs_zext(b_op, width);
+    const fe_abs_t* a     = &a_ext;
+    const fe_abs_t* b     = &b_ext;
+    fe_abs_t        r;
+
+    switch (opcode) {
+        case FE_BVADD:
+            if (!__builtin_add_overflow(a->wi.max, b->wi.max, &hi) &&
+                hi <= mask)
+                return __fe_abs_range(a->wi.min + b->wi.min, hi, width);
+            lo = a->wi.min + b->wi.min;
+            if (width < 64 && lo > mask)
+                // a->wi.max + b->wi.max < 2 * 2^width
+                return __fe_abs_range(lo & mask, hi & mask, width);
+            return __fe_abs_top(width);
+        case FE_BVSUB:
+            if (a->wi.min >= b->wi.max)
+                return __fe_abs_range(a->wi.min - b->wi.max,
+                                      a->wi.max - b->wi.min, width);
+            if (a->wi.max < b->wi.min)
+                return __fe_abs_range((a->wi.min - b->wi.max) & mask,
+                                      (a->wi.max - b->wi.min) & mask, width);
+            return __fe_abs_top(width);
+        case FE_BVMUL:
+            if (!__builtin_mul_overflow(a->wi.max, b->wi.max, &hi) &&
+                hi <= mask)
+                return __fe_abs_range(a->wi.min * b->wi.min, hi, width);
+            return __fe_abs_top(width);
+        case FE_BVAND:
+            r = __fe_abs_range(0, a->wi.max < b->wi.max ? a->wi.max : b->wi.max,
+                               width);
+            r.ones |= a->ones & b->ones;
+            r.zeros |= a->zeros | b->zeros;
+            break;
+        case FE_BVOR:
+            r = __fe_abs_range(a->wi.min > b->wi.min ? a->wi.min : b->wi.min,
+                               mask, width);
+            r.ones |= a->ones | b->ones;
+            r.zeros |= a->zeros & b->zeros;
+            break;
+        case FE_BVXOR:
+            r = __fe_abs_top(width);
+            r.ones |= (a->ones & b->zeros) | (a->zeros & b->ones);
+            r.zeros |= (a->zeros & b->zeros) | (a->ones & b->ones);
+            break;
+        case FE_BVSHL:
+        case FE_BVLSHR:
+        case FE_BVASHR: {
+            if (!__fe_abs_is_const(b))
+                return __fe_abs_top(width);
+            uint64_t s = b->wi.min;
+            if (opcode == FE_BVASHR) {
+                if (a->wi.max > (mask >> 1))
+                    // the sign may be set
+                    return __fe_abs_top(width);
+                opcode = FE_BVLSHR;
+            }
+            if (s >= width)
+                return __fe_abs_const(0, width);
+            if (opcode == FE_BVLSHR) {
+                r = __fe_abs_range(a->wi.min >> s, a->wi.max >> s, width);
+                r.ones |= a->ones >> s;
+                r.zeros |= (a->zeros >> s) | (mask & ~(mask >> s));
+            } else {
+                r = (a->wi.max << s) >> s == a->wi.max &&
+                            (a->wi.max << s) <= mask
+                        ? __fe_abs_range(a->wi.min << s, a->wi.max << s, width)
+                        : __fe_abs_top(width);
+                r.ones |= a->ones << s;
+                r.zeros |= (a->zeros << s) | ((1UL << s) - 1);
             }
             break;
         }
         default:
-            break;
+            return __fe_abs_top(width);
     }
-    return res;
+    __fe_abs_reduce(&r);
+    return r;
 }
 
-static int __detect_concat_shift(fuzzy_ctx_t* ctx, Z3_ast node, int* s_idx,
-                                 int* pos)
+static int __fast_eval_run_abstract(fast_eval_t* fe, fe_abs_inputs_t* in)
 {
-    if (Z3_get_ast_kind(ctx->z3_ctx, node) != Z3_APP_AST)
-        return 0;
+    fe_abs_t stack[FAST_EVAL_MAX_OPS];
+    fe_abs_t a, b;
+    unsigned sp = 0;
+    unsigned i, j;
 
-    Z3_app       app        = Z3_to_app(ctx->z3_ctx, node);
-    unsigned     num_fields = Z3_get_app_num_args(ctx->z3_ctx, app);
-    Z3_func_decl decl       = Z3_get_app_decl(ctx->z3_ctx, app);
-    Z3_decl_kind decl_kind  = Z3_get_decl_kind(ctx->z3_ctx, decl);
+    for (i = 0; i < fe->n_ops; ++i) {
+        fast_eval_op_t* op   = &fe->ops[i];
+        unsigned        w    = op->width;
+        uint64_t        mask = __fe_mask(w);
+        switch (op->opcode) {
+            case FE_CONST:
+                stack[sp++] = __fe_abs_const(op->imm, w);
+                break;
+            case FE_LOAD:
+                a           = __fe_abs_input(in, op->arg0);
+                stack[sp++] = __fe_abs_extract(&a, 0, w);
+                break;
+            case FE_LOAD_BE:
+            case FE_LOAD_LE:
+                a = __fe_abs_const(0, 0);
+                for (j = 0; j < op->arg1; ++j) {
+                    unsigned idx = op->opcode == FE_LOAD_BE
+                                       ? op->arg0 + j
+                                       : op->arg0 + op->arg1 - j - 1;
+                    b            = __fe_abs_input(in, idx);
+                    b            = __fe_abs_extract(&b, 0, 8);
+                    a            = __fe_abs_concat(&a, &b, 8, 8 * (j + 1));
+                }
+                stack[sp++] = a;
+                break;
+            case FE_LUT8:
+            case FE_LUT16:
+                a = __fe_abs_input(in, op->arg0);
+                a = __fe_abs_extract(&a, 0, 8);
+                if (op->opcode == FE_LUT16) {
+                    b = __fe_abs_input(in, op->imm);
+                    b = __fe_abs_extract(&b, 0, 8);
+                } else
+                    b = __fe_abs_const(0, 8);
+                stack[sp++] = __fe_abs_lut(op->lut, &a, &b, w);
+                break;
+            case FE_EXTRACT:
+                stack[sp - 1] = __fe_abs_extract(&stack[sp - 1], op->arg0, w);
+                break;
+            case FE_SEXT: {
+                uint64_t sign = 1UL << (op->arg0 - 1);
+                uint64_t ext  = mask & ~__fe_mask(op->arg0);
+                a             = stack[sp - 1];
+                if (a.wi.max < sign)
+                    b = __fe_abs_range(a.wi.min, a.wi.max, w);
+                else if (a.wi.min >= sign)
+                    b = __fe_abs_range(a.wi.min | ext, a.wi.max | ext, w);
+                else
+                    b = __fe_abs_top(w);
+                b.ones |= a.ones;
+                b.zeros |= a.zeros;
+                if (a.ones & sign)
+                    b.ones |= ext;
+                if (a.zeros & sign)
+                    b.zeros |= ext;
+                __fe_abs_reduce(&b);
+                stack[sp - 1] = b;
+                break;
+            }
+            case FE_CONCAT:
+                b             = stack[--sp];
+                stack[sp - 1] =
+                    __fe_abs_concat(&stack[sp - 1], &b, op->arg0, w);
+                break;
+            case FE_CMP:
+                b             = stack[--sp];
+                stack[sp - 1] = __fe_abs_cmp(op->cmp, &stack[sp - 1], &b, w);
+                break;
+            case FE_CMP_IMM:
+                b             = __fe_abs_const(op->imm, w);
+                stack[sp - 1] = __fe_abs_cmp(op->cmp, &stack[sp - 1], &b, w);
+                break;
+            case FE_SELECT:
+                b = stack[--sp];
+                a = stack[--sp];
+                if (stack[sp - 1].wi.min == 1)
+                    stack[sp - 1] = a;
+                else if (stack[sp - 1].wi.max == 0)
+                    stack[sp - 1] = b;
+                else
+                    stack[sp - 1] = __fe_abs_join(&a, &b, w);
+                break;
+            case FE_SELECT_IMM:
+                a = __fe_abs_const(op->imm, w);
+                b = __fe_abs_const(op->imm2, w);
+                if (stack[sp - 1].wi.min == 1)
+                    stack[sp - 1] = a;
+                else if (stack[sp - 1].wi.max == 0)
+                    stack[sp - 1] = b;
+                else
+                    stack[sp - 1] = __fe_abs_join(&a, &b, w);
+                break;
+            case FE_NOT:
+                a             = stack[sp - 1];
+                stack[sp - 1] = __fe_abs_bool(a.wi.max == 1, a.wi.min == 0);
+                break;
+            case FE_AND:
+                b             = stack[--sp];
+                a             = stack[sp - 1];
+                stack[sp - 1] = __fe_abs_bool(a.wi.min == 0 || b.wi.min == 0,
+                                              a.wi.max == 1 && b.wi.max == 1);
+                break;
+            case FE_OR:
+                b             = stack[--sp];
+                a             = stack[sp - 1];
+                stack[sp - 1] = __fe_abs_bool(a.wi.min == 0 && b.wi.min == 0,
+                                              a.wi.max == 1 || b.wi.max == 1);
+                break;
+            case FE_BVNOT:
+                a = __fe_abs_zext(&stack[sp - 1], w);
+                b = __fe_abs_range(mask - a.wi.max, mask - a.wi.min, w);
+                b.ones |= a.zeros;
+                b.zeros |= a.ones;
+                __fe_abs_reduce(&b);
+                stack[sp - 1] = b;
+                break;
+            case FE_BVNEG:
+                a = stack[sp - 1];
+                if (a.wi.min > 0)
+                    stack[sp - 1] = __fe_abs_range((-a.wi.max) & mask,
+                                                   (-a.wi.min) & mask, w);
+                else if (a.wi.max == 0)
+                    stack[sp - 1] = __fe_abs_const(0, w);
+                else
+                    stack[sp - 1] = __fe_abs_top(w);
+                break;
+            default:
+                b             = stack[--sp];
+                stack[sp - 1] =
+                    __fe_abs_arith(op->opcode, &stack[sp - 1], &b, w);
+                break;
+        }
+    }
+    if (stack[0].wi.max == 0)
+        return FE_ABS_FALSE;
+    if (stack[0].wi.min == 1)
+        return FE_ABS_TRUE;
+    return FE_ABS_UNKNOWN;
+}
 
-    if (decl_kind != Z3_OP_CONCAT) {
-        int idx;
-        if (!__detect_single_byte(ctx, node, &idx))
+// Enumeration of the values of a group in a range, skipping the sub-ranges
+// in which the program is false. The ranges are split in halves until they
+// are small enough, or until the program is true on the whole range
+#define RANGE_PRUNE_LEAF_SIZE 16
+#define RANGE_PRUNE_STACK_SIZE 130
+
+typedef struct range_prune_iter_t {
+    fast_eval_t*    fe; // NULL: no pruning
+    fe_abs_inputs_t in;
+    uint64_t        lo[RANGE_PRUNE_STACK_SIZE];
+    uint64_t        hi[RANGE_PRUNE_STACK_SIZE];
+    unsigned        sp;
+    uint64_t        next, last;
+    int             in_leaf;
+} range_prune_iter_t;
+
+static inline void __range_prune_push(range_prune_iter_t* it, uint64_t lo,
+                                      uint64_t hi)
+{
+    it->lo[it->sp]   = lo;
+    it->hi[it->sp++] = hi;
+}
+
+static inline void __range_prune_init(range_prune_iter_t* it, fast_eval_t* fe,
+                                      index_group_t*            ig,
+                                      const wrapped_interval_t* wi,
+                                      unsigned long*            values)
+{
+    it->fe        = skip_range_pruning || !fe->valid ? NULL : fe;
+    it->in.values = values;
+    it->in.ig     = ig;
+    it->sp        = 0;
+    it->in_leaf   = 0;
+
+    // the ranges are popped from the top: start from wi->min as
+    // wi_iter_get_next does
+    if (wi->min > wi->max) {
+        __range_prune_push(it, 0, wi->max);
+        __range_prune_push(it, wi->min, __fe_mask(wi->size));
+    } else
+        __range_prune_push(it, wi->min, wi->max);
+}
+
+static int __range_prune_next(range_prune_iter_t* it, uint64_t* val)
+{
+    uint64_t lo, hi, mid;
+    unsigned k;
+
+    while (1) {
+        if (it->in_leaf) {
+            *val = it->next;
+            if (it->next == it->last)
+                it->in_leaf = 0;
+            else
+                it->next++;
+            return 1;
+        }
+        if (it->sp == 0)
             return 0;
 
-        *pos   = 0;
-        *s_idx = idx;
-        return 1;
+        lo = it->lo[--it->sp];
+        hi = it->hi[it->sp];
+        if (it->fe != NULL && hi - lo >= RANGE_PRUNE_LEAF_SIZE) {
+            for (k = 0; k < it->in.ig->n; ++k) {
+                // a byte is exact if the bytes above it are the same
+                // in the whole range
+                int exact = k == 7 || (lo >> (8 * (k + 1))) ==
+                                          (hi >> (8 * (k + 1)));
+                it->in.bytes[k] = exact ? __fe_abs_range((lo >> (8 * k)) & 0xff,
+                                                         (hi >> (8 * k)) & 0xff,
+                                                         8)
+                                        : __fe_abs_top(8);
+            }
+            int r = __fast_eval_run_abstract(it->fe, &it->in);
+            if (r == FE_ABS_FALSE)
+                continue;
+            if (r == FE_ABS_UNKNOWN) {
+                mid = lo + (hi - lo) / 2;
+                __range_prune_push(it, mid + 1, hi);
+                __range_prune_push(it, lo, mid);
+                continue;
+            }
+        }
+        it->next    = lo;
+        it->last    = hi;
+        it->in_leaf = 1;
     }
+}
 
-    if (num_fields != 2)
+static inline fast_eval_op_t* __fast_eval_emit(fast_eval_t* fe,
+                                               unsigned char opcode,
+                                               unsigned      width)
+{
+    if (fe->n_ops == FAST_EVAL_MAX_OPS)
+        return NULL;
+
+    fast_eval_op_t* op = &fe->ops[fe->n_ops++];
+    memset(op, 0, sizeof(fast_eval_op_t));
+    op->opcode = opcode;
+    op->width  = width;
+    return op;
+}
+
+static int __fast_eval_compile_node(fuzzy_ctx_t* ctx, Z3_ast node,
+                                    fast_eval_t* fe, unsigned* width);
+
+static int __fast_eval_symbol_byte(fuzzy_ctx_t* ctx, Z3_ast node,
+                                   unsigned* idx)
+{
+    if (Z3_get_ast_kind(ctx->z3_ctx, node) != Z3_APP_AST)
         return 0;
 
-    *s_idx = -1;
-    *pos   = -1;
+    Z3_app       app  = Z3_to_app(ctx->z3_ctx, node);
+    Z3_func_decl decl = Z3_get_app_decl(ctx->z3_ctx, app);
+    if (Z3_get_decl_kind(ctx->z3_ctx, decl) != Z3_OP_UNINTERPRETED)
+        return 0;
 
-    Z3_ast child_sx = Z3_get_app_arg(ctx->z3_ctx, app, 0);
-    Z3_inc_ref(ctx->z3_ctx, child_sx);
-    int idx;
-    if (__detect_single_byte(ctx, child_sx, &idx)) {
-        *s_idx = idx;
-    } else {
-        Z3_dec_ref(ctx->z3_ctx, child_sx);
+    Z3_symbol s = Z3_get_decl_name(ctx->z3_ctx, decl);
+    if (Z3_get_symbol_kind(ctx->z3_ctx, s) != Z3_INT_SYMBOL)
         return 0;
-    }
-    Z3_dec_ref(ctx->z3_ctx, child_sx);
 
-    Z3_ast child_dx = Z3_get_app_arg(ctx->z3_ctx, app, 1);
-    Z3_inc_ref(ctx->z3_ctx, child_dx);
-    if (Z3_get_ast_kind(ctx->z3_ctx, child_dx) == Z3_NUMERAL_AST) {
-        *pos = Z3_get_bv_sort_size(ctx->z3_ctx,
-                                   Z3_get_sort(ctx->z3_ctx, child_dx));
-        if (*pos % 8 != 0) {
-            Z3_dec_ref(ctx->z3_ctx, child_dx);
-            return 0;
-        }
-        *pos /= 8;
-    } else {
-        Z3_dec_ref(ctx->z3_ctx, child_dx);
+    Z3_sort sort = Z3_get_sort(ctx->z3_ctx, node);
+    if (Z3_get_sort_kind(ctx->z3_ctx, sort) != Z3_BV_SORT ||
+        Z3_get_bv_sort_size(ctx->z3_ctx, sort) != 8)
         return 0;
-    }
-    Z3_dec_ref(ctx->z3_ctx, child_dx);
 
+    *idx = Z3_get_symbol_int(ctx->z3_ctx, s);
     return 1;
 }
 
-static int __detect_input_group(fuzzy_ctx_t* ctx, Z3_ast node,
-                                index_group_t* ig, char* approx)
+static void __fast_eval_flatten_concat(fuzzy_ctx_t* ctx, Z3_ast node,
+                                       da__Z3_ast* leaves)
 {
-    int res;
-    switch (Z3_get_ast_kind(ctx->z3_ctx, node)) {
-        case Z3_APP_AST: {
-            Z3_app       app        = Z3_to_app(ctx->z3_ctx, node);
-            unsigned     num_fields = Z3_get_app_num_args(ctx->z3_ctx, app);
-            Z3_func_decl decl       = Z3_get_app_decl(ctx->z3_ctx, app);
-            Z3_decl_kind decl_kind  = Z3_get_decl_kind(ctx->z3_ctx, decl);
-            unsigned     i;
-            switch (decl_kind) {
-                case Z3_OP_EXTRACT: {
-#ifdef DEBUG_DETECT_GROUP
-                    Z3FUZZ_LOG("DETECT_GROUP [Z3_OP_EXTRACT]\n");
-#endif
+    if (Z3_get_ast_kind(ctx->z3_ctx, node) == Z3_APP_AST) {
+        Z3_app       app  = Z3_to_app(ctx->z3_ctx, node);
+        Z3_func_decl decl = Z3_get_app_decl(ctx->z3_ctx, app);
+        if (Z3_get_decl_kind(ctx->z3_ctx, decl) == Z3_OP_CONCAT) {
+            unsigned i;
+            for (i = 0; i < Z3_get_app_num_args(ctx->z3_ctx, app); ++i)
+                __fast_eval_flatten_concat(
+                    ctx, Z3_get_app_arg(ctx->z3_ctx, app, i), leaves);
+            return;
+        }
+    }
+    da_add_item__Z3_ast(leaves, node);
+}
 
-                    int prev_n = ig->n;
+static int __fast_eval_compile_concat(fuzzy_ctx_t* ctx, Z3_ast node,
+                                      fast_eval_t* fe, unsigned* width)
+{
+    da__Z3_ast leaves;
+    da_init__Z3_ast(&leaves);
+    __fast_eval_flatten_concat(ctx, node, &leaves);
+
+    int      res = 1;
+    unsigned i, idx, first_idx = 0, is_be = 1, is_le = 1;
+    for (i = 0; i < leaves.size && (is_be || is_le); ++i) {
+        if (!__fast_eval_symbol_byte(ctx, leaves.data[i], &idx)) {
+            is_be = is_le = 0;
+            break;
+        }
+        if (i == 0)
+            first_idx = idx;
+        is_be &= idx == first_idx + i;
+        is_le &= idx + i == first_idx;
+    }
+
+    fast_eval_op_t* op;
+    if (leaves.size <= 8 && (is_be || is_le)) {
+        // multi-byte load from the input, fused in a single operation
+        *width = 8 * leaves.size;
+        op     = __fast_eval_emit(fe, is_be ? FE_LOAD_BE : FE_LOAD_LE, *width);
+        if (op == NULL) {
+            res = 0;
+            goto OUT;
+        }
+        op->arg0 = is_be ? first_idx : first_idx - (leaves.size - 1);
+        op->arg1 = leaves.size;
+        res      = op->arg0 + op->arg1 <= ctx->testcases.data[0].values_len;
+        goto OUT;
+    }
 
-                    unsigned long hig =
-                        Z3_get_decl_int_parameter(ctx->z3_ctx, decl, 0);
-                    unsigned long low =
-                        Z3_get_decl_int_parameter(ctx->z3_ctx, decl, 1);
-#ifdef DEBUG_DETECT_GROUP
-                    Z3FUZZ_LOG("hig: %lu, low: %lu, prev_n: %d\n", hig, low,
-                               prev_n);
-#endif
-                    if (hig + 1 % 8 != 0 || low % 8 != 0)
-                        *approx = 1;
+    *width = 0;
+    for (i = 0; i < leaves.size; ++i) {
+        unsigned leaf_width;
+        if (!__fast_eval_compile_node(ctx, leaves.data[i], fe, &leaf_width)) {
+            res = 0;
+            goto OUT;
+        }
+        *width += leaf_width;
+        if (*width > 64) {
+            res = 0;
+            goto OUT;
+        }
+        if (i == 0)
+            continue;
+        op = __fast_eval_emit(fe, FE_CONCAT, *width);
+        if (op == NULL) {
+            res = 0;
+            goto OUT;
+        }
+        op->arg0 = leaf_width;
+    }
 
-                    // recursive call
-                    Z3_ast child = Z3_get_app_arg(ctx->z3_ctx, app, 0);
-                    Z3_inc_ref(ctx->z3_ctx, child);
-                    res = __detect_input_group(ctx, child, ig, approx);
-                    Z3_dec_ref(ctx->z3_ctx, child);
-                    if (res == 0)
-                        break;
+OUT:
+    da_free__Z3_ast(&leaves, NULL);
+    return res;
+}
 
-                    int next_n = ig->n;
-#ifdef DEBUG_DETECT_GROUP
-                    Z3FUZZ_LOG("next_n: %d\n", next_n);
-                    for (i = 0; i < ig->n; ++i)
-                        Z3FUZZ_LOG(" @ ig->indexes[%u] = 0x%lx\n", i,
-                                   ig->indexes[i]);
-#endif
+static int __fast_eval_compile_cmp(fuzzy_ctx_t* ctx, Z3_app app,
+                                   fast_eval_t* fe, unsigned cmp)
+{
+    static const unsigned char swapped[] = {
+        FE_EQ, FE_NE, FE_UGT, FE_UGE, FE_ULT, FE_ULE,
+        FE_SGT, FE_SGE, FE_SLT, FE_SLE};
 
-                    unsigned bv_width = next_n - prev_n;
-                    if (bv_width < hig / 8 + 1) {
-                        res = 0;
-                        break;
-                    }
+    Z3_ast   arg0 = Z3_get_app_arg(ctx->z3_ctx, app, 0);
+    Z3_ast   arg1 = Z3_get_app_arg(ctx->z3_ctx, app, 1);
+    uint64_t imm;
+    unsigned width;
 
-                    // spill in tmp (little endian)
-                    unsigned long tmp[bv_width];
-                    for (i = 0; i < bv_width; ++i)
-                        tmp[i] = ig->indexes[next_n - i - 1];
+    if (Z3_get_ast_kind(ctx->z3_ctx, arg0) == Z3_NUMERAL_AST) {
+        // compare-immediate with the constant moved on the right
+        Z3_ast tmp = arg0;
+        arg0       = arg1;
+        arg1       = tmp;
+        cmp        = swapped[cmp];
+    }
 
-                    // move tmp to: ig->indexes + prev_n
-                    for (i = low / 8; i <= hig / 8; ++i) {
-                        ASSERT_OR_ABORT(i < bv_width, "extract overflow");
-                        ig->indexes[prev_n++] = tmp[i];
-                    }
-                    ig->n = prev_n;
+    if (!__fast_eval_compile_node(ctx, arg0, fe, &width))
+        return 0;
 
-#ifdef DEBUG_DETECT_GROUP
-                    for (i = 0; i < ig->n; ++i)
-                        Z3FUZZ_LOG(" > ig->indexes[%u] = 0x%lx\n", i,
-                                   ig->indexes[i]);
-#endif
-                    break;
-                }
-                case Z3_OP_BAND: {
-#ifdef DEBUG_DETECT_GROUP
-                    Z3FUZZ_LOG("DETECT_GROUP [Z3_OP_BAND]\n");
-#endif
-                    // check if one of the two is a constant
-                    // recursive call as before
-                    if (num_fields != 2) {
-                        res = 0;
-                        break;
-                    }
+    if (Z3_get_ast_kind(ctx->z3_ctx, arg1) == Z3_NUMERAL_AST &&
+        Z3_get_numeral_uint64(ctx->z3_ctx, arg1, &imm)) {
+        fast_eval_op_t* op = __fast_eval_emit(fe, FE_CMP_IMM, width);
+        if (op == NULL)
+            return 0;
+        op->cmp = cmp;
+        op->imm = imm;
+        return 1;
+    }
 
-                    Z3_ast child_1 = Z3_get_app_arg(ctx->z3_ctx, app, 0);
-                    Z3_inc_ref(ctx->z3_ctx, child_1);
+    if (!__fast_eval_compile_node(ctx, arg1, fe, &width))
+        return 0;
+    fast_eval_op_t* op = __fast_eval_emit(fe, FE_CMP, width);
+    if (op == NULL)
+        return 0;
+    op->cmp = cmp;
+    return 1;
+}
 
-                    Z3_ast child_2 = Z3_get_app_arg(ctx->z3_ctx, app, 1);
-                    Z3_inc_ref(ctx->z3_ctx, child_2);
+static int __fast_eval_compile_nary(fuzzy_ctx_t* ctx, Z3_app app,
+                                    fast_eval_t* fe, unsigned char opcode,
+                                    unsigned* width)
+{
+    unsigned i, num_args = Z3_get_app_num_args(ctx->z3_ctx, app);
+    for (i = 0; i < num_args; ++i) {
+        if (!__fast_eval_compile_node(ctx, Z3_get_app_arg(ctx->z3_ctx, app, i),
+                                      fe, width))
+            return 0;
+        if (i > 0 && __fast_eval_emit(fe, opcode, *width) == NULL)
+            return 0;
+    }
+    return num_args > 0;
+}
 
-                    Z3_ast        subexpr = NULL;
-                    unsigned long mask;
-                    if (Z3_get_ast_kind(ctx->z3_ctx, child_1) ==
-                        Z3_NUMERAL_AST) {
-                        Z3_bool successGet = Z3_get_numeral_uint64(
-                            ctx->z3_ctx, child_1, (uint64_t*)&mask);
-                        if (successGet == Z3_FALSE) {
-                            res = 0;
-                            goto BVAND_EXIT;
-                        }
-                        subexpr = child_2;
-                    } else if (Z3_get_ast_kind(ctx->z3_ctx, child_2) ==
-                               Z3_NUMERAL_AST) {
-                        Z3_bool successGet = Z3_get_numeral_uint64(
-                            ctx->z3_ctx, child_2, (uint64_t*)&mask);
-                        if (successGet == Z3_FALSE) {
-                            res = 0; // constant is too big
-                            goto BVAND_EXIT;
-                        }
-                        subexpr = child_1;
-                    } else {
-                        res = 0;
-                        goto BVAND_EXIT;
-                    }
-                    if (mask == 0) {
-                        res = 0; // and with 0 -> no group, it is always 0
-                        goto BVAND_EXIT;
-                    }
+// Subterms that read only one or two input bytes (character classes,
+// table lookups, small arithmetic on a byte) are replaced by a table of
+// their 256 or 65536 values, indexed by the bytes. The tables are pure
+// functions of the subterm, and they are kept in the context across queries.
+// With one byte, also subterms the compiler does not support (e.g., udiv)
+// are tabulated using the model evaluator.
 
-                    int prev_n = ig->n;
-#ifdef DEBUG_DETECT_GROUP
-                    Z3FUZZ_LOG("prev_n: %d\n", prev_n);
-#endif
+#define FAST_EVAL_LUT8_MIN_OPS 4
+#define FAST_EVAL_LUT16_MIN_OPS 12
+#define FAST_EVAL_LUT_MAX_BYTES (64UL << 20)
 
-                    // recursive call
-                    res = __detect_input_group(ctx, subexpr, ig, approx);
-                    if (res == 0)
-                        goto BVAND_EXIT;
+static int fast_eval_building_lut = 0;
 
-                    // find rightmost and leftmost set-bit of mask
-                    unsigned long low = rightmost_set_bit(mask);
-                    unsigned long hig = leftmost_set_bit(mask);
-                    if (hig + 1 % 8 != 0 || low % 8 != 0)
-                        *approx = 1;
+static void __fast_eval_build_lut(fuzzy_ctx_t* ctx, Z3_ast node,
+                                  lookup_table_t* lt)
+{
+    testcase_t*    seed = &ctx->testcases.data[0];
+    fast_eval_t    sub;
+    unsigned long *values, i, n_entries = 1UL << (8 * lt->n_support);
+    unsigned       width;
+    int            compiled;
+
+    fast_eval_building_lut = 1;
+    sub.ast                = node;
+    sub.n_ops              = 0;
+    compiled               = __fast_eval_compile_node(ctx, node, &sub, &width);
+    fast_eval_building_lut = 0;
+
+    if (compiled && sub.n_ops < (lt->n_support == 1 ? FAST_EVAL_LUT8_MIN_OPS
+                                                    : FAST_EVAL_LUT16_MIN_OPS))
+        return; // cheaper than the lookup
+    if (!compiled && lt->n_support == 2)
+        return; // too many calls to the model evaluator
+
+    values = (unsigned long*)malloc(sizeof(unsigned long) * seed->values_len);
+    ASSERT_OR_ABORT(values != NULL, "__fast_eval_build_lut(): malloc failed");
+    memcpy(values, seed->values, sizeof(unsigned long) * seed->values_len);
+    lt->size  = sizeof(unsigned long) * n_entries;
+    lt->table = (unsigned long*)malloc(lt->size);
+    ASSERT_OR_ABORT(lt->table != NULL,
+                    "__fast_eval_build_lut(): malloc failed");
+
+    for (i = 0; i < n_entries; ++i) {
+        values[lt->support[0]] = i & 0xff;
+        if (lt->n_support == 2)
+            values[lt->support[1]] = i >> 8;
+        lt->table[i] =
+            compiled ? __fast_eval_run(&sub, values)
+                     : ctx->model_eval(ctx->z3_ctx, node, values,
+                                       seed->value_sizes, seed->values_len,
+                                       NULL);
+    }
+    free(values);
+    ctx->stats.num_lookup_tables++;
+}
 
-                    int next_n = ig->n;
-#ifdef DEBUG_DETECT_GROUP
-                    Z3FUZZ_LOG("low: %lu, hig: %lu\n", low, hig);
-                    Z3FUZZ_LOG("next_n: %d\n", next_n);
-                    for (i = 0; i < ig->n; ++i)
-                        Z3FUZZ_LOG(" @ ig->indexes[%u] = 0x%lx\n", i,
-                                   ig->indexes[i]);
-#endif
+static int __fast_eval_compile_lut(fuzzy_ctx_t* ctx, Z3_ast node,
+                                   fast_eval_t* fe, unsigned width)
+{
+    lookup_tables_t* lts    = (lookup_tables_t*)ctx->lookup_tables;
+    unsigned long    ast_id = Z3_get_ast_id(ctx->z3_ctx, node);
+    lookup_table_t*  lt = dict_get_ref__lookup_table_t(&lts->tables, ast_id);
+
+    if (lt == NULL) {
+        ast_info_ptr   info;
+        lookup_table_t el = {0};
+        unsigned long  i, *p;
+
+        detect_involved_inputs_wrapper(ctx, node, &info);
+        if (info->uses_assignments || info->approximated_groups > 0 ||
+            info->indexes.size + info->indexes_ud.size == 0 ||
+            info->indexes.size + info->indexes_ud.size > 2)
+            return 0;
 
-                    unsigned bv_width = next_n - prev_n;
-                    if (bv_width < hig / 8 + 1) {
-                        res = 0;
-                        goto BVAND_EXIT;
-                    }
+        set_reset_iter__ulong(&info->indexes, 0);
+        while (set_iter_next__ulong(&info->indexes, 0, &p))
+            el.support[el.n_support++] = *p;
+        for (i = 0; i < info->indexes_ud.size; ++i)
+            el.support[el.n_support++] = info->indexes_ud.data[i];
+
+        __fast_eval_build_lut(ctx, node, &el);
+        el.ast.ctx = ctx->z3_ctx;
+        el.ast.ast = node;
+        Z3_inc_ref(ctx->z3_ctx, node);
+        dict_set__lookup_table_t(&lts->tables, ast_id, el);
+        lts->bytes += el.size;
+        lt = dict_get_ref__lookup_table_t(&lts->tables, ast_id);
+    }
+    if (lt->table == NULL)
+        return 0;
 
-                    // spill in tmp (little endian)
-                    unsigned long* tmp = (unsigned long*)malloc(
-                        sizeof(unsigned long) * bv_width);
-                    for (i = 0; i < bv_width; ++i)
-                        tmp[i] = ig->indexes[next_n - i - 1];
+    fast_eval_op_t* op = __fast_eval_emit(
+        fe, lt->n_support == 1 ? FE_LUT8 : FE_LUT16, width);
+    if (op == NULL)
+        return 0;
+    op->arg0 = lt->support[0];
+    op->imm  = lt->support[1];
+    op->lut  = lt->table;
+    return 1;
+}
 
-                    // move tmp to: ig->indexes + prev_n
-                    for (i = low / 8; i <= hig / 8; ++i) {
-                        ASSERT_OR_ABORT(i < bv_width, "extract overflow");
-                        ig->indexes[prev_n++] = tmp[i];
-                    }
-                    ig->n = prev_n;
+static int __fast_eval_compile_node(fuzzy_ctx_t* ctx, Z3_ast node,
+                                    fast_eval_t* fe, unsigned* width)
+{
+    Z3_sort      sort      = Z3_get_sort(ctx->z3_ctx, node);
+    Z3_sort_kind sort_kind = Z3_get_sort_kind(ctx->z3_ctx, sort);
+    if (sort_kind == Z3_BOOL_SORT)
+        *width = 1;
+    else if (sort_kind == Z3_BV_SORT)
+        *width = Z3_get_bv_sort_size(ctx->z3_ctx, sort);
+    else
+        return 0;
+    if (*width > 64)
+        return 0;
 
-#ifdef DEBUG_DETECT_GROUP
-                    for (i = 0; i < ig->n; ++i)
-                        Z3FUZZ_LOG(" > ig->indexes[%u] = 0x%lx\n", i,
-                                   ig->indexes[i]);
-#endif
-                    free(tmp);
+    fast_eval_op_t* op;
+    switch (Z3_get_ast_kind(ctx->z3_ctx, node)) {
+        case Z3_NUMERAL_AST: {
+            uint64_t v;
+            if (!Z3_get_numeral_uint64(ctx->z3_ctx, node, &v))
+                return 0;
+            op = __fast_eval_emit(fe, FE_CONST, *width);
+            if (op == NULL)
+                return 0;
+            op->imm = v;
+            return 1;
+        }
+        case Z3_APP_AST:
+            break;
+        default:
+            return 0;
+    }
 
-                BVAND_EXIT:
-                    Z3_dec_ref(ctx->z3_ctx, child_1);
-                    Z3_dec_ref(ctx->z3_ctx, child_2);
-                    break;
-                }
-                case Z3_OP_BADD:
-                case Z3_OP_BOR: {
-                    // detect if is an OR/ADD of BSHL
-#ifdef DEBUG_DETECT_GROUP
-                    Z3FUZZ_LOG("DETECT_GROUP [Z3_OP_BADD/Z3_OP_BOR]\n");
-#endif
+    Z3_app       app       = Z3_to_app(ctx->z3_ctx, node);
+    unsigned     num_args  = Z3_get_app_num_args(ctx->z3_ctx, app);
+    Z3_func_decl decl      = Z3_get_app_decl(ctx->z3_ctx, app);
+    Z3_decl_kind decl_kind = Z3_get_decl_kind(ctx->z3_ctx, decl);
+    unsigned     child_width;
 
-                    if (decl_kind == Z3_OP_BOR) {
+    if (!skip_lookup_tables && !fast_eval_building_lut && num_args > 0 &&
+        decl_kind != Z3_OP_UNINTERPRETED &&
+        __fast_eval_compile_lut(ctx, node, fe, *width))
+        return 1;
 
-                        da__Z3_ast args;
-                        da_init__Z3_ast(&args);
-                        flatten_bor_args(ctx, node, &args);
+    switch (decl_kind) {
+        case Z3_OP_TRUE:
+        case Z3_OP_FALSE:
+            op = __fast_eval_emit(fe, FE_CONST, 1);
+            if (op == NULL)
+                return 0;
+            op->imm = decl_kind == Z3_OP_TRUE;
+            return 1;
+        case Z3_OP_UNINTERPRETED: {
+            Z3_symbol s = Z3_get_decl_name(ctx->z3_ctx, decl);
+            if (num_args != 0 ||
+                Z3_get_symbol_kind(ctx->z3_ctx, s) != Z3_INT_SYMBOL ||
+                sort_kind != Z3_BV_SORT)
+                return 0;
+            op = __fast_eval_emit(fe, FE_LOAD, *width);
+            if (op == NULL)
+                return 0;
+            op->arg0 = Z3_get_symbol_int(ctx->z3_ctx, s);
+            return op->arg0 < ctx->testcases.data[0].values_len;
+        }
+        case Z3_OP_CONCAT:
+            return __fast_eval_compile_concat(ctx, node, fe, width);
+        case Z3_OP_EXTRACT: {
+            unsigned low = Z3_get_decl_int_parameter(ctx->z3_ctx, decl, 1);
+            if (!__fast_eval_compile_node(
+                    ctx, Z3_get_app_arg(ctx->z3_ctx, app, 0), fe, &child_width))
+                return 0;
+            op = __fast_eval_emit(fe, FE_EXTRACT, *width);
+            if (op == NULL)
+                return 0;
+            op->arg0 = low;
+            return 1;
+        }
+        case Z3_OP_ZERO_EXT:
+            // values are kept masked, zero extension is free
+            return __fast_eval_compile_node(
+                ctx, Z3_get_app_arg(ctx->z3_ctx, app, 0), fe, &child_width);
+        case Z3_OP_SIGN_EXT:
+            if (!__fast_eval_compile_node(
+                    ctx, Z3_get_app_arg(ctx->z3_ctx, app, 0), fe, &child_width))
+                return 0;
+            op = __fast_eval_emit(fe, FE_SEXT, *width);
+            if (op == NULL)
+                return 0;
+            op->arg0 = child_width;
+            return 1;
+        case Z3_OP_ITE: {
+            Z3_ast   then_ast = Z3_get_app_arg(ctx->z3_ctx, app, 1);
+            Z3_ast   else_ast = Z3_get_app_arg(ctx->z3_ctx, app, 2);
+            uint64_t then_v, else_v;
+            if (!__fast_eval_compile_node(
+                    ctx, Z3_get_app_arg(ctx->z3_ctx, app, 0), fe, &child_width))
+                return 0;
+            if (Z3_get_ast_kind(ctx->z3_ctx, then_ast) == Z3_NUMERAL_AST &&
+                Z3_get_ast_kind(ctx->z3_ctx, else_ast) == Z3_NUMERAL_AST &&
+                Z3_get_numeral_uint64(ctx->z3_ctx, then_ast, &then_v) &&
+                Z3_get_numeral_uint64(ctx->z3_ctx, else_ast, &else_v)) {
+                // select between two constants
+                op = __fast_eval_emit(fe, FE_SELECT_IMM, *width);
+                if (op == NULL)
+                    return 0;
+                op->imm  = then_v;
+                op->imm2 = else_v;
+                return 1;
+            }
+            if (!__fast_eval_compile_node(ctx, then_ast, fe, &child_width) ||
+                !__fast_eval_compile_node(ctx, else_ast, fe, &child_width))
+                return 0;
+            return __fast_eval_emit(fe, FE_SELECT, *width) != NULL;
+        }
+        case Z3_OP_EQ:
+        case Z3_OP_IFF:
+            return num_args == 2 &&
+                   __fast_eval_compile_cmp(ctx, app, fe, FE_EQ);
+        case Z3_OP_DISTINCT:
+            return num_args == 2 &&
+                   __fast_eval_compile_cmp(ctx, app, fe, FE_NE);
+        case Z3_OP_ULT:
+            return __fast_eval_compile_cmp(ctx, app, fe, FE_ULT);
+        case Z3_OP_ULEQ:
+            return __fast_eval_compile_cmp(ctx, app, fe, FE_ULE);
+        case Z3_OP_UGT:
+            return __fast_eval_compile_cmp(ctx, app, fe, FE_UGT);
+        case Z3_OP_UGEQ:
+            return __fast_eval_compile_cmp(ctx, app, fe, FE_UGE);
+        case Z3_OP_SLT:
+            return __fast_eval_compile_cmp(ctx, app, fe, FE_SLT);
+        case Z3_OP_SLEQ:
+            return __fast_eval_compile_cmp(ctx, app, fe, FE_SLE);
+        case Z3_OP_SGT:
+            return __fast_eval_compile_cmp(ctx, app, fe, FE_SGT);
+        case Z3_OP_SGEQ:
+            return __fast_eval_compile_cmp(ctx, app, fe, FE_SGE);
+        case Z3_OP_NOT:
+            if (!__fast_eval_compile_node(
+                    ctx, Z3_get_app_arg(ctx->z3_ctx, app, 0), fe, &child_width))
+                return 0;
+            return __fast_eval_emit(fe, FE_NOT, 1) != NULL;
+        case Z3_OP_BNOT:
+            if (!__fast_eval_compile_node(
+                    ctx, Z3_get_app_arg(ctx->z3_ctx, app, 0), fe, &child_width))
+                return 0;
+            return __fast_eval_emit(fe, FE_BVNOT, *width) != NULL;
+        case Z3_OP_BNEG:
+            if (!__fast_eval_compile_node(
+                    ctx, Z3_get_app_arg(ctx->z3_ctx, app, 0), fe, &child_width))
+                return 0;
+            return __fast_eval_emit(fe, FE_BVNEG, *width) != NULL;
+        case Z3_OP_AND:
+            return __fast_eval_compile_nary(ctx, app, fe, FE_AND, width);
+        case Z3_OP_OR:
+            return __fast_eval_compile_nary(ctx, app, fe, FE_OR, width);
+        case Z3_OP_BADD:
+            return __fast_eval_compile_nary(ctx, app, fe, FE_BVADD, width);
+        case Z3_OP_BSUB:
+            return __fast_eval_compile_nary(ctx, app, fe, FE_BVSUB, width);
+        case Z3_OP_BMUL:
+            return __fast_eval_compile_nary(ctx, app, fe, FE_BVMUL, width);
+        case Z3_OP_BAND:
+            return __fast_eval_compile_nary(ctx, app, fe, FE_BVAND, width);
+        case Z3_OP_BOR:
+            return __fast_eval_compile_nary(ctx, app, fe, FE_BVOR, width);
+        case Z3_OP_BXOR:
+            return __fast_eval_compile_nary(ctx, app, fe, FE_BVXOR, width);
+        case Z3_OP_BSHL:
+            return num_args == 2 &&
+                   __fast_eval_compile_nary(ctx, app, fe, FE_BVSHL, width);
+        case Z3_OP_BLSHR:
+            return num_args == 2 &&
+                   __fast_eval_compile_nary(ctx, app, fe, FE_BVLSHR, width);
+        case Z3_OP_BASHR:
+            return num_args == 2 &&
+                   __fast_eval_compile_nary(ctx, app, fe, FE_BVASHR, width);
+        default:
+            return 0;
+    }
+}
 
-                        int found_concat_shifts = 1;
-                        int n_tmp_inps          = 0;
-                        int tmp_inps[8]         = {-1, -1, -1, -1, -1, -1, -1};
-                        for (i = 0; i < args.size; ++i) {
-                            if (i >= 8) {
-                                found_concat_shifts = 0;
-                                break;
-                            }
-                            Z3_ast child = args.data[i];
-
-                            int symb_idx, pos;
-                            if (!__detect_concat_shift(ctx, child, &symb_idx,
-                                                       &pos)) {
-                                found_concat_shifts = 0;
-                                break;
-                            }
+static inline void __fast_eval_compile(fuzzy_ctx_t* ctx, Z3_ast node,
+                                       fast_eval_t* fe)
+{
+    unsigned         width;
+    lookup_tables_t* lts = (lookup_tables_t*)ctx->lookup_tables;
+
+    // the tables referenced by the other live programs (e.g., the gd
+    // objective) are compiled after the global one
+    if (unlikely(lts->bytes > FAST_EVAL_LUT_MAX_BYTES)) {
+        dict_remove_all__lookup_table_t(&lts->tables);
+        lts->bytes = 0;
+    }
+
+    fe->ast   = node;
+    fe->n_ops = 0;
+    fe->valid = !skip_fast_eval &&
+                Z3_get_sort_kind(ctx->z3_ctx, Z3_get_sort(ctx->z3_ctx, node)) ==
+                    Z3_BOOL_SORT &&
+                __fast_eval_compile_node(ctx, node, fe, &width);
+}
 
-                            if (tmp_inps[pos] != -1) {
-                                found_concat_shifts = 0;
-                                break;
-                            }
+// for bitvector terms up to 64 bits (e.g., the objective of gd)
+static inline void __fast_eval_compile_bv(fuzzy_ctx_t* ctx, Z3_ast node,
+                                          fast_eval_t* fe)
+{
+    unsigned width;
+    Z3_sort  sort = Z3_get_sort(ctx->z3_ctx, node);
+
+    fe->ast   = node;
+    fe->n_ops = 0;
+    fe->valid = !skip_fast_eval &&
+                Z3_get_sort_kind(ctx->z3_ctx, sort) == Z3_BV_SORT &&
+                Z3_get_bv_sort_size(ctx->z3_ctx, sort) <= 64 &&
+                __fast_eval_compile_node(ctx, node, fe, &width);
+}
 
-                            tmp_inps[pos] = symb_idx;
-                            n_tmp_inps++;
-                        }
-                        for (i = 0; i < args.size; ++i)
-                            Z3_dec_ref(ctx->z3_ctx, args.data[i]);
-                        da_free__Z3_ast(&args, NULL);
+static __always_inline unsigned long
+__fast_eval_or_model_eval(fuzzy_ctx_t* ctx, Z3_ast node, unsigned long* values,
+                          unsigned char* value_sizes, unsigned long n_values)
+{
+    if (fast_eval.ast != node)
+        __fast_eval_compile(ctx, node, &fast_eval);
+
+    if (fast_eval.valid) {
+        ctx->stats.num_fast_evaluate++;
+        unsigned long res = __fast_eval_run(&fast_eval, values);
+        if (unlikely(check_fast_eval)) {
+            // debug: every fast evaluation is compared with model_eval
+            unsigned long expected = ctx->model_eval(
+                ctx->z3_ctx, node, values, value_sizes, n_values, NULL);
+            if (res != expected) {
+                Z3FUZZ_LOG("fast eval mismatch: 0x%lx instead of 0x%lx\n%s\n",
+                           res, expected,
+                           Z3_ast_to_string(ctx->z3_ctx, node));
+                ASSERT_OR_ABORT(0, "__fast_eval_or_model_eval() mismatch");
+            }
+        }
+        return res;
+    }
+    return ctx->model_eval(ctx->z3_ctx, node, values, value_sizes, n_values,
+                           NULL);
+}
 
-                        if (found_concat_shifts) {
-                            for (i = 0; i < 8; ++i) {
-                                if (ig->n >= MAX_GROUP_SIZE) {
-                                    res = 0;
-                                    break;
-                                }
-                                if (tmp_inps[i] == -1)
-                                    break;
-                                ig->indexes[ig->n++] = tmp_inps[i];
-                            }
-                            if (i != n_tmp_inps) {
-                                res = 0;
-                                break;
-                            }
-                            // invert group!
-                            for (i = 0; i < n_tmp_inps; ++i)
-                                ig->indexes[i] = tmp_inps[n_tmp_inps - i - 1];
-#ifdef DEBUG_DETECT_GROUP
-                            Z3FUZZ_LOG("Detected with detect concat shift the "
-                                       "group:\n");
-                            print_index_group(ig);
-#endif
-                            res = 1;
-                            break;
-                        }
-                    }
+static __always_inline int
+__update_optimistic_solution(fuzzy_ctx_t* ctx, unsigned long* values,
+                             unsigned depth)
+{
+    if (!opt_found || depth > opt_num_sat) {
+        testcase_t* t = &ctx->testcases.data[0];
+        opt_found     = 1;
+        opt_num_sat   = depth;
+        memcpy(tmp_opt_input, values, t->values_len * sizeof(unsigned long));
+        __vals_long_to_char(values, tmp_opt_proof, t->testcase_len);
+        return 1;
+    }
+    return 0;
+}
 
-                    res                            = 0;
-                    unsigned long shift_mask       = 0;
-                    int           op_without_shift = 0;
-                    for (i = 0; i < num_fields; ++i) {
-                        Z3_ast child = Z3_get_app_arg(ctx->z3_ctx, app, i);
-                        if (Z3_get_ast_kind(ctx->z3_ctx, child) == Z3_APP_AST) {
-                            Z3_app child_app = Z3_to_app(ctx->z3_ctx, child);
-                            Z3_func_decl child_decl =
-                                Z3_get_app_decl(ctx->z3_ctx, child_app);
-                            if (Z3_get_decl_kind(ctx->z3_ctx, child_decl) ==
-                                Z3_OP_BSHL) {
-#ifdef DEBUG_DETECT_GROUP
-                                Z3FUZZ_LOG("> shift\n");
-#endif
-                                unsigned long shift_val = 0;
+static void __report_optimistic_solution(fuzzy_ctx_t* ctx)
+{
+    // opt_found is reset by the AND handler for each conjunct: only report
+    // candidates deeper than the last one the caller has seen
+    if (likely(progress_callback == NULL) ||
+        __atomic_load_n(&stop_requested, __ATOMIC_RELAXED))
+        return;
+    if (progress_reported && opt_num_sat <= progress_depth)
+        return;
 
-                                Z3_ast child_1 =
-                                    Z3_get_app_arg(ctx->z3_ctx, child_app, 0);
-                                Z3_inc_ref(ctx->z3_ctx, child_1);
+    testcase_t* t     = &ctx->testcases.data[0];
+    progress_reported = 1;
+    progress_depth    = opt_num_sat;
+    if (progress_callback(tmp_opt_proof, t->testcase_len, opt_num_sat, 0) ==
+        Z3FUZZ_STOP)
+        __atomic_store_n(&stop_requested, 1, __ATOMIC_RELAXED);
+}
 
-                                Z3_ast child_2 =
-                                    Z3_get_app_arg(ctx->z3_ctx, child_app, 1);
-                                Z3_inc_ref(ctx->z3_ctx, child_2);
+static inline int __evaluate_branch_query_ex(fuzzy_ctx_t* ctx, Z3_ast query,
+                                             Z3_ast         branch_condition,
+                                             unsigned long* values,
+                                             unsigned char* value_sizes,
+                                             unsigned long  n_values,
+                                             int            unique_candidate)
+{
+    if (timer_check_wrapper(ctx)) {
+        ctx->stats.num_timeouts++;
+        return TIMEOUT_V;
+    }
 
-                                Z3_ast subexpr = NULL;
-                                if (Z3_get_ast_kind(ctx->z3_ctx, child_2) ==
-                                    Z3_NUMERAL_AST) {
-                                    Z3_bool successGet = Z3_get_numeral_uint64(
-                                        ctx->z3_ctx, child_2,
-                                        (uint64_t*)&shift_val);
-                                    if (!successGet)
-                                        res = 0; // constant is too big
-                                    else {
-                                        subexpr = child_1;
-                                        res     = 1;
-                                    }
-                                } else
-                                    res = 0;
+    ctx->stats.num_evaluate++;
 
-                                if (!res) {
-                                    Z3_dec_ref(ctx->z3_ctx, child_1);
-                                    Z3_dec_ref(ctx->z3_ctx, child_2);
-                                    break;
-                                }
+    // an active checkpoint records the digests of every candidate, unique
+    // ones too: they are skipped when the phase runs again on the branch
+    if (check_unnecessary_eval) {
+        if (unique_candidate && active_checkpoint == NULL)
+            ctx->stats.num_unhashed_evaluate++;
+        else if (__check_or_add_digest(&ast_data.processed_set,
+                                       (unsigned char*)values,
+                                       ctx->n_symbols * sizeof(unsigned long)))
+            return 0;
+    }
 
-#ifdef DEBUG_DETECT_GROUP
-                                Z3FUZZ_LOG("> shift val: 0x%016lx\n",
-                                           shift_val);
+    int      res;
+    uint32_t depth;
+    res = (int)__fast_eval_or_model_eval(ctx, branch_condition, values,
+                                         value_sizes, n_values);
+    if (res) {
+#if 0
+        unsigned num_sat;
+        res = evaluate_pi(ctx, query, values, value_sizes, n_values, &num_sat);
+        if (!opt_found || num_sat > opt_num_sat) {
+            testcase_t* t = &ctx->testcases.data[0];
+            opt_found     = 1;
+            opt_num_sat   = num_sat;
+            memcpy(tmp_opt_input, values,
+                   t->values_len * sizeof(unsigned long));
+            __vals_long_to_char(values, tmp_opt_proof, t->testcase_len);
+        }
+#else
+        res = (int)ctx->model_eval(ctx->z3_ctx, query, values, value_sizes,
+                                   n_values, &depth);
+        if (__update_optimistic_solution(ctx, values, depth) && !res)
+            __report_optimistic_solution(ctx);
 #endif
+    }
+    res = res != 0 ? 1 : 0;
+    return res;
+}
 
-                                unsigned char prev_n = ig->n;
-                                res = __detect_input_group(ctx, subexpr, ig,
-                                                           approx);
-                                if (ig->n == prev_n) {
-                                    res = 0;
-                                    Z3_dec_ref(ctx->z3_ctx, child_1);
-                                    Z3_dec_ref(ctx->z3_ctx, child_2);
-                                    break;
-                                }
-                                // TODO: fix this. `Concat(k!0, 0x00) << 8` <-
-                                // mispredicted
-                                unsigned long curr_mask =
-                                    (2UL << ((ig->n - prev_n) * 8 - 1)) - 1;
-                                if (((curr_mask << shift_val) & shift_mask) !=
-                                    0) {
-                                    res = 0;
-                                    Z3_dec_ref(ctx->z3_ctx, child_1);
-                                    Z3_dec_ref(ctx->z3_ctx, child_2);
-                                    break;
-                                }
-                                shift_mask |= curr_mask << shift_val;
-
-                                Z3_dec_ref(ctx->z3_ctx, child_1);
-                                Z3_dec_ref(ctx->z3_ctx, child_2);
+static inline int __evaluate_branch_query(fuzzy_ctx_t* ctx, Z3_ast query,
+                                          Z3_ast         branch_condition,
+                                          unsigned long* values,
+                                          unsigned char* value_sizes,
+                                          unsigned long  n_values)
+{
+    return __evaluate_branch_query_ex(ctx, query, branch_condition, values,
+                                      value_sizes, n_values, 0);
+}
 
-                                if (!res)
-                                    break;
-#ifdef DEBUG_DETECT_GROUP
-                                Z3FUZZ_LOG("> shift OK\n");
-#endif
-                                continue;
-                            }
-                        }
-                        if (!op_without_shift)
-                            op_without_shift = 1;
-                        else {
-                            res = 0;
-                            break;
-                        }
-#ifdef DEBUG_DETECT_GROUP
-                        Z3FUZZ_LOG("> op != shift\n");
-#endif
-                        res = __detect_input_group(ctx, child, ig, approx);
-                        if (!res)
-                            break;
-#ifdef DEBUG_DETECT_GROUP
-                        Z3FUZZ_LOG("> op != shift OK\n");
-#endif
-                    }
+// for generators that never produce the same candidate twice in a phase
+// (e.g., enumerating the values of a group): hashing the candidate and
+// storing its digest would be wasted, unless a checkpoint of the branch is
+// active. Candidates of earlier phases may be evaluated again, with the
+// same result
+static inline int __evaluate_branch_query_unique(fuzzy_ctx_t* ctx,
+                                                 Z3_ast       query,
+                                                 Z3_ast branch_condition,
+                                                 unsigned long* values,
+                                                 unsigned char* value_sizes,
+                                                 unsigned long  n_values)
+{
+    return __evaluate_branch_query_ex(ctx, query, branch_condition, values,
+                                      value_sizes, n_values, 1);
+}
 
-                    break;
-                }
-                case Z3_OP_CONCAT: {
-                    // recursive call
-                    int found_inp = 0;
-                    res           = 0;
-                    for (i = 0; i < num_fields; ++i) {
-                        Z3_ast child = Z3_get_app_arg(ctx->z3_ctx, app, i);
-                        Z3_inc_ref(ctx->z3_ctx, child);
-                        Z3_ast_kind child_kind =
-                            Z3_get_ast_kind(ctx->z3_ctx, child);
-                        if (child_kind != Z3_NUMERAL_AST)
-                            found_inp = 1;
-                        else if (child_kind == Z3_NUMERAL_AST && found_inp)
-                            // the group is shifted...
-                            *approx = 1;
+// state shared by the workers of a parallel phase. The workers evaluate the
+// branch condition with fast_eval (that must be valid), candidates that
+// satisfy it are evaluated on the query with Z3 under the lock, that
+// serializes the updates of the optimistic solution too
+typedef struct parallel_phase_t {
+    fuzzy_ctx_t*    ctx;
+    Z3_ast          query;
+    testcase_t*     testcase;
+    unsigned long*  start_input; // tmp_input when the phase started
+    uint64_t*       filter;      // fingerprints of the candidates
+    unsigned long   num_evaluate;
+    unsigned long   num_fast_evaluate;
+    pthread_mutex_t lock;
+    int             res; // written with the lock
+} parallel_phase_t;
+
+static void __parallel_phase_init(parallel_phase_t* pp, fuzzy_ctx_t* ctx,
+                                  Z3_ast query)
+{
+    pp->ctx               = ctx;
+    pp->query             = query;
+    pp->testcase          = &ctx->testcases.data[0];
+    pp->num_evaluate      = 0;
+    pp->num_fast_evaluate = 0;
+    pp->res               = 0;
+    pp->start_input       = (unsigned long*)malloc(sizeof(unsigned long) *
+                                             pp->testcase->values_len);
+    ASSERT_OR_ABORT(pp->start_input, "__parallel_phase_init(): malloc failed");
+    memcpy(pp->start_input, tmp_input,
+           sizeof(unsigned long) * pp->testcase->values_len);
+    pp->filter = (uint64_t*)calloc(CANDIDATE_FILTER_SIZE, sizeof(uint64_t));
+    ASSERT_OR_ABORT(pp->filter, "__parallel_phase_init(): calloc failed");
+    pthread_mutex_init(&pp->lock, NULL);
+}
 
-                        if (child_kind == Z3_NUMERAL_AST) {
-                            Z3_dec_ref(ctx->z3_ctx, child);
-                            continue;
-                        }
+// wait for the submitted tasks. A solution is left in tmp_input
+static int __parallel_phase_wait(parallel_phase_t* pp)
+{
+    thread_pool_wait(&thread_pool);
 
-                        res = __detect_input_group(ctx, child, ig, approx);
-                        Z3_dec_ref(ctx->z3_ctx, child);
-                        if (res == 0)
-                            break;
-                    }
-                    break;
-                }
-                case Z3_OP_UNINTERPRETED: {
-                    Z3_symbol s = Z3_get_decl_name(ctx->z3_ctx, decl);
-                    unsigned  symbol_index =
-                        (unsigned)Z3_get_symbol_int(ctx->z3_ctx, s);
+    pp->ctx->stats.num_evaluate += pp->num_evaluate;
+    pp->ctx->stats.num_fast_evaluate += pp->num_fast_evaluate;
+    if (pp->res == TIMEOUT_V)
+        pp->ctx->stats.num_timeouts++;
 
-                    if (symbol_index >= ctx->testcases.data[0].testcase_len)
-                        // it is an assignment
-                        return 0;
+    pthread_mutex_destroy(&pp->lock);
+    free(pp->filter);
+    free(pp->start_input);
+    return pp->res;
+}
 
-                    if (ig->n >= MAX_GROUP_SIZE) {
-                        res = 0;
-                        break;
-                    }
+// the timer (or a stop request) ends the phase for every worker
+static int __parallel_phase_expired(parallel_phase_t* pp, tp_worker_t* w)
+{
+    fuzzy_ctx_t* ctx = pp->ctx;
+    if (!__atomic_load_n(&stop_requested, __ATOMIC_RELAXED) &&
+        (ctx->timer == NULL || !check_timer(ctx->timer)))
+        return 0;
 
-                    int      already_in = 0;
-                    unsigned i;
-                    for (i = 0; i < ig->n; ++i) {
-                        if (ig->indexes[i] == symbol_index)
-                            already_in = 1;
-                    }
+    pthread_mutex_lock(&pp->lock);
+    if (pp->res == 0)
+        pp->res = TIMEOUT_V;
+    pthread_mutex_unlock(&pp->lock);
+    thread_pool_cancel(w->pool);
+    return 1;
+}
 
-                    if (!already_in)
-                        ig->indexes[ig->n++] = symbol_index;
-
-                    res = 1;
-                    break;
-                }
-                default: {
-                    res = 0;
-                    break;
-                }
-            }
-            break;
-        }
-        case Z3_NUMERAL_AST: {
-            // uint64_t v;
-            // Z3_bool  successGet =
-            //     Z3_get_numeral_uint64(ctx->z3_ctx, node, (uint64_t*)&v);
-            // if (!successGet || v != 0)
-            //     *approx = 1;
-
-            res = 1;
-            break;
-        }
-        default: {
-            res = 0;
-            break;
+// input satisfies the branch condition
+static int __parallel_phase_check_query(parallel_phase_t* pp, tp_worker_t* w,
+                                        unsigned long* input)
+{
+    fuzzy_ctx_t* ctx = pp->ctx;
+    testcase_t*  t   = pp->testcase;
+    uint32_t     depth;
+    int          sat = 0;
+
+    pthread_mutex_lock(&pp->lock);
+    if (pp->res == 0) {
+        sat = (int)ctx->model_eval(ctx->z3_ctx, pp->query, input,
+                                   t->value_sizes, t->values_len, &depth);
+        if (__update_optimistic_solution(ctx, input, depth) && !sat)
+            __report_optimistic_solution(ctx);
+        if (sat) {
+            memcpy(tmp_input, input, sizeof(unsigned long) * t->values_len);
+            pp->res = 1;
+            thread_pool_cancel(w->pool);
         }
     }
-    return res;
+    pthread_mutex_unlock(&pp->lock);
+    return sat;
 }
 
-static void __detect_input_to_state_query(fuzzy_ctx_t* ctx, Z3_ast node,
-                                          ast_data_t* data, int constant_strict)
+static inline void
+__parallel_phase_add_stats(parallel_phase_t* pp, unsigned long num_evaluate,
+                           unsigned long num_fast_evaluate)
 {
-    Z3_ast_kind node_kind = Z3_get_ast_kind(ctx->z3_ctx, node);
-    unsigned    is_app    = node_kind == Z3_APP_AST;
+    __atomic_add_fetch(&pp->num_evaluate, num_evaluate, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&pp->num_fast_evaluate, num_fast_evaluate,
+                       __ATOMIC_RELAXED);
+}
 
-    Z3_app       node_app = is_app ? Z3_to_app(ctx->z3_ctx, node) : (Z3_app)0;
-    Z3_func_decl node_decl =
-        is_app ? Z3_get_app_decl(ctx->z3_ctx, node_app) : (Z3_func_decl)0;
-    Z3_decl_kind node_decl_kind =
-        is_app ? Z3_get_decl_kind(ctx->z3_ctx, node_decl) : (Z3_decl_kind)0;
+static unsigned long __seed_eval(fuzzy_ctx_t* ctx, Z3_ast e)
+{
+    dict__seed_eval_t* seed_eval_cache =
+        (dict__seed_eval_t*)ctx->seed_eval_cache;
+    unsigned long ast_id = Z3_get_ast_id(ctx->z3_ctx, e);
+
+    // cached ASTs are referenced, hence their ids cannot be recycled
+    seed_eval_t* cached = dict_get_ref__seed_eval_t(seed_eval_cache, ast_id);
+    if (cached != NULL) {
+        ctx->stats.seed_eval_cache_hits++;
+        return cached->value;
+    }
+
+    if (unlikely(seed_eval_cache->size > max_seed_eval_cache_size))
+        dict_remove_all__seed_eval_t(seed_eval_cache);
+
+    testcase_t* seed = &ctx->testcases.data[0];
+    seed_eval_t el;
+    el.ast.ctx = ctx->z3_ctx;
+    el.ast.ast = e;
+    el.value   = ctx->model_eval(ctx->z3_ctx, e, seed->values,
+                                 seed->value_sizes, seed->values_len, NULL);
+    Z3_inc_ref(ctx->z3_ctx, e);
+    dict_set__seed_eval_t(seed_eval_cache, ast_id, el);
+    return el.value;
+}
 
-    // condition 1 - root is a comparison (should always be the case)
-    // also, save the comparison type
-    if (!is_app) {
-        data->is_input_to_state = 0;
-        return;
-    }
+static inline int __evaluate_branch_query_on_seed(fuzzy_ctx_t* ctx,
+                                                  Z3_ast       query,
+                                                  Z3_ast branch_condition)
+{
+    // consecutive queries on the same path share most of their conjuncts:
+    // their value on the seed is cached, and only new conjuncts are evaluated
+    testcase_t* seed = &ctx->testcases.data[0];
+    if (skip_seed_eval_cache ||
+        memcmp(tmp_input, seed->values,
+               seed->values_len * sizeof(unsigned long)) != 0)
+        return __evaluate_branch_query(ctx, query, branch_condition,
+                                       tmp_input, seed->value_sizes,
+                                       seed->values_len);
 
-    unsigned is_neg;
-    unsigned op_type;
+    if (timer_check_wrapper(ctx)) {
+        ctx->stats.num_timeouts++;
+        return TIMEOUT_V;
+    }
 
-    if (node_decl_kind == Z3_OP_EQ || node_decl_kind == Z3_OP_UGEQ ||
-        node_decl_kind == Z3_OP_SGEQ || node_decl_kind == Z3_OP_ULEQ ||
-        node_decl_kind == Z3_OP_SLEQ || node_decl_kind == Z3_OP_UGT ||
-        node_decl_kind == Z3_OP_SGT || node_decl_kind == Z3_OP_ULT ||
-        node_decl_kind == Z3_OP_SLT) {
+    ctx->stats.num_evaluate++;
 
-        op_type = node_decl_kind;
-        is_neg  = 0;
-    } else if (node_decl_kind == Z3_OP_NOT) {
-        Z3_ast      child        = Z3_get_app_arg(ctx->z3_ctx, node_app, 0);
-        Z3_ast_kind child_kind   = Z3_get_ast_kind(ctx->z3_ctx, child);
-        unsigned    child_is_app = child_kind == Z3_APP_AST;
-        if (!child_is_app) {
-            data->is_input_to_state = 0;
-            return;
+    if (check_unnecessary_eval)
+        if (__check_or_add_digest(&ast_data.processed_set,
+                                  (unsigned char*)tmp_input,
+                                  ctx->n_symbols * sizeof(unsigned long))) {
+            return 0;
         }
 
-        Z3_app       child_app  = Z3_to_app(ctx->z3_ctx, child);
-        Z3_func_decl child_decl = Z3_get_app_decl(ctx->z3_ctx, child_app);
-        Z3_decl_kind child_decl_kind =
-            Z3_get_decl_kind(ctx->z3_ctx, child_decl);
-
-        node_app       = child_app;
-        node_decl      = child_decl;
-        node_decl_kind = child_decl_kind;
-        is_app         = child_is_app;
-
-        if (child_decl_kind == Z3_OP_EQ || child_decl_kind == Z3_OP_UGEQ ||
-            child_decl_kind == Z3_OP_SGEQ || child_decl_kind == Z3_OP_ULEQ ||
-            child_decl_kind == Z3_OP_SLEQ || child_decl_kind == Z3_OP_UGT ||
-            child_decl_kind == Z3_OP_SGT || child_decl_kind == Z3_OP_ULT ||
-            child_decl_kind == Z3_OP_SLT) {
+    if (!__seed_eval(ctx, branch_condition))
+        return 0;
 
-            op_type = child_decl_kind;
-            is_neg  = 1;
-        } else {
-            data->is_input_to_state = 0;
-            return;
+    Z3_app   app      = NULL;
+    unsigned num_args = 1;
+    if (Z3_get_ast_kind(ctx->z3_ctx, query) == Z3_APP_AST) {
+        Z3_app       query_app = Z3_to_app(ctx->z3_ctx, query);
+        Z3_func_decl decl      = Z3_get_app_decl(ctx->z3_ctx, query_app);
+        if (Z3_get_decl_kind(ctx->z3_ctx, decl) == Z3_OP_AND) {
+            app      = query_app;
+            num_args = Z3_get_app_num_args(ctx->z3_ctx, app);
         }
-    } else {
-        data->is_input_to_state = 0;
-        return;
     }
 
-    // condition 2 - one child is input-to-state
-    int      condition_ok = 0;
-    unsigned its_operand  = 0;
-    unsigned num_fields   = Z3_get_app_num_args(ctx->z3_ctx, node_app);
     unsigned i;
-    for (i = 0; i < num_fields; ++i) {
-        Z3_ast child = Z3_get_app_arg(ctx->z3_ctx, node_app, i);
-        Z3_inc_ref(ctx->z3_ctx, child);
-        char approx;
-        condition_ok = __detect_input_group(
-                           ctx, child, &data->input_to_state_group, &approx) &&
-                       data->input_to_state_group.n > 0;
-        Z3_dec_ref(ctx->z3_ctx, child);
-        if (condition_ok) {
-            its_operand = i;
-            break;
-        }
-    }
-
-    if (!condition_ok) {
-        data->is_input_to_state = 0;
-        return;
-    }
-
-    // The other child is a constant?
-    condition_ok           = 0;
-    unsigned const_operand = its_operand == 1 ? 0 : 1;
-    Z3_ast   other_child = Z3_get_app_arg(ctx->z3_ctx, node_app, const_operand);
-    Z3_inc_ref(ctx->z3_ctx, other_child);
-    if (Z3_get_ast_kind(ctx->z3_ctx, other_child) == Z3_NUMERAL_AST) {
-        Z3_bool successGet = Z3_get_numeral_uint64(
-            ctx->z3_ctx, other_child, (uint64_t*)&data->input_to_state_const);
-        if (successGet == Z3_FALSE) {
-            Z3_dec_ref(ctx->z3_ctx, other_child);
-            data->is_input_to_state = 0;
-            return; // constant is too big
-        }
-        condition_ok = 1;
-    }
-
-    if (!condition_ok) {
-        if (constant_strict) {
-            data->is_input_to_state = 0;
-            Z3_dec_ref(ctx->z3_ctx, other_child);
-            return;
+    for (i = 0; i < num_args; ++i) {
+        Z3_ast conjunct = app != NULL ? Z3_get_app_arg(ctx->z3_ctx, app, i)
+                                      : query;
+        if (!__seed_eval(ctx, conjunct)) {
+            // the depth is needed to rank the optimistic solution
+            uint32_t depth;
+            int      res = (int)ctx->model_eval(
+                ctx->z3_ctx, query, tmp_input, seed->value_sizes,
+                seed->values_len, &depth);
+            if (__update_optimistic_solution(ctx, tmp_input, depth) && !res)
+                __report_optimistic_solution(ctx);
+            return res != 0 ? 1 : 0;
         }
-        // Not a constant, lets evaluate the AST in the current testcase...
-        testcase_t* current_testcase = &ctx->testcases.data[0];
-
-        data->input_to_state_const = ctx->model_eval(
-            ctx->z3_ctx, other_child, current_testcase->values,
-            current_testcase->value_sizes, current_testcase->values_len, NULL);
-    }
-
-    Z3_dec_ref(ctx->z3_ctx, other_child);
-
-    if (is_neg && (op_type == Z3_OP_EQ || op_type == Z3_OP_UGEQ ||
-                   op_type == Z3_OP_SGEQ)) {
-        data->input_to_state_const += (const_operand == 0 ? 1 : -1);
-    } else if (is_neg && (op_type == Z3_OP_ULEQ || op_type == Z3_OP_SLEQ)) {
-        data->input_to_state_const += (const_operand == 0 ? -1 : 1);
-    } else if (!is_neg && (op_type == Z3_OP_UGT || op_type == Z3_OP_SGT)) {
-        data->input_to_state_const += (const_operand == 0 ? -1 : 1);
-    } else if (!is_neg && (op_type == Z3_OP_ULT || op_type == Z3_OP_SLT)) {
-        data->input_to_state_const += (const_operand == 1 ? -1 : 1);
     }
 
-    data->op_input_to_state = op_type;
-    data->is_input_to_state = 1;
-    return;
+    // every conjunct holds: the depth is the one model_eval would report,
+    // which ranks above any partial solution
+    __update_optimistic_solution(ctx, tmp_input, num_args);
+    return 1;
 }
 
-static void __union_ast_info(ast_info_ptr dst, ast_info_ptr src)
-{
-    index_group_t* group;
-    set_reset_iter__index_group_t(&src->index_groups, 0);
-    while (set_iter_next__index_group_t(&src->index_groups, 0, &group)) {
-        set_add__index_group_t(&dst->index_groups, *group);
-    }
+// *************************************************
+// **** HEURISTICS - POPULATE ast_data_t struct ****
+// *************************************************
 
-    ulong* p;
-    set_reset_iter__ulong(&src->indexes, 0);
-    while (set_iter_next__ulong(&src->indexes, 0, &p)) {
-        set_add__ulong(&dst->indexes, *p);
-    }
+static inline int is_bor_constraint(fuzzy_ctx_t* ctx, Z3_ast branch_condition)
+{
+    Z3_ast_kind node_kind = Z3_get_ast_kind(ctx->z3_ctx, branch_condition);
+    if (node_kind != Z3_APP_AST)
+        return 0;
 
-    unsigned long i;
-    for (i = 0; i < src->indexes_ud.size; ++i)
-        if (!da_check_el__ulong(&dst->indexes_ud, src->indexes_ud.data[i]))
-            da_add_item__ulong(&dst->indexes_ud, src->indexes_ud.data[i]);
-    for (i = 0; i < src->index_groups_ud.size; ++i)
-        if (!da_check_el__index_group_t(&dst->index_groups_ud,
-                                        &src->index_groups_ud.data[i]))
-            da_add_item__index_group_t(&dst->index_groups_ud,
-                                       src->index_groups_ud.data[i]);
-    for (i = 0; i < src->inp_to_state_ite.size; ++i)
-        if (!da_check_el__ite_its_t(&dst->inp_to_state_ite,
-                                    &src->inp_to_state_ite.data[i]))
-            da_add_item__ite_its_t(&dst->inp_to_state_ite,
-                                   src->inp_to_state_ite.data[i]);
+    Z3_app       node_app       = Z3_to_app(ctx->z3_ctx, branch_condition);
+    Z3_func_decl node_decl      = Z3_get_app_decl(ctx->z3_ctx, node_app);
+    Z3_decl_kind node_decl_kind = Z3_get_decl_kind(ctx->z3_ctx, node_decl);
 
-    dst->input_extract_ops += src->input_extract_ops;
-    dst->linear_arithmetic_operations += src->linear_arithmetic_operations;
-    dst->nonlinear_arithmetic_operations +=
-        src->nonlinear_arithmetic_operations;
-    dst->query_size += src->query_size;
-    dst->approximated_groups += src->approximated_groups;
+    if (node_decl_kind == Z3_OP_BOR)
+        return 1;
+    return 0;
 }
 
-static void ast_info_populate_with_blacklist(ast_info_ptr dst, ast_info_ptr src,
-                                             set__ulong* blacklist)
+static inline void flatten_bor_args(fuzzy_ctx_t* ctx, Z3_ast node,
+                                    da__Z3_ast* args)
 {
-    ulong* p;
-    set_reset_iter__ulong(&src->indexes, 0);
-    while (set_iter_next__ulong(&src->indexes, 0, &p))
-        if (!set_check__ulong(blacklist, *p))
-            set_add__ulong(&dst->indexes, *p);
-
-    index_group_t* group;
-    set_reset_iter__index_group_t(&src->index_groups, 0);
-    while (set_iter_next__index_group_t(&src->index_groups, 0, &group)) {
-        char     is_ok = 1;
-        unsigned i;
-        for (i = 0; i < group->n; ++i)
-            if (set_check__ulong(blacklist, group->indexes[i])) {
-                is_ok = 0;
-                break;
-            }
+    Z3_app   app        = Z3_to_app(ctx->z3_ctx, node);
+    unsigned num_fields = Z3_get_app_num_args(ctx->z3_ctx, app);
 
-        if (is_ok)
-            set_add__index_group_t(&dst->index_groups, *group);
+    unsigned i;
+    for (i = 0; i < num_fields; ++i) {
+        Z3_ast child = Z3_get_app_arg(ctx->z3_ctx, app, i);
+        if (is_bor_constraint(ctx, child))
+            flatten_bor_args(ctx, child, args);
         else {
-            // add indexes as individual groups
-            index_group_t g;
-            for (i = 0; i < group->n; ++i)
-                if (!set_check__ulong(blacklist, group->indexes[i])) {
-                    g.n          = 1;
-                    g.indexes[0] = group->indexes[i];
-                    set_add__index_group_t(&dst->index_groups, g);
-                }
+            Z3_inc_ref(ctx->z3_ctx, child);
+            da_add_item__Z3_ast(args, child);
         }
     }
 }
 
-static inline int is_and_constraint(fuzzy_ctx_t* ctx, Z3_ast branch_condition,
-                                    int* with_not)
+static int __detect_single_byte(fuzzy_ctx_t* ctx, Z3_ast node, int* idx)
 {
-    Z3_ast_kind node_kind = Z3_get_ast_kind(ctx->z3_ctx, branch_condition);
-    if (node_kind != Z3_APP_AST)
+    if (Z3_get_ast_kind(ctx->z3_ctx, node) != Z3_APP_AST)
         return 0;
 
-    Z3_app       node_app       = Z3_to_app(ctx->z3_ctx, branch_condition);
-    Z3_func_decl node_decl      = Z3_get_app_decl(ctx->z3_ctx, node_app);
-    Z3_decl_kind node_decl_kind = Z3_get_decl_kind(ctx->z3_ctx, node_decl);
-
-    if (node_decl_kind == Z3_OP_AND) {
-        *with_not = 0;
-        return 1;
+    int          res        = 0;
+    Z3_app       app        = Z3_to_app(ctx->z3_ctx, node);
+    unsigned     num_fields = Z3_get_app_num_args(ctx->z3_ctx, app);
+    Z3_func_decl decl       = Z3_get_app_decl(ctx->z3_ctx, app);
+    Z3_decl_kind decl_kind  = Z3_get_decl_kind(ctx->z3_ctx, decl);
+    if (num_fields > 1) {
+        return 0;
     }
 
-    int is_not = 0;
-    while (node_decl_kind == Z3_OP_NOT) {
-        branch_condition = Z3_get_app_arg(ctx->z3_ctx, node_app, 0);
-        node_app         = Z3_to_app(ctx->z3_ctx, branch_condition);
-        node_decl        = Z3_get_app_decl(ctx->z3_ctx, node_app);
-        node_decl_kind   = Z3_get_decl_kind(ctx->z3_ctx, node_decl);
-        is_not           = !is_not;
-    }
-    if (is_not && node_decl_kind == Z3_OP_OR) {
-        *with_not = 1;
-        return 1;
+    switch (decl_kind) {
+        case Z3_OP_EXTRACT:
+        case Z3_OP_ZERO_EXT:
+        case Z3_OP_SIGN_EXT: {
+            Z3_ast child = Z3_get_app_arg(ctx->z3_ctx, app, 0);
+            res          = __detect_single_byte(ctx, child, idx);
+            break;
+        }
+        case Z3_OP_UNINTERPRETED: {
+            Z3_symbol s            = Z3_get_decl_name(ctx->z3_ctx, decl);
+            int       symbol_index = Z3_get_symbol_int(ctx->z3_ctx, s);
+            if (symbol_index >= ctx->testcases.data[0].testcase_len)
+                // it is an assignment
+                res = 0;
+            else {
+                *idx = symbol_index;
+                res  = 1;
+            }
+            break;
+        }
+        default:
+            break;
     }
-
-    return 0;
+    return res;
 }
 
-static inline void flatten_and_args(fuzzy_ctx_t* ctx, Z3_ast node,
-                                    da__Z3_ast* args)
+static int __detect_concat_shift(fuzzy_ctx_t* ctx, Z3_ast node, int* s_idx,
+                                 int* pos)
 {
+    if (Z3_get_ast_kind(ctx->z3_ctx, node) != Z3_APP_AST)
+        return 0;
+
     Z3_app       app        = Z3_to_app(ctx->z3_ctx, node);
     unsigned     num_fields = Z3_get_app_num_args(ctx->z3_ctx, app);
     Z3_func_decl decl       = Z3_get_app_decl(ctx->z3_ctx, app);
     Z3_decl_kind decl_kind  = Z3_get_decl_kind(ctx->z3_ctx, decl);
 
-    int negated = 0;
-    if (decl_kind != Z3_OP_AND) {
-        int is_not = 0;
-        while (decl_kind == Z3_OP_NOT) {
-            node      = Z3_get_app_arg(ctx->z3_ctx, app, 0);
-            app       = Z3_to_app(ctx->z3_ctx, node);
-            decl      = Z3_get_app_decl(ctx->z3_ctx, app);
-            decl_kind = Z3_get_decl_kind(ctx->z3_ctx, decl);
-            is_not    = !is_not;
-        }
-        negated = is_not;
-        ASSERT_OR_ABORT(decl_kind == Z3_OP_OR,
-                        "flatten_and_args: not an and constraint");
-        num_fields = Z3_get_app_num_args(ctx->z3_ctx, app);
-    }
+    if (decl_kind != Z3_OP_CONCAT) {
+        int idx;
+        if (!__detect_single_byte(ctx, node, &idx))
+            return 0;
 
-    int      with_not;
-    unsigned i;
-    for (i = 0; i < num_fields; ++i) {
-        Z3_ast child = Z3_get_app_arg(ctx->z3_ctx, app, i);
-        if (is_and_constraint(ctx, child, &with_not))
-            flatten_and_args(ctx, child, args);
-        else {
-            if (negated)
-                child = Z3_mk_not(ctx->z3_ctx, child);
-            Z3_inc_ref(ctx->z3_ctx, child);
-            da_add_item__Z3_ast(args, child);
-        }
+        *pos   = 0;
+        *s_idx = idx;
+        return 1;
     }
-}
 
-static inline void __detect_involved_inputs(fuzzy_ctx_t* ctx, Z3_ast v,
-                                            ast_info_ptr* data)
-{
-    // visit the AST and collect some data
-    // 1. Find "groups" of inputs involved in the AST and store them in
-    // 'index_queue'
-    // 2. Populate global 'indexes' with encountered indexes
+    if (num_fields != 2)
+        return 0;
 
-    unsigned long       ast_hash = Z3_UNIQUE(ctx->z3_ctx, v);
-    dict__ast_info_ptr* ast_info_cache =
-        (dict__ast_info_ptr*)ctx->ast_info_cache;
-    ast_info_ptr* cached_el;
-    if ((cached_el = dict_get_ref__ast_info_ptr(ast_info_cache, ast_hash)) !=
-        NULL) {
-        ctx->stats.ast_info_cache_hits++;
-        *data = *cached_el;
-        return;
+    *s_idx = -1;
+    *pos   = -1;
+
+    Z3_ast child_sx = Z3_get_app_arg(ctx->z3_ctx, app, 0);
+    Z3_inc_ref(ctx->z3_ctx, child_sx);
+    int idx;
+    if (__detect_single_byte(ctx, child_sx, &idx)) {
+        *s_idx = idx;
+    } else {
+        Z3_dec_ref(ctx->z3_ctx, child_sx);
+        return 0;
     }
-    ast_info_ptr new_el = (ast_info_ptr)malloc(sizeof(ast_info_t));
-    ast_info_init(new_el);
+    Z3_dec_ref(ctx->z3_ctx, child_sx);
 
-    switch (Z3_get_ast_kind(ctx->z3_ctx, v)) {
-        case Z3_NUMERAL_AST: {
-            new_el->query_size++;
-            break;
+    Z3_ast child_dx = Z3_get_app_arg(ctx->z3_ctx, app, 1);
+    Z3_inc_ref(ctx->z3_ctx, child_dx);
+    if (Z3_get_ast_kind(ctx->z3_ctx, child_dx) == Z3_NUMERAL_AST) {
+        *pos = Z3_get_bv_sort_size(ctx->z3_ctx,
+                                   Z3_get_sort(ctx->z3_ctx, child_dx));
+        if (*pos % 8 != 0) {
+            Z3_dec_ref(ctx->z3_ctx, child_dx);
+            return 0;
         }
+        *pos /= 8;
+    } else {
+        Z3_dec_ref(ctx->z3_ctx, child_dx);
+        return 0;
+    }
+    Z3_dec_ref(ctx->z3_ctx, child_dx);
+
+    return 1;
+}
+
+static int __detect_input_group(fuzzy_ctx_t* ctx, Z3_ast node,
+                                index_group_t* ig, char* approx)
+{
+    int res;
+    switch (Z3_get_ast_kind(ctx->z3_ctx, node)) {
         case Z3_APP_AST: {
-            new_el->query_size++;
-            unsigned     i;
-            Z3_app       app        = Z3_to_app(ctx->z3_ctx, v);
+            Z3_app       app        = Z3_to_app(ctx->z3_ctx, node);
             unsigned     num_fields = Z3_get_app_num_args(ctx->z3_ctx, app);
             Z3_func_decl decl       = Z3_get_app_decl(ctx->z3_ctx, app);
             Z3_decl_kind decl_kind  = Z3_get_decl_kind(ctx->z3_ctx, decl);
-
+            unsigned     i;
             switch (decl_kind) {
-                case Z3_OP_EXTRACT:
-                case Z3_OP_BAND:
-                case Z3_OP_BADD:
-                case Z3_OP_BOR:
-                case Z3_OP_CONCAT: {
-                    index_group_t group  = {0};
-                    char          approx = 0;
-                    if (__detect_input_group(ctx, v, &group, &approx) &&
-                        group.n > 0) {
-                        new_el->approximated_groups += approx;
-                        // concat chain. commit
-                        unsigned i, at_least_one = 0;
-                        for (i = 0; i < group.n; ++i)
-                            if (!set_check__ulong(
-                                    (set__ulong*)ctx->univocally_defined_inputs,
-                                    group.indexes[i])) {
-                                set_add__ulong(&new_el->indexes,
-                                               group.indexes[i]);
-                                at_least_one = 1;
-                            } else if (!da_check_el__ulong(
-                                           &new_el->indexes_ud,
-                                           group.indexes[i])) { // linear check,
-                                                                // but it
-                                                                // should
-                                                                // be small...
-                                da_add_item__ulong(&new_el->indexes_ud,
-                                                   group.indexes[i]);
-                            }
+                case Z3_OP_EXTRACT: {
+#ifdef DEBUG_DETECT_GROUP
+                    Z3FUZZ_LOG("DETECT_GROUP [Z3_OP_EXTRACT]\n");
+#endif
 
-                        if (at_least_one)
-                            set_add__index_group_t(&new_el->index_groups,
-                                                   group);
-                        else if (!da_check_el__index_group_t(
-                                     &new_el->index_groups_ud,
-                                     &group)) // linear check, but it should be
-                                              // small...
-                            da_add_item__index_group_t(&new_el->index_groups_ud,
-                                                       group);
+                    int prev_n = ig->n;
 
-                        goto FUN_END;
-                    } else {
-                        if (decl_kind == Z3_OP_EXTRACT ||
-                            decl_kind == Z3_OP_BAND)
-                            // extract op not within a group. Take note
-                            new_el->input_extract_ops++;
-                    }
-                    break;
-                }
-                case Z3_OP_UNINTERPRETED: {
-                    index_group_t group = {0};
-                    Z3_symbol     s     = Z3_get_decl_name(ctx->z3_ctx, decl);
-                    int symbol_index    = Z3_get_symbol_int(ctx->z3_ctx, s);
+                    unsigned long hig =
+                        Z3_get_decl_int_parameter(ctx->z3_ctx, decl, 0);
+                    unsigned long low =
+                        Z3_get_decl_int_parameter(ctx->z3_ctx, decl, 1);
+#ifdef DEBUG_DETECT_GROUP
+                    Z3FUZZ_LOG("hig: %lu, low: %lu, prev_n: %d\n", hig, low,
+                               prev_n);
+#endif
+                    if (hig + 1 % 8 != 0 || low % 8 != 0)
+                        *approx = 1;
 
-                    if (symbol_index >= ctx->testcases.data[0].testcase_len) {
-                        // the symbol is indeed an assignment. Resolve the
-                        // assignment
-                        ast_info_ptr tmp;
-                        __detect_involved_inputs(
-                            ctx, ctx->assignments[symbol_index], &tmp);
-                        __union_ast_info(new_el, tmp);
+                    // recursive call
+                    Z3_ast child = Z3_get_app_arg(ctx->z3_ctx, app, 0);
+                    Z3_inc_ref(ctx->z3_ctx, child);
+                    res = __detect_input_group(ctx, child, ig, approx);
+                    Z3_dec_ref(ctx->z3_ctx, child);
+                    if (res == 0)
+                        break;
+
+                    int next_n = ig->n;
+#ifdef DEBUG_DETECT_GROUP
+                    Z3FUZZ_LOG("next_n: %d\n", next_n);
+                    for (i = 0; i < ig->n; ++i)
+                        Z3FUZZ_LOG(" @ ig->indexes[%u] = 0x%lx\n", i,
+                                   ig->indexes[i]);
+#endif
+
+                    unsigned bv_width = next_n - prev_n;
+                    if (bv_width < hig / 8 + 1) {
+                        res = 0;
                         break;
                     }
 
-                    group.indexes[group.n++] = symbol_index;
+                    // spill in tmp (little endian)
+                    unsigned long tmp[bv_width];
+                    for (i = 0; i < bv_width; ++i)
+                        tmp[i] = ig->indexes[next_n - i - 1];
 
-                    if (!set_check__ulong(
-                            (set__ulong*)ctx->univocally_defined_inputs,
-                            symbol_index)) {
-                        set_add__index_group_t(&new_el->index_groups, group);
-                        set_add__ulong(&new_el->indexes, symbol_index);
-                    } else if (!da_check_el__ulong(
-                                   &new_el->indexes_ud,
-                                   symbol_index)) { // linear check, but it
-                                                    // should
-                                                    // be small...
-                        da_add_item__ulong(&new_el->indexes_ud, symbol_index);
-                        da_add_item__index_group_t(&new_el->index_groups_ud,
-                                                   group);
+                    // move tmp to: ig->indexes + prev_n
+                    for (i = low / 8; i <= hig / 8; ++i) {
+                        ASSERT_OR_ABORT(i < bv_width, "extract overflow");
+                        ig->indexes[prev_n++] = tmp[i];
                     }
-                    goto FUN_END;
-                }
-                case Z3_OP_BLSHR:
-                case Z3_OP_BASHR:
-                case Z3_OP_BUDIV0:
-                case Z3_OP_BUDIV:
-                case Z3_OP_BUDIV_I:
-                case Z3_OP_BSDIV0:
-                case Z3_OP_BSDIV:
-                case Z3_OP_BSDIV_I:
-                case Z3_OP_BUREM:
-                case Z3_OP_BUREM_I:
-                case Z3_OP_BSREM:
-                case Z3_OP_BSREM_I:
-                case Z3_OP_BSMOD: {
-                    new_el->input_extract_ops++;
+                    ig->n = prev_n;
+
+#ifdef DEBUG_DETECT_GROUP
+                    for (i = 0; i < ig->n; ++i)
+                        Z3FUZZ_LOG(" > ig->indexes[%u] = 0x%lx\n", i,
+                                   ig->indexes[i]);
+#endif
                     break;
                 }
-                case Z3_OP_ITE: {
-                    // look in ite condition
-                    Z3_ast cond = Z3_get_app_arg(ctx->z3_ctx, app, 0);
-                    Z3_inc_ref(ctx->z3_ctx, cond);
-                    da__Z3_ast and_vals;
-                    da_init__Z3_ast(&and_vals);
-                    int with_not;
-                    if (is_and_constraint(ctx, cond, &with_not))
-                        flatten_and_args(ctx, cond, &and_vals);
-                    else {
-                        Z3_inc_ref(ctx->z3_ctx, cond);
-                        da_add_item__Z3_ast(&and_vals, cond);
+                case Z3_OP_BAND: {
+#ifdef DEBUG_DETECT_GROUP
+                    Z3FUZZ_LOG("DETECT_GROUP [Z3_OP_BAND]\n");
+#endif
+                    // check if one of the two is a constant
+                    // recursive call as before
+                    if (num_fields != 2) {
+                        res = 0;
+                        break;
                     }
 
-                    unsigned i;
-                    for (i = 0; i < and_vals.size; ++i) {
-                        ast_data_t tmp = {0};
-                        __detect_input_to_state_query(ctx, and_vals.data[i],
-                                                      &tmp, 1);
-                        if (tmp.is_input_to_state) {
-                            ite_its_t its_el = {.ig = tmp.input_to_state_group,
-                                                .val =
-                                                    tmp.input_to_state_const};
-                            da_add_item__ite_its_t(&new_el->inp_to_state_ite,
-                                                   its_el);
+                    Z3_ast child_1 = Z3_get_app_arg(ctx->z3_ctx, app, 0);
+                    Z3_inc_ref(ctx->z3_ctx, child_1);
+
+                    Z3_ast child_2 = Z3_get_app_arg(ctx->z3_ctx, app, 1);
+                    Z3_inc_ref(ctx->z3_ctx, child_2);
+
+                    Z3_ast        subexpr = NULL;
+                    unsigned long mask;
+                    if (Z3_get_ast_kind(ctx->z3_ctx, child_1) ==
+                        Z3_NUMERAL_AST) {
+                        Z3_bool successGet = Z3_get_numeral_uint64(
+                            ctx->z3_ctx, child_1, (uint64_t*)&mask);
+                        if (successGet == Z3_FALSE) {
+                            res = 0;
+                            goto BVAND_EXIT;
                         }
-                        Z3_dec_ref(ctx->z3_ctx, and_vals.data[i]);
+                        subexpr = child_2;
+                    } else if (Z3_get_ast_kind(ctx->z3_ctx, child_2) ==
+                               Z3_NUMERAL_AST) {
+                        Z3_bool successGet = Z3_get_numeral_uint64(
+                            ctx->z3_ctx, child_2, (uint64_t*)&mask);
+                        if (successGet == Z3_FALSE) {
+                            res = 0; // constant is too big
+                            goto BVAND_EXIT;
+                        }
+                        subexpr = child_1;
+                    } else {
+                        res = 0;
+                        goto BVAND_EXIT;
+                    }
+                    if (mask == 0) {
+                        res = 0; // and with 0 -> no group, it is always 0
+                        goto BVAND_EXIT;
                     }
-                    da_free__Z3_ast(&and_vals, NULL);
-                    Z3_dec_ref(ctx->z3_ctx, cond);
-                    break;
-                }
-                default: {
-                    break;
-                }
-            }
-            if (num_fields > 0) {
-                for (i = 0; i < num_fields; i++) {
-                    Z3_ast child = Z3_get_app_arg(ctx->z3_ctx, app, i);
-                    Z3_inc_ref(ctx->z3_ctx, child);
-                    ast_info_ptr tmp;
-                    __detect_involved_inputs(ctx, child, &tmp);
-                    __union_ast_info(new_el, tmp);
-                    Z3_dec_ref(ctx->z3_ctx, child);
-                }
-            }
-            break;
-        }
-        case Z3_QUANTIFIER_AST: {
-            ASSERT_OR_ABORT(0, "__main_ast_visit() found quantifier\n");
-        }
-        default:
-            ASSERT_OR_ABORT(0, "__main_ast_visit() unknown ast kind\n");
-    }
 
-FUN_END:
-    dict_set__ast_info_ptr(ast_info_cache, ast_hash, new_el);
-    *data = new_el;
-}
+                    int prev_n = ig->n;
+#ifdef DEBUG_DETECT_GROUP
+                    Z3FUZZ_LOG("prev_n: %d\n", prev_n);
+#endif
 
-static void detect_involved_inputs_wrapper(fuzzy_ctx_t* ctx, Z3_ast v,
-                                           ast_info_ptr* data)
-{
-    __detect_involved_inputs(ctx, v, data);
-}
+                    // recursive call
+                    res = __detect_input_group(ctx, subexpr, ig, approx);
+                    if (res == 0)
+                        goto BVAND_EXIT;
 
-static void __detect_early_constants(fuzzy_ctx_t* ctx, Z3_ast v,
-                                     ast_data_t* data)
-{
-    // look for constants in early SUB/AND and in early EQ/GE/GT/LE/LT/SLE/SLT
-    unsigned long tmp_const;
-    switch (Z3_get_ast_kind(ctx->z3_ctx, v)) {
-        case Z3_APP_AST: {
-            Z3_bool      successGet;
-            Z3_ast       child1, child2;
-            Z3_app       app       = Z3_to_app(ctx->z3_ctx, v);
-            Z3_func_decl decl      = Z3_get_app_decl(ctx->z3_ctx, app);
-            Z3_decl_kind decl_kind = Z3_get_decl_kind(ctx->z3_ctx, decl);
+                    // find rightmost and leftmost set-bit of mask
+                    unsigned long low = rightmost_set_bit(mask);
+                    unsigned long hig = leftmost_set_bit(mask);
+                    if (hig + 1 % 8 != 0 || low % 8 != 0)
+                        *approx = 1;
 
-            switch (decl_kind) {
-                case Z3_OP_EXTRACT:
-                case Z3_OP_NOT: {
-                    // unary forward
-                    child1 = Z3_get_app_arg(ctx->z3_ctx, app, 0);
-                    __detect_early_constants(ctx, child1, data);
-                    break;
-                }
-                case Z3_OP_CONCAT: {
-                    child1 = Z3_get_app_arg(ctx->z3_ctx, app, 0);
-                    Z3_inc_ref(ctx->z3_ctx, child1);
-                    child2 = Z3_get_app_arg(ctx->z3_ctx, app, 1);
-                    Z3_inc_ref(ctx->z3_ctx, child2);
+                    int next_n = ig->n;
+#ifdef DEBUG_DETECT_GROUP
+                    Z3FUZZ_LOG("low: %lu, hig: %lu\n", low, hig);
+                    Z3FUZZ_LOG("next_n: %d\n", next_n);
+                    for (i = 0; i < ig->n; ++i)
+                        Z3FUZZ_LOG(" @ ig->indexes[%u] = 0x%lx\n", i,
+                                   ig->indexes[i]);
+#endif
 
-                    __detect_early_constants(ctx, child1, data);
-                    Z3_dec_ref(ctx->z3_ctx, child1);
-                    __detect_early_constants(ctx, child2, data);
-                    Z3_dec_ref(ctx->z3_ctx, child2);
-                    break;
-                }
-                case Z3_OP_OR:
-                case Z3_OP_AND: {
-                    unsigned num_fields = Z3_get_app_num_args(ctx->z3_ctx, app);
-                    unsigned i          = 0;
-                    for (i = 0; i < num_fields; ++i) {
-                        Z3_ast child = Z3_get_app_arg(ctx->z3_ctx, app, i);
-                        Z3_inc_ref(ctx->z3_ctx, child);
-                        __detect_early_constants(ctx, child, data);
-                        Z3_dec_ref(ctx->z3_ctx, child);
+                    unsigned bv_width = next_n - prev_n;
+                    if (bv_width < hig / 8 + 1) {
+                        res = 0;
+                        goto BVAND_EXIT;
+                    }
+
+                    // spill in tmp (little endian)
+                    unsigned long* tmp = (unsigned long*)malloc(
+                        sizeof(unsigned long) * bv_width);
+                    for (i = 0; i < bv_width; ++i)
+                        tmp[i] = ig->indexes[next_n - i - 1];
+
+                    // move tmp to: ig->indexes + prev_n
+                    for (i = low / 8; i <= hig / 8; ++i) {
+                        ASSERT_OR_ABORT(i < bv_width, "extract overflow");
+                        ig->indexes[prev_n++] = tmp[i];
                     }
+                    ig->n = prev_n;
+
+#ifdef DEBUG_DETECT_GROUP
+                    for (i = 0; i < ig->n; ++i)
+                        Z3FUZZ_LOG(" > ig->indexes[%u] = 0x%lx\n", i,
+                                   ig->indexes[i]);
+#endif
+                    free(tmp);
+
+                BVAND_EXIT:
+                    Z3_dec_ref(ctx->z3_ctx, child_1);
+                    Z3_dec_ref(ctx->z3_ctx, child_2);
                     break;
                 }
-                case Z3_OP_EQ:
-                case Z3_OP_UGEQ:
-                case Z3_OP_SGEQ:
-                case Z3_OP_UGT:
-                case Z3_OP_SGT:
-                case Z3_OP_ULEQ:
-                case Z3_OP_ULT:
-                case Z3_OP_SLT:
-                case Z3_OP_SLEQ: {
-                    child1 = Z3_get_app_arg(ctx->z3_ctx, app, 0);
-                    Z3_inc_ref(ctx->z3_ctx, child1);
-                    child2 = Z3_get_app_arg(ctx->z3_ctx, app, 1);
-                    Z3_inc_ref(ctx->z3_ctx, child2);
+                case Z3_OP_BADD:
+                case Z3_OP_BOR: {
+                    // detect if is an OR/ADD of BSHL
+#ifdef DEBUG_DETECT_GROUP
+                    Z3FUZZ_LOG("DETECT_GROUP [Z3_OP_BADD/Z3_OP_BOR]\n");
+#endif
 
-                    if (Z3_get_ast_kind(ctx->z3_ctx, child1) ==
-                        Z3_NUMERAL_AST) {
-                        successGet = Z3_get_numeral_uint64(
-                            ctx->z3_ctx, child1, (uint64_t*)&tmp_const);
-                        if (successGet == Z3_FALSE)
-                            break; // constant bigger than 64
-                        da_add_item__ulong(&data->values, tmp_const);
-                        da_add_item__ulong(&data->values, tmp_const + 1);
-                        da_add_item__ulong(&data->values, tmp_const - 1);
-                    } else if (Z3_get_ast_kind(ctx->z3_ctx, child2) ==
-                               Z3_NUMERAL_AST) {
-                        successGet = Z3_get_numeral_uint64(
-                            ctx->z3_ctx, child2, (uint64_t*)&tmp_const);
-                        if (successGet == Z3_FALSE)
-                            break; // constant bigger than 64
-                        da_add_item__ulong(&data->values, tmp_const);
-                        da_add_item__ulong(&data->values, tmp_const + 1);
-                        da_add_item__ulong(&data->values, tmp_const - 1);
+                    if (decl_kind == Z3_OP_BOR) {
+
+                        da__Z3_ast args;
+                        da_init__Z3_ast(&args);
+                        flatten_bor_args(ctx, node, &args);
+
+                        int found_concat_shifts = 1;
+                        int n_tmp_inps          = 0;
+                        int tmp_inps[8]         = {-1, -1, -1, -1, -1, -1, -1};
+                        for (i = 0; i < args.size; ++i) {
+                            if (i >= 8) {
+                                found_concat_shifts = 0;
+                                break;
+                            }
+                            Z3_ast child = args.data[i];
+
+                            int symb_idx, pos;
+                            if (!__detect_concat_shift(ctx, child, &symb_idx,
+                                                       &pos)) {
+                                found_concat_shifts = 0;
+                                break;
+                            }
+
+                            if (tmp_inps[pos] != -1) {
+                                found_concat_shifts = 0;
+                                break;
+                            }
+
+                            tmp_inps[pos] = symb_idx;
+                            n_tmp_inps++;
+                        }
+                        for (i = 0; i < args.size; ++i)
+                            Z3_dec_ref(ctx->z3_ctx, args.data[i]);
+                        da_free__Z3_ast(&args, NULL);
+
+                        if (found_concat_shifts) {
+                            for (i = 0; i < 8; ++i) {
+                                if (ig->n >= MAX_GROUP_SIZE) {
+                                    res = 0;
+                                    break;
+                                }
+                                if (tmp_inps[i] == -1)
+                                    break;
+                                ig->indexes[ig->n++] = tmp_inps[i];
+                            }
+                            if (i != n_tmp_inps) {
+                                res = 0;
+                                break;
+                            }
+                            // invert group!
+                            for (i = 0; i < n_tmp_inps; ++i)
+                                ig->indexes[i] = tmp_inps[n_tmp_inps - i - 1];
+#ifdef DEBUG_DETECT_GROUP
+                            Z3FUZZ_LOG("Detected with detect concat shift the "
+                                       "group:\n");
+                            print_index_group(ig);
+#endif
+                            res = 1;
+                            break;
+                        }
+                    }
+
+                    res                            = 0;
+                    unsigned long shift_mask       = 0;
+                    int           op_without_shift = 0;
+                    for (i = 0; i < num_fields; ++i) {
+                        Z3_ast child = Z3_get_app_arg(ctx->z3_ctx, app, i);
+                        if (Z3_get_ast_kind(ctx->z3_ctx, child) == Z3_APP_AST) {
+                            Z3_app child_app = Z3_to_app(ctx->z3_ctx, child);
+                            Z3_func_decl child_decl =
+                                Z3_get_app_decl(ctx->z3_ctx, child_app);
+                            if (Z3_get_decl_kind(ctx->z3_ctx, child_decl) ==
+                                Z3_OP_BSHL) {
+#ifdef DEBUG_DETECT_GROUP
+                                Z3FUZZ_LOG("> shift\n");
+#endif
+                                unsigned long shift_val = 0;
+
+                                Z3_ast child_1 =
+                                    Z3_get_app_arg(ctx->z3_ctx, child_app, 0);
+                                Z3_inc_ref(ctx->z3_ctx, child_1);
+
+                                Z3_ast child_2 =
+                                    Z3_get_app_arg(ctx->z3_ctx, child_app, 1);
+                                Z3_inc_ref(ctx->z3_ctx, child_2);
+
+                                Z3_ast subexpr = NULL;
+                                if (Z3_get_ast_kind(ctx->z3_ctx, child_2) ==
+                                    Z3_NUMERAL_AST) {
+                                    Z3_bool successGet = Z3_get_numeral_uint64(
+                                        ctx->z3_ctx, child_2,
+                                        (uint64_t*)&shift_val);
+                                    if (!successGet)
+                                        res = 0; // constant is too big
+                                    else {
+                                        subexpr = child_1;
+                                        res     = 1;
+                                    }
+                                } else
+                                    res = 0;
+
+                                if (!res) {
+                                    Z3_dec_ref(ctx->z3_ctx, child_1);
+                                    Z3_dec_ref(ctx->z3_ctx, child_2);
+                                    break;
+                                }
+
+#ifdef DEBUG_DETECT_GROUP
+                                Z3FUZZ_LOG("> shift val: 0x%016lx\n",
+                                           shift_val);
+#endif
+
+                                unsigned char prev_n = ig->n;
+                                res = __detect_input_group(ctx, subexpr, ig,
+                                                           approx);
+                                if (ig->n == prev_n) {
+                                    res = 0;
+                                    Z3_dec_ref(ctx->z3_ctx, child_1);
+                                    Z3_dec_ref(ctx->z3_ctx, child_2);
+                                    break;
+                                }
+                                // TODO: fix this. `Concat(k!0, 0x00) << 8` <-
+                                // mispredicted
+                                unsigned long curr_mask =
+                                    (2UL << ((ig->n - prev_n) * 8 - 1)) - 1;
+                                if (((curr_mask << shift_val) & shift_mask) !=
+                                    0) {
+                                    res = 0;
+                                    Z3_dec_ref(ctx->z3_ctx, child_1);
+                                    Z3_dec_ref(ctx->z3_ctx, child_2);
+                                    break;
+                                }
+                                shift_mask |= curr_mask << shift_val;
+
+                                Z3_dec_ref(ctx->z3_ctx, child_1);
+                                Z3_dec_ref(ctx->z3_ctx, child_2);
+
+                                if (!res)
+                                    break;
+#ifdef DEBUG_DETECT_GROUP
+                                Z3FUZZ_LOG("> shift OK\n");
+#endif
+                                continue;
+                            }
+                        }
+                        if (!op_without_shift)
+                            op_without_shift = 1;
+                        else {
+                            res = 0;
+                            break;
+                        }
+#ifdef DEBUG_DETECT_GROUP
+                        Z3FUZZ_LOG("> op != shift\n");
+#endif
+                        res = __detect_input_group(ctx, child, ig, approx);
+                        if (!res)
+                            break;
+#ifdef DEBUG_DETECT_GROUP
+                        Z3FUZZ_LOG("> op != shift OK\n");
+#endif
+                    }
+
+                    break;
+                }
+                case Z3_OP_CONCAT: {
+                    // recursive call
+                    int found_inp = 0;
+                    res           = 0;
+                    for (i = 0; i < num_fields; ++i) {
+                        Z3_ast child = Z3_get_app_arg(ctx->z3_ctx, app, i);
+                        Z3_inc_ref(ctx->z3_ctx, child);
+                        Z3_ast_kind child_kind =
+                            Z3_get_ast_kind(ctx->z3_ctx, child);
+                        if (child_kind != Z3_NUMERAL_AST)
+                            found_inp = 1;
+                        else if (child_kind == Z3_NUMERAL_AST && found_inp)
+                            // the group is shifted...
+                            *approx = 1;
+
+                        if (child_kind == Z3_NUMERAL_AST) {
+                            Z3_dec_ref(ctx->z3_ctx, child);
+                            continue;
+                        }
+
+                        res = __detect_input_group(ctx, child, ig, approx);
+                        Z3_dec_ref(ctx->z3_ctx, child);
+                        if (res == 0)
+                            break;
+                    }
+                    break;
+                }
+                case Z3_OP_UNINTERPRETED: {
+                    Z3_symbol s = Z3_get_decl_name(ctx->z3_ctx, decl);
+                    unsigned  symbol_index =
+                        (unsigned)Z3_get_symbol_int(ctx->z3_ctx, s);
+
+                    if (symbol_index >= ctx->testcases.data[0].testcase_len)
+                        // it is an assignment
+                        return 0;
+
+                    if (ig->n >= MAX_GROUP_SIZE) {
+                        res = 0;
+                        break;
+                    }
+
+                    int      already_in = 0;
+                    unsigned i;
+                    for (i = 0; i < ig->n; ++i) {
+                        if (ig->indexes[i] == symbol_index)
+                            already_in = 1;
                     }
 
-                    // binary forward
-                    __detect_early_constants(ctx, child1, data);
-                    Z3_dec_ref(ctx->z3_ctx, child1);
-                    __detect_early_constants(ctx, child2, data);
-                    Z3_dec_ref(ctx->z3_ctx, child2);
-                    break;
-                }
-                case Z3_OP_BSUB:
-                case Z3_OP_BADD:
-                case Z3_OP_BAND: {
-                    // look for constant
-                    child1 = Z3_get_app_arg(ctx->z3_ctx, app, 0);
-                    Z3_inc_ref(ctx->z3_ctx, child1);
-                    child2 = Z3_get_app_arg(ctx->z3_ctx, app, 1);
-                    Z3_inc_ref(ctx->z3_ctx, child2);
+                    if (!already_in)
+                        ig->indexes[ig->n++] = symbol_index;
+
+                    res = 1;
+                    break;
+                }
+                default: {
+                    res = 0;
+                    break;
+                }
+            }
+            break;
+        }
+        case Z3_NUMERAL_AST: {
+            // uint64_t v;
+            // Z3_bool  successGet =
+            //     Z3_get_numeral_uint64(ctx->z3_ctx, node, (uint64_t*)&v);
+            // if (!successGet || v != 0)
+            //     *approx = 1;
+
+            res = 1;
+            break;
+        }
+        default: {
+            res = 0;
+            break;
+        }
+    }
+    return res;
+}
+
+static void __detect_input_to_state_query(fuzzy_ctx_t* ctx, Z3_ast node,
+                                          ast_data_t* data, int constant_strict)
+{
+    Z3_ast_kind node_kind = Z3_get_ast_kind(ctx->z3_ctx, node);
+    unsigned    is_app    = node_kind == Z3_APP_AST;
+
+    Z3_app       node_app = is_app ? Z3_to_app(ctx->z3_ctx, node) : (Z3_app)0;
+    Z3_func_decl node_decl =
+        is_app ? Z3_get_app_decl(ctx->z3_ctx, node_app) : (Z3_func_decl)0;
+    Z3_decl_kind node_decl_kind =
+        is_app ? Z3_get_decl_kind(ctx->z3_ctx, node_decl) : (Z3_decl_kind)0;
+
+    // condition 1 - root is a comparison (should always be the case)
+    // also, save the comparison type
+    if (!is_app) {
+        data->is_input_to_state = 0;
+        return;
+    }
+
+    unsigned is_neg;
+    unsigned op_type;
+
+    if (node_decl_kind == Z3_OP_EQ || node_decl_kind == Z3_OP_UGEQ ||
+        node_decl_kind == Z3_OP_SGEQ || node_decl_kind == Z3_OP_ULEQ ||
+        node_decl_kind == Z3_OP_SLEQ || node_decl_kind == Z3_OP_UGT ||
+        node_decl_kind == Z3_OP_SGT || node_decl_kind == Z3_OP_ULT ||
+        node_decl_kind == Z3_OP_SLT) {
+
+        op_type = node_decl_kind;
+        is_neg  = 0;
+    } else if (node_decl_kind == Z3_OP_NOT) {
+        Z3_ast      child        = Z3_get_app_arg(ctx->z3_ctx, node_app, 0);
+        Z3_ast_kind child_kind   = Z3_get_ast_kind(ctx->z3_ctx, child);
+        unsigned    child_is_app = child_kind == Z3_APP_AST;
+        if (!child_is_app) {
+            data->is_input_to_state = 0;
+            return;
+        }
+
+        Z3_app       child_app  = Z3_to_app(ctx->z3_ctx, child);
+        Z3_func_decl child_decl = Z3_get_app_decl(ctx->z3_ctx, child_app);
+        Z3_decl_kind child_decl_kind =
+            Z3_get_decl_kind(ctx->z3_ctx, child_decl);
+
+        node_app       = child_app;
+        node_decl      = child_decl;
+        node_decl_kind = child_decl_kind;
+        is_app         = child_is_app;
+
+        if (child_decl_kind == Z3_OP_EQ || child_decl_kind == Z3_OP_UGEQ ||
+            child_decl_kind == Z3_OP_SGEQ || child_decl_kind == Z3_OP_ULEQ ||
+            child_decl_kind == Z3_OP_SLEQ || child_decl_kind == Z3_OP_UGT ||
+            child_decl_kind == Z3_OP_SGT || child_decl_kind == Z3_OP_ULT ||
+            child_decl_kind == Z3_OP_SLT) {
+
+            op_type = child_decl_kind;
+            is_neg  = 1;
+        } else {
+            data->is_input_to_state = 0;
+            return;
+        }
+    } else {
+        data->is_input_to_state = 0;
+        return;
+    }
+
+    // condition 2 - one child is input-to-state
+    int      condition_ok = 0;
+    unsigned its_operand  = 0;
+    unsigned num_fields   = Z3_get_app_num_args(ctx->z3_ctx, node_app);
+    unsigned i;
+    for (i = 0; i < num_fields; ++i) {
+        Z3_ast child = Z3_get_app_arg(ctx->z3_ctx, node_app, i);
+        Z3_inc_ref(ctx->z3_ctx, child);
+        char approx;
+        condition_ok = __detect_input_group(
+                           ctx, child, &data->input_to_state_group, &approx) &&
+                       data->input_to_state_group.n > 0;
+        Z3_dec_ref(ctx->z3_ctx, child);
+        if (condition_ok) {
+            its_operand = i;
+            break;
+        }
+    }
+
+    if (!condition_ok) {
+        data->is_input_to_state = 0;
+        return;
+    }
+
+    // The other child is a constant?
+    condition_ok           = 0;
+    unsigned const_operand = its_operand == 1 ? 0 : 1;
+    Z3_ast   other_child = Z3_get_app_arg(ctx->z3_ctx, node_app, const_operand);
+    Z3_inc_ref(ctx->z3_ctx, other_child);
+    if (Z3_get_ast_kind(ctx->z3_ctx, other_child) == Z3_NUMERAL_AST) {
+        Z3_bool successGet = Z3_get_numeral_uint64(
+            ctx->z3_ctx, other_child, (uint64_t*)&data->input_to_state_const);
+        if (successGet == Z3_FALSE) {
+            Z3_dec_ref(ctx->z3_ctx, other_child);
+            data->is_input_to_state = 0;
+            return; // constant is too big
+        }
+        condition_ok = 1;
+    }
+
+    if (!condition_ok) {
+        if (constant_strict) {
+            data->is_input_to_state = 0;
+            Z3_dec_ref(ctx->z3_ctx, other_child);
+            return;
+        }
+        // Not a constant, lets evaluate the AST in the current testcase...
+        testcase_t* current_testcase = &ctx->testcases.data[0];
+
+        data->input_to_state_const = ctx->model_eval(
+            ctx->z3_ctx, other_child, current_testcase->values,
+            current_testcase->value_sizes, current_testcase->values_len, NULL);
+    }
+
+    Z3_dec_ref(ctx->z3_ctx, other_child);
+
+    if (is_neg && (op_type == Z3_OP_EQ || op_type == Z3_OP_UGEQ ||
+                   op_type == Z3_OP_SGEQ)) {
+        data->input_to_state_const += (const_operand == 0 ? 1 : -1);
+    } else if (is_neg && (op_type == Z3_OP_ULEQ || op_type == Z3_OP_SLEQ)) {
+        data->input_to_state_const += (const_operand == 0 ? -1 : 1);
+    } else if (!is_neg && (op_type == Z3_OP_UGT || op_type == Z3_OP_SGT)) {
+        data->input_to_state_const += (const_operand == 0 ? -1 : 1);
+    } else if (!is_neg && (op_type == Z3_OP_ULT || op_type == Z3_OP_SLT)) {
+        data->input_to_state_const += (const_operand == 1 ? -1 : 1);
+    }
+
+    data->op_input_to_state = op_type;
+    data->is_input_to_state = 1;
+    return;
+}
+
+static void __union_ast_info(ast_info_ptr dst, ast_info_ptr src)
+{
+    index_group_t* group;
+    set_reset_iter__index_group_t(&src->index_groups, 0);
+    while (set_iter_next__index_group_t(&src->index_groups, 0, &group)) {
+        set_add__index_group_t(&dst->index_groups, *group);
+    }
+
+    ulong* p;
+    set_reset_iter__ulong(&src->indexes, 0);
+    while (set_iter_next__ulong(&src->indexes, 0, &p)) {
+        set_add__ulong(&dst->indexes, *p);
+    }
+
+    unsigned long i;
+    for (i = 0; i < src->indexes_ud.size; ++i)
+        if (!da_check_el__ulong(&dst->indexes_ud, src->indexes_ud.data[i]))
+            da_add_item__ulong(&dst->indexes_ud, src->indexes_ud.data[i]);
+    for (i = 0; i < src->index_groups_ud.size; ++i)
+        if (!da_check_el__index_group_t(&dst->index_groups_ud,
+                                        &src->index_groups_ud.data[i]))
+            da_add_item__index_group_t(&dst->index_groups_ud,
+                                       src->index_groups_ud.data[i]);
+    for (i = 0; i < src->inp_to_state_ite.size; ++i)
+        if (!da_check_el__ite_its_t(&dst->inp_to_state_ite,
+                                    &src->inp_to_state_ite.data[i]))
+            da_add_item__ite_its_t(&dst->inp_to_state_ite,
+                                   src->inp_to_state_ite.data[i]);
+
+    dst->input_extract_ops += src->input_extract_ops;
+    dst->linear_arithmetic_operations += src->linear_arithmetic_operations;
+    dst->nonlinear_arithmetic_operations +=
+        src->nonlinear_arithmetic_operations;
+    dst->query_size += src->query_size;
+    dst->approximated_groups += src->approximated_groups;
+    dst->uses_assignments |= src->uses_assignments;
+}
+
+static void ast_info_populate_with_blacklist(ast_info_ptr dst, ast_info_ptr src,
+                                             set__ulong* blacklist)
+{
+    ulong* p;
+    set_reset_iter__ulong(&src->indexes, 0);
+    while (set_iter_next__ulong(&src->indexes, 0, &p))
+        if (!set_check__ulong(blacklist, *p))
+            set_add__ulong(&dst->indexes, *p);
+
+    index_group_t* group;
+    set_reset_iter__index_group_t(&src->index_groups, 0);
+    while (set_iter_next__index_group_t(&src->index_groups, 0, &group)) {
+        char     is_ok = 1;
+        unsigned i;
+        for (i = 0; i < group->n; ++i)
+            if (set_check__ulong(blacklist, group->indexes[i])) {
+                is_ok = 0;
+                break;
+            }
+
+        if (is_ok)
+            set_add__index_group_t(&dst->index_groups, *group);
+        else {
+            // add indexes as individual groups
+            index_group_t g;
+            for (i = 0; i < group->n; ++i)
+                if (!set_check__ulong(blacklist, group->indexes[i])) {
+                    g.n          = 1;
+                    g.indexes[0] = group->indexes[i];
+                    set_add__index_group_t(&dst->index_groups, g);
+                }
+        }
+    }
+}
+
+static inline int is_and_constraint(fuzzy_ctx_t* ctx, Z3_ast branch_condition,
+                                    int* with_not)
+{
+    Z3_ast_kind node_kind = Z3_get_ast_kind(ctx->z3_ctx, branch_condition);
+    if (node_kind != Z3_APP_AST)
+        return 0;
+
+    Z3_app       node_app       = Z3_to_app(ctx->z3_ctx, branch_condition);
+    Z3_func_decl node_decl      = Z3_get_app_decl(ctx->z3_ctx, node_app);
+    Z3_decl_kind node_decl_kind = Z3_get_decl_kind(ctx->z3_ctx, node_decl);
+
+    if (node_decl_kind == Z3_OP_AND) {
+        *with_not = 0;
+        return 1;
+    }
+
+    int is_not = 0;
+    while (node_decl_kind == Z3_OP_NOT) {
+        branch_condition = Z3_get_app_arg(ctx->z3_ctx, node_app, 0);
+        node_app         = Z3_to_app(ctx->z3_ctx, branch_condition);
+        node_decl        = Z3_get_app_decl(ctx->z3_ctx, node_app);
+        node_decl_kind   = Z3_get_decl_kind(ctx->z3_ctx, node_decl);
+        is_not           = !is_not;
+    }
+    if (is_not && node_decl_kind == Z3_OP_OR) {
+        *with_not = 1;
+        return 1;
+    }
+
+    return 0;
+}
+
+static inline void flatten_and_args(fuzzy_ctx_t* ctx, Z3_ast node,
+                                    da__Z3_ast* args)
+{
+    Z3_app       app        = Z3_to_app(ctx->z3_ctx, node);
+    unsigned     num_fields = Z3_get_app_num_args(ctx->z3_ctx, app);
+    Z3_func_decl decl       = Z3_get_app_decl(ctx->z3_ctx, app);
+    Z3_decl_kind decl_kind  = Z3_get_decl_kind(ctx->z3_ctx, decl);
+
+    int negated = 0;
+    if (decl_kind != Z3_OP_AND) {
+        int is_not = 0;
+        while (decl_kind == Z3_OP_NOT) {
+            node      = Z3_get_app_arg(ctx->z3_ctx, app, 0);
+            app       = Z3_to_app(ctx->z3_ctx, node);
+            decl      = Z3_get_app_decl(ctx->z3_ctx, app);
+            decl_kind = Z3_get_decl_kind(ctx->z3_ctx, decl);
+            is_not    = !is_not;
+        }
+        negated = is_not;
+        ASSERT_OR_ABORT(decl_kind == Z3_OP_OR,
+                        "flatten_and_args: not an and constraint");
+        num_fields = Z3_get_app_num_args(ctx->z3_ctx, app);
+    }
+
+    int      with_not;
+    unsigned i;
+    for (i = 0; i < num_fields; ++i) {
+        Z3_ast child = Z3_get_app_arg(ctx->z3_ctx, app, i);
+        if (is_and_constraint(ctx, child, &with_not))
+            flatten_and_args(ctx, child, args);
+        else {
+            if (negated)
+                child = Z3_mk_not(ctx->z3_ctx, child);
+            Z3_inc_ref(ctx->z3_ctx, child);
+            da_add_item__Z3_ast(args, child);
+        }
+    }
+}
+
+static inline int __detect_involved_inputs(fuzzy_ctx_t* ctx, Z3_ast v,
+                                           ast_info_ptr* data)
+{
+    // visit the AST and collect some data
+    // 1. Find "groups" of inputs involved in the AST and store them in
+    // 'index_queue'
+    // 2. Populate global 'indexes' with encountered indexes
+    // Returns 1 if the info has been computed by the visit (i.e., it does not
+    // come from the cache)
+
+    unsigned long       ast_hash = Z3_UNIQUE(ctx->z3_ctx, v);
+    dict__ast_info_ptr* ast_info_cache =
+        (dict__ast_info_ptr*)ctx->ast_info_cache;
+    ast_info_ptr* cached_el;
+    if ((cached_el = dict_get_ref__ast_info_ptr(ast_info_cache, ast_hash)) !=
+        NULL) {
+        ctx->stats.ast_info_cache_hits++;
+        *data = *cached_el;
+        return 0;
+    }
+    ast_info_ptr new_el = (ast_info_ptr)malloc(sizeof(ast_info_t));
+    ast_info_init(new_el);
+
+
+    switch (Z3_get_ast_kind(ctx->z3_ctx, v)) {
+        case Z3_NUMERAL_AST: {
+            new_el->query_size++;
+            break;
+        }
+        case Z3_APP_AST: {
+            new_el->query_size++;
+            unsigned     i;
+            Z3_app       app        = Z3_to_app(ctx->z3_ctx, v);
+            unsigned     num_fields = Z3_get_app_num_args(ctx->z3_ctx, app);
+            Z3_func_decl decl       = Z3_get_app_decl(ctx->z3_ctx, app);
+            Z3_decl_kind decl_kind  = Z3_get_decl_kind(ctx->z3_ctx, decl);
+
+            switch (decl_kind) {
+                case Z3_OP_EXTRACT:
+                case Z3_OP_BAND:
+                case Z3_OP_BADD:
+                case Z3_OP_BOR:
+                case Z3_OP_CONCAT: {
+                    index_group_t group  = {0};
+                    char          approx = 0;
+                    if (__detect_input_group(ctx, v, &group, &approx) &&
+                        group.n > 0) {
+                        new_el->approximated_groups += approx;
+                        // concat chain. commit
+                        unsigned i, at_least_one = 0;
+                        for (i = 0; i < group.n; ++i)
+                            if (!set_check__ulong(
+                                    (set__ulong*)ctx->univocally_defined_inputs,
+                                    group.indexes[i])) {
+                                set_add__ulong(&new_el->indexes,
+                                               group.indexes[i]);
+                                at_least_one = 1;
+                            } else if (!da_check_el__ulong(
+                                           &new_el->indexes_ud,
+                                           group.indexes[i])) { // linear check,
+                                                                // but it
+                                                                // should
+                                                                // be small...
+                                da_add_item__ulong(&new_el->indexes_ud,
+                                                   group.indexes[i]);
+                            }
+
+                        if (at_least_one)
+                            set_add__index_group_t(&new_el->index_groups,
+                                                   group);
+                        else if (!da_check_el__index_group_t(
+                                     &new_el->index_groups_ud,
+                                     &group)) // linear check, but it should be
+                                              // small...
+                            da_add_item__index_group_t(&new_el->index_groups_ud,
+                                                       group);
+
+                        goto FUN_END;
+                    } else {
+                        if (decl_kind == Z3_OP_EXTRACT ||
+                            decl_kind == Z3_OP_BAND)
+                            // extract op not within a group. Take note
+                            new_el->input_extract_ops++;
+                    }
+                    break;
+                }
+                case Z3_OP_UNINTERPRETED: {
+                    index_group_t group = {0};
+                    Z3_symbol     s     = Z3_get_decl_name(ctx->z3_ctx, decl);
+                    int symbol_index    = Z3_get_symbol_int(ctx->z3_ctx, s);
+
+                    if (symbol_index >= ctx->testcases.data[0].testcase_len) {
+                        // the symbol is indeed an assignment. Resolve the
+                        // assignment
+                        ast_info_ptr tmp;
+                        __detect_involved_inputs(
+                            ctx, ctx->assignments[symbol_index], &tmp);
+                        __union_ast_info(new_el, tmp);
+                        new_el->uses_assignments = 1;
+                        break;
+                    }
+
+                    group.indexes[group.n++] = symbol_index;
+
+                    if (!set_check__ulong(
+                            (set__ulong*)ctx->univocally_defined_inputs,
+                            symbol_index)) {
+                        set_add__index_group_t(&new_el->index_groups, group);
+                        set_add__ulong(&new_el->indexes, symbol_index);
+                    } else if (!da_check_el__ulong(
+                                   &new_el->indexes_ud,
+                                   symbol_index)) { // linear check, but it
+                                                    // should
+                                                    // be small...
+                        da_add_item__ulong(&new_el->indexes_ud, symbol_index);
+                        da_add_item__index_group_t(&new_el->index_groups_ud,
+                                                   group);
+                    }
+                    goto FUN_END;
+                }
+                case Z3_OP_BLSHR:
+                case Z3_OP_BASHR:
+                case Z3_OP_BUDIV0:
+                case Z3_OP_BUDIV:
+                case Z3_OP_BUDIV_I:
+                case Z3_OP_BSDIV0:
+                case Z3_OP_BSDIV:
+                case Z3_OP_BSDIV_I:
+                case Z3_OP_BUREM:
+                case Z3_OP_BUREM_I:
+                case Z3_OP_BSREM:
+                case Z3_OP_BSREM_I:
+                case Z3_OP_BSMOD: {
+                    new_el->input_extract_ops++;
+                    break;
+                }
+                case Z3_OP_ITE: {
+                    // look in ite condition
+                    Z3_ast cond = Z3_get_app_arg(ctx->z3_ctx, app, 0);
+                    Z3_inc_ref(ctx->z3_ctx, cond);
+                    da__Z3_ast and_vals;
+                    da_init__Z3_ast(&and_vals);
+                    int with_not;
+                    if (is_and_constraint(ctx, cond, &with_not))
+                        flatten_and_args(ctx, cond, &and_vals);
+                    else {
+                        Z3_inc_ref(ctx->z3_ctx, cond);
+                        da_add_item__Z3_ast(&and_vals, cond);
+                    }
+
+                    unsigned i;
+                    for (i = 0; i < and_vals.size; ++i) {
+                        ast_data_t tmp = {0};
+                        __detect_input_to_state_query(ctx, and_vals.data[i],
+                                                      &tmp, 1);
+                        if (tmp.is_input_to_state) {
+                            ite_its_t its_el = {.ig = tmp.input_to_state_group,
+                                                .val =
+                                                    tmp.input_to_state_const};
+                            da_add_item__ite_its_t(&new_el->inp_to_state_ite,
+                                                   its_el);
+                        }
+                        Z3_dec_ref(ctx->z3_ctx, and_vals.data[i]);
+                    }
+                    da_free__Z3_ast(&and_vals, NULL);
+                    Z3_dec_ref(ctx->z3_ctx, cond);
+                    break;
+                }
+                default: {
+                    break;
+                }
+            }
+            if (num_fields > 0) {
+                for (i = 0; i < num_fields; i++) {
+                    Z3_ast child = Z3_get_app_arg(ctx->z3_ctx, app, i);
+                    Z3_inc_ref(ctx->z3_ctx, child);
+                    ast_info_ptr tmp;
+                    __detect_involved_inputs(ctx, child, &tmp);
+                    __union_ast_info(new_el, tmp);
+                    Z3_dec_ref(ctx->z3_ctx, child);
+                }
+            }
+            break;
+        }
+        case Z3_QUANTIFIER_AST: {
+            ASSERT_OR_ABORT(0, "__main_ast_visit() found quantifier\n");
+        }
+        default:
+            ASSERT_OR_ABORT(0, "__main_ast_visit() unknown ast kind\n");
+    }
+
+FUN_END:
+    dict_set__ast_info_ptr(ast_info_cache, ast_hash, new_el);
+    *data = new_el;
+    return 1;
+}
+
+static void detect_involved_inputs_wrapper(fuzzy_ctx_t* ctx, Z3_ast v,
+                                           ast_info_ptr* data)
+{
+    // only the roots go through the shared cache: publishing every
+    // intermediate node would copy its info and lock a shard for each of them
+    dict__ast_info_ptr* ast_info_cache =
+        (dict__ast_info_ptr*)ctx->ast_info_cache;
+    unsigned long ast_hash = Z3_UNIQUE(ctx->z3_ctx, v);
+    unsigned long hash     = 0;
+    if (use_shared_ast_info_cache &&
+        dict_get_ref__ast_info_ptr(ast_info_cache, ast_hash) == NULL) {
+        hash = __ast_structural_hash(ctx, v);
+        if (__shared_ast_info_lookup(ctx, hash, data)) {
+            ctx->stats.ast_info_shared_cache_hits++;
+            dict_set__ast_info_ptr(ast_info_cache, ast_hash, *data);
+            return;
+        }
+    }
+
+    if (__detect_involved_inputs(ctx, v, data) && use_shared_ast_info_cache &&
+        !(*data)->uses_assignments)
+        __shared_ast_info_publish(ctx, hash, *data);
+}
+
+static void __detect_early_constants(fuzzy_ctx_t* ctx, Z3_ast v,
+                                     ast_data_t* data)
+{
+    // look for constants in early SUB/AND and in early EQ/GE/GT/LE/LT/SLE/SLT
+    unsigned long tmp_const;
+    switch (Z3_get_ast_kind(ctx->z3_ctx, v)) {
+        case Z3_APP_AST: {
+            Z3_bool      successGet;
+            Z3_ast       child1, child2;
+            Z3_app       app       = Z3_to_app(ctx->z3_ctx, v);
+            Z3_func_decl decl      = Z3_get_app_decl(ctx->z3_ctx, app);
+            Z3_decl_kind decl_kind = Z3_get_decl_kind(ctx->z3_ctx, decl);
+
+            switch (decl_kind) {
+                case Z3_OP_EXTRACT:
+                case Z3_OP_NOT: {
+                    // unary forward
+                    child1 = Z3_get_app_arg(ctx->z3_ctx, app, 0);
+                    __detect_early_constants(ctx, child1, data);
+                    break;
+                }
+                case Z3_OP_CONCAT: {
+                    child1 = Z3_get_app_arg(ctx->z3_ctx, app, 0);
+                    Z3_inc_ref(ctx->z3_ctx, child1);
+                    child2 = Z3_get_app_arg(ctx->z3_ctx, app, 1);
+                    Z3_inc_ref(ctx->z3_ctx, child2);
+
+                    __detect_early_constants(ctx, child1, data);
+                    Z3_dec_ref(ctx->z3_ctx, child1);
+                    __detect_early_constants(ctx, child2, data);
+                    Z3_dec_ref(ctx->z3_ctx, child2);
+                    break;
+                }
+                case Z3_OP_OR:
+                case Z3_OP_AND: {
+                    unsigned num_fields = Z3_get_app_num_args(ctx->z3_ctx, app);
+                    unsigned i          = 0;
+                    for (i = 0; i < num_fields; ++i) {
+                        Z3_ast child = Z3_get_app_arg(ctx->z3_ctx, app, i);
+                        Z3_inc_ref(ctx->z3_ctx, child);
+                        __detect_early_constants(ctx, child, data);
+                        Z3_dec_ref(ctx->z3_ctx, child);
+                    }
+                    break;
+                }
+                case Z3_OP_EQ:
+                case Z3_OP_UGEQ:
+                case Z3_OP_SGEQ:
+                case Z3_OP_UGT:
+                case Z3_OP_SGT:
+                case Z3_OP_ULEQ:
+                case Z3_OP_ULT:
+                case Z3_OP_SLT:
+                case Z3_OP_SLEQ: {
+                    child1 = Z3_get_app_arg(ctx->z3_ctx, app, 0);
+                    Z3_inc_ref(ctx->z3_ctx, child1);
+                    child2 = Z3_get_app_arg(ctx->z3_ctx, app, 1);
+                    Z3_inc_ref(ctx->z3_ctx, child2);
+
+                    if (Z3_get_ast_kind(ctx->z3_ctx, child1) ==
+                        Z3_NUMERAL_AST) {
+                        successGet = Z3_get_numeral_uint64(
+                            ctx->z3_ctx, child1, (uint64_t*)&tmp_const);
+                        if (successGet == Z3_FALSE)
+                            break; // constant bigger than 64
+                        da_add_item__ulong(&data->values, tmp_const);
+                        da_add_item__ulong(&data->values, tmp_const + 1);
+                        da_add_item__ulong(&data->values, tmp_const - 1);
+                    } else if (Z3_get_ast_kind(ctx->z3_ctx, child2) ==
+                               Z3_NUMERAL_AST) {
+                        successGet = Z3_get_numeral_uint64(
+                            ctx->z3_ctx, child2, (uint64_t*)&tmp_const);
+                        if (successGet == Z3_FALSE)
+                            break; // constant bigger than 64
+                        da_add_item__ulong(&data->values, tmp_const);
+                        da_add_item__ulong(&data->values, tmp_const + 1);
+                        da_add_item__ulong(&data->values, tmp_const - 1);
+                    }
+
+                    // binary forward
+                    __detect_early_constants(ctx, child1, data);
+                    Z3_dec_ref(ctx->z3_ctx, child1);
+                    __detect_early_constants(ctx, child2, data);
+                    Z3_dec_ref(ctx->z3_ctx, child2);
+                    break;
+                }
+                case Z3_OP_BSUB:
+                case Z3_OP_BADD:
+                case Z3_OP_BAND: {
+                    // look for constant
+                    child1 = Z3_get_app_arg(ctx->z3_ctx, app, 0);
+                    Z3_inc_ref(ctx->z3_ctx, child1);
+                    child2 = Z3_get_app_arg(ctx->z3_ctx, app, 1);
+                    Z3_inc_ref(ctx->z3_ctx, child2);
+
+                    if (Z3_get_ast_kind(ctx->z3_ctx, child1) ==
+                        Z3_NUMERAL_AST) {
+                        successGet = Z3_get_numeral_uint64(
+                            ctx->z3_ctx, child1, (uint64_t*)&tmp_const);
+                        ASSERT_OR_ABORT(successGet == Z3_TRUE,
+                                        "failed to get constant");
+                        da_add_item__ulong(&data->values, tmp_const);
+                        da_add_item__ulong(&data->values, tmp_const + 1);
+                        da_add_item__ulong(&data->values, tmp_const - 1);
+                    } else if (Z3_get_ast_kind(ctx->z3_ctx, child2) ==
+                               Z3_NUMERAL_AST) {
+                        successGet = Z3_get_numeral_uint64(
+                            ctx->z3_ctx, child2, (uint64_t*)&tmp_const);
+                        ASSERT_OR_ABORT(successGet == Z3_TRUE,
+                                        "failed to get constant");
+                        da_add_item__ulong(&data->values, tmp_const);
+                        da_add_item__ulong(&data->values, tmp_const + 1);
+                        da_add_item__ulong(&data->values, tmp_const - 1);
+                    }
+                    Z3_dec_ref(ctx->z3_ctx, child1);
+                    Z3_dec_ref(ctx->z3_ctx, child2);
+                    break;
+                }
+                case Z3_OP_ITE: {
+                    // look in ite condition
+                    Z3_ast cond = Z3_get_app_arg(ctx->z3_ctx, app, 0);
+                    Z3_inc_ref(ctx->z3_ctx, cond);
+                    __detect_early_constants(ctx, cond, data);
+                    Z3_dec_ref(ctx->z3_ctx, cond);
+                    break;
+                }
+                default: {
+                    break;
+                }
+            }
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+    return;
+}
+
+static inline unsigned long get_group_value_in_tmp_input(index_group_t* group)
+{
+    unsigned long res = 0;
+    unsigned char k;
+    for (k = 0; k < group->n; ++k) {
+        unsigned long index = group->indexes[group->n - k - 1];
+        res |= tmp_input[index] << (k * 8);
+    }
+    return res;
+}
+
+static inline unsigned long
+get_group_value_in_tmp_input_inv(index_group_t* group)
+{
+    unsigned long res = 0;
+    unsigned char k;
+    for (k = 0; k < group->n; ++k) {
+        unsigned long index = group->indexes[k];
+        res |= tmp_input[index] << (k * 8);
+    }
+    return res;
+}
+
+static inline unsigned char __extract_from_long(long value, unsigned int i)
+{
+    return (value >> i * 8) & 0xff;
+}
+
+static inline void set_tmp_input_group_to_value(index_group_t* group,
+                                                uint64_t       v)
+{
+    unsigned char k;
+    for (k = 0; k < group->n; ++k) {
+        unsigned long index = group->indexes[group->n - k - 1];
+        unsigned char b     = __extract_from_long(v, k);
+        tmp_input[index]    = b;
+    }
+}
+
+static inline void set_tmp_input_group_to_value_inv(index_group_t* group,
+                                                    uint64_t       v)
+{
+    unsigned char k;
+    for (k = 0; k < group->n; ++k) {
+        unsigned long index = group->indexes[k];
+        unsigned char b     = __extract_from_long(v, k);
+        tmp_input[index]    = b;
+    }
+}
+
+static inline void restore_tmp_input_group(index_group_t* group,
+                                           unsigned long* vals)
+{
+    unsigned char k;
+    for (k = 0; k < group->n; ++k) {
+        unsigned long index = group->indexes[group->n - k - 1];
+        tmp_input[index]    = vals[index];
+    }
+}
+
+static void __put_solutions_of_current_groups_to_early_constants(
+    fuzzy_ctx_t* ctx, ast_data_t* data, ast_info_ptr curr_groups)
+{
+    index_group_t* ig;
+    set_reset_iter__index_group_t(&curr_groups->index_groups, 0);
+    while (set_iter_next__index_group_t(&curr_groups->index_groups, 0, &ig)) {
+        unsigned long val = get_group_value_in_tmp_input(ig);
+        da_add_item__ulong(&data->values, val);
+    }
+}
+
+__attribute__((unused)) static void
+__detect_all_constants(fuzzy_ctx_t* ctx, Z3_ast v, ast_data_t* data)
+{
+    switch (Z3_get_ast_kind(ctx->z3_ctx, v)) {
+        case Z3_APP_AST: {
+            Z3_app   app        = Z3_to_app(ctx->z3_ctx, v);
+            unsigned num_fields = Z3_get_app_num_args(ctx->z3_ctx, app);
+            unsigned i;
+            for (i = 0; i < num_fields; ++i) {
+                Z3_ast child = Z3_get_app_arg(ctx->z3_ctx, app, i);
+                __detect_all_constants(ctx, child, data);
+            }
+            break;
+        }
+        case Z3_NUMERAL_AST: {
+            unsigned long tmp_const;
+            Z3_bool       successGet =
+                Z3_get_numeral_uint64(ctx->z3_ctx, v, (uint64_t*)&tmp_const);
+            ASSERT_OR_ABORT(successGet == Z3_TRUE, "failed to get constant");
+            da_add_item__ulong(&data->values, tmp_const);
+            da_add_item__ulong(&data->values, tmp_const + 1);
+            da_add_item__ulong(&data->values, tmp_const - 1);
+        }
+        default: {
+            break;
+        }
+    }
+    return;
+}
+
+static inline int __check_conflicting_constraint(fuzzy_ctx_t* ctx, Z3_ast expr)
+{
+    Z3_ast_kind kind = Z3_get_ast_kind(ctx->z3_ctx, expr);
+    if (kind != Z3_APP_AST)
+        return 0;
+
+    int res = 0;
+    Z3_inc_ref(ctx->z3_ctx, expr);
+    Z3_app       app       = Z3_to_app(ctx->z3_ctx, expr);
+    Z3_func_decl decl      = Z3_get_app_decl(ctx->z3_ctx, app);
+    Z3_decl_kind decl_kind = Z3_get_decl_kind(ctx->z3_ctx, decl);
+    Z3_ast       old_expr  = expr;
+    Z3_inc_ref(ctx->z3_ctx, old_expr);
+
+    // exclude initial NOT
+    int is_not = 0;
+    while (decl_kind == Z3_OP_NOT) {
+        Z3_ast tmp_expr = Z3_get_app_arg(ctx->z3_ctx, app, 0);
+        Z3_inc_ref(ctx->z3_ctx, tmp_expr);
+        Z3_dec_ref(ctx->z3_ctx, expr);
+        expr      = tmp_expr;
+        app       = Z3_to_app(ctx->z3_ctx, expr);
+        decl      = Z3_get_app_decl(ctx->z3_ctx, app);
+        decl_kind = Z3_get_decl_kind(ctx->z3_ctx, decl);
+        is_not    = !is_not;
+    }
+
+    if (decl_kind != Z3_OP_EQ && decl_kind != Z3_OP_SLEQ &&
+        decl_kind != Z3_OP_ULEQ && decl_kind != Z3_OP_SLT &&
+        decl_kind != Z3_OP_ULT && decl_kind != Z3_OP_SGEQ &&
+        decl_kind != Z3_OP_UGEQ && decl_kind != Z3_OP_SGT &&
+        decl_kind != Z3_OP_UGT && decl_kind != Z3_OP_OR) {
+        res = 0;
+        goto OUT;
+    }
+
+    if (is_not) {
+        Z3_dec_ref(ctx->z3_ctx, expr);
+        expr = old_expr;
+        Z3_inc_ref(ctx->z3_ctx, expr);
+    }
+
+    ast_info_ptr inputs;
+    detect_involved_inputs_wrapper(ctx, expr, &inputs);
+#if 1
+    if (inputs->query_size > 1020) {
+        res = 0;
+        goto OUT;
+    }
+#endif
+
+    // Take note of groups
+    dict__conflicting_ptr* conflicting_asts =
+        (dict__conflicting_ptr*)ctx->conflicting_asts;
+
+    index_group_t* ig = NULL;
+    set_reset_iter__index_group_t(&inputs->index_groups, 0);
+    while (set_iter_next__index_group_t(&inputs->index_groups, 0, &ig)) {
+        unsigned i;
+        for (i = 0; i < ig->n; ++i)
+            add_item_to_conflicting(conflicting_asts, expr, ig->indexes[i],
+                                    ctx->z3_ctx);
+    }
+    res = 1;
+OUT:
+    Z3_dec_ref(ctx->z3_ctx, expr);
+    Z3_dec_ref(ctx->z3_ctx, old_expr);
+    return res;
+}
+
+static inline optype __find_optype(Z3_decl_kind dk, int is_const_at_right,
+                                   int has_zext)
+{
+    switch (dk) {
+        case Z3_OP_SLEQ:
+            if (is_const_at_right)
+                if (!has_zext)
+                    return OP_SLE;
+                else
+                    return OP_ULE;
+            else if (!has_zext)
+                return OP_SGE;
+            else
+                return OP_UGE;
+        case Z3_OP_ULEQ:
+            if (is_const_at_right)
+                return OP_ULE;
+            else
+                return OP_UGE;
+        case Z3_OP_SLT:
+            if (is_const_at_right)
+                if (!has_zext)
+                    return OP_SLT;
+                else
+                    return OP_ULT;
+            else if (!has_zext)
+                return OP_SGT;
+            else
+                return OP_UGT;
+        case Z3_OP_ULT:
+            if (is_const_at_right)
+                return OP_ULT;
+            else
+                return OP_UGT;
+        case Z3_OP_SGEQ:
+            if (is_const_at_right)
+                if (!has_zext)
+                    return OP_SGE;
+                else
+                    return OP_UGE;
+            else if (!has_zext)
+                return OP_SLE;
+            else
+                return OP_ULE;
+        case Z3_OP_UGEQ:
+            if (is_const_at_right)
+                return OP_UGE;
+            else
+                return OP_ULE;
+        case Z3_OP_SGT:
+            if (is_const_at_right)
+                if (!has_zext)
+                    return OP_SGT;
+                else
+                    return OP_UGT;
+            else if (!has_zext)
+                return OP_SLT;
+            else
+                return OP_ULT;
+        case Z3_OP_UGT:
+            if (is_const_at_right)
+                return OP_UGT;
+            else
+                return OP_ULT;
+        case Z3_OP_EQ:
+            return OP_EQ;
+        default:
+            break;
+    }
+    ABORT("__find_optype() unexpected Z3_decl_kind");
+}
+
+static inline int __find_child_constant(Z3_context ctx, Z3_app app,
+                                        uint64_t* constant,
+                                        unsigned* const_operand,
+                                        unsigned* const_size)
+{
+    int      condition_ok = 0;
+    unsigned num_fields   = Z3_get_app_num_args(ctx, app);
+
+    unsigned i;
+    for (i = 0; i < num_fields; ++i) {
+        Z3_ast child = Z3_get_app_arg(ctx, app, i);
+        if (Z3_get_ast_kind(ctx, child) == Z3_NUMERAL_AST) {
+            Z3_bool successGet =
+                Z3_get_numeral_uint64(ctx, child, (uint64_t*)constant);
+            if (successGet == Z3_FALSE)
+                return 0; // constant is too big
+            condition_ok   = 1;
+            *const_operand = i;
+            *const_size    = Z3_get_bv_sort_size(ctx, Z3_get_sort(ctx, child));
+            break;
+        }
+    }
+    return condition_ok;
+}
+
+static inline Z3_decl_kind get_opposite_decl_kind(Z3_decl_kind kind)
+{
+    switch (kind) {
+        case Z3_OP_SLEQ:
+            return Z3_OP_SGT;
+        case Z3_OP_ULEQ:
+            return Z3_OP_UGT;
+        case Z3_OP_SLT:
+            return Z3_OP_SGEQ;
+        case Z3_OP_ULT:
+            return Z3_OP_UGEQ;
+        case Z3_OP_SGEQ:
+            return Z3_OP_SLT;
+        case Z3_OP_UGEQ:
+            return Z3_OP_ULT;
+        case Z3_OP_SGT:
+            return Z3_OP_SLEQ;
+        case Z3_OP_UGT:
+            return Z3_OP_ULEQ;
+        default:
+            break;
+    }
+    ABORT("get_opposite_decl_kind() - unexpected decl kind");
+}
+
+static inline int is_signed_op(optype op)
+{
+    return op == OP_SGT || op == OP_SGE || op == OP_SLT || op == OP_SLE;
+}
+
+static inline unsigned size_normalized(unsigned size)
+{
+    switch (size) {
+        case 1:
+            return 1;
+        case 2:
+            return 2;
+        case 3:
+        case 4:
+            return 4;
+        case 5:
+        case 6:
+        case 7:
+        case 8:
+            return 8;
+        default:
+            break;
+    }
+    ABORT("size_normalized() - unexpected size");
+}
+
+static inline wrapped_interval_t
+__range_to_interval(index_group_t* ig, uint64_t c, optype op,
+                    uint64_t add_constant, uint64_t sub_constant,
+                    int should_invert, uint32_t add_sub_const_size,
+                    uint32_t const_size)
+{
+    wrapped_interval_t wi = wi_init(const_size);
+    wi_update_cmp(&wi, c, op);
+    if (add_constant > 0) {
+        wi_modify_size(&wi, add_sub_const_size);
+        wi_update_sub(&wi, add_constant);
+    }
+    if (sub_constant > 0) {
+        wi_modify_size(&wi, add_sub_const_size);
+        if (!should_invert)
+            wi_update_add(&wi, sub_constant);
+        else {
+            wi_update_invert(&wi);
+            wi_update_add(&wi, sub_constant);
+        }
+    }
+
+    wi_modify_size(&wi, ig->n * 8);
+    return wi;
+}
+
+static inline interval_group_ptr
+interval_group_set_add_or_intersect(set__interval_group_ptr* set,
+                                    index_group_t* ig, wrapped_interval_t* wi,
+                                    int* created_new)
+{
+    interval_group_t    igt     = {.group = *ig, .interval = {0}};
+    interval_group_ptr  igt_p   = &igt;
+    interval_group_ptr* igt_ptr = set_find_el__interval_group_ptr(set, &igt_p);
+
+    if (igt_ptr != NULL) {
+        wi_intersect(&(*igt_ptr)->interval, wi);
+        return *igt_ptr;
+    } else {
+        *created_new = 1;
+        interval_group_ptr new_el =
+            (interval_group_ptr)malloc(sizeof(interval_group_t));
+        new_el->interval = *wi;
+        new_el->group    = *ig;
+        set_add__interval_group_ptr(set, new_el);
+        return new_el;
+    }
+}
+
+static inline void
+update_or_create_in_index_to_group_intervals(dict__da__interval_group_ptr* dict,
+                                             unsigned long                 idx,
+                                             interval_group_ptr            el)
+{
+    da__interval_group_ptr* el_list;
+    el_list = dict_get_ref__da__interval_group_ptr(dict, idx);
+    if (el_list == NULL) {
+        da__interval_group_ptr new_list;
+        da_init__interval_group_ptr(&new_list);
+        da_add_item__interval_group_ptr(&new_list, el);
+        dict_set__da__interval_group_ptr(dict, idx, new_list);
+    } else {
+        da_add_item__interval_group_ptr(el_list, el);
+    }
+}
+
+static inline wrapped_interval_t*
+interval_group_get_interval(set__interval_group_ptr* set, index_group_t* ig)
+{
+    interval_group_t    igt     = {.group = *ig, .interval = {0}};
+    interval_group_ptr  igt_p   = &igt;
+    interval_group_ptr* igt_ptr = set_find_el__interval_group_ptr(set, &igt_p);
+    if (igt_ptr != NULL)
+        return &(*igt_ptr)->interval;
+    return NULL;
+}
+
+static inline int __check_if_range(fuzzy_ctx_t* ctx, Z3_ast expr,
+                                   // output args
+                                   index_group_t* ig, uint64_t* constant,
+                                   optype* op, uint64_t* add_constant,
+                                   uint64_t* sub_constant, int* should_invert,
+                                   uint32_t* add_sub_const_size,
+                                   unsigned* const_size)
+{
+    int         res  = 0;
+    Z3_ast_kind kind = Z3_get_ast_kind(ctx->z3_ctx, expr);
+    if (kind != Z3_APP_AST)
+        return 0;
+
+    Z3_inc_ref(ctx->z3_ctx, expr);
+    Z3_app       app       = Z3_to_app(ctx->z3_ctx, expr);
+    Z3_func_decl decl      = Z3_get_app_decl(ctx->z3_ctx, app);
+    Z3_decl_kind decl_kind = Z3_get_decl_kind(ctx->z3_ctx, decl);
+
+    Z3_ast original_expr = expr;
+    Z3_inc_ref(ctx->z3_ctx, original_expr);
+
+    // exclude initial NOT
+    int is_not = 0;
+    while (decl_kind == Z3_OP_NOT) {
+        Z3_ast tmp_expr = Z3_get_app_arg(ctx->z3_ctx, app, 0);
+        Z3_inc_ref(ctx->z3_ctx, tmp_expr);
+        Z3_dec_ref(ctx->z3_ctx, expr);
+        expr      = tmp_expr;
+        app       = Z3_to_app(ctx->z3_ctx, expr);
+        decl      = Z3_get_app_decl(ctx->z3_ctx, app);
+        decl_kind = Z3_get_decl_kind(ctx->z3_ctx, decl);
+        is_not    = !is_not;
+    }
+
+    // it is a range query
+    if (decl_kind != Z3_OP_SLEQ && decl_kind != Z3_OP_ULEQ &&
+        decl_kind != Z3_OP_SLT && decl_kind != Z3_OP_ULT &&
+        decl_kind != Z3_OP_SGEQ && decl_kind != Z3_OP_UGEQ &&
+        decl_kind != Z3_OP_SGT && decl_kind != Z3_OP_UGT &&
+        decl_kind != Z3_OP_EQ)
+        goto END_FUN_1;
+    if (is_not && decl_kind == Z3_OP_EQ)
+        // could be extended...
+        goto END_FUN_1;
+    if (is_not)
+        decl_kind = get_opposite_decl_kind(decl_kind);
+
+    // should be always the case
+    if (Z3_get_app_num_args(ctx->z3_ctx, app) != 2)
+        goto END_FUN_1;
+
+    // one of the two child is a constant
+    unsigned const_operand;
+    if (!__find_child_constant(ctx->z3_ctx, app, constant, &const_operand,
+                               const_size))
+        goto END_FUN_1;
+
+    // the other operand is a group (possibly with an add/sub with a constant)
+    Z3_ast non_const_operand =
+        Z3_get_app_arg(ctx->z3_ctx, app, const_operand ^ 1);
+    if (Z3_get_ast_kind(ctx->z3_ctx, non_const_operand) != Z3_APP_AST)
+        goto END_FUN_1;
+    if (Z3_get_sort_kind(ctx->z3_ctx,
+                         Z3_get_sort(ctx->z3_ctx, non_const_operand)) !=
+        Z3_BV_SORT)
+        goto END_FUN_1;
+
+    Z3_inc_ref(ctx->z3_ctx, non_const_operand);
+
+    Z3_app       nonconst_op_app = Z3_to_app(ctx->z3_ctx, non_const_operand);
+    Z3_func_decl nonconst_op_decl =
+        Z3_get_app_decl(ctx->z3_ctx, nonconst_op_app);
+    Z3_decl_kind nonconst_op_decl_kind =
+        Z3_get_decl_kind(ctx->z3_ctx, nonconst_op_decl);
 
-                    if (Z3_get_ast_kind(ctx->z3_ctx, child1) ==
-                        Z3_NUMERAL_AST) {
-                        successGet = Z3_get_numeral_uint64(
-                            ctx->z3_ctx, child1, (uint64_t*)&tmp_const);
-                        ASSERT_OR_ABORT(successGet == Z3_TRUE,
-                                        "failed to get constant");
-                        da_add_item__ulong(&data->values, tmp_const);
-                        da_add_item__ulong(&data->values, tmp_const + 1);
-                        da_add_item__ulong(&data->values, tmp_const - 1);
-                    } else if (Z3_get_ast_kind(ctx->z3_ctx, child2) ==
-                               Z3_NUMERAL_AST) {
-                        successGet = Z3_get_numeral_uint64(
-                            ctx->z3_ctx, child2, (uint64_t*)&tmp_const);
-                        ASSERT_OR_ABORT(successGet == Z3_TRUE,
-                                        "failed to get constant");
-                        da_add_item__ulong(&data->values, tmp_const);
-                        da_add_item__ulong(&data->values, tmp_const + 1);
-                        da_add_item__ulong(&data->values, tmp_const - 1);
-                    }
-                    Z3_dec_ref(ctx->z3_ctx, child1);
-                    Z3_dec_ref(ctx->z3_ctx, child2);
-                    break;
-                }
-                case Z3_OP_ITE: {
-                    // look in ite condition
-                    Z3_ast cond = Z3_get_app_arg(ctx->z3_ctx, app, 0);
-                    Z3_inc_ref(ctx->z3_ctx, cond);
-                    __detect_early_constants(ctx, cond, data);
-                    Z3_dec_ref(ctx->z3_ctx, cond);
-                    break;
-                }
-                default: {
-                    break;
+    // remove concat with 0 (extend to any constant?)
+    int has_zext = 0;
+    if (nonconst_op_decl_kind == Z3_OP_CONCAT) {
+        if (Z3_get_app_num_args(ctx->z3_ctx, nonconst_op_app) == 2) {
+            Z3_ast tmp_expr = Z3_get_app_arg(ctx->z3_ctx, nonconst_op_app, 0);
+            Z3_inc_ref(ctx->z3_ctx, tmp_expr);
+
+            if (Z3_get_ast_kind(ctx->z3_ctx, tmp_expr) == Z3_NUMERAL_AST) {
+                uint64_t v;
+                Z3_bool  successGet =
+                    Z3_get_numeral_uint64(ctx->z3_ctx, tmp_expr, &v);
+
+                if (successGet != Z3_FALSE && v == 0) {
+                    has_zext                     = 1;
+                    Z3_ast old_non_const_operand = non_const_operand;
+                    non_const_operand =
+                        Z3_get_app_arg(ctx->z3_ctx, nonconst_op_app, 1);
+                    Z3_inc_ref(ctx->z3_ctx, non_const_operand);
+                    nonconst_op_app = Z3_to_app(ctx->z3_ctx, non_const_operand);
+                    nonconst_op_decl =
+                        Z3_get_app_decl(ctx->z3_ctx, nonconst_op_app);
+                    nonconst_op_decl_kind =
+                        Z3_get_decl_kind(ctx->z3_ctx, nonconst_op_decl);
+                    Z3_dec_ref(ctx->z3_ctx, old_non_const_operand);
                 }
             }
-            break;
-        }
-        default: {
-            break;
+            Z3_dec_ref(ctx->z3_ctx, tmp_expr);
         }
     }
-    return;
-}
 
-static inline unsigned long get_group_value_in_tmp_input(index_group_t* group)
-{
-    unsigned long res = 0;
-    unsigned char k;
-    for (k = 0; k < group->n; ++k) {
-        unsigned long index = group->indexes[group->n - k - 1];
-        res |= tmp_input[index] << (k * 8);
+    *add_constant       = 0;
+    *sub_constant       = 0;
+    *add_sub_const_size = 0;
+    *should_invert      = 0;
+
+    if (nonconst_op_decl_kind == Z3_OP_BADD ||
+        nonconst_op_decl_kind == Z3_OP_BSUB) {
+
+        if (Z3_get_app_num_args(ctx->z3_ctx, nonconst_op_app) != 2)
+            goto END_FUN_2;
+
+        uint64_t constant_2;
+        unsigned const_operand_2;
+        if (!__find_child_constant(ctx->z3_ctx, nonconst_op_app, &constant_2,
+                                   &const_operand_2, add_sub_const_size))
+            goto END_FUN_2;
+
+        if (nonconst_op_decl_kind == Z3_OP_BADD) {
+            *add_constant = constant_2;
+        } else {
+            *sub_constant = constant_2;
+            if (const_operand_2 == 0)
+                *should_invert = 1;
+        }
+
+        Z3_ast non_const_operand2 =
+            Z3_get_app_arg(ctx->z3_ctx, nonconst_op_app, const_operand_2 ^ 1);
+        Z3_inc_ref(ctx->z3_ctx, non_const_operand2);
+
+        char approx = 0;
+        int  input_group_ok =
+            __detect_input_group(ctx, non_const_operand2, ig, &approx);
+        if (!input_group_ok || ig->n == 0 || approx) {
+            // no input group or approximated group
+            Z3_dec_ref(ctx->z3_ctx, non_const_operand2);
+            goto END_FUN_2;
+        }
+
+        Z3_dec_ref(ctx->z3_ctx, non_const_operand);
+        non_const_operand = non_const_operand2;
+    } else {
+        // only one group in the non_const_operand
+        char approx = 0;
+        int  input_group_ok =
+            __detect_input_group(ctx, non_const_operand, ig, &approx);
+        if (!input_group_ok || ig->n == 0 || approx)
+            // no input group or approximated group
+            goto END_FUN_2;
     }
+    // it is a range query!
+    has_zext = 0;
+    *op      = __find_optype(decl_kind, const_operand, has_zext);
+
+    res = 1;
+END_FUN_2:
+    Z3_dec_ref(ctx->z3_ctx, non_const_operand);
+END_FUN_1:
+    Z3_dec_ref(ctx->z3_ctx, expr);
+    Z3_dec_ref(ctx->z3_ctx, original_expr);
     return res;
 }
 
-static inline unsigned long
-get_group_value_in_tmp_input_inv(index_group_t* group)
+static inline int __check_range_constraint(fuzzy_ctx_t* ctx, Z3_ast expr,
+                                           index_group_t*      ig,
+                                           wrapped_interval_t* wi)
 {
-    unsigned long res = 0;
-    unsigned char k;
-    for (k = 0; k < group->n; ++k) {
-        unsigned long index = group->indexes[k];
-        res |= tmp_input[index] << (k * 8);
+    Z3_inc_ref(ctx->z3_ctx, expr);
+    int res = 0;
+
+    uint64_t constant, add_constant, sub_constant;
+    optype   op = -1;
+    uint32_t add_sub_const_size;
+    unsigned const_size;
+    int      should_invert;
+
+    memset(ig, 0, sizeof(index_group_t));
+    if (!__check_if_range(ctx, expr, ig, &constant, &op, &add_constant,
+                          &sub_constant, &should_invert, &add_sub_const_size,
+                          &const_size)) {
+        goto OUT;
     }
+    if (const_size > 64)
+        goto OUT;
+
+    ASSERT_OR_ABORT(op != -1, "__check_range_constraint() invalid optype");
+    *wi = __range_to_interval(ig, constant, op, add_constant, sub_constant,
+                              should_invert, add_sub_const_size, const_size);
+    res = 1;
+OUT:
+    Z3_dec_ref(ctx->z3_ctx, expr);
     return res;
 }
 
-static inline unsigned char __extract_from_long(long value, unsigned int i)
+static inline void __add_range_constraint(fuzzy_ctx_t* ctx, index_group_t* ig,
+                                          wrapped_interval_t* wi)
 {
-    return (value >> i * 8) & 0xff;
-}
+    set__interval_group_ptr* group_intervals =
+        (set__interval_group_ptr*)ctx->group_intervals;
 
-static inline void set_tmp_input_group_to_value(index_group_t* group,
-                                                uint64_t       v)
-{
-    unsigned char k;
-    for (k = 0; k < group->n; ++k) {
-        unsigned long index = group->indexes[group->n - k - 1];
-        unsigned char b     = __extract_from_long(v, k);
-        tmp_input[index]    = b;
-    }
-}
+    dict__da__interval_group_ptr* index_to_group_intervals =
+        (dict__da__interval_group_ptr*)ctx->index_to_group_intervals;
 
-static inline void set_tmp_input_group_to_value_inv(index_group_t* group,
-                                                    uint64_t       v)
-{
-    unsigned char k;
-    for (k = 0; k < group->n; ++k) {
-        unsigned long index = group->indexes[k];
-        unsigned char b     = __extract_from_long(v, k);
-        tmp_input[index]    = b;
-    }
-}
+    int                created_new = 0;
+    interval_group_ptr el =
+        interval_group_set_add_or_intersect(group_intervals, ig, wi,
+                                            &created_new);
+    // also an interval tightened in place invalidates the checkpoints
+    ctx->intervals_version++;
 
-static inline void restore_tmp_input_group(index_group_t* group,
-                                           unsigned long* vals)
-{
-    unsigned char k;
-    for (k = 0; k < group->n; ++k) {
-        unsigned long index = group->indexes[group->n - k - 1];
-        tmp_input[index]    = vals[index];
+    if (created_new) {
+        unsigned i;
+        for (i = 0; i < ig->n; ++i)
+            update_or_create_in_index_to_group_intervals(
+                index_to_group_intervals, ig->indexes[i], el);
     }
-}
 
-static void __put_solutions_of_current_groups_to_early_constants(
-    fuzzy_ctx_t* ctx, ast_data_t* data, ast_info_ptr curr_groups)
-{
-    index_group_t* ig;
-    set_reset_iter__index_group_t(&curr_groups->index_groups, 0);
-    while (set_iter_next__index_group_t(&curr_groups->index_groups, 0, &ig)) {
-        unsigned long val = get_group_value_in_tmp_input(ig);
-        da_add_item__ulong(&data->values, val);
-    }
+#ifdef DEBUG_RANGE
+    puts("+++++++++++++++++++++++++++++++++++++");
+    print_interval_groups(ctx);
+    puts("+++++++++++++++++++++++++++++++++++++");
+#endif
 }
 
-__attribute__((unused)) static void
-__detect_all_constants(fuzzy_ctx_t* ctx, Z3_ast v, ast_data_t* data)
-{
-    switch (Z3_get_ast_kind(ctx->z3_ctx, v)) {
-        case Z3_APP_AST: {
-            Z3_app   app        = Z3_to_app(ctx->z3_ctx, v);
-            unsigned num_fields = Z3_get_app_num_args(ctx->z3_ctx, app);
-            unsigned i;
-            for (i = 0; i < num_fields; ++i) {
-                Z3_ast child = Z3_get_app_arg(ctx->z3_ctx, app, i);
-                __detect_all_constants(ctx, child, data);
-            }
-            break;
-        }
-        case Z3_NUMERAL_AST: {
-            unsigned long tmp_const;
-            Z3_bool       successGet =
-                Z3_get_numeral_uint64(ctx->z3_ctx, v, (uint64_t*)&tmp_const);
-            ASSERT_OR_ABORT(successGet == Z3_TRUE, "failed to get constant");
-            da_add_item__ulong(&data->values, tmp_const);
-            da_add_item__ulong(&data->values, tmp_const + 1);
-            da_add_item__ulong(&data->values, tmp_const - 1);
-        }
-        default: {
-            break;
-        }
-    }
-    return;
+static inline int get_range(fuzzy_ctx_t* ctx, Z3_ast expr, index_group_t* ig,
+                            wrapped_interval_t* wi)
+{
+    Z3_inc_ref(ctx->z3_ctx, expr);
+    int res = 0;
+
+    uint64_t constant, add_constant, sub_constant;
+    optype   op;
+    uint32_t add_sub_const_size;
+    unsigned const_size;
+    int      should_invert;
+
+    if (!__check_if_range(ctx, expr, ig, &constant, &op, &add_constant,
+                          &sub_constant, &should_invert, &add_sub_const_size,
+                          &const_size))
+        goto OUT;
+
+    set__interval_group_ptr* group_intervals =
+        (set__interval_group_ptr*)ctx->group_intervals;
+
+    *wi = __range_to_interval(ig, constant, op, add_constant, sub_constant,
+                              should_invert, add_sub_const_size, const_size);
+
+    const wrapped_interval_t* cached_wi =
+        interval_group_get_interval(group_intervals, ig);
+    if (!performing_aggressive_optimistic && cached_wi != NULL)
+        wi_intersect(wi, cached_wi);
+
+    res = 1;
+OUT:
+    Z3_dec_ref(ctx->z3_ctx, expr);
+    return res;
 }
 
-static inline int __check_conflicting_constraint(fuzzy_ctx_t* ctx, Z3_ast expr)
+static inline int __check_univocally_defined(fuzzy_ctx_t* ctx, Z3_ast expr,
+                                             index_group_t* ud_group)
 {
     Z3_ast_kind kind = Z3_get_ast_kind(ctx->z3_ctx, expr);
     if (kind != Z3_APP_AST)
         return 0;
 
-    int res = 0;
-    Z3_inc_ref(ctx->z3_ctx, expr);
     Z3_app       app       = Z3_to_app(ctx->z3_ctx, expr);
     Z3_func_decl decl      = Z3_get_app_decl(ctx->z3_ctx, app);
     Z3_decl_kind decl_kind = Z3_get_decl_kind(ctx->z3_ctx, decl);
-    Z3_ast       old_expr  = expr;
-    Z3_inc_ref(ctx->z3_ctx, old_expr);
 
-    // exclude initial NOT
-    int is_not = 0;
-    while (decl_kind == Z3_OP_NOT) {
-        Z3_ast tmp_expr = Z3_get_app_arg(ctx->z3_ctx, app, 0);
-        Z3_inc_ref(ctx->z3_ctx, tmp_expr);
-        Z3_dec_ref(ctx->z3_ctx, expr);
-        expr      = tmp_expr;
-        app       = Z3_to_app(ctx->z3_ctx, expr);
-        decl      = Z3_get_app_decl(ctx->z3_ctx, app);
-        decl_kind = Z3_get_decl_kind(ctx->z3_ctx, decl);
-        is_not    = !is_not;
-    }
+    if (decl_kind != Z3_OP_EQ)
+        return 0;
 
-    if (decl_kind != Z3_OP_EQ && decl_kind != Z3_OP_SLEQ &&
-        decl_kind != Z3_OP_ULEQ && decl_kind != Z3_OP_SLT &&
-        decl_kind != Z3_OP_ULT && decl_kind != Z3_OP_SGEQ &&
-        decl_kind != Z3_OP_UGEQ && decl_kind != Z3_OP_SGT &&
-        decl_kind != Z3_OP_UGT && decl_kind != Z3_OP_OR) {
-        res = 0;
-        goto OUT;
-    }
+    Z3_ast expr_sx = Z3_get_app_arg(ctx->z3_ctx, app, 0);
+    Z3_inc_ref(ctx->z3_ctx, expr_sx);
+    Z3_ast expr_dx = Z3_get_app_arg(ctx->z3_ctx, app, 1);
+    Z3_inc_ref(ctx->z3_ctx, expr_dx);
 
-    if (is_not) {
-        Z3_dec_ref(ctx->z3_ctx, expr);
-        expr = old_expr;
-        Z3_inc_ref(ctx->z3_ctx, expr);
-    }
+    ast_info_ptr inputs_sx, inputs_dx, inputs;
+    detect_involved_inputs_wrapper(ctx, expr, &inputs_sx);
+    detect_involved_inputs_wrapper(ctx, expr, &inputs_dx);
 
-    ast_info_ptr inputs;
-    detect_involved_inputs_wrapper(ctx, expr, &inputs);
-#if 1
-    if (inputs->query_size > 1020) {
-        res = 0;
-        goto OUT;
-    }
-#endif
+    Z3_dec_ref(ctx->z3_ctx, expr_sx);
+    Z3_dec_ref(ctx->z3_ctx, expr_dx);
 
-    // Take note of groups
-    dict__conflicting_ptr* conflicting_asts =
-        (dict__conflicting_ptr*)ctx->conflicting_asts;
+    if (inputs_sx->input_extract_ops > 0 ||
+        inputs_sx->approximated_groups > 0 ||
+        inputs_dx->input_extract_ops > 0 || inputs_dx->approximated_groups > 0)
+        return 0; // it is not safe to add to univocally defined
+
+    if (inputs_sx->index_groups.size == 1 && inputs_sx->index_groups.size == 0)
+        inputs = inputs_sx;
+    else if (inputs_sx->index_groups.size == 0 &&
+             inputs_sx->index_groups.size == 1)
+        inputs = inputs_dx;
+    else
+        return 0;
 
+    // we have (= something f(INPUT)) in the branch condition
+    // from now on, INPUT is univocally defined (from seed!)
+    // never add INPUT to indexes/index_groups again
     index_group_t* ig = NULL;
     set_reset_iter__index_group_t(&inputs->index_groups, 0);
-    while (set_iter_next__index_group_t(&inputs->index_groups, 0, &ig)) {
-        unsigned i;
-        for (i = 0; i < ig->n; ++i)
-            add_item_to_conflicting(conflicting_asts, expr, ig->indexes[i],
-                                    ctx->z3_ctx);
-    }
-    res = 1;
-OUT:
-    Z3_dec_ref(ctx->z3_ctx, expr);
-    Z3_dec_ref(ctx->z3_ctx, old_expr);
-    return res;
+    set_iter_next__index_group_t(&inputs->index_groups, 0, &ig);
+    *ud_group = *ig;
+    return 1;
 }
 
-static inline optype __find_optype(Z3_decl_kind dk, int is_const_at_right,
-                                   int has_zext)
+static inline void __add_univocally_defined(fuzzy_ctx_t*   ctx,
+                                            index_group_t* ig)
 {
-    switch (dk) {
-        case Z3_OP_SLEQ:
-            if (is_const_at_right)
-                if (!has_zext)
-                    return OP_SLE;
-                else
-                    return OP_ULE;
-            else if (!has_zext)
-                return OP_SGE;
-            else
-                return OP_UGE;
-        case Z3_OP_ULEQ:
-            if (is_const_at_right)
-                return OP_ULE;
-            else
-                return OP_UGE;
-        case Z3_OP_SLT:
-            if (is_const_at_right)
-                if (!has_zext)
-                    return OP_SLT;
-                else
-                    return OP_ULT;
-            else if (!has_zext)
-                return OP_SGT;
-            else
-                return OP_UGT;
-        case Z3_OP_ULT:
-            if (is_const_at_right)
-                return OP_ULT;
-            else
-                return OP_UGT;
-        case Z3_OP_SGEQ:
-            if (is_const_at_right)
-                if (!has_zext)
-                    return OP_SGE;
-                else
-                    return OP_UGE;
-            else if (!has_zext)
-                return OP_SLE;
-            else
-                return OP_ULE;
-        case Z3_OP_UGEQ:
-            if (is_const_at_right)
-                return OP_UGE;
-            else
-                return OP_ULE;
-        case Z3_OP_SGT:
-            if (is_const_at_right)
-                if (!has_zext)
-                    return OP_SGT;
-                else
-                    return OP_UGT;
-            else if (!has_zext)
-                return OP_SLT;
-            else
-                return OP_ULT;
-        case Z3_OP_UGT:
-            if (is_const_at_right)
-                return OP_UGT;
-            else
-                return OP_ULT;
-        case Z3_OP_EQ:
-            return OP_EQ;
-        default:
-            break;
+    unsigned i;
+    for (i = 0; i < ig->n; ++i) {
+        if (set_check__ulong((set__ulong*)ctx->univocally_defined_inputs,
+                             ig->indexes[i]))
+            continue;
+        set_add__ulong((set__ulong*)ctx->univocally_defined_inputs,
+                       ig->indexes[i]);
+        ctx->univocally_defined_digest ^= __mix_index(ig->indexes[i]);
     }
-    ABORT("__find_optype() unexpected Z3_decl_kind");
+
+    // invalidate ast_info_cache
+    dict__ast_info_ptr* ast_info_cache =
+        (dict__ast_info_ptr*)ctx->ast_info_cache;
+    dict_remove_all__ast_info_ptr(ast_info_cache);
 }
 
-static inline int __find_child_constant(Z3_context ctx, Z3_app app,
-                                        uint64_t* constant,
-                                        unsigned* const_operand,
-                                        unsigned* const_size)
-{
-    int      condition_ok = 0;
-    unsigned num_fields   = Z3_get_app_num_args(ctx, app);
+static inline int __detect_strcmp_pattern(fuzzy_ctx_t* ctx, Z3_ast ast,
+                                          unsigned long* values)
+{
+    /*
+        (... whatever
+            (concat
+                #x0..0
+                (ite (= inp_0 const_0) #b1 #b0)
+                (ite (= inp_1 const_1) #b1 #b0)
+                ...
+                (ite (= inp_i const_i) #b1 #b0)))
+    */
+    Z3_bool     successGet;
+    unsigned    i;
+    Z3_ast_kind kind = Z3_get_ast_kind(ctx->z3_ctx, ast);
+    if (kind != Z3_APP_AST)
+        return 0;
+
+    int          res        = 0;
+    Z3_app       app        = Z3_to_app(ctx->z3_ctx, ast);
+    unsigned     num_fields = Z3_get_app_num_args(ctx->z3_ctx, app);
+    Z3_func_decl decl       = Z3_get_app_decl(ctx->z3_ctx, app);
+    Z3_decl_kind decl_kind  = Z3_get_decl_kind(ctx->z3_ctx, decl);
+
+    if (decl_kind == Z3_OP_CONCAT) {
+        res = 1;
+        for (i = 0; i < num_fields; ++i) {
+            Z3_ast      child      = Z3_get_app_arg(ctx->z3_ctx, app, i);
+            Z3_ast_kind child_kind = Z3_get_ast_kind(ctx->z3_ctx, child);
+            if (child_kind == Z3_NUMERAL_AST)
+                continue;
+            if (child_kind == Z3_APP_AST) {
+                Z3_app       child_app = Z3_to_app(ctx->z3_ctx, child);
+                Z3_func_decl child_decl =
+                    Z3_get_app_decl(ctx->z3_ctx, child_app);
+                Z3_decl_kind child_decl_kind =
+                    Z3_get_decl_kind(ctx->z3_ctx, child_decl);
+                if (child_decl_kind != Z3_OP_ITE) {
+                    res = 0;
+                    break;
+                }
+                Z3_ast cond    = Z3_get_app_arg(ctx->z3_ctx, child_app, 0);
+                Z3_ast iftrue  = Z3_get_app_arg(ctx->z3_ctx, child_app, 1);
+                Z3_ast iffalse = Z3_get_app_arg(ctx->z3_ctx, child_app, 2);
+
+                // iftrue must be #b0 or #b1
+                if (Z3_get_ast_kind(ctx->z3_ctx, iftrue) != Z3_NUMERAL_AST) {
+                    res = 0;
+                    break;
+                }
+                uint64_t iftrue_v;
+                successGet = Z3_get_numeral_uint64(ctx->z3_ctx, iftrue,
+                                                   (uint64_t*)&iftrue_v);
+                if (!successGet || (iftrue_v != 0 && iftrue_v != 1)) {
+                    res = 0;
+                    break;
+                }
+                if (Z3_get_ast_kind(ctx->z3_ctx, iffalse) != Z3_NUMERAL_AST) {
+                    res = 0;
+                    break;
+                }
+
+                // iffalse must be #b0 or #b1
+                uint64_t iffalse_v;
+                successGet = Z3_get_numeral_uint64(ctx->z3_ctx, iftrue,
+                                                   (uint64_t*)&iffalse_v);
+                if (!successGet || (iffalse_v != 0 && iffalse_v != 1)) {
+                    res = 0;
+                    break;
+                }
+
+                // cond must be (= inp_i const_i)
+                if (Z3_get_ast_kind(ctx->z3_ctx, cond) != Z3_APP_AST) {
+                    res = 0;
+                    break;
+                }
+                Z3_app       cond_app  = Z3_to_app(ctx->z3_ctx, cond);
+                Z3_func_decl cond_decl = Z3_get_app_decl(ctx->z3_ctx, cond_app);
+                Z3_decl_kind cond_decl_kind =
+                    Z3_get_decl_kind(ctx->z3_ctx, cond_decl);
+                if (cond_decl_kind != Z3_OP_EQ) {
+                    res = 0;
+                    break;
+                }
+                Z3_ast inp_i   = Z3_get_app_arg(ctx->z3_ctx, cond_app, 0);
+                Z3_ast const_i = Z3_get_app_arg(ctx->z3_ctx, cond_app, 1);
+                if (Z3_get_ast_kind(ctx->z3_ctx, inp_i) != Z3_APP_AST) {
+                    res = 0;
+                    break;
+                }
+                if (Z3_get_ast_kind(ctx->z3_ctx, const_i) != Z3_NUMERAL_AST) {
+                    res = 0;
+                    break;
+                }
+                Z3_app       inp_i_app = Z3_to_app(ctx->z3_ctx, inp_i);
+                Z3_func_decl inp_i_decl =
+                    Z3_get_app_decl(ctx->z3_ctx, inp_i_app);
+                Z3_decl_kind inp_i_decl_kind =
+                    Z3_get_decl_kind(ctx->z3_ctx, inp_i_decl);
+                if (inp_i_decl_kind != Z3_OP_UNINTERPRETED) {
+                    res = 0;
+                    break;
+                }
+                int inp_i_idx = Z3_get_symbol_int(
+                    ctx->z3_ctx, Z3_get_decl_name(ctx->z3_ctx, inp_i_decl));
+                uint64_t const_i_v;
+                successGet = Z3_get_numeral_uint64(ctx->z3_ctx, const_i,
+                                                   (uint64_t*)&const_i_v);
+                if (!successGet) {
+                    res = 0;
+                    break;
+                }
 
-    unsigned i;
-    for (i = 0; i < num_fields; ++i) {
-        Z3_ast child = Z3_get_app_arg(ctx, app, i);
-        if (Z3_get_ast_kind(ctx, child) == Z3_NUMERAL_AST) {
-            Z3_bool successGet =
-                Z3_get_numeral_uint64(ctx, child, (uint64_t*)constant);
-            if (successGet == Z3_FALSE)
-                return 0; // constant is too big
-            condition_ok   = 1;
-            *const_operand = i;
-            *const_size    = Z3_get_bv_sort_size(ctx, Z3_get_sort(ctx, child));
-            break;
+                // finally. Set value
+                values[inp_i_idx] = const_i_v;
+                res               = 1;
+            } else {
+                res = 0;
+                break;
+            }
         }
+        if (res)
+            return res;
     }
-    return condition_ok;
-}
 
-static inline Z3_decl_kind get_opposite_decl_kind(Z3_decl_kind kind)
-{
-    switch (kind) {
-        case Z3_OP_SLEQ:
-            return Z3_OP_SGT;
-        case Z3_OP_ULEQ:
-            return Z3_OP_UGT;
-        case Z3_OP_SLT:
-            return Z3_OP_SGEQ;
-        case Z3_OP_ULT:
-            return Z3_OP_UGEQ;
-        case Z3_OP_SGEQ:
-            return Z3_OP_SLT;
-        case Z3_OP_UGEQ:
-            return Z3_OP_ULT;
-        case Z3_OP_SGT:
-            return Z3_OP_SLEQ;
-        case Z3_OP_UGT:
-            return Z3_OP_ULEQ;
-        default:
-            break;
+    for (i = 0; i < num_fields; ++i) {
+        res |= __detect_strcmp_pattern(ctx, Z3_get_app_arg(ctx->z3_ctx, app, i),
+                                       values);
     }
-    ABORT("get_opposite_decl_kind() - unexpected decl kind");
-}
 
-static inline int is_signed_op(optype op)
-{
-    return op == OP_SGT || op == OP_SGE || op == OP_SLT || op == OP_SLE;
+    return res;
 }
 
-static inline unsigned size_normalized(unsigned size)
-{
-    switch (size) {
-        case 1:
-            return 1;
-        case 2:
-            return 2;
-        case 3:
-        case 4:
-            return 4;
-        case 5:
-        case 6:
-        case 7:
-        case 8:
-            return 8;
-        default:
-            break;
-    }
-    ABORT("size_normalized() - unexpected size");
-}
+// *************************************************
+// **************** HEURISTICS - END ***************
+// *************************************************
 
-static inline interval_group_ptr interval_group_set_add_or_modify(
-    set__interval_group_ptr* set, index_group_t* ig, uint64_t c, optype op,
-    uint64_t add_constant, uint64_t sub_constant, int should_invert,
-    uint32_t add_sub_const_size, uint32_t const_size, int* created_new)
+static inline void __reset_ast_data()
 {
-    ASSERT_OR_ABORT(op != -1,
-                    "interval_group_set_add_or_modify() invalid optype");
-    interval_group_t    igt     = {.group = *ig, .interval = {0}};
-    interval_group_ptr  igt_p   = &igt;
-    interval_group_ptr* igt_ptr = set_find_el__interval_group_ptr(set, &igt_p);
-
-    wrapped_interval_t wi = wi_init(const_size);
-    wi_update_cmp(&wi, c, op);
-    if (add_constant > 0) {
-        wi_modify_size(&wi, add_sub_const_size);
-        wi_update_sub(&wi, add_constant);
-    }
-    if (sub_constant > 0) {
-        wi_modify_size(&wi, add_sub_const_size);
-        if (!should_invert)
-            wi_update_add(&wi, sub_constant);
-        else {
-            wi_update_invert(&wi);
-            wi_update_add(&wi, sub_constant);
-        }
-    }
-
-    wi_modify_size(&wi, ig->n * 8);
-    if (igt_ptr != NULL) {
-        wi_intersect(&(*igt_ptr)->interval, &wi);
-        return *igt_ptr;
-    } else {
-        *created_new = 1;
-        interval_group_ptr new_el =
-            (interval_group_ptr)malloc(sizeof(interval_group_t));
-        unsigned size    = ig->n;
-        size             = size_normalized(size);
-        new_el->interval = wi;
-        new_el->group    = *ig;
-        set_add__interval_group_ptr(set, new_el);
-        return new_el;
-    }
-}
+    set_remove_all__digest_t(&ast_data.processed_set, NULL);
+    da_remove_all__ulong(&ast_data.values, NULL);
 
-static inline void
-update_or_create_in_index_to_group_intervals(dict__da__interval_group_ptr* dict,
-                                             unsigned long                 idx,
-                                             interval_group_ptr            el)
-{
-    da__interval_group_ptr* el_list;
-    el_list = dict_get_ref__da__interval_group_ptr(dict, idx);
-    if (el_list == NULL) {
-        da__interval_group_ptr new_list;
-        da_init__interval_group_ptr(&new_list);
-        da_add_item__interval_group_ptr(&new_list, el);
-        dict_set__da__interval_group_ptr(dict, idx, new_list);
-    } else {
-        da_add_item__interval_group_ptr(el_list, el);
-    }
-}
+    ast_data.is_input_to_state      = 0;
+    ast_data.inputs                 = NULL;
+    ast_data.input_to_state_group.n = 0;
+    ast_data.n_useless_eval         = 0;
 
-static inline wrapped_interval_t*
-interval_group_get_interval(set__interval_group_ptr* set, index_group_t* ig)
-{
-    interval_group_t    igt     = {.group = *ig, .interval = {0}};
-    interval_group_ptr  igt_p   = &igt;
-    interval_group_ptr* igt_ptr = set_find_el__interval_group_ptr(set, &igt_p);
-    if (igt_ptr != NULL)
-        return &(*igt_ptr)->interval;
-    return NULL;
+    fast_eval.ast = NULL;
 }
 
-static inline int __check_if_range(fuzzy_ctx_t* ctx, Z3_ast expr,
-                                   // output args
-                                   index_group_t* ig, uint64_t* constant,
-                                   optype* op, uint64_t* add_constant,
-                                   uint64_t* sub_constant, int* should_invert,
-                                   uint32_t* add_sub_const_size,
-                                   unsigned* const_size)
+static inline void __init_global_data(fuzzy_ctx_t* ctx, Z3_ast query,
+                                      Z3_ast branch_condition)
 {
-    int         res  = 0;
-    Z3_ast_kind kind = Z3_get_ast_kind(ctx->z3_ctx, expr);
-    if (kind != Z3_APP_AST)
-        return 0;
-
-    Z3_inc_ref(ctx->z3_ctx, expr);
-    Z3_app       app       = Z3_to_app(ctx->z3_ctx, expr);
-    Z3_func_decl decl      = Z3_get_app_decl(ctx->z3_ctx, app);
-    Z3_decl_kind decl_kind = Z3_get_decl_kind(ctx->z3_ctx, decl);
 
-    Z3_ast original_expr = expr;
-    Z3_inc_ref(ctx->z3_ctx, original_expr);
+    opt_found = 0;
 
-    // exclude initial NOT
-    int is_not = 0;
-    while (decl_kind == Z3_OP_NOT) {
-        Z3_ast tmp_expr = Z3_get_app_arg(ctx->z3_ctx, app, 0);
-        Z3_inc_ref(ctx->z3_ctx, tmp_expr);
-        Z3_dec_ref(ctx->z3_ctx, expr);
-        expr      = tmp_expr;
-        app       = Z3_to_app(ctx->z3_ctx, expr);
-        decl      = Z3_get_app_decl(ctx->z3_ctx, app);
-        decl_kind = Z3_get_decl_kind(ctx->z3_ctx, decl);
-        is_not    = !is_not;
-    }
+    __reset_ast_data();
 
-    // it is a range query
-    if (decl_kind != Z3_OP_SLEQ && decl_kind != Z3_OP_ULEQ &&
-        decl_kind != Z3_OP_SLT && decl_kind != Z3_OP_ULT &&
-        decl_kind != Z3_OP_SGEQ && decl_kind != Z3_OP_UGEQ &&
-        decl_kind != Z3_OP_SGT && decl_kind != Z3_OP_UGT &&
-        decl_kind != Z3_OP_EQ)
-        goto END_FUN_1;
-    if (is_not && decl_kind == Z3_OP_EQ)
-        // could be extended...
-        goto END_FUN_1;
-    if (is_not)
-        decl_kind = get_opposite_decl_kind(decl_kind);
+    __detect_input_to_state_query(ctx, branch_condition, &ast_data, 0);
+    detect_involved_inputs_wrapper(ctx, branch_condition, &ast_data.inputs);
+    __detect_early_constants(ctx, branch_condition, &ast_data);
 
-    // should be always the case
-    if (Z3_get_app_num_args(ctx->z3_ctx, app) != 2)
-        goto END_FUN_1;
+    testcase_t* current_testcase = &ctx->testcases.data[0];
+    memcpy(tmp_input, current_testcase->values,
+           current_testcase->values_len * sizeof(unsigned long));
+}
 
-    // one of the two child is a constant
-    unsigned const_operand;
-    if (!__find_child_constant(ctx->z3_ctx, app, constant, &const_operand,
-                               const_size))
-        goto END_FUN_1;
+static __always_inline int PHASE_reuse(fuzzy_ctx_t* ctx, Z3_ast query,
+                                       Z3_ast                branch_condition,
+                                       unsigned char const** proof,
+                                       unsigned long*        proof_size)
+{
+    if (skip_reuse)
+        return 0;
 
-    // the other operand is a group (possibly with an add/sub with a constant)
-    Z3_ast non_const_operand =
-        Z3_get_app_arg(ctx->z3_ctx, app, const_operand ^ 1);
-    if (Z3_get_ast_kind(ctx->z3_ctx, non_const_operand) != Z3_APP_AST)
-        goto END_FUN_1;
-    if (Z3_get_sort_kind(ctx->z3_ctx,
-                         Z3_get_sort(ctx->z3_ctx, non_const_operand)) !=
-        Z3_BV_SORT)
-        goto END_FUN_1;
+    ASSERT_OR_ABORT(ctx->testcases.size > 1,
+                    "PHASE_reuse not enough testcases");
+#ifdef DEBUG_CHECK_LIGHT
+    Z3FUZZ_LOG("Trying REUSE PHASE\n");
+#endif
+    unsigned i;
+    for (i = 1; i < ctx->testcases.size; ++i) {
+        __concretize_pending_assignments(ctx, i);
+        testcase_t* testcase = &ctx->testcases.data[i];
 
-    Z3_inc_ref(ctx->z3_ctx, non_const_operand);
+        int eval_v = __evaluate_branch_query(
+            ctx, query, branch_condition, testcase->values,
+            testcase->value_sizes, testcase->values_len);
+        if (eval_v == 1) {
+#ifdef PRINT_SAT
+            Z3FUZZ_LOG("[check light - reuse] Query is SAT\n");
+#endif
+            __vals_long_to_char(testcase->values, tmp_proof,
+                                testcase->testcase_len);
+            ctx->stats.reuse++;
+            *proof      = tmp_proof;
+            *proof_size = testcase->testcase_len;
+            return 1;
+        } else if (unlikely(eval_v == TIMEOUT_V))
+            return TIMEOUT_V;
+    }
+    return 0;
+}
 
-    Z3_app       nonconst_op_app = Z3_to_app(ctx->z3_ctx, non_const_operand);
-    Z3_func_decl nonconst_op_decl =
-        Z3_get_app_decl(ctx->z3_ctx, nonconst_op_app);
-    Z3_decl_kind nonconst_op_decl_kind =
-        Z3_get_decl_kind(ctx->z3_ctx, nonconst_op_decl);
+static __always_inline int PHASE_input_to_state(fuzzy_ctx_t* ctx, Z3_ast query,
+                                                Z3_ast branch_condition,
+                                                unsigned char const** proof,
+                                                unsigned long* proof_size)
+{
+    if (unlikely(skip_input_to_state))
+        return 0;
 
-    // remove concat with 0 (extend to any constant?)
-    int has_zext = 0;
-    if (nonconst_op_decl_kind == Z3_OP_CONCAT) {
-        if (Z3_get_app_num_args(ctx->z3_ctx, nonconst_op_app) == 2) {
-            Z3_ast tmp_expr = Z3_get_app_arg(ctx->z3_ctx, nonconst_op_app, 0);
-            Z3_inc_ref(ctx->z3_ctx, tmp_expr);
+    ASSERT_OR_ABORT(ast_data.is_input_to_state,
+                    "PHASE_input_to_state not an input to state query");
+#ifdef DEBUG_CHECK_LIGHT
+    Z3FUZZ_LOG("Trying Input to State\n");
+#endif
+    testcase_t*    current_testcase = &ctx->testcases.data[0];
+    index_group_t* group;
+    unsigned int   index;
+    unsigned char  b;
+    unsigned       k;
+    group = &ast_data.input_to_state_group;
+    for (k = 0; k < group->n; ++k) {
+        index = group->indexes[group->n - k - 1];
+        b     = __extract_from_long(ast_data.input_to_state_const, k);
 
-            if (Z3_get_ast_kind(ctx->z3_ctx, tmp_expr) == Z3_NUMERAL_AST) {
-                uint64_t v;
-                Z3_bool  successGet =
-                    Z3_get_numeral_uint64(ctx->z3_ctx, tmp_expr, &v);
+        if (current_testcase->values[index] == (unsigned long)b)
+            continue;
 
-                if (successGet != Z3_FALSE && v == 0) {
-                    has_zext                     = 1;
-                    Z3_ast old_non_const_operand = non_const_operand;
-                    non_const_operand =
-                        Z3_get_app_arg(ctx->z3_ctx, nonconst_op_app, 1);
-                    Z3_inc_ref(ctx->z3_ctx, non_const_operand);
-                    nonconst_op_app = Z3_to_app(ctx->z3_ctx, non_const_operand);
-                    nonconst_op_decl =
-                        Z3_get_app_decl(ctx->z3_ctx, nonconst_op_app);
-                    nonconst_op_decl_kind =
-                        Z3_get_decl_kind(ctx->z3_ctx, nonconst_op_decl);
-                    Z3_dec_ref(ctx->z3_ctx, old_non_const_operand);
-                }
-            }
-            Z3_dec_ref(ctx->z3_ctx, tmp_expr);
-        }
+#ifdef DEBUG_CHECK_LIGHT
+        Z3FUZZ_LOG("L1 - inj byte: 0x%x @ %d\n", b, index);
+#endif
+        tmp_input[index] = b;
+    }
+    int valid_eval = is_valid_eval_group(ctx, group, tmp_input,
+                                         current_testcase->value_sizes,
+                                         current_testcase->values_len);
+    if (valid_eval) {
+        int eval_v = __evaluate_branch_query(
+            ctx, query, branch_condition, tmp_input,
+            current_testcase->value_sizes, current_testcase->values_len);
+        if (eval_v == 1) {
+#ifdef PRINT_SAT
+            Z3FUZZ_LOG("[check light - input to state] Query is SAT\n");
+#endif
+            ctx->stats.input_to_state++;
+            ctx->stats.num_sat++;
+            __vals_long_to_char(tmp_input, tmp_proof,
+                                current_testcase->testcase_len);
+            *proof      = tmp_proof;
+            *proof_size = current_testcase->testcase_len;
+            return 1;
+        } else if (unlikely(eval_v == TIMEOUT_V))
+            return TIMEOUT_V;
     }
 
-    *add_constant       = 0;
-    *sub_constant       = 0;
-    *add_sub_const_size = 0;
-    *should_invert      = 0;
+    // if (ast_data.op_input_to_state == Z3_OP_EQ)
+    //     // query is UNSAT
+    //     return 2;
 
-    if (nonconst_op_decl_kind == Z3_OP_BADD ||
-        nonconst_op_decl_kind == Z3_OP_BSUB) {
+    // restore tmp_input
+    for (k = 0; k < group->n; ++k) {
+        index            = group->indexes[group->n - k - 1];
+        tmp_input[index] = (unsigned long)current_testcase->values[index];
+    }
 
-        if (Z3_get_app_num_args(ctx->z3_ctx, nonconst_op_app) != 2)
-            goto END_FUN_2;
+    return 0;
+}
 
-        uint64_t constant_2;
-        unsigned const_operand_2;
-        if (!__find_child_constant(ctx->z3_ctx, nonconst_op_app, &constant_2,
-                                   &const_operand_2, add_sub_const_size))
-            goto END_FUN_2;
+static __always_inline int PHASE_simple_math(fuzzy_ctx_t* ctx, Z3_ast query,
+                                             Z3_ast branch_condition,
+                                             unsigned char const** proof,
+                                             unsigned long*        proof_size)
+{
+    if (unlikely(skip_simple_math))
+        return 0;
 
-        if (nonconst_op_decl_kind == Z3_OP_BADD) {
-            *add_constant = constant_2;
-        } else {
-            *sub_constant = constant_2;
-            if (const_operand_2 == 0)
-                *should_invert = 1;
-        }
+    index_group_t      ig = {0};
+    wrapped_interval_t wi;
+    if (!get_range(ctx, branch_condition, &ig, &wi))
+        return 0;
 
-        Z3_ast non_const_operand2 =
-            Z3_get_app_arg(ctx->z3_ctx, nonconst_op_app, const_operand_2 ^ 1);
-        Z3_inc_ref(ctx->z3_ctx, non_const_operand2);
+#ifdef DEBUG_CHECK_LIGHT
+    Z3FUZZ_LOG("Trying Simple Math\n");
+#endif
+    testcase_t*   current_testcase = &ctx->testcases.data[0];
+    unsigned long c;
+    int           i, j, k;
 
-        char approx = 0;
-        int  input_group_ok =
-            __detect_input_group(ctx, non_const_operand2, ig, &approx);
-        if (!input_group_ok || ig->n == 0 || approx) {
-            // no input group or approximated group
-            Z3_dec_ref(ctx->z3_ctx, non_const_operand2);
-            goto END_FUN_2;
-        }
+    if (wi_get_range(&wi) > RANGE_MAX_WIDTH_BRUTE_FORCE)
+        goto TRY_MIN_MAX; // range too wide
 
-        Z3_dec_ref(ctx->z3_ctx, non_const_operand);
-        non_const_operand = non_const_operand2;
-    } else {
-        // only one group in the non_const_operand
-        char approx = 0;
-        int  input_group_ok =
-            __detect_input_group(ctx, non_const_operand, ig, &approx);
-        if (!input_group_ok || ig->n == 0 || approx)
-            // no input group or approximated group
-            goto END_FUN_2;
+    wrapped_interval_iter_t it = wi_init_iter_values(&wi);
+    uint64_t                val;
+    while (wi_iter_get_next(&it, &val)) {
+        set_tmp_input_group_to_value(&ig, val);
+        int eval_v = __evaluate_branch_query_unique(
+            ctx, query, branch_condition, tmp_input,
+            current_testcase->value_sizes, current_testcase->values_len);
+        if (eval_v == 1) {
+#ifdef PRINT_SAT
+            Z3FUZZ_LOG("[check light - simple math] Query is SAT\n");
+#endif
+            ctx->stats.simple_math++;
+            ctx->stats.num_sat++;
+            __vals_long_to_char(tmp_input, tmp_proof,
+                                current_testcase->testcase_len);
+            *proof      = tmp_proof;
+            *proof_size = current_testcase->testcase_len;
+            return 1;
+        } else if (unlikely(eval_v == TIMEOUT_V))
+            return TIMEOUT_V;
     }
-    // it is a range query!
-    has_zext = 0;
-    *op      = __find_optype(decl_kind, const_operand, has_zext);
+    return 2;
 
-    res = 1;
-END_FUN_2:
-    Z3_dec_ref(ctx->z3_ctx, non_const_operand);
-END_FUN_1:
-    Z3_dec_ref(ctx->z3_ctx, expr);
-    Z3_dec_ref(ctx->z3_ctx, original_expr);
-    return res;
-}
+TRY_MIN_MAX:
+    for (j = 0; j < 2; ++j) {
+        if (j == 0)
+            c = wi.min;
+        else
+            c = wi.max;
 
-static inline int __check_range_constraint(fuzzy_ctx_t* ctx, Z3_ast expr)
-{
-    Z3_inc_ref(ctx->z3_ctx, expr);
-    int res = 0;
+        for (k = 0; k < ig.n; ++k) {
+            unsigned int  index = ig.indexes[ig.n - k - 1];
+            unsigned char b     = __extract_from_long(c, k);
 
-    index_group_t ig = {0};
-    uint64_t      constant, add_constant, sub_constant;
-    optype        op = -1;
-    uint32_t      add_sub_const_size;
-    unsigned      const_size;
-    int           should_invert;
+#ifdef DEBUG_CHECK_LIGHT
+            Z3FUZZ_LOG("SM - inj byte: 0x%x @ %d\n", b, index);
+#endif
+            if (current_testcase->values[index] == (unsigned long)b)
+                continue;
 
-    if (!__check_if_range(ctx, expr, &ig, &constant, &op, &add_constant,
-                          &sub_constant, &should_invert, &add_sub_const_size,
-                          &const_size)) {
-        goto OUT;
+            tmp_input[index] = b;
+        }
+        int valid_eval = is_valid_eval_group(ctx, &ig, tmp_input,
+                                             current_testcase->value_sizes,
+                                             current_testcase->values_len);
+        if (valid_eval) {
+            int eval_v = __evaluate_branch_query(
+                ctx, query, branch_condition, tmp_input,
+                current_testcase->value_sizes, current_testcase->values_len);
+            if (eval_v == 1) {
+#ifdef PRINT_SAT
+                Z3FUZZ_LOG("[check light - simple math] Query "
+                           "is SAT\n");
+#endif
+                ctx->stats.simple_math++;
+                ctx->stats.num_sat++;
+                __vals_long_to_char(tmp_input, tmp_proof,
+                                    current_testcase->testcase_len);
+                *proof      = tmp_proof;
+                *proof_size = current_testcase->values_len;
+                return 1;
+            } else if (unlikely(eval_v == TIMEOUT_V))
+                return TIMEOUT_V;
+        }
     }
-    if (const_size > 64)
-        goto OUT;
-
-    set__interval_group_ptr* group_intervals =
-        (set__interval_group_ptr*)ctx->group_intervals;
-
-    dict__da__interval_group_ptr* index_to_group_intervals =
-        (dict__da__interval_group_ptr*)ctx->index_to_group_intervals;
-
-    int                created_new;
-    interval_group_ptr el = interval_group_set_add_or_modify(
-        group_intervals, &ig, constant, op, add_constant, sub_constant,
-        should_invert, add_sub_const_size, const_size, &created_new);
-
-    if (created_new) {
-        unsigned i;
-        for (i = 0; i < ig.n; ++i)
-            update_or_create_in_index_to_group_intervals(
-                index_to_group_intervals, ig.indexes[i], el);
+    for (k = 0; k < ig.n; ++k) {
+        i            = ig.indexes[ig.n - k - 1];
+        tmp_input[i] = current_testcase->values[i];
     }
+    return 0;
+}
 
-#ifdef DEBUG_RANGE
-    puts("+++++++++++++++++++++++++++++++++++++");
-    z3fuzz_print_expr(ctx, expr);
-    print_interval_groups(ctx);
-    puts("+++++++++++++++++++++++++++++++++++++");
-#endif
+// div mod: the branch condition compares with a constant the quotient, the
+// remainder or a mask of an input group by a constant. The values of the
+// group that satisfy it are a range or a residue class, the members
+// closest to the seed are tried first
+#define DIV_MOD_MAX_CANDIDATES 16
 
-    res = 1;
-OUT:
-    Z3_dec_ref(ctx->z3_ctx, expr);
-    return res;
+typedef struct div_mod_cands_t {
+    __int128 v[DIV_MOD_MAX_CANDIDATES];
+    unsigned n;
+} div_mod_cands_t;
+
+static inline __int128 __div_mod_clamp(__int128 v, __int128 lo, __int128 hi)
+{
+    return v < lo ? lo : (v > hi ? hi : v);
 }
 
-static inline int get_range(fuzzy_ctx_t* ctx, Z3_ast expr, index_group_t* ig,
-                            wrapped_interval_t* wi)
+static inline void __div_mod_add(div_mod_cands_t* c, __int128 v)
 {
-    Z3_inc_ref(ctx->z3_ctx, expr);
-    int res = 0;
+    if (c->n < DIV_MOD_MAX_CANDIDATES)
+        c->v[c->n++] = v;
+}
 
-    uint64_t constant, add_constant, sub_constant;
-    optype   op;
-    uint32_t add_sub_const_size;
-    unsigned const_size;
-    int      should_invert;
+static inline __int128 __div_mod_signed(uint64_t v, unsigned width)
+{
+    if (width < 64 && (v >> (width - 1)) & 1)
+        return (__int128)v - ((__int128)1 << width);
+    return width == 64 ? (__int128)(int64_t)v : (__int128)v;
+}
 
-    if (!__check_if_range(ctx, expr, ig, &constant, &op, &add_constant,
-                          &sub_constant, &should_invert, &add_sub_const_size,
-                          &const_size))
-        goto OUT;
+// x in [lo, hi] such that x / d (truncated) is in [a, b], with d > 0
+static void __div_mod_cands_div(div_mod_cands_t* c, __int128 sx, __int128 a,
+                                __int128 b, __int128 d, __int128 lo,
+                                __int128 hi)
+{
+    __int128 x_lo = a > 0 ? a * d : a * d - (d - 1);
+    __int128 x_hi = b >= 0 ? b * d + d - 1 : b * d;
 
-    set__interval_group_ptr* group_intervals =
-        (set__interval_group_ptr*)ctx->group_intervals;
+    x_lo = x_lo < lo ? lo : x_lo;
+    x_hi = x_hi > hi ? hi : x_hi;
+    if (x_lo > x_hi)
+        return;
+    __div_mod_add(c, __div_mod_clamp(sx, x_lo, x_hi));
+    __div_mod_add(c, x_lo);
+    __div_mod_add(c, x_hi);
+}
 
-    *wi = wi_init(const_size);
+// x such that x rem d is in [a, b], with d > 0. The remainder has the sign
+// of x: [a, b] is either non negative or non positive
+static void __div_mod_cands_rem(div_mod_cands_t* c, __int128 sx, __int128 a,
+                                __int128 b, __int128 d)
+{
+    int      negative = b <= 0 && a < 0;
+    __int128 q0, q, base;
 
-    wi_update_cmp(wi, constant, op);
-    if (add_constant > 0) {
-        wi_modify_size(wi, add_sub_const_size);
-        wi_update_sub(wi, add_constant);
+    if (!negative)
+        q0 = sx > 0 ? sx / d : 0;
+    else
+        q0 = sx < 0 ? -sx / d : 0;
+    for (q = q0 > 0 ? q0 - 1 : 0; q <= q0 + 1; ++q) {
+        base = negative ? -q * d : q * d;
+        __div_mod_add(c, base + __div_mod_clamp(sx - base, a, b));
     }
-    if (sub_constant > 0) {
-        wi_modify_size(wi, add_sub_const_size);
-        if (!should_invert)
-            wi_update_add(wi, sub_constant);
-        else {
-            wi_update_invert(wi);
-            wi_update_add(wi, sub_constant);
+}
+
+static int __div_mod_group(fuzzy_ctx_t* ctx, Z3_ast e, index_group_t* ig)
+{
+    // the dividend is a group, possibly zero extended
+    while (Z3_get_ast_kind(ctx->z3_ctx, e) == Z3_APP_AST) {
+        Z3_app       app  = Z3_to_app(ctx->z3_ctx, e);
+        Z3_func_decl decl = Z3_get_app_decl(ctx->z3_ctx, app);
+        Z3_decl_kind kind = Z3_get_decl_kind(ctx->z3_ctx, decl);
+        uint64_t     v;
+        if (kind == Z3_OP_ZERO_EXT) {
+            e = Z3_get_app_arg(ctx->z3_ctx, app, 0);
+            continue;
+        }
+        if (kind == Z3_OP_CONCAT &&
+            Z3_get_app_num_args(ctx->z3_ctx, app) == 2 &&
+            Z3_get_ast_kind(ctx->z3_ctx,
+                            Z3_get_app_arg(ctx->z3_ctx, app, 0)) ==
+                Z3_NUMERAL_AST &&
+            Z3_get_numeral_uint64(ctx->z3_ctx,
+                                  Z3_get_app_arg(ctx->z3_ctx, app, 0), &v) &&
+            v == 0) {
+            e = Z3_get_app_arg(ctx->z3_ctx, app, 1);
+            continue;
         }
+        break;
     }
-    wi_modify_size(wi, ig->n * 8);
-
-    const wrapped_interval_t* cached_wi =
-        interval_group_get_interval(group_intervals, ig);
-    if (!performing_aggressive_optimistic && cached_wi != NULL)
-        wi_intersect(wi, cached_wi);
 
-    res = 1;
-OUT:
-    Z3_dec_ref(ctx->z3_ctx, expr);
-    return res;
+    char approx = 0;
+    memset(ig, 0, sizeof(index_group_t));
+    if (!__detect_input_group(ctx, e, ig, &approx) || ig->n == 0 ||
+        ig->n > 8 || approx)
+        return 0;
+    return Z3_get_sort_kind(ctx->z3_ctx, Z3_get_sort(ctx->z3_ctx, e)) ==
+               Z3_BV_SORT &&
+           Z3_get_bv_sort_size(ctx->z3_ctx, Z3_get_sort(ctx->z3_ctx, e)) ==
+               8 * ig->n;
 }
 
-static inline int __check_univocally_defined(fuzzy_ctx_t* ctx, Z3_ast expr)
+// cmp(f(group, d), k), where f is a division, a remainder or a mask by the
+// constant d. allowed are the values of f that satisfy the branch
+static int __div_mod_parse(fuzzy_ctx_t* ctx, Z3_ast branch_condition,
+                           Z3_decl_kind* f_kind, uint64_t* d,
+                           unsigned* width, index_group_t* ig,
+                           wrapped_interval_t* allowed)
 {
-    Z3_ast_kind kind = Z3_get_ast_kind(ctx->z3_ctx, expr);
-    if (kind != Z3_APP_AST)
-        return 0;
+    Z3_ast       e      = branch_condition;
+    int          is_not = 0;
+    Z3_app       app;
+    Z3_decl_kind kind;
 
-    Z3_app       app       = Z3_to_app(ctx->z3_ctx, expr);
-    Z3_func_decl decl      = Z3_get_app_decl(ctx->z3_ctx, app);
-    Z3_decl_kind decl_kind = Z3_get_decl_kind(ctx->z3_ctx, decl);
-
-    if (decl_kind != Z3_OP_EQ)
+    while (1) {
+        if (Z3_get_ast_kind(ctx->z3_ctx, e) != Z3_APP_AST)
+            return 0;
+        app  = Z3_to_app(ctx->z3_ctx, e);
+        kind = Z3_get_decl_kind(ctx->z3_ctx, Z3_get_app_decl(ctx->z3_ctx, app));
+        if (kind != Z3_OP_NOT)
+            break;
+        e      = Z3_get_app_arg(ctx->z3_ctx, app, 0);
+        is_not = !is_not;
+    }
+    switch (kind) {
+        case Z3_OP_EQ:
+        case Z3_OP_DISTINCT:
+            if (is_not)
+                kind = kind == Z3_OP_EQ ? Z3_OP_DISTINCT : Z3_OP_EQ;
+            break;
+        case Z3_OP_ULT:
+        case Z3_OP_ULEQ:
+        case Z3_OP_UGT:
+        case Z3_OP_UGEQ:
+        case Z3_OP_SLT:
+        case Z3_OP_SLEQ:
+        case Z3_OP_SGT:
+        case Z3_OP_SGEQ:
+            if (is_not)
+                kind = get_opposite_decl_kind(kind);
+            break;
+        default:
+            return 0;
+    }
+    if (Z3_get_app_num_args(ctx->z3_ctx, app) != 2)
         return 0;
 
-    Z3_ast expr_sx = Z3_get_app_arg(ctx->z3_ctx, app, 0);
-    Z3_inc_ref(ctx->z3_ctx, expr_sx);
-    Z3_ast expr_dx = Z3_get_app_arg(ctx->z3_ctx, app, 1);
-    Z3_inc_ref(ctx->z3_ctx, expr_dx);
-
-    ast_info_ptr inputs_sx, inputs_dx, inputs;
-    detect_involved_inputs_wrapper(ctx, expr, &inputs_sx);
-    detect_involved_inputs_wrapper(ctx, expr, &inputs_dx);
-
-    Z3_dec_ref(ctx->z3_ctx, expr_sx);
-    Z3_dec_ref(ctx->z3_ctx, expr_dx);
-
-    if (inputs_sx->input_extract_ops > 0 ||
-        inputs_sx->approximated_groups > 0 ||
-        inputs_dx->input_extract_ops > 0 || inputs_dx->approximated_groups > 0)
-        return 0; // it is not safe to add to univocally defined
+    uint64_t k;
+    unsigned const_operand, const_size;
+    if (!__find_child_constant(ctx->z3_ctx, app, &k, &const_operand,
+                               &const_size) ||
+        const_size > 64)
+        return 0;
 
-    if (inputs_sx->index_groups.size == 1 && inputs_sx->index_groups.size == 0)
-        inputs = inputs_sx;
-    else if (inputs_sx->index_groups.size == 0 &&
-             inputs_sx->index_groups.size == 1)
-        inputs = inputs_dx;
-    else
+    Z3_ast f = Z3_get_app_arg(ctx->z3_ctx, app, const_operand ^ 1);
+    if (Z3_get_ast_kind(ctx->z3_ctx, f) != Z3_APP_AST)
+        return 0;
+    Z3_app f_app = Z3_to_app(ctx->z3_ctx, f);
+    *f_kind =
+        Z3_get_decl_kind(ctx->z3_ctx, Z3_get_app_decl(ctx->z3_ctx, f_app));
+    switch (*f_kind) {
+        case Z3_OP_BUDIV:
+        case Z3_OP_BUDIV_I:
+        case Z3_OP_BSDIV:
+        case Z3_OP_BSDIV_I:
+        case Z3_OP_BUREM:
+        case Z3_OP_BUREM_I:
+        case Z3_OP_BSREM:
+        case Z3_OP_BSREM_I:
+        case Z3_OP_BAND:
+            break;
+        default:
+            return 0;
+    }
+    if (Z3_get_app_num_args(ctx->z3_ctx, f_app) != 2)
         return 0;
 
-    // we have (= something f(INPUT)) in the branch condition
-    // from now on, INPUT is univocally defined (from seed!)
-    // never add INPUT to indexes/index_groups again
-    index_group_t* ig = NULL;
-    set_reset_iter__index_group_t(&inputs->index_groups, 0);
-    set_iter_next__index_group_t(&inputs->index_groups, 0, &ig);
+    // the divisor is the second operand, a mask can be either
+    unsigned f_const_operand, f_const_size;
+    if (!__find_child_constant(ctx->z3_ctx, f_app, d, &f_const_operand,
+                               &f_const_size) ||
+        (*f_kind != Z3_OP_BAND && f_const_operand != 1))
+        return 0;
+    if (!__div_mod_group(
+            ctx, Z3_get_app_arg(ctx->z3_ctx, f_app, f_const_operand ^ 1), ig))
+        return 0;
 
-    unsigned i;
-    for (i = 0; i < ig->n; ++i) {
-        set_add__ulong((set__ulong*)ctx->univocally_defined_inputs,
-                       ig->indexes[i]);
+    *width        = const_size;
+    uint64_t mask = *width == 64 ? -1UL : (1UL << *width) - 1;
+    *allowed      = wi_init(*width);
+    switch (kind) {
+        case Z3_OP_EQ:
+            allowed->min = allowed->max = k;
+            return 1;
+        case Z3_OP_DISTINCT:
+            allowed->min = (k + 1) & mask;
+            allowed->max = (k - 1) & mask;
+            return 1;
+        default: {
+            optype   op   = __find_optype(kind, const_operand, 0);
+            uint64_t smin = 1UL << (*width - 1), smax = smin - 1;
+            if ((op == OP_ULT && k == 0) || (op == OP_UGT && k == mask) ||
+                (op == OP_SLT && k == smin) || (op == OP_SGT && k == smax))
+                return 0; // no value of f
+            return wi_update_cmp(allowed, k, op);
+        }
     }
-    return 1;
 }
 
-static inline int __detect_strcmp_pattern(fuzzy_ctx_t* ctx, Z3_ast ast,
-                                          unsigned long* values)
+static __always_inline int PHASE_div_mod(fuzzy_ctx_t* ctx, Z3_ast query,
+                                         Z3_ast branch_condition,
+                                         unsigned char const** proof,
+                                         unsigned long*        proof_size)
 {
-    /*
-        (... whatever
-            (concat
-                #x0..0
-                (ite (= inp_0 const_0) #b1 #b0)
-                (ite (= inp_1 const_1) #b1 #b0)
-                ...
-                (ite (= inp_i const_i) #b1 #b0)))
-    */
-    Z3_bool     successGet;
-    unsigned    i;
-    Z3_ast_kind kind = Z3_get_ast_kind(ctx->z3_ctx, ast);
-    if (kind != Z3_APP_AST)
+    if (unlikely(skip_div_mod))
         return 0;
 
-    int          res        = 0;
-    Z3_app       app        = Z3_to_app(ctx->z3_ctx, ast);
-    unsigned     num_fields = Z3_get_app_num_args(ctx->z3_ctx, app);
-    Z3_func_decl decl       = Z3_get_app_decl(ctx->z3_ctx, app);
-    Z3_decl_kind decl_kind  = Z3_get_decl_kind(ctx->z3_ctx, decl);
-
-    if (decl_kind == Z3_OP_CONCAT) {
-        res = 1;
-        for (i = 0; i < num_fields; ++i) {
-            Z3_ast      child      = Z3_get_app_arg(ctx->z3_ctx, app, i);
-            Z3_ast_kind child_kind = Z3_get_ast_kind(ctx->z3_ctx, child);
-            if (child_kind == Z3_NUMERAL_AST)
-                continue;
-            if (child_kind == Z3_APP_AST) {
-                Z3_app       child_app = Z3_to_app(ctx->z3_ctx, child);
-                Z3_func_decl child_decl =
-                    Z3_get_app_decl(ctx->z3_ctx, child_app);
-                Z3_decl_kind child_decl_kind =
-                    Z3_get_decl_kind(ctx->z3_ctx, child_decl);
-                if (child_decl_kind != Z3_OP_ITE) {
-                    res = 0;
-                    break;
-                }
-                Z3_ast cond    = Z3_get_app_arg(ctx->z3_ctx, child_app, 0);
-                Z3_ast iftrue  = Z3_get_app_arg(ctx->z3_ctx, child_app, 1);
-                Z3_ast iffalse = Z3_get_app_arg(ctx->z3_ctx, child_app, 2);
-
-                // iftrue must be #b0 or #b1
-                if (Z3_get_ast_kind(ctx->z3_ctx, iftrue) != Z3_NUMERAL_AST) {
-                    res = 0;
-                    break;
-                }
-                uint64_t iftrue_v;
-                successGet = Z3_get_numeral_uint64(ctx->z3_ctx, iftrue,
-                                                   (uint64_t*)&iftrue_v);
-                if (!successGet || (iftrue_v != 0 && iftrue_v != 1)) {
-                    res = 0;
-                    break;
-                }
-                if (Z3_get_ast_kind(ctx->z3_ctx, iffalse) != Z3_NUMERAL_AST) {
-                    res = 0;
-                    break;
-                }
+    index_group_t      ig;
+    wrapped_interval_t allowed;
+    Z3_decl_kind       f_kind;
+    uint64_t           d;
+    unsigned           width;
+    if (!__div_mod_parse(ctx, branch_condition, &f_kind, &d, &width, &ig,
+                         &allowed))
+        return 0;
 
-                // iffalse must be #b0 or #b1
-                uint64_t iffalse_v;
-                successGet = Z3_get_numeral_uint64(ctx->z3_ctx, iftrue,
-                                                   (uint64_t*)&iffalse_v);
-                if (!successGet || (iffalse_v != 0 && iffalse_v != 1)) {
-                    res = 0;
-                    break;
-                }
+#ifdef DEBUG_CHECK_LIGHT
+    Z3FUZZ_LOG("Trying Div Mod\n");
+#endif
+    testcase_t* current_testcase = &ctx->testcases.data[0];
+    int         is_signed = f_kind == Z3_OP_BSDIV || f_kind == Z3_OP_BSDIV_I ||
+                    f_kind == Z3_OP_BSREM || f_kind == Z3_OP_BSREM_I;
+    uint64_t mask       = width == 64 ? -1UL : (1UL << width) - 1;
+    uint64_t group_mask = ig.n == 8 ? -1UL : (1UL << (8 * ig.n)) - 1;
+    uint64_t sign       = 1UL << (width - 1);
+    uint64_t g0 = 0, segs[3][2], g, vals[DIV_MOD_MAX_CANDIDATES];
+    __int128 sx, lo, hi, a, b, ds, dists[DIV_MOD_MAX_CANDIDATES];
+    unsigned i, j, n_segs = 0, n_vals = 0;
+
+    for (i = 0; i < ig.n; ++i)
+        g0 |= tmp_input[ig.indexes[ig.n - i - 1]] << (8 * i);
+
+    // the values of the dividend, it is negative only if not zero extended
+    lo = 0;
+    hi = group_mask;
+    sx = g0;
+    if (is_signed && 8 * ig.n == width) {
+        lo = -(__int128)sign;
+        hi = (__int128)sign - 1;
+        sx = __div_mod_signed(g0, width);
+    }
+
+    // the allowed values of f, as intervals that do not wrap around in the
+    // order of f
+    if (allowed.min <= allowed.max) {
+        segs[n_segs][0]   = allowed.min;
+        segs[n_segs++][1] = allowed.max;
+    } else {
+        segs[n_segs][0]   = allowed.min;
+        segs[n_segs++][1] = mask;
+        segs[n_segs][0]   = 0;
+        segs[n_segs++][1] = allowed.max;
+    }
+    if (is_signed)
+        for (i = 0; i < n_segs; ++i)
+            if (segs[i][0] < sign && segs[i][1] >= sign) {
+                segs[n_segs][0]   = sign;
+                segs[n_segs++][1] = segs[i][1];
+                segs[i][1]        = sign - 1;
+            }
 
-                // cond must be (= inp_i const_i)
-                if (Z3_get_ast_kind(ctx->z3_ctx, cond) != Z3_APP_AST) {
-                    res = 0;
-                    break;
-                }
-                Z3_app       cond_app  = Z3_to_app(ctx->z3_ctx, cond);
-                Z3_func_decl cond_decl = Z3_get_app_decl(ctx->z3_ctx, cond_app);
-                Z3_decl_kind cond_decl_kind =
-                    Z3_get_decl_kind(ctx->z3_ctx, cond_decl);
-                if (cond_decl_kind != Z3_OP_EQ) {
-                    res = 0;
-                    break;
-                }
-                Z3_ast inp_i   = Z3_get_app_arg(ctx->z3_ctx, cond_app, 0);
-                Z3_ast const_i = Z3_get_app_arg(ctx->z3_ctx, cond_app, 1);
-                if (Z3_get_ast_kind(ctx->z3_ctx, inp_i) != Z3_APP_AST) {
-                    res = 0;
+    div_mod_cands_t c = {.n = 0};
+    for (i = 0; i < n_segs; ++i) {
+        a = is_signed ? __div_mod_signed(segs[i][0], width) : segs[i][0];
+        b = is_signed ? __div_mod_signed(segs[i][1], width) : segs[i][1];
+        ds = is_signed ? __div_mod_signed(d, width) : d;
+        switch (f_kind) {
+            case Z3_OP_BUDIV:
+            case Z3_OP_BUDIV_I:
+            case Z3_OP_BSDIV:
+            case Z3_OP_BSDIV_I:
+                if (ds == 0)
                     break;
-                }
-                if (Z3_get_ast_kind(ctx->z3_ctx, const_i) != Z3_NUMERAL_AST) {
-                    res = 0;
+                if (ds < 0)
+                    __div_mod_cands_div(&c, sx, -b, -a, -ds, lo, hi);
+                else
+                    __div_mod_cands_div(&c, sx, a, b, ds, lo, hi);
+                break;
+            case Z3_OP_BUREM:
+            case Z3_OP_BUREM_I:
+            case Z3_OP_BSREM:
+            case Z3_OP_BSREM_I:
+                if (ds == 0)
                     break;
-                }
-                Z3_app       inp_i_app = Z3_to_app(ctx->z3_ctx, inp_i);
-                Z3_func_decl inp_i_decl =
-                    Z3_get_app_decl(ctx->z3_ctx, inp_i_app);
-                Z3_decl_kind inp_i_decl_kind =
-                    Z3_get_decl_kind(ctx->z3_ctx, inp_i_decl);
-                if (inp_i_decl_kind != Z3_OP_UNINTERPRETED) {
-                    res = 0;
+                ds = ds < 0 ? -ds : ds;
+                if (a < 0 && b >= -(ds - 1))
+                    __div_mod_cands_rem(&c, sx, a < -(ds - 1) ? -(ds - 1) : a,
+                                        b > 0 ? 0 : b, ds);
+                if (b >= 0 && a <= ds - 1)
+                    __div_mod_cands_rem(&c, sx, a < 0 ? 0 : a,
+                                        b > ds - 1 ? ds - 1 : b, ds);
+                break;
+            case Z3_OP_BAND: {
+                uint64_t m = d & mask, v, t;
+                if (m != mask && ((m + 1) & m) == 0) {
+                    // alignment: a low mask is a remainder
+                    if (b >= 0 && a <= m)
+                        __div_mod_cands_rem(&c, sx, a, b > m ? m : b, m + 1);
                     break;
                 }
-                int inp_i_idx = Z3_get_symbol_int(
-                    ctx->z3_ctx, Z3_get_decl_name(ctx->z3_ctx, inp_i_decl));
-                uint64_t const_i_v;
-                successGet = Z3_get_numeral_uint64(ctx->z3_ctx, const_i,
-                                                   (uint64_t*)&const_i_v);
-                if (!successGet) {
-                    res = 0;
-                    break;
+                // the bits out of the mask are kept
+                t = ((uint64_t)sx & m) ^ (m & -m);
+                uint64_t tries[6] = {
+                    (uint64_t)__div_mod_clamp((uint64_t)sx & m, a, b),
+                    (uint64_t)a, (uint64_t)b, t, 0, m};
+                for (j = 0; j < 6; ++j) {
+                    v = tries[j];
+                    if ((v & ~m) == 0 && v >= a && v <= b)
+                        __div_mod_add(&c, ((uint64_t)sx & ~m) | v);
                 }
-
-                // finally. Set value
-                values[inp_i_idx] = const_i_v;
-                res               = 1;
-            } else {
-                res = 0;
                 break;
             }
+            default:
+                break;
         }
-        if (res)
-            return res;
     }
 
-    for (i = 0; i < num_fields; ++i) {
-        res |= __detect_strcmp_pattern(ctx, Z3_get_app_arg(ctx->z3_ctx, app, i),
-                                       values);
+    // in the domain of the dividend, without duplicates, by distance from
+    // the seed
+    for (i = 0; i < c.n; ++i) {
+        if (c.v[i] < lo || c.v[i] > hi)
+            continue;
+        g = (uint64_t)c.v[i] & group_mask;
+        if (g == g0)
+            continue;
+        for (j = 0; j < n_vals && vals[j] != g; ++j)
+            ;
+        if (j < n_vals)
+            continue;
+        __int128 dist = c.v[i] > sx ? c.v[i] - sx : sx - c.v[i];
+        for (j = n_vals++; j > 0 && dists[j - 1] > dist; --j) {
+            vals[j]  = vals[j - 1];
+            dists[j] = dists[j - 1];
+        }
+        vals[j]  = g;
+        dists[j] = dist;
     }
 
-    return res;
+    for (i = 0; i < n_vals; ++i) {
+        set_tmp_input_group_to_value(&ig, vals[i]);
+        if (!is_valid_eval_group(ctx, &ig, tmp_input,
+                                 current_testcase->value_sizes,
+                                 current_testcase->values_len))
+            continue;
+        int eval_v = __evaluate_branch_query(
+            ctx, query, branch_condition, tmp_input,
+            current_testcase->value_sizes, current_testcase->values_len);
+        if (eval_v == 1) {
+#ifdef PRINT_SAT
+            Z3FUZZ_LOG("[check light - div mod] Query is SAT\n");
+#endif
+            ctx->stats.div_mod++;
+            ctx->stats.num_sat++;
+            __vals_long_to_char(tmp_input, tmp_proof,
+                                current_testcase->testcase_len);
+            *proof      = tmp_proof;
+            *proof_size = current_testcase->testcase_len;
+            return 1;
+        } else if (unlikely(eval_v == TIMEOUT_V))
+            return TIMEOUT_V;
+    }
+    set_tmp_input_group_to_value(&ig, g0);
+    return 0;
 }
 
-// *************************************************
-// **************** HEURISTICS - END ***************
-// *************************************************
+static inline int ig_has_index(index_group_t* ig, ulong idx)
+{
+    unsigned i;
+    for (i = 0; i < ig->n; ++i) {
+        if (ig->indexes[i] == idx)
+            return 1;
+    }
+    return 0;
+}
 
-static inline void __reset_ast_data()
+static inline int __input_to_input_side(fuzzy_ctx_t* ctx, Z3_ast side,
+                                         index_group_t* ig)
 {
-    set_remove_all__digest_t(&ast_data.processed_set, NULL);
-    da_remove_all__ulong(&ast_data.values, NULL);
+    // the side must read a single group of inputs
+    Z3_sort sort = Z3_get_sort(ctx->z3_ctx, side);
+    if (Z3_get_sort_kind(ctx->z3_ctx, sort) != Z3_BV_SORT ||
+        Z3_get_bv_sort_size(ctx->z3_ctx, sort) > 64)
+        return 0;
 
-    ast_data.is_input_to_state      = 0;
-    ast_data.inputs                 = NULL;
-    ast_data.input_to_state_group.n = 0;
-    ast_data.n_useless_eval         = 0;
+    ast_info_ptr info;
+    detect_involved_inputs_wrapper(ctx, side, &info);
+    if (info->index_groups.size != 1)
+        return 0;
+
+    index_group_t* el = NULL;
+    set_reset_iter__index_group_t(&info->index_groups, 0);
+    set_iter_next__index_group_t(&info->index_groups, 0, &el);
+    *ig = *el;
+    return 1;
 }
 
-static inline void __init_global_data(fuzzy_ctx_t* ctx, Z3_ast query,
-                                      Z3_ast branch_condition)
+static inline int __input_to_input_cmp(fuzzy_ctx_t* ctx,
+                                       Z3_ast branch_condition, Z3_ast* lhs,
+                                       Z3_ast* rhs, Z3_decl_kind* kind)
 {
+    // kind is the comparison once the negations are pushed into it
+    Z3_ast e      = branch_condition;
+    int    is_not = 0;
+    while (Z3_get_ast_kind(ctx->z3_ctx, e) == Z3_APP_AST) {
+        Z3_app       app  = Z3_to_app(ctx->z3_ctx, e);
+        Z3_func_decl decl = Z3_get_app_decl(ctx->z3_ctx, app);
+        Z3_decl_kind k    = Z3_get_decl_kind(ctx->z3_ctx, decl);
+        switch (k) {
+            case Z3_OP_NOT:
+                e      = Z3_get_app_arg(ctx->z3_ctx, app, 0);
+                is_not = !is_not;
+                continue;
+            case Z3_OP_EQ:
+            case Z3_OP_DISTINCT:
+                if (is_not)
+                    k = k == Z3_OP_EQ ? Z3_OP_DISTINCT : Z3_OP_EQ;
+                break;
+            case Z3_OP_ULT:
+            case Z3_OP_ULEQ:
+            case Z3_OP_UGT:
+            case Z3_OP_UGEQ:
+            case Z3_OP_SLT:
+            case Z3_OP_SLEQ:
+            case Z3_OP_SGT:
+            case Z3_OP_SGEQ:
+                if (is_not)
+                    k = get_opposite_decl_kind(k);
+                break;
+            default:
+                return 0;
+        }
+        if (Z3_get_app_num_args(ctx->z3_ctx, app) != 2)
+            return 0;
+        *kind = k;
+        *lhs  = Z3_get_app_arg(ctx->z3_ctx, app, 0);
+        *rhs  = Z3_get_app_arg(ctx->z3_ctx, app, 1);
+        return 1;
+    }
+    return 0;
+}
 
-    opt_found = 0;
+static __always_inline int PHASE_input_to_input(fuzzy_ctx_t* ctx,
+                                                Z3_ast       query,
+                                                Z3_ast branch_condition,
+                                                unsigned char const** proof,
+                                                unsigned long* proof_size)
+{
+    if (unlikely(skip_input_to_input))
+        return 0;
 
-    __reset_ast_data();
+    // branch conditions like 'A op f(B)', where A and B are two different
+    // groups of inputs (e.g., a length field checked against a trailer)
+    Z3_ast        sides[2];
+    index_group_t groups[2];
+    Z3_decl_kind  kind;
+    if (!__input_to_input_cmp(ctx, branch_condition, &sides[0], &sides[1],
+                              &kind))
+        return 0;
+    if (!__input_to_input_side(ctx, sides[0], &groups[0]) ||
+        !__input_to_input_side(ctx, sides[1], &groups[1]))
+        return 0;
 
-    __detect_input_to_state_query(ctx, branch_condition, &ast_data, 0);
-    detect_involved_inputs_wrapper(ctx, branch_condition, &ast_data.inputs);
-    __detect_early_constants(ctx, branch_condition, &ast_data);
+    unsigned i, j;
+    for (i = 0; i < groups[0].n; ++i)
+        if (ig_has_index(&groups[1], groups[0].indexes[i]))
+            return 0;
 
+#ifdef DEBUG_CHECK_LIGHT
+    Z3FUZZ_LOG("Trying Input to Input\n");
+#endif
     testcase_t* current_testcase = &ctx->testcases.data[0];
-    memcpy(tmp_input, current_testcase->values,
-           current_testcase->values_len * sizeof(unsigned long));
+
+    // an equality needs the copy as it is, a disequality one of its
+    // neighbours, the inequalities any of them
+    static const int64_t deltas[]    = {0, 1, -1};
+    unsigned             delta_begin = kind == Z3_OP_DISTINCT ? 1 : 0;
+    unsigned             delta_end   = kind == Z3_OP_EQ ? 1 : 3;
+    unsigned             dir, delta_i, inv;
+    for (dir = 0; dir < 2; ++dir) {
+        index_group_t* dst_group = &groups[dir];
+        Z3_ast         dst_side  = sides[dir];
+        Z3_ast         src_side  = sides[1 - dir];
+
+        unsigned dst_size = Z3_get_bv_sort_size(
+            ctx->z3_ctx, Z3_get_sort(ctx->z3_ctx, dst_side));
+        uint64_t mask = dst_size == 64 ? UINT64_MAX : (1UL << dst_size) - 1;
+
+        // copy the value of the source side, compensating a constant
+        // offset of the destination side (e.g., 'A + c == B')
+        uint64_t target = ctx->model_eval(
+            ctx->z3_ctx, src_side, tmp_input, current_testcase->value_sizes,
+            current_testcase->values_len, NULL);
+        set_tmp_input_group_to_value(dst_group, 0);
+        uint64_t offset = ctx->model_eval(
+            ctx->z3_ctx, dst_side, tmp_input, current_testcase->value_sizes,
+            current_testcase->values_len, NULL);
+        uint64_t v = (target - offset) & mask;
+
+        for (delta_i = delta_begin; delta_i < delta_end; ++delta_i) {
+            // try both byte orders of the destination group
+            for (inv = 0; inv < (dst_group->n > 1 ? 2 : 1); ++inv) {
+                uint64_t c = (v + deltas[delta_i]) & mask;
+                if (inv)
+                    set_tmp_input_group_to_value_inv(dst_group, c);
+                else
+                    set_tmp_input_group_to_value(dst_group, c);
+
+                if (!is_valid_eval_group(ctx, dst_group, tmp_input,
+                                         current_testcase->value_sizes,
+                                         current_testcase->values_len))
+                    continue;
+
+                int eval_v = __evaluate_branch_query(
+                    ctx, query, branch_condition, tmp_input,
+                    current_testcase->value_sizes,
+                    current_testcase->values_len);
+                if (eval_v == 1) {
+#ifdef PRINT_SAT
+                    Z3FUZZ_LOG("[check light - input to input] Query is "
+                               "SAT\n");
+#endif
+                    ctx->stats.input_to_input++;
+                    ctx->stats.num_sat++;
+                    __vals_long_to_char(tmp_input, tmp_proof,
+                                        current_testcase->testcase_len);
+                    *proof      = tmp_proof;
+                    *proof_size = current_testcase->testcase_len;
+                    return 1;
+                } else if (unlikely(eval_v == TIMEOUT_V))
+                    return TIMEOUT_V;
+            }
+        }
+        for (j = 0; j < 2; ++j)
+            restore_tmp_input_group(&groups[j], current_testcase->values);
+    }
+    return 0;
 }
 
-static __always_inline int PHASE_reuse(fuzzy_ctx_t* ctx, Z3_ast query,
-                                       Z3_ast                branch_condition,
-                                       unsigned char const** proof,
-                                       unsigned long*        proof_size)
+static __always_inline int PHASE_input_to_state_extended(
+    fuzzy_ctx_t* ctx, Z3_ast query, Z3_ast branch_condition,
+    unsigned char const** proof, unsigned long* proof_size)
 {
-    if (skip_reuse)
+    if (unlikely(skip_input_to_state_extended))
         return 0;
 
-    ASSERT_OR_ABORT(ctx->testcases.size > 1,
-                    "PHASE_reuse not enough testcases");
+    ASSERT_OR_ABORT(ast_data.values.size > 0 ||
+                        ast_data.inputs->inp_to_state_ite.size > 0,
+                    "PHASE_input_to_state_extended  no early constants");
+
 #ifdef DEBUG_CHECK_LIGHT
-    Z3FUZZ_LOG("Trying REUSE PHASE\n");
+    Z3FUZZ_LOG("Trying Input to State Extended\n");
 #endif
-    unsigned i;
-    for (i = 1; i < ctx->testcases.size; ++i) {
-        testcase_t* testcase = &ctx->testcases.data[i];
+    testcase_t* current_testcase = &ctx->testcases.data[0];
+
+    index_group_t* group;
+    unsigned int   index;
+    unsigned       i;
+    unsigned       k;
+
+    for (i = 0; i < ast_data.values.size; ++i) {
+        set_reset_iter__index_group_t(&ast_data.inputs->index_groups, 0);
+        while (set_iter_next__index_group_t(&ast_data.inputs->index_groups, 0,
+                                            &group)) {
+            // little endian
+            for (k = 0; k < group->n; ++k) {
+                unsigned int  index = group->indexes[group->n - k - 1];
+                unsigned char b =
+                    __extract_from_long(ast_data.values.data[i], k);
+
+#ifdef DEBUG_CHECK_LIGHT
+                Z3FUZZ_LOG("L2 - inj byte: 0x%x @ %d\n", b, index);
+#endif
+                if (tmp_input[index] == (unsigned long)b)
+                    continue;
+
+                tmp_input[index] = b;
+            }
+            int valid_eval = is_valid_eval_group(ctx, group, tmp_input,
+                                                 current_testcase->value_sizes,
+                                                 current_testcase->values_len);
+            if (valid_eval) {
+                int eval_v = __evaluate_branch_query(
+                    ctx, query, branch_condition, tmp_input,
+                    current_testcase->value_sizes,
+                    current_testcase->values_len);
+                if (eval_v == 1) {
+#ifdef PRINT_SAT
+                    Z3FUZZ_LOG("[check light - input to state extended] Query "
+                               "is SAT\n");
+#endif
+                    ctx->stats.input_to_state_ext++;
+                    ctx->stats.num_sat++;
+                    __vals_long_to_char(tmp_input, tmp_proof,
+                                        current_testcase->testcase_len);
+                    *proof      = tmp_proof;
+                    *proof_size = current_testcase->values_len;
+                    return 1;
+                } else if (unlikely(eval_v == TIMEOUT_V))
+                    return TIMEOUT_V;
+            }
+            // big endian
+            for (k = 0; k < group->n; ++k) {
+                unsigned int  index = group->indexes[k];
+                unsigned char b =
+                    __extract_from_long(ast_data.values.data[i], k);
+
+#ifdef DEBUG_CHECK_LIGHT
+                Z3FUZZ_LOG("L2 - inj byte: 0x%x @ %d\n", b, index);
+#endif
+                if (tmp_input[index] == (unsigned long)b)
+                    continue;
+
+                tmp_input[index] = b;
+            }
+            valid_eval = is_valid_eval_group(ctx, group, tmp_input,
+                                             current_testcase->value_sizes,
+                                             current_testcase->values_len);
+            if (valid_eval) {
+                int eval_v = __evaluate_branch_query(
+                    ctx, query, branch_condition, tmp_input,
+                    current_testcase->value_sizes,
+                    current_testcase->values_len);
+                if (eval_v == 1) {
+#ifdef PRINT_SAT
+                    Z3FUZZ_LOG("[check light - input to state extended] Query "
+                               "is SAT\n");
+#endif
+                    ctx->stats.input_to_state_ext++;
+                    ctx->stats.num_sat++;
+                    __vals_long_to_char(tmp_input, tmp_proof,
+                                        current_testcase->testcase_len);
+                    *proof      = tmp_proof;
+                    *proof_size = current_testcase->values_len;
+                    return 1;
+                } else if (unlikely(eval_v == TIMEOUT_V))
+                    return TIMEOUT_V;
+            }
+            // restore tmp_input
+            for (k = 0; k < group->n; ++k) {
+                index            = group->indexes[k];
+                tmp_input[index] = current_testcase->values[index];
+            }
+        }
+    }
+
+    // ite constants
+    for (i = 0; i < ast_data.inputs->inp_to_state_ite.size; ++i) {
+        ite_its_t* its_el = &ast_data.inputs->inp_to_state_ite.data[i];
+        set_tmp_input_group_to_value(&its_el->ig, its_el->val);
+    }
+    int eval_v = __evaluate_branch_query(
+        ctx, query, branch_condition, tmp_input, current_testcase->value_sizes,
+        current_testcase->values_len);
+    if (eval_v == 1) {
+#ifdef PRINT_SAT
+        Z3FUZZ_LOG("[check light - input to state extended] Query "
+                   "is SAT\n");
+#endif
+        ctx->stats.input_to_state_ext++;
+        ctx->stats.num_sat++;
+        __vals_long_to_char(tmp_input, tmp_proof,
+                            current_testcase->testcase_len);
+        *proof      = tmp_proof;
+        *proof_size = current_testcase->values_len;
+        return 1;
+    } else if (unlikely(eval_v == TIMEOUT_V))
+        return TIMEOUT_V;
 
-        int eval_v = __evaluate_branch_query(
-            ctx, query, branch_condition, testcase->values,
-            testcase->value_sizes, testcase->values_len);
-        if (eval_v == 1) {
-#ifdef PRINT_SAT
-            Z3FUZZ_LOG("[check light - reuse] Query is SAT\n");
-#endif
-            __vals_long_to_char(testcase->values, tmp_proof,
-                                testcase->testcase_len);
-            ctx->stats.reuse++;
-            *proof      = tmp_proof;
-            *proof_size = testcase->testcase_len;
-            return 1;
-        } else if (unlikely(eval_v == TIMEOUT_V))
-            return TIMEOUT_V;
+    // restore tmp_input
+    for (i = 0; i < ast_data.inputs->inp_to_state_ite.size; ++i) {
+        ite_its_t* its_el = &ast_data.inputs->inp_to_state_ite.data[i];
+        for (k = 0; k < its_el->ig.n; ++k) {
+            index            = its_el->ig.indexes[k];
+            tmp_input[index] = current_testcase->values[index];
+        }
     }
     return 0;
 }
 
-static __always_inline int PHASE_input_to_state(fuzzy_ctx_t* ctx, Z3_ast query,
-                                                Z3_ast branch_condition,
-                                                unsigned char const** proof,
-                                                unsigned long* proof_size)
+static __always_inline int PHASE_brute_force(fuzzy_ctx_t* ctx, Z3_ast query,
+                                             Z3_ast branch_condition,
+                                             unsigned char const** proof,
+                                             unsigned long*        proof_size)
 {
-    if (unlikely(skip_input_to_state))
-        return 0;
+    if (unlikely(skip_brute_force))
+        return 2;
+
+    testcase_t*        current_testcase = &ctx->testcases.data[0];
+    unsigned long*     uniq_index;
+    index_group_t      ig = {0};
+    wrapped_interval_t wi = wi_init(8);
+    range_prune_iter_t it;
+    uint64_t           val;
 
-    ASSERT_OR_ABORT(ast_data.is_input_to_state,
-                    "PHASE_input_to_state not an input to state query");
 #ifdef DEBUG_CHECK_LIGHT
-    Z3FUZZ_LOG("Trying Input to State\n");
+    Z3FUZZ_LOG("Trying Brute Force\n");
 #endif
-    testcase_t*    current_testcase = &ctx->testcases.data[0];
-    index_group_t* group;
-    unsigned int   index;
-    unsigned char  b;
-    unsigned       k;
-    group = &ast_data.input_to_state_group;
-    for (k = 0; k < group->n; ++k) {
-        index = group->indexes[group->n - k - 1];
-        b     = __extract_from_long(ast_data.input_to_state_const, k);
 
-        if (current_testcase->values[index] == (unsigned long)b)
-            continue;
+    uniq_index = NULL;
+    set_reset_iter__ulong(&ast_data.inputs->indexes, 0);
+    set_iter_next__ulong(&ast_data.inputs->indexes, 0, &uniq_index);
 
-#ifdef DEBUG_CHECK_LIGHT
-        Z3FUZZ_LOG("L1 - inj byte: 0x%x @ %d\n", b, index);
-#endif
-        tmp_input[index] = b;
-    }
-    int valid_eval = is_valid_eval_group(ctx, group, tmp_input,
-                                         current_testcase->value_sizes,
-                                         current_testcase->values_len);
-    if (valid_eval) {
-        int eval_v = __evaluate_branch_query(
+    ig.indexes[ig.n++] = *uniq_index;
+    if (fast_eval.ast != branch_condition)
+        __fast_eval_compile(ctx, branch_condition, &fast_eval);
+    __range_prune_init(&it, &fast_eval, &ig, &wi, tmp_input);
+    while (__range_prune_next(&it, &val)) {
+        tmp_input[*uniq_index] = val;
+        int eval_v             = __evaluate_branch_query_unique(
             ctx, query, branch_condition, tmp_input,
             current_testcase->value_sizes, current_testcase->values_len);
         if (eval_v == 1) {
 #ifdef PRINT_SAT
-            Z3FUZZ_LOG("[check light - input to state] Query is SAT\n");
+            Z3FUZZ_LOG("[check light - brute force] "
+                       "Query is SAT\n");
 #endif
-            ctx->stats.input_to_state++;
+            ctx->stats.brute_force++;
             ctx->stats.num_sat++;
             __vals_long_to_char(tmp_input, tmp_proof,
                                 current_testcase->testcase_len);
@@ -3406,298 +6892,913 @@ static __always_inline int PHASE_input_to_state(fuzzy_ctx_t* ctx, Z3_ast query,
         } else if (unlikely(eval_v == TIMEOUT_V))
             return TIMEOUT_V;
     }
+    // if we are here, the query is UNSAT
+    return 0;
+}
 
-    // if (ast_data.op_input_to_state == Z3_OP_EQ)
-    //     // query is UNSAT
-    //     return 2;
+// micro sat: the branch condition and the conjuncts of pi that share inputs
+// with it (transitively) are bit-blasted and handed to a small CDCL solver.
+// The slice is closed, so its answers are exact for the whole query
+#define MICRO_SAT_MAX_BITS 128
+#define MICRO_SAT_MAX_VARS (1 << 18)
+#define MICRO_SAT_MAX_CONFLICTS 20000
+
+typedef struct micro_sat_blaster_t {
+    fuzzy_ctx_t*         ctx;
+    msat_t               s;
+    da__ulong            bits;  // literals of the blasted terms, LSB first
+    dict__blasted_term_t terms; // by ast id
+    da__ulong            free_bytes;
+    da__ulong            free_offsets;
+    unsigned long*       values; // the bytes that are not free
+    msat_lit_t           lit_true;
+} micro_sat_blaster_t;
+
+#define MSAT_BIT(b, off, i) ((msat_lit_t)(b)->bits.data[(off) + (i)])
+
+static inline void __msat_push(micro_sat_blaster_t* b, msat_lit_t l)
+{
+    da_add_item__ulong(&b->bits, l);
+}
 
-    // restore tmp_input
-    for (k = 0; k < group->n; ++k) {
-        index            = group->indexes[group->n - k - 1];
-        tmp_input[index] = (unsigned long)current_testcase->values[index];
+static inline msat_lit_t __msat_new_lit(micro_sat_blaster_t* b)
+{
+    return MSAT_LIT(msat_new_var(&b->s), 0);
+}
+
+static inline void __msat_clause3(micro_sat_blaster_t* b, msat_lit_t l0,
+                                  msat_lit_t l1, msat_lit_t l2, unsigned n)
+{
+    msat_lit_t lits[3] = {l0, l1, l2};
+    msat_add_clause(&b->s, lits, n);
+}
+
+static msat_lit_t __msat_and2(micro_sat_blaster_t* b, msat_lit_t x,
+                              msat_lit_t y)
+{
+    msat_lit_t lit_false = MSAT_NEG(b->lit_true);
+    if (x == lit_false || y == lit_false || x == MSAT_NEG(y))
+        return lit_false;
+    if (x == b->lit_true || x == y)
+        return y;
+    if (y == b->lit_true)
+        return x;
+
+    msat_lit_t o = __msat_new_lit(b);
+    __msat_clause3(b, MSAT_NEG(o), x, 0, 2);
+    __msat_clause3(b, MSAT_NEG(o), y, 0, 2);
+    __msat_clause3(b, o, MSAT_NEG(x), MSAT_NEG(y), 3);
+    return o;
+}
+
+static inline msat_lit_t __msat_or2(micro_sat_blaster_t* b, msat_lit_t x,
+                                    msat_lit_t y)
+{
+    return MSAT_NEG(__msat_and2(b, MSAT_NEG(x), MSAT_NEG(y)));
+}
+
+static msat_lit_t __msat_xor2(micro_sat_blaster_t* b, msat_lit_t x,
+                              msat_lit_t y)
+{
+    msat_lit_t lit_false = MSAT_NEG(b->lit_true);
+    if (x == lit_false)
+        return y;
+    if (y == lit_false)
+        return x;
+    if (x == b->lit_true)
+        return MSAT_NEG(y);
+    if (y == b->lit_true)
+        return MSAT_NEG(x);
+    if (x == y)
+        return lit_false;
+    if (x == MSAT_NEG(y))
+        return b->lit_true;
+
+    msat_lit_t o = __msat_new_lit(b);
+    __msat_clause3(b, MSAT_NEG(o), x, y, 3);
+    __msat_clause3(b, MSAT_NEG(o), MSAT_NEG(x), MSAT_NEG(y), 3);
+    __msat_clause3(b, o, MSAT_NEG(x), y, 3);
+    __msat_clause3(b, o, x, MSAT_NEG(y), 3);
+    return o;
+}
+
+static msat_lit_t __msat_mux(micro_sat_blaster_t* b, msat_lit_t c,
+                             msat_lit_t t, msat_lit_t e)
+{
+    if (c == b->lit_true || t == e)
+        return t;
+    if (c == MSAT_NEG(b->lit_true))
+        return e;
+
+    msat_lit_t o = __msat_new_lit(b);
+    __msat_clause3(b, MSAT_NEG(c), MSAT_NEG(t), o, 3);
+    __msat_clause3(b, MSAT_NEG(c), t, MSAT_NEG(o), 3);
+    __msat_clause3(b, c, MSAT_NEG(e), o, 3);
+    __msat_clause3(b, c, e, MSAT_NEG(o), 3);
+    return o;
+}
+
+static unsigned long __msat_const(micro_sat_blaster_t* b, uint64_t v,
+                                  unsigned width)
+{
+    unsigned long res = b->bits.size;
+    unsigned      i;
+    for (i = 0; i < width; ++i)
+        __msat_push(b, i < 64 && ((v >> i) & 1) ? b->lit_true
+                                                 : MSAT_NEG(b->lit_true));
+    return res;
+}
+
+static unsigned long __msat_add(micro_sat_blaster_t* b, unsigned long x,
+                                unsigned long y, unsigned width,
+                                msat_lit_t carry)
+{
+    unsigned long res = b->bits.size;
+    unsigned      i;
+    for (i = 0; i < width; ++i) {
+        msat_lit_t xi = MSAT_BIT(b, x, i), yi = MSAT_BIT(b, y, i);
+        msat_lit_t t  = __msat_xor2(b, xi, yi);
+        __msat_push(b, __msat_xor2(b, t, carry));
+        if (i + 1 < width)
+            carry = __msat_or2(b, __msat_and2(b, xi, yi),
+                               __msat_and2(b, t, carry));
     }
+    return res;
+}
 
-    return 0;
+static unsigned long __msat_not(micro_sat_blaster_t* b, unsigned long x,
+                                unsigned width)
+{
+    unsigned long res = b->bits.size;
+    unsigned      i;
+    for (i = 0; i < width; ++i)
+        __msat_push(b, MSAT_NEG(MSAT_BIT(b, x, i)));
+    return res;
 }
 
-static __always_inline int PHASE_simple_math(fuzzy_ctx_t* ctx, Z3_ast query,
-                                             Z3_ast branch_condition,
-                                             unsigned char const** proof,
-                                             unsigned long*        proof_size)
+static inline unsigned long __msat_sub(micro_sat_blaster_t* b,
+                                       unsigned long x, unsigned long y,
+                                       unsigned width)
 {
-    if (unlikely(skip_simple_math))
-        return 0;
+    return __msat_add(b, x, __msat_not(b, y, width), width, b->lit_true);
+}
 
-    index_group_t      ig = {0};
-    wrapped_interval_t wi;
-    if (!get_range(ctx, branch_condition, &ig, &wi))
-        return 0;
+static unsigned long __msat_mul(micro_sat_blaster_t* b, unsigned long x,
+                                unsigned long y, unsigned width)
+{
+    // shift and add
+    unsigned long acc = __msat_const(b, 0, width), partial;
+    unsigned      i, j;
+    for (i = 0; i < width; ++i) {
+        msat_lit_t yi = MSAT_BIT(b, y, i);
+        if (yi == MSAT_NEG(b->lit_true))
+            continue;
+        partial = b->bits.size;
+        for (j = 0; j < width; ++j)
+            __msat_push(b, j < i ? MSAT_NEG(b->lit_true)
+                                 : __msat_and2(b, MSAT_BIT(b, x, j - i), yi));
+        acc = __msat_add(b, acc, partial, width, MSAT_NEG(b->lit_true));
+    }
+    return acc;
+}
 
-#ifdef DEBUG_CHECK_LIGHT
-    Z3FUZZ_LOG("Trying Simple Math\n");
-#endif
-    testcase_t*   current_testcase = &ctx->testcases.data[0];
-    unsigned long c;
-    int           i, j, k;
+static unsigned long __msat_bitwise(micro_sat_blaster_t* b, unsigned long x,
+                                    unsigned long y, unsigned width,
+                                    Z3_decl_kind kind)
+{
+    unsigned long res = b->bits.size;
+    unsigned      i;
+    for (i = 0; i < width; ++i) {
+        msat_lit_t xi = MSAT_BIT(b, x, i), yi = MSAT_BIT(b, y, i);
+        __msat_push(b, kind == Z3_OP_BAND  ? __msat_and2(b, xi, yi)
+                       : kind == Z3_OP_BOR ? __msat_or2(b, xi, yi)
+                                           : __msat_xor2(b, xi, yi));
+    }
+    return res;
+}
 
-    if (wi_get_range(&wi) > RANGE_MAX_WIDTH_BRUTE_FORCE)
-        goto TRY_MIN_MAX; // range too wide
+static unsigned long __msat_ite(micro_sat_blaster_t* b, msat_lit_t c,
+                                unsigned long t, unsigned long e,
+                                unsigned width)
+{
+    unsigned long res = b->bits.size;
+    unsigned      i;
+    for (i = 0; i < width; ++i)
+        __msat_push(b, __msat_mux(b, c, MSAT_BIT(b, t, i), MSAT_BIT(b, e, i)));
+    return res;
+}
 
-    wrapped_interval_iter_t it = wi_init_iter_values(&wi);
-    uint64_t                val;
-    while (wi_iter_get_next(&it, &val)) {
-        set_tmp_input_group_to_value(&ig, val);
-        int eval_v = __evaluate_branch_query(
-            ctx, query, branch_condition, tmp_input,
-            current_testcase->value_sizes, current_testcase->values_len);
-        if (eval_v == 1) {
-#ifdef PRINT_SAT
-            Z3FUZZ_LOG("[check light - simple math] Query is SAT\n");
-#endif
-            ctx->stats.simple_math++;
-            ctx->stats.num_sat++;
-            __vals_long_to_char(tmp_input, tmp_proof,
-                                current_testcase->testcase_len);
-            *proof      = tmp_proof;
-            *proof_size = current_testcase->testcase_len;
+static msat_lit_t __msat_eq(micro_sat_blaster_t* b, unsigned long x,
+                            unsigned long y, unsigned width)
+{
+    msat_lit_t res = b->lit_true;
+    unsigned   i;
+    for (i = 0; i < width; ++i)
+        res = __msat_and2(
+            b, res,
+            MSAT_NEG(__msat_xor2(b, MSAT_BIT(b, x, i), MSAT_BIT(b, y, i))));
+    return res;
+}
+
+static msat_lit_t __msat_lt(micro_sat_blaster_t* b, unsigned long x,
+                            unsigned long y, unsigned width, int is_signed)
+{
+    // from the LSB to the MSB: the most significant bit that differs decides
+    msat_lit_t res = MSAT_NEG(b->lit_true);
+    unsigned   i;
+    for (i = 0; i < width; ++i) {
+        msat_lit_t xi = MSAT_BIT(b, x, i), yi = MSAT_BIT(b, y, i);
+        res           = __msat_mux(b, __msat_xor2(b, xi, yi),
+                                   is_signed && i == width - 1 ? xi : yi, res);
+    }
+    return res;
+}
+
+static unsigned long __msat_shift(micro_sat_blaster_t* b, unsigned long x,
+                                  unsigned long y, unsigned width,
+                                  Z3_decl_kind kind)
+{
+    msat_lit_t fill = kind == Z3_OP_BASHR ? MSAT_BIT(b, x, width - 1)
+                                          : MSAT_NEG(b->lit_true);
+    msat_lit_t    overflow = MSAT_NEG(b->lit_true), shifted;
+    unsigned long cur      = x, next;
+    unsigned      i, k;
+
+    // barrel shifter, the stages that shift by width or more set overflow
+    for (k = 0; k < width; ++k) {
+        msat_lit_t yk = MSAT_BIT(b, y, k);
+        if (k >= 32 || (1U << k) >= width) {
+            overflow = __msat_or2(b, overflow, yk);
+            continue;
+        }
+        unsigned sh = 1U << k;
+        next        = b->bits.size;
+        for (i = 0; i < width; ++i) {
+            if (kind == Z3_OP_BSHL)
+                shifted =
+                    i >= sh ? MSAT_BIT(b, cur, i - sh) : MSAT_NEG(b->lit_true);
+            else
+                shifted = i + sh < width ? MSAT_BIT(b, cur, i + sh) : fill;
+            __msat_push(b, __msat_mux(b, yk, shifted, MSAT_BIT(b, cur, i)));
+        }
+        cur = next;
+    }
+    if (overflow == MSAT_NEG(b->lit_true))
+        return cur;
+
+    next = b->bits.size;
+    for (i = 0; i < width; ++i)
+        __msat_push(b, __msat_mux(b, overflow, fill, MSAT_BIT(b, cur, i)));
+    return next;
+}
+
+static int __msat_blast(micro_sat_blaster_t* b, Z3_ast node,
+                        unsigned long* off, unsigned* width);
+
+static inline int __msat_blast_arg(micro_sat_blaster_t* b, Z3_app app,
+                                   unsigned i, unsigned long* off)
+{
+    unsigned width;
+    return __msat_blast(b, Z3_get_app_arg(b->ctx->z3_ctx, app, i), off,
+                        &width);
+}
+
+static int __msat_blast_app(micro_sat_blaster_t* b, Z3_ast node,
+                            unsigned long* off, unsigned width)
+{
+    Z3_context    z3        = b->ctx->z3_ctx;
+    Z3_app        app       = Z3_to_app(z3, node);
+    unsigned      num_args  = Z3_get_app_num_args(z3, app);
+    Z3_func_decl  decl      = Z3_get_app_decl(z3, app);
+    Z3_decl_kind  decl_kind = Z3_get_decl_kind(z3, decl);
+    unsigned long x, y, z, i, j;
+    unsigned      child_width;
+    msat_lit_t    l;
+
+    switch (decl_kind) {
+        case Z3_OP_TRUE:
+        case Z3_OP_FALSE:
+            *off = __msat_const(b, decl_kind == Z3_OP_TRUE, 1);
             return 1;
-        } else if (unlikely(eval_v == TIMEOUT_V))
-            return TIMEOUT_V;
+        case Z3_OP_UNINTERPRETED: {
+            Z3_symbol s = Z3_get_decl_name(z3, decl);
+            if (num_args != 0 || Z3_get_symbol_kind(z3, s) != Z3_INT_SYMBOL ||
+                width != 8)
+                return 0;
+            unsigned long idx = Z3_get_symbol_int(z3, s);
+            if (idx >= b->ctx->testcases.data[0].testcase_len)
+                return 0; // assignment
+            for (i = 0; i < b->free_bytes.size; ++i)
+                if (b->free_bytes.data[i] == idx) {
+                    *off = b->free_offsets.data[i];
+                    return 1;
+                }
+            *off = __msat_const(b, b->values[idx], 8);
+            return 1;
+        }
+        case Z3_OP_NOT:
+            if (!__msat_blast_arg(b, app, 0, &x))
+                return 0;
+            *off = __msat_not(b, x, 1);
+            return 1;
+        case Z3_OP_AND:
+        case Z3_OP_OR:
+            l = decl_kind == Z3_OP_AND ? b->lit_true : MSAT_NEG(b->lit_true);
+            for (i = 0; i < num_args; ++i) {
+                if (!__msat_blast_arg(b, app, i, &x))
+                    return 0;
+                l = decl_kind == Z3_OP_AND
+                        ? __msat_and2(b, l, MSAT_BIT(b, x, 0))
+                        : __msat_or2(b, l, MSAT_BIT(b, x, 0));
+            }
+            *off = b->bits.size;
+            __msat_push(b, l);
+            return 1;
+        case Z3_OP_XOR:
+        case Z3_OP_IMPLIES:
+            if (num_args != 2 || !__msat_blast_arg(b, app, 0, &x) ||
+                !__msat_blast_arg(b, app, 1, &y))
+                return 0;
+            *off = b->bits.size;
+            __msat_push(b, decl_kind == Z3_OP_XOR
+                               ? __msat_xor2(b, MSAT_BIT(b, x, 0),
+                                             MSAT_BIT(b, y, 0))
+                               : __msat_or2(b, MSAT_NEG(MSAT_BIT(b, x, 0)),
+                                            MSAT_BIT(b, y, 0)));
+            return 1;
+        case Z3_OP_EQ:
+        case Z3_OP_IFF:
+        case Z3_OP_DISTINCT:
+            if (num_args != 2 ||
+                !__msat_blast(b, Z3_get_app_arg(z3, app, 0), &x,
+                              &child_width) ||
+                !__msat_blast_arg(b, app, 1, &y))
+                return 0;
+            l    = __msat_eq(b, x, y, child_width);
+            *off = b->bits.size;
+            __msat_push(b, decl_kind == Z3_OP_DISTINCT ? MSAT_NEG(l) : l);
+            return 1;
+        case Z3_OP_ULT:
+        case Z3_OP_ULEQ:
+        case Z3_OP_UGT:
+        case Z3_OP_UGEQ:
+        case Z3_OP_SLT:
+        case Z3_OP_SLEQ:
+        case Z3_OP_SGT:
+        case Z3_OP_SGEQ: {
+            int is_signed = decl_kind == Z3_OP_SLT || decl_kind == Z3_OP_SLEQ ||
+                            decl_kind == Z3_OP_SGT || decl_kind == Z3_OP_SGEQ;
+            if (!__msat_blast(b, Z3_get_app_arg(z3, app, 0), &x,
+                              &child_width) ||
+                !__msat_blast_arg(b, app, 1, &y))
+                return 0;
+            // x <= y is not (y < x), x > y is y < x
+            if (decl_kind == Z3_OP_ULEQ || decl_kind == Z3_OP_UGT ||
+                decl_kind == Z3_OP_SLEQ || decl_kind == Z3_OP_SGT) {
+                z = x;
+                x = y;
+                y = z;
+            }
+            l = __msat_lt(b, x, y, child_width, is_signed);
+            if (decl_kind == Z3_OP_ULEQ || decl_kind == Z3_OP_UGEQ ||
+                decl_kind == Z3_OP_SLEQ || decl_kind == Z3_OP_SGEQ)
+                l = MSAT_NEG(l);
+            *off = b->bits.size;
+            __msat_push(b, l);
+            return 1;
+        }
+        case Z3_OP_ITE:
+            if (!__msat_blast_arg(b, app, 0, &x) ||
+                !__msat_blast_arg(b, app, 1, &y) ||
+                !__msat_blast_arg(b, app, 2, &z))
+                return 0;
+            *off = __msat_ite(b, MSAT_BIT(b, x, 0), y, z, width);
+            return 1;
+        case Z3_OP_CONCAT:
+            // blast the arguments first, then copy their (memoized) bits
+            // contiguously. The first argument is the most significant
+            for (i = 0; i < num_args; ++i)
+                if (!__msat_blast_arg(b, app, i, &x))
+                    return 0;
+            *off = b->bits.size;
+            for (i = num_args; i-- > 0;) {
+                __msat_blast(b, Z3_get_app_arg(z3, app, i), &x, &child_width);
+                for (j = 0; j < child_width; ++j)
+                    __msat_push(b, MSAT_BIT(b, x, j));
+            }
+            return 1;
+        case Z3_OP_EXTRACT:
+            if (!__msat_blast_arg(b, app, 0, &x))
+                return 0;
+            *off = x + Z3_get_decl_int_parameter(z3, decl, 1);
+            return 1;
+        case Z3_OP_ZERO_EXT:
+        case Z3_OP_SIGN_EXT:
+            if (!__msat_blast(b, Z3_get_app_arg(z3, app, 0), &x, &child_width))
+                return 0;
+            l    = decl_kind == Z3_OP_ZERO_EXT
+                       ? MSAT_NEG(b->lit_true)
+                       : MSAT_BIT(b, x, child_width - 1);
+            *off = b->bits.size;
+            for (j = 0; j < width; ++j)
+                __msat_push(b, j < child_width ? MSAT_BIT(b, x, j) : l);
+            return 1;
+        case Z3_OP_ROTATE_LEFT:
+        case Z3_OP_ROTATE_RIGHT: {
+            unsigned r = Z3_get_decl_int_parameter(z3, decl, 0) % width;
+            if (!__msat_blast_arg(b, app, 0, &x))
+                return 0;
+            if (decl_kind == Z3_OP_ROTATE_RIGHT)
+                r = (width - r) % width;
+            *off = b->bits.size;
+            for (j = 0; j < width; ++j)
+                __msat_push(b, MSAT_BIT(b, x, (j + width - r) % width));
+            return 1;
+        }
+        case Z3_OP_BNOT:
+            if (!__msat_blast_arg(b, app, 0, &x))
+                return 0;
+            *off = __msat_not(b, x, width);
+            return 1;
+        case Z3_OP_BNEG:
+            if (!__msat_blast_arg(b, app, 0, &x))
+                return 0;
+            *off = __msat_sub(b, __msat_const(b, 0, width), x, width);
+            return 1;
+        case Z3_OP_BADD:
+        case Z3_OP_BSUB:
+        case Z3_OP_BMUL:
+        case Z3_OP_BAND:
+        case Z3_OP_BOR:
+        case Z3_OP_BXOR:
+            if (num_args == 0 || !__msat_blast_arg(b, app, 0, &x))
+                return 0;
+            for (i = 1; i < num_args; ++i) {
+                if (!__msat_blast_arg(b, app, i, &y))
+                    return 0;
+                if (decl_kind == Z3_OP_BADD)
+                    x = __msat_add(b, x, y, width, MSAT_NEG(b->lit_true));
+                else if (decl_kind == Z3_OP_BSUB)
+                    x = __msat_sub(b, x, y, width);
+                else if (decl_kind == Z3_OP_BMUL)
+                    x = __msat_mul(b, x, y, width);
+                else
+                    x = __msat_bitwise(b, x, y, width, decl_kind);
+            }
+            *off = x;
+            return 1;
+        case Z3_OP_BSHL:
+        case Z3_OP_BLSHR:
+        case Z3_OP_BASHR:
+            if (num_args != 2 || !__msat_blast_arg(b, app, 0, &x) ||
+                !__msat_blast_arg(b, app, 1, &y))
+                return 0;
+            *off = __msat_shift(b, x, y, width, decl_kind);
+            return 1;
+        default:
+            // division and remainder are not blasted
+            return 0;
+    }
+}
+
+static int __msat_blast(micro_sat_blaster_t* b, Z3_ast node,
+                        unsigned long* off, unsigned* width)
+{
+    Z3_context      z3 = b->ctx->z3_ctx;
+    unsigned long   id = Z3_get_ast_id(z3, node);
+    blasted_term_t* bt = dict_get_ref__blasted_term_t(&b->terms, id);
+    if (bt != NULL) {
+        *off   = bt->offset;
+        *width = bt->width;
+        return 1;
+    }
+    if (b->s.n_vars > MICRO_SAT_MAX_VARS)
+        return 0;
+
+    Z3_sort      sort      = Z3_get_sort(z3, node);
+    Z3_sort_kind sort_kind = Z3_get_sort_kind(z3, sort);
+    if (sort_kind == Z3_BOOL_SORT)
+        *width = 1;
+    else if (sort_kind == Z3_BV_SORT)
+        *width = Z3_get_bv_sort_size(z3, sort);
+    else
+        return 0;
+
+    switch (Z3_get_ast_kind(z3, node)) {
+        case Z3_NUMERAL_AST: {
+            uint64_t v;
+            if (*width > 64 || !Z3_get_numeral_uint64(z3, node, &v))
+                return 0;
+            *off = __msat_const(b, v, *width);
+            break;
+        }
+        case Z3_APP_AST:
+            if (!__msat_blast_app(b, node, off, *width))
+                return 0;
+            break;
+        default:
+            return 0;
     }
-    return 2;
 
-TRY_MIN_MAX:
-    for (j = 0; j < 2; ++j) {
-        if (j == 0)
-            c = wi.min;
-        else
-            c = wi.max;
+    blasted_term_t el = {.offset = *off, .width = *width};
+    dict_set__blasted_term_t(&b->terms, id, el);
+    return 1;
+}
 
-        for (k = 0; k < ig.n; ++k) {
-            unsigned int  index = ig.indexes[ig.n - k - 1];
-            unsigned char b     = __extract_from_long(c, k);
+static int __micro_sat_should_stop(void* ctx)
+{
+    return timer_check_wrapper((fuzzy_ctx_t*)ctx);
+}
 
-#ifdef DEBUG_CHECK_LIGHT
-            Z3FUZZ_LOG("SM - inj byte: 0x%x @ %d\n", b, index);
-#endif
-            if (current_testcase->values[index] == (unsigned long)b)
+// the conjuncts of the query connected to the branch condition through the
+// inputs they share. 0 if the slice has too many input bits or refers to
+// assignments
+static int __micro_sat_slice(fuzzy_ctx_t* ctx, da__Z3_ast* conjuncts,
+                             unsigned char* in_slice, da__ulong* bytes)
+{
+    ast_info_ptr  info;
+    unsigned long i, j, *p;
+    int           changed = 1, shares;
+
+    // the branch condition is the last conjunct
+    in_slice[conjuncts->size - 1] = 2;
+    while (changed) {
+        changed = 0;
+        for (i = 0; i < conjuncts->size; ++i) {
+            if (in_slice[i] == 1)
+                continue;
+            detect_involved_inputs_wrapper(ctx, conjuncts->data[i], &info);
+            shares = in_slice[i] == 2;
+            set_reset_iter__ulong(&info->indexes, 0);
+            while (!shares && set_iter_next__ulong(&info->indexes, 0, &p))
+                shares = da_check_el__ulong(bytes, *p);
+            for (j = 0; !shares && j < info->indexes_ud.size; ++j)
+                shares = da_check_el__ulong(bytes, info->indexes_ud.data[j]);
+            if (!shares)
                 continue;
 
-            tmp_input[index] = b;
+            if (info->uses_assignments)
+                return 0;
+            in_slice[i] = 1;
+            changed     = 1;
+            set_reset_iter__ulong(&info->indexes, 0);
+            while (set_iter_next__ulong(&info->indexes, 0, &p))
+                if (!da_check_el__ulong(bytes, *p))
+                    da_add_item__ulong(bytes, *p);
+            for (j = 0; j < info->indexes_ud.size; ++j)
+                if (!da_check_el__ulong(bytes, info->indexes_ud.data[j]))
+                    da_add_item__ulong(bytes, info->indexes_ud.data[j]);
+            if (bytes->size * 8 > MICRO_SAT_MAX_BITS)
+                return 0;
         }
-        int valid_eval = is_valid_eval_group(ctx, &ig, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len);
-        if (valid_eval) {
-            int eval_v = __evaluate_branch_query(
+    }
+    return 1;
+}
+
+// with branch_only set, only the branch condition is blasted: a model is not
+// a proof, but its evaluation records the optimistic solution
+static int __micro_sat(fuzzy_ctx_t* ctx, Z3_ast query, Z3_ast branch_condition,
+                       int branch_only, unsigned char const** proof,
+                       unsigned long* proof_size)
+{
+    testcase_t*         current_testcase = &ctx->testcases.data[0];
+    micro_sat_blaster_t b;
+    da__Z3_ast          conjuncts;
+    da__ulong           bytes;
+    unsigned char*      in_slice;
+    unsigned long       i, k, off, saved[MICRO_SAT_MAX_BITS / 8];
+    unsigned            width;
+    int                 with_not, res = 0;
+
+    da_init__Z3_ast(&conjuncts);
+    if (!branch_only) {
+        if (is_and_constraint(ctx, query, &with_not))
+            flatten_and_args(ctx, query, &conjuncts);
+        else {
+            Z3_inc_ref(ctx->z3_ctx, query);
+            da_add_item__Z3_ast(&conjuncts, query);
+        }
+    }
+    Z3_inc_ref(ctx->z3_ctx, branch_condition);
+    da_add_item__Z3_ast(&conjuncts, branch_condition);
+
+    da_init__ulong(&bytes);
+    in_slice = (unsigned char*)calloc(conjuncts.size, 1);
+    ASSERT_OR_ABORT(in_slice != NULL, "PHASE_micro_sat(): calloc failed");
+    if (!__micro_sat_slice(ctx, &conjuncts, in_slice, &bytes)) {
+        free(in_slice);
+        goto OUT_SLICE;
+    }
+
+    b.ctx    = ctx;
+    b.values = tmp_input;
+    msat_init(&b.s);
+    da_init__ulong(&b.bits);
+    da_init__ulong(&b.free_bytes);
+    da_init__ulong(&b.free_offsets);
+    dict_init__blasted_term_t(&b.terms, NULL);
+    b.lit_true = __msat_new_lit(&b);
+    msat_add_clause(&b.s, &b.lit_true, 1);
+
+    // the seed is the first assignment tried by the solver
+    for (i = 0; i < bytes.size; ++i) {
+        da_add_item__ulong(&b.free_bytes, bytes.data[i]);
+        da_add_item__ulong(&b.free_offsets, b.bits.size);
+        for (k = 0; k < 8; ++k) {
+            msat_lit_t l = __msat_new_lit(&b);
+            msat_set_phase(&b.s, MSAT_VAR(l),
+                           (tmp_input[bytes.data[i]] >> k) & 1);
+            __msat_push(&b, l);
+        }
+    }
+    for (i = 0; i < conjuncts.size; ++i) {
+        if (!in_slice[i])
+            continue;
+        if (!__msat_blast(&b, conjuncts.data[i], &off, &width))
+            goto OUT;
+        msat_lit_t l = MSAT_BIT(&b, off, 0);
+        msat_add_clause(&b.s, &l, 1);
+    }
+
+    switch (msat_solve(&b.s, MICRO_SAT_MAX_CONFLICTS,
+                       __micro_sat_should_stop, ctx)) {
+        case MSAT_UNSAT:
+            if (!branch_only)
+                ctx->stats.micro_sat_unsat++;
+            res = 2;
+            break;
+        case MSAT_SAT:
+            for (i = 0; i < bytes.size; ++i) {
+                saved[i]                 = tmp_input[bytes.data[i]];
+                tmp_input[bytes.data[i]] = 0;
+                for (k = 0; k < 8; ++k)
+                    tmp_input[bytes.data[i]] |=
+                        (unsigned long)msat_value(
+                            &b.s, MSAT_VAR(MSAT_BIT(
+                                      &b, b.free_offsets.data[i], k)))
+                        << k;
+            }
+            res = __evaluate_branch_query(
                 ctx, query, branch_condition, tmp_input,
                 current_testcase->value_sizes, current_testcase->values_len);
-            if (eval_v == 1) {
+            if (res == 1) {
 #ifdef PRINT_SAT
-                Z3FUZZ_LOG("[check light - simple math] Query "
-                           "is SAT\n");
+                Z3FUZZ_LOG("[check light - micro sat] "
+                           "Query is SAT\n");
 #endif
-                ctx->stats.simple_math++;
+                ctx->stats.micro_sat++;
                 ctx->stats.num_sat++;
                 __vals_long_to_char(tmp_input, tmp_proof,
                                     current_testcase->testcase_len);
                 *proof      = tmp_proof;
-                *proof_size = current_testcase->values_len;
-                return 1;
-            } else if (unlikely(eval_v == TIMEOUT_V))
-                return TIMEOUT_V;
-        }
-    }
-    for (k = 0; k < ig.n; ++k) {
-        i            = ig.indexes[ig.n - k - 1];
-        tmp_input[i] = current_testcase->values[i];
+                *proof_size = current_testcase->testcase_len;
+                break;
+            }
+            for (i = 0; i < bytes.size; ++i)
+                tmp_input[bytes.data[i]] = saved[i];
+            break;
+        default:
+            break;
     }
-    return 0;
+
+OUT:
+    msat_free(&b.s);
+    da_free__ulong(&b.bits, NULL);
+    da_free__ulong(&b.free_bytes, NULL);
+    da_free__ulong(&b.free_offsets, NULL);
+    dict_free__blasted_term_t(&b.terms);
+    free(in_slice);
+OUT_SLICE:
+    da_free__ulong(&bytes, NULL);
+    for (i = 0; i < conjuncts.size; ++i)
+        Z3_dec_ref(ctx->z3_ctx, conjuncts.data[i]);
+    da_free__Z3_ast(&conjuncts, NULL);
+    return res;
 }
 
-static __always_inline int PHASE_input_to_state_extended(
-    fuzzy_ctx_t* ctx, Z3_ast query, Z3_ast branch_condition,
-    unsigned char const** proof, unsigned long* proof_size)
+static __always_inline int PHASE_micro_sat(fuzzy_ctx_t* ctx, Z3_ast query,
+                                           Z3_ast branch_condition,
+                                           unsigned char const** proof,
+                                           unsigned long*        proof_size)
 {
-    if (unlikely(skip_input_to_state_extended))
+    if (unlikely(skip_micro_sat))
         return 0;
 
-    ASSERT_OR_ABORT(ast_data.values.size > 0 ||
-                        ast_data.inputs->inp_to_state_ite.size > 0,
-                    "PHASE_input_to_state_extended  no early constants");
-
 #ifdef DEBUG_CHECK_LIGHT
-    Z3FUZZ_LOG("Trying Input to State Extended\n");
+    Z3FUZZ_LOG("Trying Micro SAT\n");
 #endif
-    testcase_t* current_testcase = &ctx->testcases.data[0];
 
-    index_group_t* group;
-    unsigned int   index;
-    unsigned       i;
-    unsigned       k;
+    int res = __micro_sat(ctx, query, branch_condition, 0, proof, proof_size);
+    if (res != 2 || opt_found)
+        return res;
 
-    for (i = 0; i < ast_data.values.size; ++i) {
-        set_reset_iter__index_group_t(&ast_data.inputs->index_groups, 0);
-        while (set_iter_next__index_group_t(&ast_data.inputs->index_groups, 0,
-                                            &group)) {
-            // little endian
-            for (k = 0; k < group->n; ++k) {
-                unsigned int  index = group->indexes[group->n - k - 1];
-                unsigned char b =
-                    __extract_from_long(ast_data.values.data[i], k);
+    // the slice is UNSAT, but the clients fall back on the optimistic
+    // solution: look for one by solving the branch condition alone
+    res = __micro_sat(ctx, query, branch_condition, 1, proof, proof_size);
+    if (unlikely(res == TIMEOUT_V))
+        return TIMEOUT_V;
+    // otherwise the next phases look for it
+    return (res == 2 || opt_found) ? 2 : 0;
+}
 
-#ifdef DEBUG_CHECK_LIGHT
-                Z3FUZZ_LOG("L2 - inj byte: 0x%x @ %d\n", b, index);
-#endif
-                if (tmp_input[index] == (unsigned long)b)
-                    continue;
+// parallel multi-start gd: the trajectories start from the seed (or from
+// where the last attempt stopped), from the inputs of the other testcases,
+// from interesting values and from random points. A trajectory ends in a
+// minimum or in a point already visited by some trajectory
+#define GD_STARTS_PER_WORKER 4
+
+typedef enum gd_start_kind_t {
+    GD_START_SEED,
+    GD_START_TESTCASE,
+    GD_START_INTERESTING,
+    GD_START_RANDOM
+} gd_start_kind_t;
+
+typedef struct gd_shared_t {
+    parallel_phase_t   pp;
+    eval_wapper_ctx_t* ew;
+    fast_eval_t        objective;
+    unsigned long*     x0;
+    unsigned long*     best_x; // written with the lock
+    int64_t            best_f;
+} gd_shared_t;
+
+typedef struct gd_start_t {
+    gd_shared_t*    gs;
+    gd_start_kind_t kind;
+    unsigned        testcase_idx;
+} gd_start_t;
+
+typedef struct gd_trajectory_t {
+    gd_shared_t*  gs;
+    tp_worker_t*  w;
+    unsigned long num_evaluate;
+} gd_trajectory_t;
+
+static uint64_t __gd_eval_worker(void* opaque, uint64_t* x, int* should_exit)
+{
+    gd_trajectory_t* tr = (gd_trajectory_t*)opaque;
 
-                tmp_input[index] = b;
-            }
-            int valid_eval = is_valid_eval_group(ctx, group, tmp_input,
-                                                 current_testcase->value_sizes,
-                                                 current_testcase->values_len);
-            if (valid_eval) {
-                int eval_v = __evaluate_branch_query(
-                    ctx, query, branch_condition, tmp_input,
-                    current_testcase->value_sizes,
-                    current_testcase->values_len);
-                if (eval_v == 1) {
-#ifdef PRINT_SAT
-                    Z3FUZZ_LOG("[check light - input to state extended] Query "
-                               "is SAT\n");
-#endif
-                    ctx->stats.input_to_state_ext++;
-                    ctx->stats.num_sat++;
-                    __vals_long_to_char(tmp_input, tmp_proof,
-                                        current_testcase->testcase_len);
-                    *proof      = tmp_proof;
-                    *proof_size = current_testcase->values_len;
-                    return 1;
-                } else if (unlikely(eval_v == TIMEOUT_V))
-                    return TIMEOUT_V;
-            }
-            // big endian
-            for (k = 0; k < group->n; ++k) {
-                unsigned int  index = group->indexes[k];
-                unsigned char b =
-                    __extract_from_long(ast_data.values.data[i], k);
+    *should_exit = 0;
+    if ((++tr->num_evaluate & 15) == 0 &&
+        (thread_pool_cancelled(tr->w) ||
+         __parallel_phase_expired(&tr->gs->pp, tr->w))) {
+        *should_exit = 1;
+        return 0;
+    }
 
-#ifdef DEBUG_CHECK_LIGHT
-                Z3FUZZ_LOG("L2 - inj byte: 0x%x @ %d\n", b, index);
-#endif
-                if (tmp_input[index] == (unsigned long)b)
-                    continue;
+    __gd_fix_input(tr->gs->ew, (unsigned long*)x, tr->w->input);
+    return __fast_eval_run(&tr->gs->objective, tr->w->input);
+}
 
-                tmp_input[index] = b;
-            }
-            valid_eval = is_valid_eval_group(ctx, group, tmp_input,
-                                             current_testcase->value_sizes,
-                                             current_testcase->values_len);
-            if (valid_eval) {
-                int eval_v = __evaluate_branch_query(
-                    ctx, query, branch_condition, tmp_input,
-                    current_testcase->value_sizes,
-                    current_testcase->values_len);
-                if (eval_v == 1) {
-#ifdef PRINT_SAT
-                    Z3FUZZ_LOG("[check light - input to state extended] Query "
-                               "is SAT\n");
-#endif
-                    ctx->stats.input_to_state_ext++;
-                    ctx->stats.num_sat++;
-                    __vals_long_to_char(tmp_input, tmp_proof,
-                                        current_testcase->testcase_len);
-                    *proof      = tmp_proof;
-                    *proof_size = current_testcase->values_len;
-                    return 1;
-                } else if (unlikely(eval_v == TIMEOUT_V))
-                    return TIMEOUT_V;
-            }
-            // restore tmp_input
-            for (k = 0; k < group->n; ++k) {
-                index            = group->indexes[k];
-                tmp_input[index] = current_testcase->values[index];
+static void __gd_start_point(gd_start_t* st, tp_worker_t* w, uint64_t* x)
+{
+    eval_wapper_ctx_t* ew = st->gs->ew;
+    testcase_t*        t;
+    unsigned           i, j;
+    long               v;
+
+    memcpy(x, st->gs->x0, sizeof(uint64_t) * ew->mapping_size);
+    switch (st->kind) {
+        case GD_START_SEED:
+            break;
+        case GD_START_TESTCASE:
+            t = &st->gs->pp.ctx->testcases.data[st->testcase_idx];
+            for (i = 0; i < ew->mapping_size; ++i) {
+                x[i] = 0;
+                for (j = 0; j < ew->mapping[i].n; ++j) {
+                    mapping_subel_t* sel = &ew->mapping[i].subels[j];
+                    if (sel->idx < t->values_len)
+                        x[i] |= (t->values[sel->idx] & 0xff) << sel->shift;
+                }
             }
-        }
+            break;
+        case GD_START_INTERESTING:
+            i = tp_rand_below(w, ew->mapping_size);
+            if (ew->mapping[i].n == 1)
+                v = interesting8[tp_rand_below(w, sizeof(interesting8))];
+            else if (ew->mapping[i].n == 2)
+                v = interesting16[tp_rand_below(
+                    w, sizeof(interesting16) / sizeof(short))];
+            else
+                v = interesting32[tp_rand_below(
+                    w, sizeof(interesting32) / sizeof(int))];
+            x[i] = (unsigned long)v & __fe_mask(8 * ew->mapping[i].n);
+            break;
+        case GD_START_RANDOM:
+            for (i = 0; i < ew->mapping_size; ++i)
+                x[i] = tp_rand(w) & __fe_mask(8 * ew->mapping[i].n);
+            break;
     }
+}
 
-    // ite constants
-    for (i = 0; i < ast_data.inputs->inp_to_state_ite.size; ++i) {
-        ite_its_t* its_el = &ast_data.inputs->inp_to_state_ite.data[i];
-        set_tmp_input_group_to_value(&its_el->ig, its_el->val);
-    }
-    int eval_v = __evaluate_branch_query(
-        ctx, query, branch_condition, tmp_input, current_testcase->value_sizes,
-        current_testcase->values_len);
-    if (eval_v == 1) {
-#ifdef PRINT_SAT
-        Z3FUZZ_LOG("[check light - input to state extended] Query "
-                   "is SAT\n");
-#endif
-        ctx->stats.input_to_state_ext++;
-        ctx->stats.num_sat++;
-        __vals_long_to_char(tmp_input, tmp_proof,
-                            current_testcase->testcase_len);
-        *proof      = tmp_proof;
-        *proof_size = current_testcase->values_len;
-        return 1;
-    } else if (unlikely(eval_v == TIMEOUT_V))
-        return TIMEOUT_V;
+static void __gd_update_best(gd_shared_t* gs, uint64_t* x, int64_t f)
+{
+    if (f >= __atomic_load_n(&gs->best_f, __ATOMIC_RELAXED))
+        return;
 
-    // restore tmp_input
-    for (i = 0; i < ast_data.inputs->inp_to_state_ite.size; ++i) {
-        ite_its_t* its_el = &ast_data.inputs->inp_to_state_ite.data[i];
-        for (k = 0; k < its_el->ig.n; ++k) {
-            index            = its_el->ig.indexes[k];
-            tmp_input[index] = current_testcase->values[index];
-        }
+    pthread_mutex_lock(&gs->pp.lock);
+    if (f < gs->best_f) {
+        __atomic_store_n(&gs->best_f, f, __ATOMIC_RELAXED);
+        memcpy(gs->best_x, x, sizeof(uint64_t) * gs->ew->mapping_size);
     }
-    return 0;
+    pthread_mutex_unlock(&gs->pp.lock);
 }
 
-static __always_inline int PHASE_brute_force(fuzzy_ctx_t* ctx, Z3_ast query,
-                                             Z3_ast branch_condition,
-                                             unsigned char const** proof,
-                                             unsigned long*        proof_size)
+static void __gd_trajectory(tp_worker_t* w, void* arg)
 {
-    if (unlikely(skip_brute_force))
-        return 2;
+    gd_start_t*     st           = (gd_start_t*)arg;
+    gd_shared_t*    gs           = st->gs;
+    unsigned        n            = gs->ew->mapping_size;
+    gd_trajectory_t tr           = {gs, w, 0};
+    gd_function_t   f            = {__gd_eval_worker, &tr};
+    unsigned long   num_evaluate = 0;
+    uint64_t*       x;
+    void*           scratch;
+    uint64_t        val;
+
+    x       = (uint64_t*)tp_arena_alloc(w, sizeof(uint64_t) * n);
+    scratch = tp_arena_alloc(w, gd_scratch_size(n));
+    ASSERT_OR_ABORT(x != NULL && scratch != NULL,
+                    "__gd_trajectory(): tp_arena_alloc failed");
+    memcpy(w->input, gs->pp.start_input,
+           sizeof(unsigned long) * gs->pp.testcase->values_len);
+    __gd_start_point(st, w, x);
+
+    while (!thread_pool_cancelled(w) &&
+           gd_descend_transf_r(&f, x, x, &val, n, scratch) == 0 &&
+           !__candidate_filter_check_or_add(
+               gs->pp.filter, __candidate_fingerprint((unsigned long*)x, n))) {
+        __gd_update_best(gs, x, (int64_t)val);
+        __gd_fix_input(gs->ew, (unsigned long*)x, w->input);
+        num_evaluate++;
+        if (__fast_eval_run(&fast_eval, w->input) &&
+            __parallel_phase_check_query(&gs->pp, w, w->input))
+            break;
+    }
 
-    testcase_t*    current_testcase = &ctx->testcases.data[0];
-    unsigned       i;
-    unsigned long* uniq_index;
+    __parallel_phase_add_stats(&gs->pp, num_evaluate + tr.num_evaluate,
+                               num_evaluate + tr.num_evaluate);
+}
 
-#ifdef DEBUG_CHECK_LIGHT
-    Z3FUZZ_LOG("Trying Brute Force\n");
-#endif
+// 0 if the objective or the branch condition needs Z3. Otherwise *res is
+// the result of the phase, and ew->input the best point reached
+static int __gd_parallel(fuzzy_ctx_t* ctx, Z3_ast query,
+                         Z3_ast branch_condition, Z3_ast objective,
+                         eval_wapper_ctx_t* ew, int* res)
+{
+    gd_shared_t gs;
+    gd_start_t* starts;
+    unsigned    n_starts, n_testcases, i;
 
-    uniq_index = NULL;
-    set_reset_iter__ulong(&ast_data.inputs->indexes, 0);
-    set_iter_next__ulong(&ast_data.inputs->indexes, 0, &uniq_index);
+    if (fast_eval.ast != branch_condition)
+        __fast_eval_compile(ctx, branch_condition, &fast_eval);
+    if (!fast_eval.valid)
+        return 0;
+    __fast_eval_compile_bv(ctx, objective, &gs.objective);
+    if (!gs.objective.valid)
+        return 0;
 
-    for (i = 0; i < 256; ++i) {
-        tmp_input[*uniq_index] = i;
-        int eval_v             = __evaluate_branch_query(
-            ctx, query, branch_condition, tmp_input,
-            current_testcase->value_sizes, current_testcase->values_len);
-        if (eval_v == 1) {
-#ifdef PRINT_SAT
-            Z3FUZZ_LOG("[check light - brute force] "
-                       "Query is SAT\n");
-#endif
-            ctx->stats.brute_force++;
-            ctx->stats.num_sat++;
-            __vals_long_to_char(tmp_input, tmp_proof,
-                                current_testcase->testcase_len);
-            *proof      = tmp_proof;
-            *proof_size = current_testcase->testcase_len;
-            return 1;
-        } else if (unlikely(eval_v == TIMEOUT_V))
-            return TIMEOUT_V;
+    __parallel_phase_init(&gs.pp, ctx, query);
+    gs.ew     = ew;
+    gs.x0     = ew->input;
+    gs.best_f = INT64_MAX;
+    gs.best_x =
+        (unsigned long*)malloc(sizeof(unsigned long) * ew->mapping_size);
+    ASSERT_OR_ABORT(gs.best_x, "__gd_parallel(): malloc failed");
+    memcpy(gs.best_x, ew->input, sizeof(unsigned long) * ew->mapping_size);
+
+    n_starts = GD_STARTS_PER_WORKER * thread_pool.n_workers;
+    starts   = (gd_start_t*)malloc(sizeof(gd_start_t) * n_starts);
+    ASSERT_OR_ABORT(starts, "__gd_parallel(): malloc failed");
+
+    // a quarter of the starts at most from the other testcases
+    n_testcases = ctx->testcases.size - 1;
+    if (n_testcases > n_starts / 4)
+        n_testcases = n_starts / 4;
+    for (i = 0; i < n_testcases; ++i)
+        __concretize_pending_assignments(ctx, i + 1);
+
+    for (i = 0; i < n_starts; ++i) {
+        starts[i].gs           = &gs;
+        starts[i].testcase_idx = 0;
+        if (i == 0)
+            starts[i].kind = GD_START_SEED;
+        else if (i <= n_testcases) {
+            starts[i].kind         = GD_START_TESTCASE;
+            starts[i].testcase_idx = i;
+        } else if (i % 2)
+            starts[i].kind = GD_START_INTERESTING;
+        else
+            starts[i].kind = GD_START_RANDOM;
+        thread_pool_submit(&thread_pool, __gd_trajectory, &starts[i]);
     }
-    // if we are here, the query is UNSAT
-    return 0;
+    *res = __parallel_phase_wait(&gs.pp);
+
+    memcpy(ew->input, gs.best_x, sizeof(unsigned long) * ew->mapping_size);
+    free(gs.best_x);
+    free(starts);
+    return 1;
 }
 
 static __always_inline int
@@ -3728,6 +7829,16 @@ PHASE_gradient_descend(fuzzy_ctx_t* ctx, Z3_ast query, Z3_ast branch_condition,
     set__digest_t digest_set;
     set_init__digest_t(&digest_set, digest_64bit_hash, digest_equals);
 
+    // resume from the point where the last attempt on this branch stopped
+    if (active_checkpoint != NULL && active_checkpoint->gd_input != NULL &&
+        active_checkpoint->gd_input_size == ew.mapping_size)
+        memcpy(ew.input, active_checkpoint->gd_input,
+               sizeof(unsigned long) * ew.mapping_size);
+
+    if (use_thread_pool &&
+        __gd_parallel(ctx, query, branch_condition, out_ast, &ew, &res))
+        goto OUT;
+
     int      gd_ret;
     uint64_t val;
     while (
@@ -3739,21 +7850,8 @@ PHASE_gradient_descend(fuzzy_ctx_t* ctx, Z3_ast query, Z3_ast branch_condition,
         int eval_v = __evaluate_branch_query(
             ctx, query, branch_condition, tmp_input,
             current_testcase->value_sizes, current_testcase->values_len);
-        if (eval_v == 1) {
-#ifdef PRINT_SAT
-            Z3FUZZ_LOG("[check light - gradient descend] "
-                       "Query is SAT\n");
-#endif
-            ctx->stats.gradient_descend++;
-            ctx->stats.num_sat++;
-            __vals_long_to_char(tmp_input, tmp_proof,
-                                current_testcase->testcase_len);
-            *proof      = tmp_proof;
-            *proof_size = current_testcase->testcase_len;
-            res         = 1;
-            goto OUT;
-        } else if (unlikely(eval_v == TIMEOUT_V)) {
-            res = TIMEOUT_V;
+        if (eval_v != 0) {
+            res = eval_v;
             goto OUT;
         }
     }
@@ -3764,6 +7862,26 @@ PHASE_gradient_descend(fuzzy_ctx_t* ctx, Z3_ast query, Z3_ast branch_condition,
 
     __gd_restore_tmp_input(current_testcase);
 OUT:
+    if (res == 1) {
+#ifdef PRINT_SAT
+        Z3FUZZ_LOG("[check light - gradient descend] "
+                   "Query is SAT\n");
+#endif
+        ctx->stats.gradient_descend++;
+        ctx->stats.num_sat++;
+        __vals_long_to_char(tmp_input, tmp_proof,
+                            current_testcase->testcase_len);
+        *proof      = tmp_proof;
+        *proof_size = current_testcase->testcase_len;
+    }
+    if (active_checkpoint != NULL && res == TIMEOUT_V) {
+        active_checkpoint->gd_input = (unsigned long*)realloc(
+            active_checkpoint->gd_input,
+            sizeof(unsigned long) * ew.mapping_size);
+        memcpy(active_checkpoint->gd_input, ew.input,
+               sizeof(unsigned long) * ew.mapping_size);
+        active_checkpoint->gd_input_size = ew.mapping_size;
+    }
     Z3_dec_ref(ctx->z3_ctx, out_ast);
     set_free__digest_t(&digest_set, NULL);
     __gd_free_eval(&ew);
@@ -3792,7 +7910,7 @@ static __always_inline int SUBPHASE_afl_det_single_waliking_bit(
                                              current_testcase->value_sizes,
                                              current_testcase->values_len);
         if (valid_eval) {
-            int eval_v = __evaluate_branch_query(
+            int eval_v = __evaluate_branch_query_unique(
                 ctx, query, branch_condition, tmp_input,
                 current_testcase->value_sizes, current_testcase->values_len);
             if (eval_v == 1) {
@@ -3836,7 +7954,7 @@ static __always_inline int SUBPHASE_afl_det_two_waliking_bits(
                                              current_testcase->values_len);
         if (valid_eval) {
 
-            int eval_v = __evaluate_branch_query(
+            int eval_v = __evaluate_branch_query_unique(
                 ctx, query, branch_condition, tmp_input,
                 current_testcase->value_sizes, current_testcase->values_len);
             if (eval_v == 1) {
@@ -3882,7 +8000,7 @@ static __always_inline int SUBPHASE_afl_det_four_waliking_bits(
                                              current_testcase->value_sizes,
                                              current_testcase->values_len);
         if (valid_eval) {
-            int eval_v = __evaluate_branch_query(
+            int eval_v = __evaluate_branch_query_unique(
                 ctx, query, branch_condition, tmp_input,
                 current_testcase->value_sizes, current_testcase->values_len);
             if (eval_v == 1) {
@@ -5965,14 +10083,391 @@ static __always_inline int PHASE_afl_havoc_mod(fuzzy_ctx_t* ctx, Z3_ast query,
         } else if (unlikely(eval_v == TIMEOUT_V)) {
             havoc_res = TIMEOUT_V;
             break;
-        }
+        }
+    }
+
+    free(indexes);
+    free(ig_16);
+    free(ig_32);
+    free(ig_64);
+    return havoc_res;
+}
+
+typedef struct havoc_pools_t {
+    unsigned long*  indexes;
+    unsigned long   indexes_size;
+    index_group_t** ig_16;
+    unsigned long   ig_16_size;
+    index_group_t** ig_32;
+    unsigned long   ig_32_size;
+    index_group_t** ig_64;
+    unsigned long   ig_64_size;
+    unsigned        mutation_pool;
+} havoc_pools_t;
+
+// workers draw from their own RNG stream, the sequential phase from UR()
+#define HAVOC_R(limit) (w != NULL ? tp_rand_below(w, (limit)) : UR(limit))
+
+// apply a stack of random mutations to input
+static __always_inline void __havoc_stacked_mutations(unsigned long* input,
+                                                      havoc_pools_t* hp,
+                                                      tp_worker_t*   w)
+{
+    index_group_t*  random_group;
+    unsigned long   index_0;
+    unsigned long   index_1;
+    unsigned long   index_2;
+    unsigned long   index_3;
+    unsigned char   val_0;
+    unsigned char   val_1;
+    unsigned char   val_2;
+    unsigned char   val_3;
+    unsigned long   random_index;
+    unsigned        tmp;
+    unsigned        random_tmp;
+    unsigned        j, K;
+    unsigned long*  indexes       = hp->indexes;
+    unsigned long   indexes_size  = hp->indexes_size;
+    index_group_t** ig_16         = hp->ig_16;
+    unsigned long   ig_16_size    = hp->ig_16_size;
+    index_group_t** ig_32         = hp->ig_32;
+    unsigned long   ig_32_size    = hp->ig_32_size;
+    index_group_t** ig_64         = hp->ig_64;
+    unsigned long   ig_64_size    = hp->ig_64_size;
+    unsigned        mutation_pool = hp->mutation_pool;
+
+    K = 1 << (1 + HAVOC_R(HAVOC_STACK_POW2));
+    for (j = 0; j < K; ++j) {
+        switch (HAVOC_R(mutation_pool)) {
+            case 0: {
+                // flip bit
+                random_index = indexes[HAVOC_R(indexes_size)];
+                input[random_index] =
+                    (unsigned long)FLIP_BIT(input[random_index], HAVOC_R(8));
+                break;
+            }
+            case 1: {
+                // set interesting byte
+                random_index        = indexes[HAVOC_R(indexes_size)];
+                input[random_index] = (unsigned long)
+                    interesting8[HAVOC_R(sizeof(interesting8) / sizeof(char))];
+                break;
+            }
+            case 2: {
+                // random subtract byte
+                random_index = indexes[HAVOC_R(indexes_size)];
+                input[random_index] -= (unsigned char)(HAVOC_R(35) + 1);
+                break;
+            }
+            case 3: {
+                // random add byte
+                random_index = indexes[HAVOC_R(indexes_size)];
+                input[random_index] += (unsigned char)(HAVOC_R(35) + 1);
+                break;
+            }
+            case 4: {
+                // random, byte set
+                random_index = indexes[HAVOC_R(indexes_size)];
+                input[random_index] ^= (unsigned char)(HAVOC_R(255) + 1);
+                break;
+            }
+            case 5: {
+                // set interesting word
+                unsigned pool = HAVOC_R(ig_16_size + ig_32_size + ig_64_size);
+                if (pool < ig_16_size) {
+                    // word group
+                    random_group = ig_16[pool];
+                    index_0      = random_group->indexes[0];
+                    index_1      = random_group->indexes[1];
+                } else if (pool < ig_32_size + ig_16_size) {
+                    // dword group
+                    random_group = ig_32[pool - ig_16_size];
+                    random_tmp   = HAVOC_R(3);
+                    index_0      = random_group->indexes[random_tmp];
+                    index_1      = random_group->indexes[random_tmp + 1];
+                } else {
+                    // qword group
+                    random_group = ig_64[pool - ig_32_size - ig_16_size];
+                    random_tmp   = HAVOC_R(7);
+                    index_0      = random_group->indexes[random_tmp];
+                    index_1      = random_group->indexes[random_tmp + 1];
+                }
+
+                short interesting_16 = interesting16[HAVOC_R(
+                    sizeof(interesting16) / sizeof(short))];
+                val_0                = interesting_16 & 0xff;
+                val_1                = (interesting_16 >> 8) & 0xff;
+                if (HAVOC_R(2)) {
+                    tmp     = index_0;
+                    index_0 = index_1;
+                    index_1 = tmp;
+                }
+                input[index_0] = val_0;
+                input[index_1] = val_1;
+                break;
+            }
+            case 6: {
+                // random subtract word
+                unsigned pool = HAVOC_R(ig_16_size + ig_32_size + ig_64_size);
+                if (pool < ig_16_size) {
+                    // word group
+                    random_group = ig_16[pool];
+                    index_0      = random_group->indexes[0];
+                    index_1      = random_group->indexes[1];
+                } else if (pool < ig_32_size + ig_16_size) {
+                    // dword group
+                    random_group = ig_32[pool - ig_16_size];
+                    random_tmp   = HAVOC_R(3);
+                    index_0      = random_group->indexes[random_tmp];
+                    index_1      = random_group->indexes[random_tmp + 1];
+                } else {
+                    // qword group
+                    random_group = ig_64[pool - ig_32_size - ig_16_size];
+                    random_tmp   = HAVOC_R(7);
+                    index_0      = random_group->indexes[random_tmp];
+                    index_1      = random_group->indexes[random_tmp + 1];
+                }
+
+                if (HAVOC_R(2)) {
+                    tmp     = index_0;
+                    index_0 = index_1;
+                    index_1 = tmp;
+                }
+                short val = (input[index_1] << 8) | input[index_0];
+                val -= HAVOC_R(35) + 1;
+                input[index_0] = val & 0xff;
+                input[index_1] = (val >> 8) & 0xff;
+                break;
+            }
+            case 7: {
+                // random add word
+                unsigned pool = HAVOC_R(ig_16_size + ig_32_size + ig_64_size);
+                if (pool < ig_16_size) {
+                    // word group
+                    random_group = ig_16[pool];
+                    index_0      = random_group->indexes[0];
+                    index_1      = random_group->indexes[1];
+                } else if (pool < ig_32_size + ig_16_size) {
+                    // dword group
+                    random_group = ig_32[pool - ig_16_size];
+                    random_tmp   = HAVOC_R(3);
+                    index_0      = random_group->indexes[random_tmp];
+                    index_1      = random_group->indexes[random_tmp + 1];
+                } else {
+                    // qword group
+                    random_group = ig_64[pool - ig_32_size - ig_16_size];
+                    random_tmp   = HAVOC_R(7);
+                    index_0      = random_group->indexes[random_tmp];
+                    index_1      = random_group->indexes[random_tmp + 1];
+                }
+
+                if (HAVOC_R(2)) {
+                    tmp     = index_0;
+                    index_0 = index_1;
+                    index_1 = tmp;
+                }
+                short val = (input[index_1] << 8) | input[index_0];
+                val += HAVOC_R(35) + 1;
+                input[index_0] = val & 0xff;
+                input[index_1] = (val >> 8) & 0xff;
+                break;
+            }
+            case 8: {
+                // set interesting dword
+                unsigned pool = HAVOC_R(ig_32_size + ig_64_size);
+                if (pool < ig_32_size) {
+                    // dword group
+                    random_group = ig_32[pool];
+                    index_0      = random_group->indexes[0];
+                    index_1      = random_group->indexes[1];
+                    index_2      = random_group->indexes[2];
+                    index_3      = random_group->indexes[3];
+                } else {
+                    // qword group
+                    random_group = ig_64[pool - ig_32_size];
+                    random_tmp   = HAVOC_R(5);
+                    index_0      = random_group->indexes[random_tmp];
+                    index_1      = random_group->indexes[random_tmp + 1];
+                    index_2      = random_group->indexes[random_tmp + 2];
+                    index_3      = random_group->indexes[random_tmp + 3];
+                }
+
+                int interesting_32 =
+                    interesting32[HAVOC_R(sizeof(interesting32) / sizeof(int))];
+                val_0 = interesting_32 & 0xff;
+                val_1 = (interesting_32 >> 8) & 0xff;
+                val_2 = (interesting_32 >> 16) & 0xff;
+                val_3 = (interesting_32 >> 24) & 0xff;
+                if (HAVOC_R(2)) {
+                    tmp     = index_0;
+                    index_0 = index_3;
+                    index_3 = tmp;
+
+                    tmp     = index_2;
+                    index_2 = index_3;
+                    index_3 = tmp;
+                }
+                input[index_0] = val_0;
+                input[index_1] = val_1;
+                input[index_2] = val_2;
+                input[index_3] = val_3;
+                break;
+            }
+            case 9: {
+                // random subtract dword
+                unsigned pool = HAVOC_R(ig_32_size + ig_64_size);
+                if (pool < ig_32_size) {
+                    // dword group
+                    random_group = ig_32[pool];
+                    index_0      = random_group->indexes[0];
+                    index_1      = random_group->indexes[1];
+                    index_2      = random_group->indexes[2];
+                    index_3      = random_group->indexes[3];
+                } else {
+                    // qword group
+                    random_group = ig_64[pool - ig_32_size];
+                    random_tmp   = HAVOC_R(5);
+                    index_0      = random_group->indexes[random_tmp];
+                    index_1      = random_group->indexes[random_tmp + 1];
+                    index_2      = random_group->indexes[random_tmp + 2];
+                    index_3      = random_group->indexes[random_tmp + 3];
+                }
+                if (HAVOC_R(2)) {
+                    tmp     = index_0;
+                    index_0 = index_3;
+                    index_3 = tmp;
+
+                    tmp     = index_2;
+                    index_2 = index_3;
+                    index_3 = tmp;
+                }
+
+                int val = (input[index_3] << 24) |
+                          (input[index_2] << 16) |
+                          (input[index_1] << 8) | input[index_0];
+                val -= HAVOC_R(35) + 1;
+                input[index_0] = val & 0xff;
+                input[index_1] = (val >> 8) & 0xff;
+                input[index_2] = (val >> 16) & 0xff;
+                input[index_3] = (val >> 24) & 0xff;
+                break;
+            }
+            case 10: {
+                // random add dword
+                unsigned pool = HAVOC_R(ig_32_size + ig_64_size);
+                if (pool < ig_32_size) {
+                    // dword group
+                    random_group = ig_32[pool];
+                    index_0      = random_group->indexes[0];
+                    index_1      = random_group->indexes[1];
+                    index_2      = random_group->indexes[2];
+                    index_3      = random_group->indexes[3];
+                } else {
+                    // qword group
+                    random_group = ig_64[pool - ig_32_size];
+                    random_tmp   = HAVOC_R(5);
+                    index_0      = random_group->indexes[random_tmp];
+                    index_1      = random_group->indexes[random_tmp + 1];
+                    index_2      = random_group->indexes[random_tmp + 2];
+                    index_3      = random_group->indexes[random_tmp + 3];
+                }
+                if (HAVOC_R(2)) {
+                    tmp     = index_0;
+                    index_0 = index_3;
+                    index_3 = tmp;
+
+                    tmp     = index_2;
+                    index_2 = index_3;
+                    index_3 = tmp;
+                }
+
+                int val = (input[index_3] << 24) |
+                          (input[index_2] << 16) |
+                          (input[index_1] << 8) | input[index_0];
+                val += HAVOC_R(35) + 1;
+                input[index_0] = val & 0xff;
+                input[index_1] = (val >> 8) & 0xff;
+                input[index_2] = (val >> 16) & 0xff;
+                input[index_3] = (val >> 24) & 0xff;
+                break;
+            }
+            default: {
+                ASSERT_OR_ABORT(0, "havoc default case");
+            }
+        }
+    }
+}
+
+#undef HAVOC_R
+
+// parallel havoc: every worker carries on its own random walk from the
+// same input
+typedef struct havoc_shared_t {
+    parallel_phase_t pp;
+    havoc_pools_t*   hp;
+    unsigned         score;
+    unsigned         next_round;
+    int              walk_saved;
+} havoc_shared_t;
+
+static void __afl_havoc_worker(tp_worker_t* w, void* arg)
+{
+    havoc_shared_t* hs                = (havoc_shared_t*)arg;
+    fuzzy_ctx_t*    ctx               = hs->pp.ctx;
+    testcase_t*     t                 = hs->pp.testcase;
+    unsigned long*  input             = w->input;
+    unsigned long   num_evaluate      = 0;
+    unsigned long   num_fast_evaluate = 0;
+    unsigned        n_round;
+
+    memcpy(input, hs->pp.start_input, sizeof(unsigned long) * t->values_len);
+    while (!thread_pool_cancelled(w)) {
+        n_round = __atomic_fetch_add(&hs->next_round, 1, __ATOMIC_RELAXED);
+        if (n_round >= hs->score)
+            break;
+        if ((n_round & 15) == 0 && __parallel_phase_expired(&hs->pp, w))
+            break;
+
+        __havoc_stacked_mutations(input, hs->hp, w);
+        num_evaluate++;
+        if (check_unnecessary_eval &&
+            __candidate_filter_check_or_add(
+                hs->pp.filter, __candidate_fingerprint(input, ctx->n_symbols)))
+            continue;
+        num_fast_evaluate++;
+        if (__fast_eval_run(&fast_eval, input) &&
+            __parallel_phase_check_query(&hs->pp, w, input))
+            break;
     }
 
-    free(indexes);
-    free(ig_16);
-    free(ig_32);
-    free(ig_64);
-    return havoc_res;
+    // the next attempt on this branch carries on the walk of the first
+    // worker that gives up
+    pthread_mutex_lock(&hs->pp.lock);
+    if (hs->pp.res != 1 && !hs->walk_saved) {
+        memcpy(tmp_input, input, sizeof(unsigned long) * t->values_len);
+        hs->walk_saved = 1;
+    }
+    pthread_mutex_unlock(&hs->pp.lock);
+
+    __parallel_phase_add_stats(&hs->pp, num_evaluate, num_fast_evaluate);
+}
+
+// the solution (or the walk to carry on) is left in tmp_input
+static int __afl_havoc_parallel(fuzzy_ctx_t* ctx, Z3_ast query,
+                                havoc_pools_t* hp, unsigned score)
+{
+    havoc_shared_t hs;
+    unsigned       i;
+
+    __parallel_phase_init(&hs.pp, ctx, query);
+    hs.hp         = hp;
+    hs.score      = score;
+    hs.next_round = 0;
+    hs.walk_saved = 0;
+
+    for (i = 0; i < thread_pool.n_workers; ++i)
+        thread_pool_submit(&thread_pool, __afl_havoc_worker, &hs);
+    return __parallel_phase_wait(&hs.pp);
 }
 
 static __always_inline int PHASE_afl_havoc(fuzzy_ctx_t* ctx, Z3_ast query,
@@ -5988,54 +10483,34 @@ static __always_inline int PHASE_afl_havoc(fuzzy_ctx_t* ctx, Z3_ast query,
     Z3FUZZ_LOG("Trying AFL Havoc\n");
 #endif
 
-    int             havoc_res;
-    index_group_t*  random_group;
-    unsigned long   random_index;
-    unsigned long   index_0;
-    unsigned long   index_1;
-    unsigned long   index_2;
-    unsigned long   index_3;
-    unsigned char   val_0;
-    unsigned char   val_1;
-    unsigned char   val_2;
-    unsigned char   val_3;
-    unsigned        tmp;
-    unsigned        random_tmp;
-    unsigned        mutation_pool;
-    unsigned        score;
-    unsigned long*  indexes;
-    unsigned long   indexes_size;
-    index_group_t** ig_16;
-    unsigned long   ig_16_size;
-    index_group_t** ig_32;
-    unsigned long   ig_32_size;
-    index_group_t** ig_64;
-    unsigned long   ig_64_size;
-    testcase_t*     current_testcase = &ctx->testcases.data[0];
-    index_group_t*  group;
+    int            havoc_res;
+    unsigned       score;
+    havoc_pools_t  hp;
+    testcase_t*    current_testcase = &ctx->testcases.data[0];
+    index_group_t* group;
 
-    unsigned i, j;
+    unsigned i;
     ulong*   p;
 
     // initialize list input
-    indexes      = (unsigned long*)malloc(ast_data.inputs->indexes.size *
-                                     sizeof(unsigned long));
-    indexes_size = ast_data.inputs->indexes.size;
+    hp.indexes      = (unsigned long*)malloc(ast_data.inputs->indexes.size *
+                                        sizeof(unsigned long));
+    hp.indexes_size = ast_data.inputs->indexes.size;
     // initialize groups input
-    ig_16      = (index_group_t**)malloc(ast_data.inputs->index_groups.size *
-                                    sizeof(index_group_t*));
-    ig_16_size = 0;
-    ig_32      = (index_group_t**)malloc(ast_data.inputs->index_groups.size *
-                                    sizeof(index_group_t*));
-    ig_32_size = 0;
-    ig_64      = (index_group_t**)malloc(ast_data.inputs->index_groups.size *
-                                    sizeof(index_group_t*));
-    ig_64_size = 0;
+    hp.ig_16      = (index_group_t**)malloc(ast_data.inputs->index_groups.size *
+                                       sizeof(index_group_t*));
+    hp.ig_16_size = 0;
+    hp.ig_32      = (index_group_t**)malloc(ast_data.inputs->index_groups.size *
+                                       sizeof(index_group_t*));
+    hp.ig_32_size = 0;
+    hp.ig_64      = (index_group_t**)malloc(ast_data.inputs->index_groups.size *
+                                       sizeof(index_group_t*));
+    hp.ig_64_size = 0;
 
     i = 0;
     set_reset_iter__ulong(&ast_data.inputs->indexes, 1);
     while (set_iter_next__ulong(&ast_data.inputs->indexes, 1, &p)) {
-        indexes[i++] = *p;
+        hp.indexes[i++] = *p;
     }
     set_reset_iter__index_group_t(&ast_data.inputs->index_groups, 1);
     while (set_iter_next__index_group_t(&ast_data.inputs->index_groups, 1,
@@ -6044,309 +10519,71 @@ static __always_inline int PHASE_afl_havoc(fuzzy_ctx_t* ctx, Z3_ast query,
             case 1:
                 break;
             case 2:
-                ig_16[ig_16_size++] = group;
+                hp.ig_16[hp.ig_16_size++] = group;
                 break;
             case 4:
-                ig_32[ig_32_size++] = group;
+                hp.ig_32[hp.ig_32_size++] = group;
                 break;
             case 8:
-                ig_64[ig_64_size++] = group;
+                hp.ig_64[hp.ig_64_size++] = group;
                 break;
         }
     }
 
-    havoc_res     = 0;
-    mutation_pool = 5 + (ig_64_size + ig_32_size + ig_16_size > 0 ? 3 : 0) +
-                    (ig_64_size + ig_32_size > 0 ? 3 : 0);
-    score = ast_data.inputs->indexes.size * HAVOC_C;
-    for (i = 0; i < score; ++i) {
-        unsigned K = 1 << (1 + UR(HAVOC_STACK_POW2));
-        for (j = 0; j < K; ++j) {
-            switch (UR(mutation_pool)) {
-                case 0: {
-                    // flip bit
-                    random_index = indexes[UR(indexes_size)];
-                    tmp_input[random_index] =
-                        (unsigned long)FLIP_BIT(tmp_input[random_index], UR(8));
-                    break;
-                }
-                case 1: {
-                    // set interesting byte
-                    random_index            = indexes[UR(indexes_size)];
-                    tmp_input[random_index] = (unsigned long)
-                        interesting8[UR(sizeof(interesting8) / sizeof(char))];
-                    break;
-                }
-                case 2: {
-                    // random subtract byte
-                    random_index = indexes[UR(indexes_size)];
-                    tmp_input[random_index] -= (unsigned char)(UR(35) + 1);
-                    break;
-                }
-                case 3: {
-                    // random add byte
-                    random_index = indexes[UR(indexes_size)];
-                    tmp_input[random_index] += (unsigned char)(UR(35) + 1);
-                    break;
-                }
-                case 4: {
-                    // random, byte set
-                    random_index = indexes[UR(indexes_size)];
-                    tmp_input[random_index] ^= (unsigned char)(UR(255) + 1);
-                    break;
-                }
-                case 5: {
-                    // set interesting word
-                    unsigned pool = UR(ig_16_size + ig_32_size + ig_64_size);
-                    if (pool < ig_16_size) {
-                        // word group
-                        random_group = ig_16[pool];
-                        index_0      = random_group->indexes[0];
-                        index_1      = random_group->indexes[1];
-                    } else if (pool < ig_32_size + ig_16_size) {
-                        // dword group
-                        random_group = ig_32[pool - ig_16_size];
-                        random_tmp   = UR(3);
-                        index_0      = random_group->indexes[random_tmp];
-                        index_1      = random_group->indexes[random_tmp + 1];
-                    } else {
-                        // qword group
-                        random_group = ig_64[pool - ig_32_size - ig_16_size];
-                        random_tmp   = UR(7);
-                        index_0      = random_group->indexes[random_tmp];
-                        index_1      = random_group->indexes[random_tmp + 1];
-                    }
-
-                    short interesting_16 = interesting16[UR(
-                        sizeof(interesting16) / sizeof(short))];
-                    val_0                = interesting_16 & 0xff;
-                    val_1                = (interesting_16 >> 8) & 0xff;
-                    if (UR(2)) {
-                        tmp     = index_0;
-                        index_0 = index_1;
-                        index_1 = tmp;
-                    }
-                    tmp_input[index_0] = val_0;
-                    tmp_input[index_1] = val_1;
-                    break;
-                }
-                case 6: {
-                    // random subtract word
-                    unsigned pool = UR(ig_16_size + ig_32_size + ig_64_size);
-                    if (pool < ig_16_size) {
-                        // word group
-                        random_group = ig_16[pool];
-                        index_0      = random_group->indexes[0];
-                        index_1      = random_group->indexes[1];
-                    } else if (pool < ig_32_size + ig_16_size) {
-                        // dword group
-                        random_group = ig_32[pool - ig_16_size];
-                        random_tmp   = UR(3);
-                        index_0      = random_group->indexes[random_tmp];
-                        index_1      = random_group->indexes[random_tmp + 1];
-                    } else {
-                        // qword group
-                        random_group = ig_64[pool - ig_32_size - ig_16_size];
-                        random_tmp   = UR(7);
-                        index_0      = random_group->indexes[random_tmp];
-                        index_1      = random_group->indexes[random_tmp + 1];
-                    }
-
-                    if (UR(2)) {
-                        tmp     = index_0;
-                        index_0 = index_1;
-                        index_1 = tmp;
-                    }
-                    short val = (tmp_input[index_1] << 8) | tmp_input[index_0];
-                    val -= UR(35) + 1;
-                    tmp_input[index_0] = val & 0xff;
-                    tmp_input[index_1] = (val >> 8) & 0xff;
-                    break;
-                }
-                case 7: {
-                    // random add word
-                    unsigned pool = UR(ig_16_size + ig_32_size + ig_64_size);
-                    if (pool < ig_16_size) {
-                        // word group
-                        random_group = ig_16[pool];
-                        index_0      = random_group->indexes[0];
-                        index_1      = random_group->indexes[1];
-                    } else if (pool < ig_32_size + ig_16_size) {
-                        // dword group
-                        random_group = ig_32[pool - ig_16_size];
-                        random_tmp   = UR(3);
-                        index_0      = random_group->indexes[random_tmp];
-                        index_1      = random_group->indexes[random_tmp + 1];
-                    } else {
-                        // qword group
-                        random_group = ig_64[pool - ig_32_size - ig_16_size];
-                        random_tmp   = UR(7);
-                        index_0      = random_group->indexes[random_tmp];
-                        index_1      = random_group->indexes[random_tmp + 1];
-                    }
-
-                    if (UR(2)) {
-                        tmp     = index_0;
-                        index_0 = index_1;
-                        index_1 = tmp;
-                    }
-                    short val = (tmp_input[index_1] << 8) | tmp_input[index_0];
-                    val += UR(35) + 1;
-                    tmp_input[index_0] = val & 0xff;
-                    tmp_input[index_1] = (val >> 8) & 0xff;
-                    break;
-                }
-                case 8: {
-                    // set interesting dword
-                    unsigned pool = UR(ig_32_size + ig_64_size);
-                    if (pool < ig_32_size) {
-                        // dword group
-                        random_group = ig_32[pool];
-                        index_0      = random_group->indexes[0];
-                        index_1      = random_group->indexes[1];
-                        index_2      = random_group->indexes[2];
-                        index_3      = random_group->indexes[3];
-                    } else {
-                        // qword group
-                        random_group = ig_64[pool - ig_32_size];
-                        random_tmp   = UR(5);
-                        index_0      = random_group->indexes[random_tmp];
-                        index_1      = random_group->indexes[random_tmp + 1];
-                        index_2      = random_group->indexes[random_tmp + 2];
-                        index_3      = random_group->indexes[random_tmp + 3];
-                    }
-
-                    int interesting_32 =
-                        interesting32[UR(sizeof(interesting32) / sizeof(int))];
-                    val_0 = interesting_32 & 0xff;
-                    val_1 = (interesting_32 >> 8) & 0xff;
-                    val_2 = (interesting_32 >> 16) & 0xff;
-                    val_3 = (interesting_32 >> 24) & 0xff;
-                    if (UR(2)) {
-                        tmp     = index_0;
-                        index_0 = index_3;
-                        index_3 = tmp;
-
-                        tmp     = index_2;
-                        index_2 = index_3;
-                        index_3 = tmp;
-                    }
-                    tmp_input[index_0] = val_0;
-                    tmp_input[index_1] = val_1;
-                    tmp_input[index_2] = val_2;
-                    tmp_input[index_3] = val_3;
-                    break;
-                }
-                case 9: {
-                    // random subtract dword
-                    unsigned pool = UR(ig_32_size + ig_64_size);
-                    if (pool < ig_32_size) {
-                        // dword group
-                        random_group = ig_32[pool];
-                        index_0      = random_group->indexes[0];
-                        index_1      = random_group->indexes[1];
-                        index_2      = random_group->indexes[2];
-                        index_3      = random_group->indexes[3];
-                    } else {
-                        // qword group
-                        random_group = ig_64[pool - ig_32_size];
-                        random_tmp   = UR(5);
-                        index_0      = random_group->indexes[random_tmp];
-                        index_1      = random_group->indexes[random_tmp + 1];
-                        index_2      = random_group->indexes[random_tmp + 2];
-                        index_3      = random_group->indexes[random_tmp + 3];
-                    }
-                    if (UR(2)) {
-                        tmp     = index_0;
-                        index_0 = index_3;
-                        index_3 = tmp;
-
-                        tmp     = index_2;
-                        index_2 = index_3;
-                        index_3 = tmp;
-                    }
+    // carry on the random walk of the last attempt on this branch
+    if (active_checkpoint != NULL && active_checkpoint->havoc_input != NULL)
+        memcpy(tmp_input, active_checkpoint->havoc_input,
+               sizeof(unsigned long) * active_checkpoint->values_len);
 
-                    int val = (tmp_input[index_3] << 24) |
-                              (tmp_input[index_2] << 16) |
-                              (tmp_input[index_1] << 8) | tmp_input[index_0];
-                    val -= UR(35) + 1;
-                    tmp_input[index_0] = val & 0xff;
-                    tmp_input[index_1] = (val >> 8) & 0xff;
-                    tmp_input[index_2] = (val >> 16) & 0xff;
-                    tmp_input[index_3] = (val >> 24) & 0xff;
-                    break;
-                }
-                case 10: {
-                    // random add dword
-                    unsigned pool = UR(ig_32_size + ig_64_size);
-                    if (pool < ig_32_size) {
-                        // dword group
-                        random_group = ig_32[pool];
-                        index_0      = random_group->indexes[0];
-                        index_1      = random_group->indexes[1];
-                        index_2      = random_group->indexes[2];
-                        index_3      = random_group->indexes[3];
-                    } else {
-                        // qword group
-                        random_group = ig_64[pool - ig_32_size];
-                        random_tmp   = UR(5);
-                        index_0      = random_group->indexes[random_tmp];
-                        index_1      = random_group->indexes[random_tmp + 1];
-                        index_2      = random_group->indexes[random_tmp + 2];
-                        index_3      = random_group->indexes[random_tmp + 3];
-                    }
-                    if (UR(2)) {
-                        tmp     = index_0;
-                        index_0 = index_3;
-                        index_3 = tmp;
-
-                        tmp     = index_2;
-                        index_2 = index_3;
-                        index_3 = tmp;
-                    }
+    havoc_res = 0;
+    hp.mutation_pool =
+        5 + (hp.ig_64_size + hp.ig_32_size + hp.ig_16_size > 0 ? 3 : 0) +
+        (hp.ig_64_size + hp.ig_32_size > 0 ? 3 : 0);
+    score = ast_data.inputs->indexes.size * HAVOC_C;
 
-                    int val = (tmp_input[index_3] << 24) |
-                              (tmp_input[index_2] << 16) |
-                              (tmp_input[index_1] << 8) | tmp_input[index_0];
-                    val += UR(35) + 1;
-                    tmp_input[index_0] = val & 0xff;
-                    tmp_input[index_1] = (val >> 8) & 0xff;
-                    tmp_input[index_2] = (val >> 16) & 0xff;
-                    tmp_input[index_3] = (val >> 24) & 0xff;
-                    break;
-                }
-                default: {
-                    ASSERT_OR_ABORT(0, "havoc default case");
-                }
-            }
+    // the workers need an evaluator of the branch condition that does not
+    // go through Z3
+    if (use_thread_pool && fast_eval.ast != branch_condition)
+        __fast_eval_compile(ctx, branch_condition, &fast_eval);
+    if (use_thread_pool && fast_eval.valid)
+        havoc_res = __afl_havoc_parallel(ctx, query, &hp, score);
+    else {
+        for (i = 0; i < score; ++i) {
+            __havoc_stacked_mutations(tmp_input, &hp, NULL);
+            // do evaluate
+            havoc_res = __evaluate_branch_query(
+                ctx, query, branch_condition, tmp_input,
+                current_testcase->value_sizes, current_testcase->values_len);
+            if (havoc_res != 0)
+                break;
         }
-        // do evaluate
-        int eval_v = __evaluate_branch_query(
-            ctx, query, branch_condition, tmp_input,
-            current_testcase->value_sizes, current_testcase->values_len);
-        if (eval_v == 1) {
+    }
+
+    if (havoc_res == 1) {
 #ifdef PRINT_SAT
-            Z3FUZZ_LOG("[havoc L5] "
-                       "Query is SAT\n");
+        Z3FUZZ_LOG("[havoc L5] "
+                   "Query is SAT\n");
 #endif
-            ctx->stats.havoc++;
-            ctx->stats.num_sat++;
-            __vals_long_to_char(tmp_input, tmp_proof,
-                                current_testcase->testcase_len);
-            *proof      = tmp_proof;
-            *proof_size = current_testcase->testcase_len;
-            havoc_res   = 1;
-            break;
-        } else if (unlikely(eval_v == TIMEOUT_V)) {
-            havoc_res = TIMEOUT_V;
-            break;
-        }
+        ctx->stats.havoc++;
+        ctx->stats.num_sat++;
+        __vals_long_to_char(tmp_input, tmp_proof,
+                            current_testcase->testcase_len);
+        *proof      = tmp_proof;
+        *proof_size = current_testcase->testcase_len;
     }
 
-    free(indexes);
-    free(ig_16);
-    free(ig_32);
-    free(ig_64);
+    if (active_checkpoint != NULL && havoc_res != 1) {
+        if (active_checkpoint->havoc_input == NULL)
+            active_checkpoint->havoc_input = (unsigned long*)malloc(
+                sizeof(unsigned long) * active_checkpoint->values_len);
+        memcpy(active_checkpoint->havoc_input, tmp_input,
+               sizeof(unsigned long) * active_checkpoint->values_len);
+    }
+
+    free(hp.indexes);
+    free(hp.ig_16);
+    free(hp.ig_32);
+    free(hp.ig_64);
     return havoc_res;
 }
 
@@ -6782,11 +11019,14 @@ PHASE_range_bruteforce(fuzzy_ctx_t* ctx, Z3_ast query, Z3_ast branch_condition,
     if (wi_get_range(interval) > RANGE_MAX_WIDTH_BRUTE_FORCE)
         goto TRY_MIN_MAX; // range too wide
 
-    wrapped_interval_iter_t it = wi_init_iter_values(interval);
-    uint64_t                val;
-    while (wi_iter_get_next(&it, &val)) {
+    range_prune_iter_t it;
+    uint64_t           val;
+    if (fast_eval.ast != branch_condition)
+        __fast_eval_compile(ctx, branch_condition, &fast_eval);
+    __range_prune_init(&it, &fast_eval, ig, interval, tmp_input);
+    while (__range_prune_next(&it, &val)) {
         set_tmp_input_group_to_value(ig, val);
-        int eval_v = __evaluate_branch_query(
+        int eval_v = __evaluate_branch_query_unique(
             ctx, query, branch_condition, tmp_input,
             current_testcase->value_sizes, current_testcase->values_len);
         if (eval_v == 1) {
@@ -6884,10 +11124,13 @@ PHASE_range_bruteforce_opt(fuzzy_ctx_t* ctx, Z3_ast query,
         if (interval == 0)
             continue; // no interval
 
-        int                     i  = 0;
-        wrapped_interval_iter_t it = wi_init_iter_values(interval);
-        uint64_t                val;
-        while (wi_iter_get_next(&it, &val)) {
+        int                i = 0;
+        range_prune_iter_t it;
+        uint64_t           val;
+        if (fast_eval.ast != branch_condition)
+            __fast_eval_compile(ctx, branch_condition, &fast_eval);
+        __range_prune_init(&it, &fast_eval, ig, interval, tmp_input);
+        while (__range_prune_next(&it, &val)) {
             if (i++ > RANGE_MAX_WIDTH_BRUTE_FORCE / 4)
                 break;
             set_tmp_input_group_to_value(ig, val);
@@ -6910,7 +11153,377 @@ PHASE_range_bruteforce_opt(fuzzy_ctx_t* ctx, Z3_ast query,
                 return TIMEOUT_V;
         }
     }
-    return 0;
+    return 0;
+}
+
+typedef struct range_box_dim_t {
+    index_group_t      ig;
+    wrapped_interval_t wi;
+    uint64_t           projection;
+    uint64_t           range;
+    uint64_t           mask;
+} range_box_dim_t;
+
+static inline uint64_t __range_box_rand64()
+{
+    return ((uint64_t)UR(1U << 16) << 48) | ((uint64_t)UR(1U << 16) << 32) |
+           ((uint64_t)UR(1U << 16) << 16) | (uint64_t)UR(1U << 16);
+}
+
+static inline int __range_box_add(range_box_dim_t* box, unsigned* n_dims,
+                                  index_group_t* ig, wrapped_interval_t* wi)
+{
+    unsigned i;
+    for (i = 0; i < *n_dims; ++i)
+        if (index_group_equals(&box[i].ig, ig)) {
+            if (box[i].wi.size != wi->size)
+                // the same bytes, read with a different width
+                return 1;
+            return wi_intersect(&box[i].wi, wi);
+        }
+
+    if (*n_dims == RANGE_BOX_MAX_DIMS)
+        return 1;
+    box[*n_dims].ig = *ig;
+    box[*n_dims].wi = *wi;
+    *n_dims += 1;
+    return 1;
+}
+
+static inline unsigned __range_box_build(fuzzy_ctx_t* ctx,
+                                         Z3_ast branch_condition,
+                                         range_box_dim_t* box)
+{
+    set__interval_group_ptr* group_intervals =
+        (set__interval_group_ptr*)ctx->group_intervals;
+    testcase_t* current_testcase = &ctx->testcases.data[0];
+    unsigned    n_dims           = 0;
+
+    // the intervals already known for the groups of the branch condition...
+    index_group_t* ig = NULL;
+    set_reset_iter__index_group_t(&ast_data.inputs->index_groups, 0);
+    while (
+        set_iter_next__index_group_t(&ast_data.inputs->index_groups, 0, &ig)) {
+        wrapped_interval_t* interval =
+            interval_group_get_interval(group_intervals, ig);
+        if (interval != NULL)
+            __range_box_add(box, &n_dims, ig, interval);
+    }
+
+    // ...intersected with the range constraints in the branch condition
+    Z3_app   app      = NULL;
+    unsigned num_args = 1;
+    if (Z3_get_ast_kind(ctx->z3_ctx, branch_condition) == Z3_APP_AST) {
+        Z3_app       bc_app = Z3_to_app(ctx->z3_ctx, branch_condition);
+        Z3_func_decl decl   = Z3_get_app_decl(ctx->z3_ctx, bc_app);
+        if (Z3_get_decl_kind(ctx->z3_ctx, decl) == Z3_OP_AND) {
+            app      = bc_app;
+            num_args = Z3_get_app_num_args(ctx->z3_ctx, app);
+        }
+    }
+
+    unsigned i;
+    unsigned n_ranges = 0;
+    for (i = 0; i < num_args; ++i) {
+        Z3_ast conjunct = app != NULL ? Z3_get_app_arg(ctx->z3_ctx, app, i)
+                                      : branch_condition;
+        index_group_t      range_ig;
+        wrapped_interval_t range_wi;
+        if (!__check_range_constraint(ctx, conjunct, &range_ig, &range_wi))
+            continue;
+        if (!__range_box_add(box, &n_dims, &range_ig, &range_wi))
+            // empty box
+            return 0;
+        n_ranges++;
+    }
+    // sample only boxes the branch condition is actually about
+    if (n_ranges == 0 && n_dims < ast_data.inputs->index_groups.size)
+        return 0;
+
+    for (i = 0; i < n_dims; ++i) {
+        range_box_dim_t* dim = &box[i];
+        uint64_t         mask =
+            dim->wi.size == 64 ? UINT64_MAX : (1UL << dim->wi.size) - 1;
+        uint64_t seed_v =
+            index_group_to_value(&dim->ig, current_testcase->values) & mask;
+
+        dim->mask  = mask;
+        dim->range = wi_get_range(&dim->wi);
+        if (wi_contains_element(&dim->wi, seed_v))
+            dim->projection = seed_v;
+        else if (((seed_v - dim->wi.max) & mask) <
+                 ((dim->wi.min - seed_v) & mask))
+            dim->projection = dim->wi.max;
+        else
+            dim->projection = dim->wi.min;
+    }
+    return n_dims;
+}
+
+static inline void __range_box_fill_batch(range_box_dim_t* box,
+                                          unsigned n_dims, unsigned long step,
+                                          uint64_t batch[][RANGE_BOX_MAX_DIMS])
+{
+    unsigned n_corner_dims = n_dims < RANGE_BOX_MAX_CORNER_DIMS
+                                 ? n_dims
+                                 : RANGE_BOX_MAX_CORNER_DIMS;
+    unsigned long n_corners = 1UL << n_corner_dims;
+    unsigned      i, j;
+
+    // latin hypercube over the box: every dimension visits each of its
+    // RANGE_BOX_BATCH_SIZE strata once per batch
+    unsigned strata[RANGE_BOX_MAX_DIMS][RANGE_BOX_BATCH_SIZE];
+    for (j = 0; j < n_dims; ++j) {
+        for (i = 0; i < RANGE_BOX_BATCH_SIZE; ++i)
+            strata[j][i] = i;
+        for (i = RANGE_BOX_BATCH_SIZE - 1; i > 0; --i) {
+            unsigned r   = UR(i + 1);
+            unsigned tmp = strata[j][i];
+            strata[j][i] = strata[j][r];
+            strata[j][r] = tmp;
+        }
+    }
+
+    for (i = 0; i < RANGE_BOX_BATCH_SIZE; ++i) {
+        unsigned long c = step * RANGE_BOX_BATCH_SIZE + i;
+        for (j = 0; j < n_dims; ++j) {
+            range_box_dim_t* dim = &box[j];
+            uint64_t         v;
+            if (c == 0)
+                // the seed, moved inside the box
+                v = dim->projection;
+            else if (c <= n_corners)
+                v = j < n_corner_dims
+                        ? (((c - 1) >> j) & 1 ? dim->wi.max : dim->wi.min)
+                        : dim->projection;
+            else {
+                uint64_t width = dim->range / RANGE_BOX_BATCH_SIZE;
+                if (width == 0)
+                    v = dim->wi.min + __range_box_rand64() % (dim->range + 1);
+                else
+                    v = dim->wi.min + width * strata[j][i] +
+                        __range_box_rand64() % width;
+            }
+            batch[i][j] = v & dim->mask;
+        }
+    }
+}
+
+static __always_inline int
+PHASE_range_box(fuzzy_ctx_t* ctx, Z3_ast query, Z3_ast branch_condition,
+                unsigned char const** proof, unsigned long* proof_size)
+{
+    if (unlikely(skip_range_box))
+        return 0;
+    if (performing_aggressive_optimistic)
+        return 0;
+
+    // ranges over a single group are enumerated by the range phases
+    range_box_dim_t box[RANGE_BOX_MAX_DIMS];
+    unsigned        n_dims = __range_box_build(ctx, branch_condition, box);
+    if (n_dims < 2)
+        return 0;
+
+#ifdef DEBUG_CHECK_LIGHT
+    Z3FUZZ_LOG("Trying range box sampling [%u dims]\n", n_dims);
+#endif
+
+    testcase_t*   current_testcase = &ctx->testcases.data[0];
+    uint64_t      batch[RANGE_BOX_BATCH_SIZE][RANGE_BOX_MAX_DIMS];
+    unsigned long step;
+    unsigned      i, j;
+    int           res = 0;
+    for (step = 0; step < RANGE_BOX_MAX_SAMPLES / RANGE_BOX_BATCH_SIZE;
+         ++step) {
+        __range_box_fill_batch(box, n_dims, step, batch);
+        for (i = 0; i < RANGE_BOX_BATCH_SIZE; ++i) {
+            for (j = 0; j < n_dims; ++j)
+                set_tmp_input_group_to_value(&box[j].ig, batch[i][j]);
+
+            int eval_v = __evaluate_branch_query(
+                ctx, query, branch_condition, tmp_input,
+                current_testcase->value_sizes, current_testcase->values_len);
+            if (eval_v == 1) {
+#ifdef PRINT_SAT
+                Z3FUZZ_LOG("[check light - range box] Query is SAT\n");
+#endif
+                ctx->stats.range_box++;
+                ctx->stats.num_sat++;
+                __vals_long_to_char(tmp_input, tmp_proof,
+                                    current_testcase->testcase_len);
+                *proof      = tmp_proof;
+                *proof_size = current_testcase->testcase_len;
+                res         = 1;
+                goto OUT;
+            } else if (unlikely(eval_v == TIMEOUT_V)) {
+                res = TIMEOUT_V;
+                goto OUT;
+            }
+        }
+    }
+
+OUT:
+    for (j = 0; j < n_dims; ++j)
+        restore_tmp_input_group(&box[j].ig, current_testcase->values);
+    return res;
+}
+
+static inline unsigned long __checkpoint_knowledge_digest(fuzzy_ctx_t* ctx)
+{
+    // what the phases know besides the query: when it changes, completed
+    // phases could generate different candidates
+    unsigned long digest = ctx->univocally_defined_digest;
+    digest ^= __mix_index(((set__ulong*)ctx->processed_constraints)->size);
+    digest ^= __mix_index(ctx->intervals_version << 20);
+    digest ^= __mix_index((unsigned long)ctx->testcases.size << 40);
+    return digest;
+}
+
+static inline void __checkpoint_collect_conjuncts(fuzzy_ctx_t* ctx,
+                                                  Z3_ast       query,
+                                                  set__ulong*  conjuncts)
+{
+    if (Z3_get_ast_kind(ctx->z3_ctx, query) == Z3_APP_AST) {
+        Z3_app       app  = Z3_to_app(ctx->z3_ctx, query);
+        Z3_func_decl decl = Z3_get_app_decl(ctx->z3_ctx, app);
+        if (Z3_get_decl_kind(ctx->z3_ctx, decl) == Z3_OP_AND) {
+            unsigned i;
+            for (i = 0; i < Z3_get_app_num_args(ctx->z3_ctx, app); ++i)
+                set_add__ulong(conjuncts,
+                               Z3_get_ast_id(ctx->z3_ctx,
+                                             Z3_get_app_arg(ctx->z3_ctx, app,
+                                                            i)));
+            return;
+        }
+    }
+    set_add__ulong(conjuncts, Z3_get_ast_id(ctx->z3_ctx, query));
+}
+
+static int __checkpoint_covers_query(fuzzy_ctx_t* ctx, branch_checkpoint_t* cp,
+                                     Z3_ast query)
+{
+    // the candidates rejected by the last attempt are still rejected if the
+    // new query has (at least) all its conjuncts
+    if (cp->query.ast == query)
+        return 1;
+
+    set__ulong new_conjuncts, old_conjuncts;
+    set_init__ulong(&new_conjuncts, index_hash, index_equals);
+    set_init__ulong(&old_conjuncts, index_hash, index_equals);
+    __checkpoint_collect_conjuncts(ctx, query, &new_conjuncts);
+    __checkpoint_collect_conjuncts(ctx, cp->query.ast, &old_conjuncts);
+
+    int    res = 1;
+    ulong* p;
+    set_reset_iter__ulong(&old_conjuncts, 0);
+    while (set_iter_next__ulong(&old_conjuncts, 0, &p))
+        if (!set_check__ulong(&new_conjuncts, *p)) {
+            res = 0;
+            break;
+        }
+
+    set_free__ulong(&new_conjuncts, NULL);
+    set_free__ulong(&old_conjuncts, NULL);
+    return res;
+}
+
+static branch_checkpoint_t* __checkpoint_begin(fuzzy_ctx_t* ctx, Z3_ast query,
+                                               Z3_ast branch_condition)
+{
+    dict__branch_checkpoint_ptr* checkpoints =
+        (dict__branch_checkpoint_ptr*)ctx->branch_checkpoints;
+    testcase_t*   current_testcase = &ctx->testcases.data[0];
+    unsigned long ast_id = Z3_get_ast_id(ctx->z3_ctx, branch_condition);
+
+    branch_checkpoint_ptr* match =
+        dict_get_ref__branch_checkpoint_ptr(checkpoints, ast_id);
+    if (match == NULL) {
+        if (unlikely(checkpoints->size > max_branch_checkpoints))
+            dict_remove_all__branch_checkpoint_ptr(checkpoints);
+
+        branch_checkpoint_t* cp =
+            (branch_checkpoint_t*)calloc(1, sizeof(branch_checkpoint_t));
+        ASSERT_OR_ABORT(cp, "__checkpoint_begin() failed calloc");
+        da_init__digest_t(&cp->processed);
+        Z3_inc_ref(ctx->z3_ctx, branch_condition);
+        Z3_inc_ref(ctx->z3_ctx, query);
+        cp->branch_condition.ctx = ctx->z3_ctx;
+        cp->branch_condition.ast = branch_condition;
+        cp->query.ctx            = ctx->z3_ctx;
+        cp->query.ast            = query;
+        cp->values_len           = current_testcase->values_len;
+        dict_set__branch_checkpoint_ptr(checkpoints, ast_id, cp);
+        return cp;
+    }
+
+    branch_checkpoint_t* cp = *match;
+    if (cp->values_len != current_testcase->values_len ||
+        !__checkpoint_covers_query(ctx, cp, query)) {
+        branch_checkpoint_reset(cp);
+        cp->values_len = current_testcase->values_len;
+        return cp;
+    }
+
+    // resume: the candidates already evaluated are skipped, and the
+    // optimistic solution is ranked again on the new query
+    ctx->stats.branch_checkpoint_resumes++;
+    unsigned i;
+    for (i = 0; i < cp->processed.size; ++i)
+        set_add__digest_t(&ast_data.processed_set, cp->processed.data[i]);
+
+    if (cp->opt_input != NULL) {
+        uint32_t depth;
+        int      sat = (int)ctx->model_eval(
+            ctx->z3_ctx, query, cp->opt_input, current_testcase->value_sizes,
+            cp->values_len, &depth);
+        if (__update_optimistic_solution(ctx, cp->opt_input, depth) && !sat)
+            __report_optimistic_solution(ctx);
+    }
+
+    if (cp->knowledge_digest != __checkpoint_knowledge_digest(ctx))
+        cp->phase = 0;
+    return cp;
+}
+
+static void __checkpoint_end(fuzzy_ctx_t* ctx, branch_checkpoint_t* cp,
+                             Z3_ast query, int res)
+{
+    if (res == 1) {
+        // the solution is in the digest filter, start again next time
+        branch_checkpoint_reset(cp);
+        return;
+    }
+
+    cp->phase            = current_phase;
+    cp->knowledge_digest = __checkpoint_knowledge_digest(ctx);
+    if (cp->query.ast != query) {
+        Z3_inc_ref(ctx->z3_ctx, query);
+        Z3_dec_ref(ctx->z3_ctx, cp->query.ast);
+        cp->query.ast = query;
+    }
+
+    da_remove_all__digest_t(&cp->processed, NULL);
+    if (ast_data.processed_set.size <= max_checkpoint_digests) {
+        digest_t* d;
+        set_reset_iter__digest_t(&ast_data.processed_set, 0);
+        while (set_iter_next__digest_t(&ast_data.processed_set, 0, &d))
+            da_add_item__digest_t(&cp->processed, *d);
+    }
+
+    if (opt_found) {
+        if (cp->opt_input == NULL)
+            cp->opt_input = (unsigned long*)malloc(sizeof(unsigned long) *
+                                                   cp->values_len);
+        memcpy(cp->opt_input, tmp_opt_input,
+               sizeof(unsigned long) * cp->values_len);
+    }
+}
+
+static __always_inline int __should_run_phase(unsigned phase)
+{
+    // phases completed by the last attempt on the same branch are skipped
+    current_phase = phase;
+    return active_checkpoint == NULL || active_checkpoint->phase <= phase;
 }
 
 static int __query_check_light(fuzzy_ctx_t* ctx, Z3_ast query,
@@ -6930,10 +11543,10 @@ static int __query_check_light(fuzzy_ctx_t* ctx, Z3_ast query,
     testcase_t* current_testcase = &ctx->testcases.data[0];
     int         res;
 
+    current_phase = SEARCH_PHASE_REUSE;
+
     // check if sat in seed
-    int eval_v = __evaluate_branch_query(
-        ctx, query, branch_condition, tmp_input, current_testcase->value_sizes,
-        current_testcase->values_len);
+    int eval_v = __evaluate_branch_query_on_seed(ctx, query, branch_condition);
     if (eval_v == 1) {
 #ifdef DEBUG_CHECK_LIGHT
         Z3FUZZ_LOG("sat in seed... [opt_found = %d]\n", opt_found);
@@ -6948,7 +11561,7 @@ static int __query_check_light(fuzzy_ctx_t* ctx, Z3_ast query,
         return TIMEOUT_V;
 
     // Reuse Phase
-    if (ctx->testcases.size > 1) {
+    if (ctx->testcases.size > 1 && __should_run_phase(SEARCH_PHASE_REUSE)) {
         res = PHASE_reuse(ctx, query, branch_condition, proof, proof_size);
         if (unlikely(res == TIMEOUT_V))
             return TIMEOUT_V;
@@ -6979,7 +11592,8 @@ static int __query_check_light(fuzzy_ctx_t* ctx, Z3_ast query,
     }
 
     // Input to State
-    if (ast_data.is_input_to_state) {
+    if (ast_data.is_input_to_state &&
+        __should_run_phase(SEARCH_PHASE_INPUT_TO_STATE)) {
         // input to state detected
         res = PHASE_input_to_state(ctx, query, branch_condition, proof,
                                    proof_size);
@@ -6992,35 +11606,72 @@ static int __query_check_light(fuzzy_ctx_t* ctx, Z3_ast query,
     }
 
     // Simple math
-    res = PHASE_simple_math(ctx, query, branch_condition, proof, proof_size);
-    if (unlikely(res == TIMEOUT_V))
-        return TIMEOUT_V;
-    if (res == 1)
-        return 1;
-    if (res == 2)
-        return 0;
+    if (__should_run_phase(SEARCH_PHASE_SIMPLE_MATH)) {
+        res =
+            PHASE_simple_math(ctx, query, branch_condition, proof, proof_size);
+        if (unlikely(res == TIMEOUT_V))
+            return TIMEOUT_V;
+        if (res == 1)
+            return 1;
+        if (res == 2)
+            return 0;
+    }
+
+    // Division and remainder by constants
+    if (__should_run_phase(SEARCH_PHASE_DIV_MOD)) {
+        res = PHASE_div_mod(ctx, query, branch_condition, proof, proof_size);
+        if (unlikely(res == TIMEOUT_V))
+            return TIMEOUT_V;
+        if (res == 1)
+            return 1;
+    }
+
+    // Input to Input
+    if (ast_data.inputs->index_groups.size > 1 &&
+        __should_run_phase(SEARCH_PHASE_INPUT_TO_INPUT)) {
+        res = PHASE_input_to_input(ctx, query, branch_condition, proof,
+                                   proof_size);
+        if (unlikely(res == TIMEOUT_V))
+            return TIMEOUT_V;
+        if (res == 1)
+            return 1;
+    }
 
     // Range bruteforce
-    res =
-        PHASE_range_bruteforce(ctx, query, branch_condition, proof, proof_size);
-    if (unlikely(res == TIMEOUT_V))
-        return TIMEOUT_V;
-    if (res == 2)
-        return 0;
-    if (res == 1)
-        return 1;
+    if (__should_run_phase(SEARCH_PHASE_RANGE_BRUTEFORCE)) {
+        res = PHASE_range_bruteforce(ctx, query, branch_condition, proof,
+                                     proof_size);
+        if (unlikely(res == TIMEOUT_V))
+            return TIMEOUT_V;
+        if (res == 2)
+            return 0;
+        if (res == 1)
+            return 1;
+    }
 
     // Range bruteforce optimistic
-    res = PHASE_range_bruteforce_opt(ctx, query, branch_condition, proof,
-                                     proof_size);
-    if (unlikely(res == TIMEOUT_V))
-        return TIMEOUT_V;
-    if (res == 1)
-        return 1;
+    if (__should_run_phase(SEARCH_PHASE_RANGE_BRUTEFORCE_OPT)) {
+        res = PHASE_range_bruteforce_opt(ctx, query, branch_condition, proof,
+                                         proof_size);
+        if (unlikely(res == TIMEOUT_V))
+            return TIMEOUT_V;
+        if (res == 1)
+            return 1;
+    }
+
+    // Range box sampling
+    if (__should_run_phase(SEARCH_PHASE_RANGE_BOX)) {
+        res = PHASE_range_box(ctx, query, branch_condition, proof, proof_size);
+        if (unlikely(res == TIMEOUT_V))
+            return TIMEOUT_V;
+        if (res == 1)
+            return 1;
+    }
 
     // Input to State Extended
-    if (ast_data.values.size > 0 ||
-        ast_data.inputs->inp_to_state_ite.size > 0) {
+    if ((ast_data.values.size > 0 ||
+         ast_data.inputs->inp_to_state_ite.size > 0) &&
+        __should_run_phase(SEARCH_PHASE_INPUT_TO_STATE_EXT)) {
         int res = PHASE_input_to_state_extended(ctx, query, branch_condition,
                                                 proof, proof_size);
         if (unlikely(res == TIMEOUT_V))
@@ -7030,7 +11681,8 @@ static int __query_check_light(fuzzy_ctx_t* ctx, Z3_ast query,
     }
 
     // Pure Brute Force - Only One Byte is Involved
-    if (ast_data.inputs->indexes.size == 1) {
+    if (ast_data.inputs->indexes.size == 1 &&
+        __should_run_phase(SEARCH_PHASE_BRUTE_FORCE)) {
         // if the fase fails, we exit -> the query is UNSAT
         res =
             PHASE_brute_force(ctx, query, branch_condition, proof, proof_size);
@@ -7040,28 +11692,45 @@ static int __query_check_light(fuzzy_ctx_t* ctx, Z3_ast query,
             return res;
     }
 
+    // Micro SAT - exact on small bit-blasted slices of the query
+    if (__should_run_phase(SEARCH_PHASE_MICRO_SAT)) {
+        res = PHASE_micro_sat(ctx, query, branch_condition, proof, proof_size);
+        if (unlikely(res == TIMEOUT_V))
+            return TIMEOUT_V;
+        if (res == 2)
+            return 0;
+        if (res == 1)
+            return 1;
+    }
+
     // Gradient Based Transformation
-    res =
-        PHASE_gradient_descend(ctx, query, branch_condition, proof, proof_size);
-    if (unlikely(res == TIMEOUT_V))
-        return TIMEOUT_V;
-    if (res)
-        return 1;
+    if (__should_run_phase(SEARCH_PHASE_GRADIENT_DESCEND)) {
+        res = PHASE_gradient_descend(ctx, query, branch_condition, proof,
+                                     proof_size);
+        if (unlikely(res == TIMEOUT_V))
+            return TIMEOUT_V;
+        if (res)
+            return 1;
+    }
 
-        // Afl Deterministic Transformations
+    // Afl Deterministic Transformations
+    if (__should_run_phase(SEARCH_PHASE_AFL_DETERMINISTIC)) {
 #ifdef USE_AFL_DET_GROUPS
-    res = PHASE_afl_deterministic_groups(ctx, query, branch_condition, proof,
-                                         proof_size);
+        res = PHASE_afl_deterministic_groups(ctx, query, branch_condition,
+                                             proof, proof_size);
 #else
-    res = PHASE_afl_deterministic(ctx, query, branch_condition, proof,
-                                  proof_size);
+        res = PHASE_afl_deterministic(ctx, query, branch_condition, proof,
+                                      proof_size);
 #endif
-    if (unlikely(res == TIMEOUT_V))
-        return TIMEOUT_V;
-    if (res)
-        return 1;
+        if (unlikely(res == TIMEOUT_V))
+            return TIMEOUT_V;
+        if (res)
+            return 1;
+    }
 
-        // Afl Havoc Transformation
+    // Afl Havoc Transformation, never skipped: a repeated query carries on
+    // the random walk of the last attempt
+    current_phase = SEARCH_PHASE_AFL_HAVOC;
 #ifndef USE_HAVOC_ON_WHOLE_PI
     res = PHASE_afl_havoc(ctx, query, branch_condition, proof, proof_size);
 #elif USE_HAVOC_MOD
@@ -7078,16 +11747,6 @@ static int __query_check_light(fuzzy_ctx_t* ctx, Z3_ast query,
     return 0;
 }
 
-static inline int ig_has_index(index_group_t* ig, ulong idx)
-{
-    unsigned i;
-    for (i = 0; i < ig->n; ++i) {
-        if (ig->indexes[i] == idx)
-            return 1;
-    }
-    return 0;
-}
-
 static inline int find_group_with_all_inputs(index_group_t* ig)
 {
     ulong*         p;
@@ -7246,6 +11905,11 @@ static inline int query_check_light_and_multigoal(fuzzy_ctx_t* ctx,
 
     int res =
         __query_check_light(ctx, query, branch_condition, proof, proof_size);
+    if (active_checkpoint != NULL) {
+        // only the main search is checkpointed
+        __checkpoint_end(ctx, active_checkpoint, query, res);
+        active_checkpoint = NULL;
+    }
     if (unlikely(res == TIMEOUT_V))
         return 0;
 #if 0
@@ -7561,13 +12225,36 @@ static inline int handle_and_constraint(fuzzy_ctx_t* ctx, Z3_ast query,
     return res;
 }
 
-int z3fuzz_query_check_light(fuzzy_ctx_t* ctx, Z3_ast query,
-                             Z3_ast                branch_condition,
-                             unsigned char const** proof,
-                             unsigned long*        proof_size)
+static void __metrics_publish_query(fuzzy_ctx_t*         ctx,
+                                    const fuzzy_stats_t* before,
+                                    unsigned long        time_msec)
 {
-    printf("[log] call z3fuzz_query_check_light(...)\n");
+    // the counters are the increments of the stats during the query
+#define X(field)                                                               \
+    metrics_add(&metrics, METRIC_##field,                                     \
+                ctx->stats.field - before->field);
+    METRICS_STATS(X)
+#undef X
+    metrics_add(&metrics, METRIC_queries, 1);
+    metrics_add(&metrics, METRIC_query_time_msec, time_msec);
+
+    memory_impact_stats_t m_stats;
+    z3fuzz_get_mem_stats(ctx, &m_stats);
+    metrics_set(&metrics, METRIC_ast_info_cache_size,
+                m_stats.ast_info_cache_size);
+    metrics_set(&metrics, METRIC_seed_eval_cache_size,
+                m_stats.seed_eval_cache_size);
+    metrics_set(&metrics, METRIC_branch_checkpoints_size,
+                m_stats.branch_checkpoints_size);
+    metrics_set(&metrics, METRIC_conflicting_ast_size,
+                m_stats.conflicting_ast_size);
+}
 
+static int __z3fuzz_query_check_light(fuzzy_ctx_t* ctx, Z3_ast query,
+                                      Z3_ast                branch_condition,
+                                      unsigned char const** proof,
+                                      unsigned long*        proof_size)
+{
     Z3_inc_ref(ctx->z3_ctx, query);
     Z3_inc_ref(ctx->z3_ctx, branch_condition);
 
@@ -7576,102 +12263,297 @@ int z3fuzz_query_check_light(fuzzy_ctx_t* ctx, Z3_ast query,
     z3fuzz_print_expr(ctx, branch_condition);
 #endif
 
-    int res;
-    *proof_size = 0;
+    int           res;
+    fuzzy_stats_t stats_before = ctx->stats;
+    *proof_size                = 0;
 
     timer_start_wrapper(ctx);
     g_prev_num_evaluate = ctx->stats.num_evaluate;
+    __concretize_pending_assignments(ctx, 0);
 
     __init_global_data(ctx, query, branch_condition);
 
     int with_not;
-    if (is_and_constraint(ctx, branch_condition, &with_not))
-        res = handle_and_constraint(ctx, query, branch_condition, proof,
-                                    proof_size);
-    else
+    if (is_and_constraint(ctx, branch_condition, &with_not)) {
+        // the conjuncts are solved one at a time, a box of ranges over
+        // different groups is sampled as a whole first
+        res = 0;
+        if (!with_not)
+            res = PHASE_range_box(ctx, query, branch_condition, proof,
+                                  proof_size);
+        if (res != 1)
+            res = handle_and_constraint(ctx, query, branch_condition, proof,
+                                        proof_size);
+    } else {
+        // the aggressive optimistic pass re-enters with query = true: it
+        // would replace the checkpoint of the main search
+        if (!skip_branch_checkpoints && !performing_aggressive_optimistic)
+            active_checkpoint =
+                __checkpoint_begin(ctx, query, branch_condition);
         res = query_check_light_and_multigoal(ctx, query, branch_condition,
                                               proof, proof_size);
+    }
 
     if (opt_found)
         ctx->stats.opt_sat += 1;
+    if (use_metrics)
+        __metrics_publish_query(
+            ctx, &stats_before,
+            ctx->timer != NULL ? get_elapsed_time(ctx->timer) : 0);
 
     Z3_dec_ref(ctx->z3_ctx, query);
     Z3_dec_ref(ctx->z3_ctx, branch_condition);
     return res;
 }
 
+int z3fuzz_query_check_light(fuzzy_ctx_t* ctx, Z3_ast query,
+                             Z3_ast                branch_condition,
+                             unsigned char const** proof,
+                             unsigned long*        proof_size)
+{
+    printf("[log] call z3fuzz_query_check_light(...)\n");
+
+    return __z3fuzz_query_check_light(ctx, query, branch_condition, proof,
+                                      proof_size);
+}
+
+int z3fuzz_query_check_light_progressive(
+    fuzzy_ctx_t* ctx, Z3_ast query, Z3_ast branch_condition,
+    unsigned char const** proof, unsigned long* proof_size,
+    fuzzy_findall_res_t (*callback)(unsigned char const* proof,
+                                    unsigned long        proof_size,
+                                    unsigned depth, int is_sat))
+{
+    printf("[log] call z3fuzz_query_check_light_progressive(...)\n");
+
+    // the callback sees every strictly better optimistic solution (its
+    // depth is the number of satisfied conjuncts), then the final proof.
+    // When it returns Z3FUZZ_STOP the phases unwind as on a timeout
+    progress_callback = callback;
+    progress_reported = 0;
+    progress_depth    = 0;
+    stop_requested    = 0;
+
+    int res = __z3fuzz_query_check_light(ctx, query, branch_condition, proof,
+                                         proof_size);
+    if (res && !stop_requested)
+        callback(*proof, *proof_size, opt_num_sat, 1);
+
+    progress_callback = NULL;
+    stop_requested    = 0;
+    return res;
+}
+
 void z3fuzz_add_assignment(fuzzy_ctx_t* ctx, int idx, Z3_ast assignment_value)
 {
     printf("[log] call z3fuzz_add_assignment(...)\n");
-    
-    if (idx >= ctx->size_assignments) {
-        unsigned old_size     = ctx->size_assignments;
-        ctx->size_assignments = (idx + 1) * 3 / 2;
-        ctx->assignments      = (Z3_ast*)realloc(
-            ctx->assignments, sizeof(Z3_ast) * ctx->size_assignments);
-        ASSERT_OR_ABORT(
-            ctx->assignments != NULL,
-            "z3fuzz_add_assignment() ctx->assignments - failed realloc");
 
-        // set to zero the new memory
-        memset(ctx->assignments + old_size, 0,
-               ctx->size_assignments - old_size);
-    }
-    Z3_inc_ref(ctx->z3_ctx, assignment_value);
-    ctx->assignments[idx] = assignment_value;
+    __register_assignments(ctx, &idx, &assignment_value, 1);
+}
 
-    // im assuming that assignment_value is a BV
-    unsigned char assignment_size = Z3_get_bv_sort_size(
-        ctx->z3_ctx, Z3_get_sort(ctx->z3_ctx, assignment_value));
+void z3fuzz_add_assignments(fuzzy_ctx_t* ctx, int* idxs,
+                            Z3_ast* assignment_values, unsigned n)
+{
+    printf("[log] call z3fuzz_add_assignments(...)\n");
 
-    unsigned old_len = ctx->testcases.data[0].values_len;
+    // the concrete values are computed lazily, when a testcase is used
+    __register_assignments(ctx, idxs, assignment_values, n);
+}
 
-    testcase_t* testcase;
-    unsigned    i;
-    for (i = 0; i < ctx->testcases.size; ++i) {
-        testcase = &ctx->testcases.data[i];
+static inline Z3_ast __translate_ast(Z3_context src_ctx, Z3_ast e,
+                                     Z3_context dst_ctx)
+{
+    if (src_ctx == dst_ctx)
+        return e;
+    return Z3_translate(src_ctx, e, dst_ctx);
+}
 
-        if (testcase->values_len <= idx) {
-            testcase->values_len = (idx + 1) * 3 / 2;
-            testcase->values     = (unsigned long*)realloc(
-                testcase->values, sizeof(unsigned long) * testcase->values_len);
-            ASSERT_OR_ABORT(
-                testcase->values != 0,
-                "z3fuzz_add_assignment() testcase->values - failed realloc");
-            testcase->value_sizes = (unsigned char*)realloc(
-                testcase->value_sizes,
-                sizeof(unsigned char) * testcase->values_len);
-            ASSERT_OR_ABORT(
-                testcase->value_sizes != 0,
-                "z3fuzz_add_assignment() testcase->value_sizes - failed "
-                "realloc");
-            testcase->z3_values = (Z3_ast*)realloc(
-                testcase->z3_values, sizeof(Z3_ast) * testcase->values_len);
-            ASSERT_OR_ABORT(
-                testcase->z3_values != 0,
-                "z3fuzz_add_assignment() testcase->z3_values - failed realloc");
-            memset(testcase->z3_values + old_len, 0,
-                   testcase->values_len - old_len);
-        }
+fuzzy_ctx_t* z3fuzz_clone(fuzzy_ctx_t* ctx, Z3_context target_ctx)
+{
+    printf("[log] call z3fuzz_clone(...)\n");
 
-        unsigned long assignment_value_concrete =
-            ctx->model_eval(ctx->z3_ctx, assignment_value, testcase->values,
-                            testcase->value_sizes, testcase->values_len, NULL);
+    fuzzy_ctx_t* res = (fuzzy_ctx_t*)malloc(sizeof(fuzzy_ctx_t));
+    ASSERT_OR_ABORT(res, "z3fuzz_clone(): failed malloc");
+    memset((void*)&res->stats, 0, sizeof(fuzzy_stats_t));
 
-        testcase->value_sizes[idx] = assignment_size;
-        testcase->values[idx]      = assignment_value_concrete;
-        testcase->z3_values[idx] =
-            Z3_mk_unsigned_int(ctx->z3_ctx, assignment_value_concrete,
-                               Z3_mk_bv_sort(ctx->z3_ctx, assignment_size));
-        Z3_inc_ref(ctx->z3_ctx, testcase->z3_values[idx]);
+    if (ctx->timer != NULL) {
+        res->timer = (void*)malloc(sizeof(simple_timer_t));
+        timer_init_wrapper(res,
+                           ((simple_timer_t*)ctx->timer)->time_max_msec);
+    } else
+        res->timer = NULL;
+
+    Z3_set_ast_print_mode(target_ctx, Z3_PRINT_SMTLIB2_COMPLIANT);
+
+    res->model_eval    = ctx->model_eval;
+    res->z3_ctx        = target_ctx;
+    res->testcase_path = ctx->testcase_path;
+
+    // testcases (the concrete values are plain copies)
+    unsigned i, j;
+    init_testcase_list(&res->testcases);
+    for (i = 0; i < ctx->testcases.size; ++i) {
+        testcase_t* src = &ctx->testcases.data[i];
+        testcase_t  dst = {0};
+        dst.values_len   = src->values_len;
+        dst.testcase_len = src->testcase_len;
+        dst.values =
+            (unsigned long*)malloc(sizeof(unsigned long) * src->values_len);
+        ASSERT_OR_ABORT(dst.values, "z3fuzz_clone(): failed malloc");
+        memcpy(dst.values, src->values,
+               sizeof(unsigned long) * src->values_len);
+        dst.value_sizes =
+            (unsigned char*)malloc(sizeof(unsigned char) * src->values_len);
+        ASSERT_OR_ABORT(dst.value_sizes, "z3fuzz_clone(): failed malloc");
+        memcpy(dst.value_sizes, src->value_sizes,
+               sizeof(unsigned char) * src->values_len);
+        dst.z3_values = (Z3_ast*)calloc(src->values_len, sizeof(Z3_ast));
+        ASSERT_OR_ABORT(dst.z3_values, "z3fuzz_clone(): failed calloc");
+        for (j = 0; j < src->values_len; ++j) {
+            if (src->z3_values[j] == NULL)
+                continue;
+            dst.z3_values[j] = Z3_mk_unsigned_int64(
+                target_ctx, dst.values[j],
+                Z3_mk_bv_sort(target_ctx, dst.value_sizes[j]));
+            Z3_inc_ref(target_ctx, dst.z3_values[j]);
+        }
+        da_add_item__testcase_t(&res->testcases, dst);
+    }
 
-        testcase->values_len =
-            (testcase->values_len > idx + 1) ? testcase->values_len : idx + 1;
+    res->size_assignments = ctx->size_assignments;
+    res->assignments =
+        (Z3_ast*)calloc(ctx->size_assignments, sizeof(Z3_ast));
+    ASSERT_OR_ABORT(res->assignments, "z3fuzz_clone(): failed calloc");
+    for (i = 0; i < ctx->size_assignments; ++i) {
+        if (ctx->assignments[i] == NULL)
+            continue;
+        res->assignments[i] =
+            __translate_ast(ctx->z3_ctx, ctx->assignments[i], target_ctx);
+        Z3_inc_ref(target_ctx, res->assignments[i]);
     }
 
-    if (old_len < ctx->testcases.data[0].values_len) {
-        init_global_context(ctx->testcases.data[0].values_len);
+    res->n_symbols = 0;
+    res->symbols   = NULL;
+    __symbol_init(res, ctx->n_symbols);
+    init_global_context(res->testcases.data[0].values_len);
+
+    ulong* idx;
+    res->univocally_defined_inputs = (void*)malloc(sizeof(set__ulong));
+    set__ulong* univocally_defined_inputs =
+        (set__ulong*)res->univocally_defined_inputs;
+    set_init__ulong(univocally_defined_inputs, &index_hash, &index_equals);
+    set_reset_iter__ulong((set__ulong*)ctx->univocally_defined_inputs, 0);
+    while (set_iter_next__ulong((set__ulong*)ctx->univocally_defined_inputs,
+                                0, &idx))
+        set_add__ulong(univocally_defined_inputs, *idx);
+    res->univocally_defined_digest = ctx->univocally_defined_digest;
+    res->intervals_version         = ctx->intervals_version;
+
+    res->processed_constraints = (set__ulong*)malloc(sizeof(set__ulong));
+    set__ulong* processed_constraints =
+        (set__ulong*)res->processed_constraints;
+    set_init__ulong(processed_constraints, index_hash, index_equals);
+    set_reset_iter__ulong((set__ulong*)ctx->processed_constraints, 0);
+    while (set_iter_next__ulong((set__ulong*)ctx->processed_constraints, 0,
+                                &idx))
+        set_add__ulong(processed_constraints, *idx);
+
+    // intervals are updated in place, hence they are copied
+    res->group_intervals = (void*)malloc(sizeof(set__interval_group_ptr));
+    set__interval_group_ptr* group_intervals =
+        (set__interval_group_ptr*)res->group_intervals;
+    set_init__interval_group_ptr(group_intervals, &interval_group_ptr_hash,
+                                 &interval_group_ptr_equals);
+    res->index_to_group_intervals =
+        malloc(sizeof(dict__da__interval_group_ptr));
+    dict__da__interval_group_ptr* index_to_group_intervals =
+        (dict__da__interval_group_ptr*)res->index_to_group_intervals;
+    dict_init__da__interval_group_ptr(index_to_group_intervals,
+                                      &index_to_group_intervals_el_free);
+
+    interval_group_ptr* ig;
+    set_reset_iter__interval_group_ptr(
+        (set__interval_group_ptr*)ctx->group_intervals, 0);
+    while (set_iter_next__interval_group_ptr(
+        (set__interval_group_ptr*)ctx->group_intervals, 0, &ig)) {
+        interval_group_ptr new_el =
+            (interval_group_ptr)malloc(sizeof(interval_group_t));
+        *new_el = **ig;
+        set_add__interval_group_ptr(group_intervals, new_el);
+        for (j = 0; j < new_el->group.n; ++j)
+            update_or_create_in_index_to_group_intervals(
+                index_to_group_intervals, new_el->group.indexes[j], new_el);
     }
+
+    // ast_info entries are copied: the sets keep their iteration state
+    // inline, reading an entry writes it
+    dict_iter_t   it;
+    unsigned long key;
+    res->ast_info_cache = malloc(sizeof(dict__ast_info_ptr));
+    dict__ast_info_ptr* ast_info_cache =
+        (dict__ast_info_ptr*)res->ast_info_cache;
+    dict_init__ast_info_ptr(ast_info_cache, ast_info_ptr_free);
+    ast_info_ptr* ast_info;
+    dict_reset_iter__ast_info_ptr(&it);
+    while (dict_iter_next__ast_info_ptr(
+        (dict__ast_info_ptr*)ctx->ast_info_cache, &it, &key, &ast_info)) {
+        ast_info_ptr copy = (ast_info_ptr)malloc(sizeof(ast_info_t));
+        ASSERT_OR_ABORT(copy, "z3fuzz_clone(): failed malloc");
+        ast_info_init(copy);
+        __union_ast_info(copy, *ast_info);
+        dict_set__ast_info_ptr(ast_info_cache, key, copy);
+    }
+
+    // seed evaluations and checkpoints are keyed by AST ids of the source
+    // context
+    res->seed_eval_cache = malloc(sizeof(dict__seed_eval_t));
+    dict_init__seed_eval_t((dict__seed_eval_t*)res->seed_eval_cache,
+                           seed_eval_free);
+    res->lookup_tables = malloc(sizeof(lookup_tables_t));
+    dict_init__lookup_table_t(&((lookup_tables_t*)res->lookup_tables)->tables,
+                              lookup_table_free);
+    ((lookup_tables_t*)res->lookup_tables)->bytes = 0;
+    res->branch_checkpoints = malloc(sizeof(dict__branch_checkpoint_ptr));
+    dict_init__branch_checkpoint_ptr(
+        (dict__branch_checkpoint_ptr*)res->branch_checkpoints,
+        branch_checkpoint_ptr_free);
+
+    res->conflicting_asts =
+        (dict__conflicting_ptr*)malloc(sizeof(dict__conflicting_ptr));
+    dict__conflicting_ptr* conflicting_asts =
+        (dict__conflicting_ptr*)res->conflicting_asts;
+    dict_init__conflicting_ptr(conflicting_asts, conflicting_ptr_free);
+    conflicting_ptr* conflicting;
+    dict_reset_iter__conflicting_ptr(&it);
+    while (dict_iter_next__conflicting_ptr(
+        (dict__conflicting_ptr*)ctx->conflicting_asts, &it, &key,
+        &conflicting)) {
+        ast_ptr* ast_p;
+        set_reset_iter__ast_ptr(*conflicting, 0);
+        while (set_iter_next__ast_ptr(*conflicting, 0, &ast_p))
+            add_item_to_conflicting(
+                conflicting_asts,
+                __translate_ast(ctx->z3_ctx, ast_p->ast, target_ctx), key,
+                target_ctx);
+    }
+
+    pending_assignments_t* src_pending =
+        (pending_assignments_t*)ctx->pending_assignments;
+    res->pending_assignments = malloc(sizeof(pending_assignments_t));
+    pending_assignments_t* pending_assignments =
+        (pending_assignments_t*)res->pending_assignments;
+    da_init__ulong(&pending_assignments->indexes);
+    for (i = 0; i < src_pending->indexes.size; ++i)
+        da_add_item__ulong(&pending_assignments->indexes,
+                           src_pending->indexes.data[i]);
+    pending_assignments->sorted_size = src_pending->sorted_size;
+    pending_assignments->testcase_cursors =
+        (unsigned*)malloc(sizeof(unsigned) * ctx->testcases.size);
+    memcpy(pending_assignments->testcase_cursors,
+           src_pending->testcase_cursors,
+           sizeof(unsigned) * ctx->testcases.size);
+
+    return res;
 }
 
 static int compare_ulong(const void* v1, const void* v2)
@@ -7740,6 +12622,7 @@ unsigned long z3fuzz_maximize(fuzzy_ctx_t* ctx, Z3_ast pi, Z3_ast to_maximize,
     printf("[log] call z3fuzz_maximize(...)\n");
 
     Z3_inc_ref(ctx->z3_ctx, pi);
+    __concretize_pending_assignments(ctx, 0);
 
     memcpy(tmp_input, ctx->testcases.data[0].values,
            ctx->testcases.data[0].values_len * sizeof(unsigned long));
@@ -7830,6 +12713,7 @@ unsigned long z3fuzz_minimize(fuzzy_ctx_t* ctx, Z3_ast pi, Z3_ast to_minimize,
     printf("[log] call z3fuzz_minimize(...)\n");
 
     Z3_inc_ref(ctx->z3_ctx, pi);
+    __concretize_pending_assignments(ctx, 0);
     memcpy(tmp_input, ctx->testcases.data[0].values,
            ctx->testcases.data[0].values_len * sizeof(unsigned long));
 
@@ -7905,6 +12789,7 @@ void z3fuzz_find_all_values(fuzzy_ctx_t* ctx, Z3_ast expr, Z3_ast pi,
 
     Z3_inc_ref(ctx->z3_ctx, pi);
     Z3_inc_ref(ctx->z3_ctx, expr);
+    __concretize_pending_assignments(ctx, 0);
 
     testcase_t* current_testcase = &ctx->testcases.data[0];
     memcpy(tmp_input, current_testcase->values,
@@ -7915,6 +12800,11 @@ void z3fuzz_find_all_values(fuzzy_ctx_t* ctx, Z3_ast expr, Z3_ast pi,
     set__ulong output_vals;
     set_init__ulong(&output_vals, index_hash, index_equals);
 
+    // to discard the sub-ranges of a group in which pi is false
+    fast_eval_t        pi_eval;
+    range_prune_iter_t it;
+    __fast_eval_compile(ctx, pi, &pi_eval);
+
     // Perform the first evaluation in the seed
     __vals_long_to_char(tmp_input, tmp_proof, current_testcase->testcase_len);
     unsigned long value_in_seed = ctx->model_eval(
@@ -7941,9 +12831,9 @@ void z3fuzz_find_all_values(fuzzy_ctx_t* ctx, Z3_ast expr, Z3_ast pi,
 
         if (interval != NULL && wi_get_range(interval) < 256) {
             // the group is within a (small) known interval, brute force it
-            wrapped_interval_iter_t it = wi_init_iter_values(interval);
-            uint64_t                val;
-            while (wi_iter_get_next(&it, &val)) {
+            uint64_t val;
+            __range_prune_init(&it, &pi_eval, g, interval, tmp_input);
+            while (__range_prune_next(&it, &val)) {
                 set_tmp_input_group_to_value(g, val);
                 if (ctx->model_eval(ctx->z3_ctx, pi, tmp_input,
                                     current_testcase->value_sizes,
@@ -7962,9 +12852,11 @@ void z3fuzz_find_all_values(fuzzy_ctx_t* ctx, Z3_ast expr, Z3_ast pi,
             }
         } else if (g->n == 1) {
             // it is a single byte, brute-force it
-            uint64_t i;
-            for (i = 0; i < 256; ++i) {
-                set_tmp_input_group_to_value(g, i);
+            wrapped_interval_t wi = wi_init(8);
+            uint64_t           val;
+            __range_prune_init(&it, &pi_eval, g, &wi, tmp_input);
+            while (__range_prune_next(&it, &val)) {
+                set_tmp_input_group_to_value(g, val);
                 if (ctx->model_eval(ctx->z3_ctx, pi, tmp_input,
                                     current_testcase->value_sizes,
                                     current_testcase->values_len, NULL)) {
@@ -8150,6 +13042,7 @@ void z3fuzz_find_all_values_gd(
 
     Z3_inc_ref(ctx->z3_ctx, expr);
     Z3_inc_ref(ctx->z3_ctx, pi);
+    __concretize_pending_assignments(ctx, 0);
 
     testcase_t* current_testcase = &ctx->testcases.data[0];
     Z3_ast      expr_original    = expr;
@@ -8246,6 +13139,69 @@ OUT_2:
     return;
 }
 
+// ********** shared knowledge **********
+// Facts derived from a notified constraint, exchanged with the other solver
+// processes through the shared knowledge segment. They are keyed by the
+// structural fingerprint of the constraint, hence they are sound for any
+// process that is notified of the same constraint.
+
+#define SHARED_FACT_NONE 0
+#define SHARED_FACT_UNIVOCALLY_DEFINED 1
+#define SHARED_FACT_RANGE 2
+
+typedef struct shared_fact_t {
+    uint32_t           ast_hash;
+    uint32_t           kind;
+    uint64_t           shape;
+    index_group_t      group;
+    wrapped_interval_t interval;
+} shared_fact_t;
+
+_Static_assert(sizeof(shared_fact_t) <= SK_PAYLOAD_SIZE,
+               "shared_fact_t does not fit in a shared knowledge record");
+
+static int __shared_fact_import(fuzzy_ctx_t* ctx, Z3_ast constraint,
+                                uint64_t* key, shared_fact_t* fact)
+{
+    *key = 0;
+    if (!use_shared_knowledge)
+        return 0;
+
+    // the facts of a constraint that refers to assignments depend on the
+    // assignments of the context
+    ast_info_ptr inputs;
+    detect_involved_inputs_wrapper(ctx, constraint, &inputs);
+    if (inputs->uses_assignments)
+        return 0;
+
+    uint32_t ast_hash = Z3_UNIQUE(ctx->z3_ctx, constraint);
+    uint64_t shape    = __ast_shape(ctx, constraint);
+    *key              = __mix_index(ast_hash) ^ shape;
+
+    unsigned char payload[SK_PAYLOAD_SIZE];
+    if (!shared_knowledge_lookup(&shared_knowledge, *key, payload))
+        return 0;
+
+    memcpy(fact, payload, sizeof(shared_fact_t));
+    if (fact->ast_hash != ast_hash || fact->shape != shape)
+        return 0;
+
+    ctx->stats.shared_knowledge_hits++;
+    return 1;
+}
+
+static void __shared_fact_publish(fuzzy_ctx_t* ctx, Z3_ast constraint,
+                                  uint64_t key, shared_fact_t* fact)
+{
+    fact->ast_hash = Z3_UNIQUE(ctx->z3_ctx, constraint);
+    fact->shape    = __ast_shape(ctx, constraint);
+
+    unsigned char payload[SK_PAYLOAD_SIZE] = {0};
+    memcpy(payload, fact, sizeof(shared_fact_t));
+    shared_knowledge_publish(&shared_knowledge, key, payload);
+}
+// ******** end shared knowledge ********
+
 void z3fuzz_notify_constraint(fuzzy_ctx_t* ctx, Z3_ast constraint)
 {
     printf("[log] call z3fuzz_notify_constraints(...)\n");
@@ -8273,6 +13229,7 @@ void z3fuzz_notify_constraint(fuzzy_ctx_t* ctx, Z3_ast constraint)
     set_add__ulong(processed_constraints, hash);
 
     Z3_inc_ref(ctx->z3_ctx, constraint);
+    __concretize_pending_assignments(ctx, 0);
 
     int with_not;
     if (is_and_constraint(ctx, constraint, &with_not)) {
@@ -8291,19 +13248,38 @@ void z3fuzz_notify_constraint(fuzzy_ctx_t* ctx, Z3_ast constraint)
         return;
     }
 
-    if (__check_univocally_defined(ctx, constraint)) {
-        ctx->stats.num_univocally_defined++;
+    shared_fact_t fact;
+    uint64_t      fact_key = 0;
+    if (!__shared_fact_import(ctx, constraint, &fact_key, &fact)) {
+        memset(&fact, 0, sizeof(shared_fact_t));
+        fact.kind = SHARED_FACT_NONE;
+        if (__check_univocally_defined(ctx, constraint, &fact.group))
+            fact.kind = SHARED_FACT_UNIVOCALLY_DEFINED;
+        else if (__check_range_constraint(ctx, constraint, &fact.group,
+                                          &fact.interval))
+            fact.kind = SHARED_FACT_RANGE;
 
-        // invalidate ast_info_cache
-        dict__ast_info_ptr* ast_info_cache =
-            (dict__ast_info_ptr*)ctx->ast_info_cache;
-        dict_remove_all__ast_info_ptr(ast_info_cache);
-    } else {
-        ctx->stats.num_conflicting +=
-            __check_conflicting_constraint(ctx, constraint);
+        if (fact_key != 0)
+            __shared_fact_publish(ctx, constraint, fact_key, &fact);
+    }
 
-        ctx->stats.num_range_constraints +=
-            __check_range_constraint(ctx, constraint);
+    if (fact.kind == SHARED_FACT_UNIVOCALLY_DEFINED) {
+        ctx->stats.num_univocally_defined++;
+        if (use_metrics)
+            metrics_add(&metrics, METRIC_num_univocally_defined, 1);
+        __add_univocally_defined(ctx, &fact.group);
+    } else {
+        int n_conflicting = __check_conflicting_constraint(ctx, constraint);
+        ctx->stats.num_conflicting += n_conflicting;
+        if (use_metrics && n_conflicting > 0)
+            metrics_add(&metrics, METRIC_num_conflicting, n_conflicting);
+
+        if (fact.kind == SHARED_FACT_RANGE) {
+            ctx->stats.num_range_constraints++;
+            if (use_metrics)
+                metrics_add(&metrics, METRIC_num_range_constraints, 1);
+            __add_range_constraint(ctx, &fact.group, &fact.interval);
+        }
     }
 
     Z3_dec_ref(ctx->z3_ctx, constraint);
@@ -8391,12 +13367,23 @@ unsigned long z3fuzz_evaluate_expression_z3(fuzzy_ctx_t* ctx, Z3_ast query,
     return res;
 }
 
+void z3fuzz_publish_query_stats(fuzzy_ctx_t* ctx, const fuzzy_stats_t* before,
+                                unsigned long time_msec)
+{
+    if (use_metrics)
+        __metrics_publish_query(ctx, before, time_msec);
+}
+
 void z3fuzz_get_mem_stats(fuzzy_ctx_t* ctx, memory_impact_stats_t* stats)
 {
     stats->univocally_defined_size =
         ((set__ulong*)ctx->univocally_defined_inputs)->size;
     stats->ast_info_cache_size =
         ((dict__ast_info_ptr*)ctx->ast_info_cache)->size;
+    stats->seed_eval_cache_size =
+        ((dict__seed_eval_t*)ctx->seed_eval_cache)->size;
+    stats->branch_checkpoints_size =
+        ((dict__branch_checkpoint_ptr*)ctx->branch_checkpoints)->size;
     stats->conflicting_ast_size =
         ((dict__conflicting_ptr*)ctx->conflicting_asts)->size;
     stats->group_intervals_size =
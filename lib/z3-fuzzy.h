@@ -15,16 +15,22 @@ typedef enum fuzzy_findall_res_t {
 
 typedef struct fuzzy_stats_t {
     unsigned long num_evaluate;
+    unsigned long num_fast_evaluate;
     unsigned long aggressive_opt_evaluate;
     unsigned long num_sat;
     unsigned long opt_sat;
     unsigned long reuse;
     unsigned long input_to_state;
     unsigned long simple_math;
+    unsigned long div_mod;
+    unsigned long input_to_input;
     unsigned long input_to_state_ext;
     unsigned long brute_force;
     unsigned long range_brute_force;
     unsigned long range_brute_force_opt;
+    unsigned long range_box;
+    unsigned long micro_sat;
+    unsigned long micro_sat_unsat;
     unsigned long gradient_descend;
     unsigned long flip1;
     unsigned long flip2;
@@ -61,6 +67,12 @@ typedef struct fuzzy_stats_t {
     unsigned long conflicting_fallbacks_same_inputs;
     unsigned long conflicting_fallbacks_no_true;
     unsigned long ast_info_cache_hits;
+    unsigned long seed_eval_cache_hits;
+    unsigned long branch_checkpoint_resumes;
+    unsigned long ast_info_shared_cache_hits;
+    unsigned long shared_knowledge_hits;
+    unsigned long num_lookup_tables;
+    unsigned long num_unhashed_evaluate;
     unsigned long num_timeouts;
     double        avg_time_for_eval;
 } fuzzy_stats_t;
@@ -84,18 +96,26 @@ typedef struct fuzzy_ctx_t {
 #endif
 
     // opaque fields
-    void* univocally_defined_inputs;
-    void* ast_info_cache;
-    void* processed_constraints;
-    void* conflicting_asts;
-    void* group_intervals;
-    void* index_to_group_intervals;
-    void* timer;
+    void*         univocally_defined_inputs;
+    void*         ast_info_cache;
+    void*         processed_constraints;
+    void*         conflicting_asts;
+    void*         group_intervals;
+    void*         index_to_group_intervals;
+    void*         pending_assignments;
+    void*         seed_eval_cache;
+    void*         lookup_tables;
+    void*         branch_checkpoints;
+    void*         timer;
+    unsigned long univocally_defined_digest;
+    unsigned long intervals_version;
 } fuzzy_ctx_t;
 
 typedef struct memory_impact_stats_t {
     unsigned long univocally_defined_size;
     unsigned long ast_info_cache_size;
+    unsigned long seed_eval_cache_size;
+    unsigned long branch_checkpoints_size;
     unsigned long conflicting_ast_size;
     unsigned long group_intervals_size;
     unsigned long index_to_group_intervals_size;
@@ -104,12 +124,38 @@ typedef struct memory_impact_stats_t {
 
 fuzzy_ctx_t* z3fuzz_create(Z3_context ctx, char* seed_filename,
                            unsigned timeout);
+// a deep copy of ctx (seed, testcases and what was learned through notify),
+// its ASTs translated to target_ctx. The library keeps its scratch state in
+// globals: contexts are single-threaded, and only one of them (a clone or
+// its source) can run a query at any given time
+fuzzy_ctx_t* z3fuzz_clone(fuzzy_ctx_t* ctx, Z3_context target_ctx);
 void         z3fuzz_init(fuzzy_ctx_t* fctx, Z3_context ctx, char* seed_filename,
                          char* testcase_path,
                          uint64_t (*model_eval)(Z3_context, Z3_ast, uint64_t*, uint8_t*,
                                         size_t, uint32_t*),
                          unsigned timeout);
+// same as z3fuzz_create/z3fuzz_init, but the seed is read from memory. The
+// bytes are copied, seed can be released after the call
+fuzzy_ctx_t* z3fuzz_create_from_buffer(Z3_context           ctx,
+                                       unsigned char const* seed,
+                                       unsigned long        seed_len,
+                                       unsigned             timeout);
+void         z3fuzz_init_from_buffer(fuzzy_ctx_t* fctx, Z3_context ctx,
+                                     unsigned char const* seed,
+                                     unsigned long seed_len,
+                                     char* testcase_path,
+                                     uint64_t (*model_eval)(Z3_context, Z3_ast,
+                                                            uint64_t*, uint8_t*,
+                                                            size_t, uint32_t*),
+                                     unsigned timeout);
+// add a testcase (copied) to the ones used by the reuse phase. It cannot be
+// longer than the seed
+void         z3fuzz_add_testcase(fuzzy_ctx_t*         ctx,
+                                 unsigned char const* testcase,
+                                 unsigned long        testcase_len);
 void         z3fuzz_free(fuzzy_ctx_t* ctx);
+void         z3fuzz_set_seed(fuzzy_ctx_t* ctx, unsigned char const* seed,
+                             unsigned long seed_len);
 void         z3fuzz_print_expr(fuzzy_ctx_t* ctx, Z3_ast e);
 
 unsigned long z3fuzz_evaluate_expression(fuzzy_ctx_t* ctx, Z3_ast value,
@@ -120,6 +166,18 @@ int           z3fuzz_query_check_light(fuzzy_ctx_t* ctx, Z3_ast query,
                                        Z3_ast                branch_condition,
                                        unsigned char const** proof,
                                        unsigned long*        proof_size);
+// as z3fuzz_query_check_light(), the callback is called with every
+// strictly better optimistic solution (is_sat == 0, depth is the number of
+// satisfied conjuncts of query), then with the proof (is_sat == 1). It is
+// called by the calling thread or, with Z3FUZZ_THREADS > 1, by a worker of
+// the pool while the others wait: it must not call back into the library.
+// Z3FUZZ_STOP ends the search, that returns 0
+int           z3fuzz_query_check_light_progressive(
+              fuzzy_ctx_t* ctx, Z3_ast query, Z3_ast branch_condition,
+              unsigned char const** proof, unsigned long* proof_size,
+              fuzzy_findall_res_t (*callback)(unsigned char const* proof,
+                                    unsigned long        proof_size,
+                                    unsigned depth, int is_sat));
 int z3fuzz_get_optimistic_sol(fuzzy_ctx_t* ctx, unsigned char const** proof,
                               unsigned long* proof_size);
 unsigned long z3fuzz_maximize(fuzzy_ctx_t* ctx, Z3_ast pi, Z3_ast to_maximize,
@@ -139,10 +197,17 @@ void z3fuzz_find_all_values_gd(
                                     unsigned long        out_bytes_len,
                                     unsigned long        val));
 void z3fuzz_add_assignment(fuzzy_ctx_t* ctx, int idx, Z3_ast assignment_value);
+void z3fuzz_add_assignments(fuzzy_ctx_t* ctx, int* idxs,
+                            Z3_ast* assignment_values, unsigned n);
 
 void z3fuzz_notify_constraint(fuzzy_ctx_t* ctx, Z3_ast constraint);
 void z3fuzz_dump_proof(fuzzy_ctx_t* ctx, const char* filename,
                        unsigned char const* proof, unsigned long proof_size);
 
 void z3fuzz_get_mem_stats(fuzzy_ctx_t* ctx, memory_impact_stats_t* stats);
+// publish to the metrics (Z3FUZZ_METRICS) a query solved by another process,
+// e.g. a forked worker: the increments of ctx->stats since before, and the
+// time of the query
+void z3fuzz_publish_query_stats(fuzzy_ctx_t* ctx, const fuzzy_stats_t* before,
+                                unsigned long time_msec);
 #endif
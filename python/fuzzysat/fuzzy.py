@@ -1,4 +1,3 @@
-import tempfile
 import ctypes
 import os
 
@@ -16,18 +15,28 @@ libref = ctypes.cdll.LoadLibrary(
     os.path.join(SCRIPTDIR, "libfuzzy_python.so"))
 
 libref.createFuzzyCtx.restype             = ctypes.c_void_p
+libref.createFuzzyCtxFromBuffer.restype   = ctypes.c_void_p
 libref.createEvalElementArray.restype     = ctypes.POINTER(evalElement)
 libref.z3fuzz_evaluate_expression.restype = ctypes.c_uint64
 libref.z3fuzz_maximize.restype            = ctypes.c_uint64
 libref.z3fuzz_minimize.restype            = ctypes.c_uint64
 
 class FuzzyCtx(object):
-    def __init__(self, seed:str, timeout:int=0):
-        native_z3_ctx  = ctypes.c_void_p(_z3_ctx().ctx.value)
-        native_seed    = ctypes.c_char_p(bytes(seed, "ascii"))
-        native_timeout = ctypes.c_void_p(timeout)
-
-        self.handle = libref.createFuzzyCtx(native_z3_ctx, native_seed, native_timeout)
+    def __init__(self, seed:bytes, timeout:int=0):
+        # the seed is copied by the library, no temporary file is needed
+        native_z3_ctx   = ctypes.c_void_p(_z3_ctx().ctx.value)
+        native_seed     = ctypes.c_char_p(seed)
+        native_seed_len = ctypes.c_uint64(len(seed))
+        native_timeout  = ctypes.c_uint(timeout)
+
+        self.handle = libref.createFuzzyCtxFromBuffer(
+            native_z3_ctx, native_seed, native_seed_len, native_timeout)
+
+    def add_testcase(self, testcase:bytes):
+        libref.addTestcase(
+            self.handle_ref(),
+            ctypes.c_char_p(testcase),
+            ctypes.c_uint64(len(testcase)))
 
     def print_expr(self, expr:BitVecRef):
         libref.z3fuzz_print_expr(self.handle_ref(), expr.as_ast())
@@ -40,11 +49,7 @@ class FuzzyCtx(object):
 
 class FuzzySolver(object):
     def __init__(self, seed:bytes, timeout:int=1000):
-        with tempfile.NamedTemporaryFile() as f:
-            f.write(seed)
-            f.flush()
-            self.ctx = FuzzyCtx(f.name, timeout)
-
+        self.ctx = FuzzyCtx(seed, timeout)
         self.seed = seed
         self.constraints = list()
         self.inputs = [BitVec(i, 8) for i in range(len(seed))]
@@ -52,6 +57,11 @@ class FuzzySolver(object):
     def __del__(self):
         pass
 
+    def add_testcase(self, testcase:bytes):
+        if len(testcase) > len(self.seed):
+            raise ValueError("the testcase is longer than the seed")
+        self.ctx.add_testcase(testcase)
+
     def get_input(self, off:int):
         if off >= len(self.inputs) or off < 0:
             raise ValueError(f"{off} is not a valid offset")
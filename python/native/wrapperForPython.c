@@ -18,6 +18,20 @@ fuzzy_ctx_t* createFuzzyCtx(Z3_context ctx, char* seed_filename,
     return fctx;
 }
 
+fuzzy_ctx_t* createFuzzyCtxFromBuffer(Z3_context ctx, uint8_t const* seed,
+                                      uint64_t seed_len, unsigned timeout)
+{
+    fuzzy_ctx_t* fctx = (fuzzy_ctx_t*)malloc(sizeof(fuzzy_ctx_t));
+    z3fuzz_init_from_buffer(fctx, ctx, seed, seed_len, NULL, NULL, timeout);
+    return fctx;
+}
+
+void addTestcase(fuzzy_ctx_t* fctx, uint8_t const* testcase,
+                 uint64_t testcase_len)
+{
+    z3fuzz_add_testcase(fctx, testcase, testcase_len);
+}
+
 void destroyFuzzyCtx(fuzzy_ctx_t* fctx)
 {
     z3fuzz_free(fctx);
@@ -0,0 +1,7 @@
+(declare-const k!0 (_ BitVec 8))
+(declare-const k!1 (_ BitVec 8))
+(declare-const k!2 (_ BitVec 8))
+(declare-const k!3 (_ BitVec 8))
+
+(assert 
+	(and (= k!1 #x30) (bvult k!2 #x40) (= (concat k!0 k!3) #x4142)))
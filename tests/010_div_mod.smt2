@@ -0,0 +1,7 @@
+(declare-const k!0 (_ BitVec 8))
+(declare-const k!1 (_ BitVec 8))
+(declare-const k!2 (_ BitVec 8))
+(declare-const k!3 (_ BitVec 8))
+
+(assert
+	(= (bvudiv (concat k!0 k!1) #x0007) #x0100))
@@ -0,0 +1,7 @@
+(declare-const k!0 (_ BitVec 8))
+(declare-const k!1 (_ BitVec 8))
+(declare-const k!2 (_ BitVec 8))
+(declare-const k!3 (_ BitVec 8))
+
+(assert
+	(= (bvxor (bvmul (bvadd k!0 #x11) #x07) (bvudiv k!0 #x03)) #xa3))
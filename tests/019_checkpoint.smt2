@@ -0,0 +1,14 @@
+(declare-const k!0 (_ BitVec 8))
+(declare-const k!1 (_ BitVec 8))
+(declare-const k!2 (_ BitVec 8))
+(declare-const k!3 (_ BitVec 8))
+
+(assert
+	(and (= (bvxor (bvmul (concat k!0 k!1 k!2 k!3) #x9e3779b1) (bvlshr (bvmul (concat k!0 k!1 k!2 k!3) #x9e3779b1) #x0000000d)) #x12345678)
+	     (= k!0 #x41)))
+(assert
+	(and (= (bvxor (bvmul (concat k!0 k!1 k!2 k!3) #x9e3779b1) (bvlshr (bvmul (concat k!0 k!1 k!2 k!3) #x9e3779b1) #x0000000d)) #x12345678)
+	     (= k!0 #x41)))
+(assert
+	(and (= (bvxor (bvmul (concat k!0 k!1 k!2 k!3) #x9e3779b1) (bvlshr (bvmul (concat k!0 k!1 k!2 k!3) #x9e3779b1) #x0000000d)) #x12345678)
+	     (= k!0 #x41)))
@@ -0,0 +1,14 @@
+(declare-const k!0 (_ BitVec 8))
+(declare-const k!1 (_ BitVec 8))
+(declare-const k!2 (_ BitVec 8))
+(declare-const k!3 (_ BitVec 8))
+
+(assert
+	(and
+		(and
+			(bvuge (concat k!1 k!0) #x1200)
+			(bvule (concat k!1 k!0) #x12ff)
+			(bvuge (concat k!3 k!2) #x3400)
+			(bvule (concat k!3 k!2) #x34ff)
+			(bvult (bvadd (concat k!1 k!0) (concat k!3 k!2)) #x4610))
+		(bvule k!0 #xff)))
@@ -0,0 +1,52 @@
+(declare-const k!0 (_ BitVec 8))
+(declare-const k!1 (_ BitVec 8))
+(declare-const k!2 (_ BitVec 8))
+(declare-const k!3 (_ BitVec 8))
+
+(assert
+	(= (bvmul k!0 k!0) #x03))
+
+(assert
+	(= (bvmul k!0 k!0) #x03))
+
+(assert
+	(= (bvmul k!0 k!0) #x03))
+
+(assert
+	(= (bvmul k!0 k!0) #x03))
+
+(assert
+	(= (bvmul k!0 k!0) #x03))
+
+(assert
+	(= (bvmul k!0 k!0) #x03))
+
+(assert
+	(= (bvmul k!0 k!0) #x03))
+
+(assert
+	(= (bvmul k!0 k!0) #x03))
+
+(assert
+	(= (bvmul k!0 k!0) #x03))
+
+(assert
+	(= (bvmul k!0 k!0) #x03))
+
+(assert
+	(= (bvmul k!0 k!0) #x03))
+
+(assert
+	(= (bvmul k!0 k!0) #x03))
+
+(assert
+	(= (bvmul k!0 k!0) #x03))
+
+(assert
+	(= (bvmul k!0 k!0) #x03))
+
+(assert
+	(= (bvmul k!0 k!0) #x03))
+
+(assert
+	(= (bvmul k!0 k!0) #x03))
@@ -0,0 +1,31 @@
+(declare-const k!0 (_ BitVec 8))
+(declare-const k!1 (_ BitVec 8))
+(declare-const k!2 (_ BitVec 8))
+(declare-const k!3 (_ BitVec 8))
+
+(assert
+	(and
+		(= (bvadd k!0 k!1) #x42)
+		(bvult k!2 #x10)))
+
+(assert
+	(and
+		(= (bvxor k!2 k!3) #x37)
+		(bvult k!2 #x10)
+		(bvugt k!0 #x20)))
+
+(assert
+	(and
+		(= (bvadd k!0 k!1) #x42)
+		(bvult k!2 #x10)
+		(bvugt k!0 #x20)))
+
+(assert
+	(and
+		(= (bvmul k!3 k!3) #x03)
+		(bvult k!2 #x10)))
+
+(assert
+	(and
+		(= (bvxor k!2 k!3) #x37)
+		(bvult k!2 #x10)))
@@ -2,6 +2,7 @@
 
 import subprocess
 import pytest
+import random
 import os
 
 SCRIPT_DIR = os.path.dirname(os.path.realpath(__file__))
@@ -10,13 +11,35 @@ if "FUZZY_BIN" in os.environ:
     FUZZY_BIN = os.environ["FUZZY_BIN"]
 
 ZERO_SEED = os.path.join(SCRIPT_DIR, "zero_seed.bin")
+FUZZY_EXPR_TEST = os.path.join(os.path.dirname(FUZZY_BIN), "fuzzy-expr-test")
+THREAD_POOL_TEST = os.path.join(os.path.dirname(FUZZY_BIN),
+                                "thread-pool-test")
+BUFFER_API_TEST = os.path.join(os.path.dirname(FUZZY_BIN), "buffer-api-test")
+CLONE_TEST = os.path.join(os.path.dirname(FUZZY_BIN), "clone-test")
+PROGRESSIVE_TEST = os.path.join(os.path.dirname(FUZZY_BIN),
+                                "progressive-test")
+
+# the Z3FUZZ_SKIP_* flags of the search phases
+SEARCH_PHASES = [
+    "INPUT_TO_STATE", "SIMPLE_MATH", "DIV_MOD", "INPUT_TO_INPUT",
+    "RANGE_BRUTE_FORCE", "RANGE_BRUTE_FORCE_OPT", "RANGE_BOX",
+    "INPUT_TO_STATE_EXTENDED", "BRUTE_FORCE", "MICRO_SAT",
+    "GRADIENT_DESCEND", "DETERMINISTIC", "HAVOC"]
 
 def get_path(query):
     return os.path.join(SCRIPT_DIR, query)
 
-def common(query, seed):
+def only_phase_env(phase):
+    env = dict(os.environ)
+    for p in SEARCH_PHASES:
+        env["Z3FUZZ_SKIP_" + p] = "0" if p == phase else "1"
+    return env
+
+def common(query, seed, only=None):
+    # if only is set, every other search phase is disabled
     cmd = [FUZZY_BIN, "--notui", "-q", query, "-s", seed]
-    out = subprocess.check_output(cmd)
+    env = only_phase_env(only) if only is not None else None
+    out = subprocess.check_output(cmd, env=env)
     return b"SAT" in out
 
 def test_its_000():
@@ -33,3 +56,310 @@ def test_arithm_002():
 
 def test_arithm_003():
     assert common(get_path("005_arithm.smt2"), ZERO_SEED)
+
+def test_input_to_input_000():
+    assert common(get_path("006_input_to_input.smt2"), ZERO_SEED,
+                  only="INPUT_TO_INPUT")
+
+def test_input_to_input_001():
+    assert common(get_path("007_input_to_input.smt2"), ZERO_SEED,
+                  only="INPUT_TO_INPUT")
+
+def test_input_to_input_002():
+    assert common(get_path("008_input_to_input.smt2"), ZERO_SEED,
+                  only="INPUT_TO_INPUT")
+
+def test_div_mod_000():
+    # udiv by a constant
+    assert common(get_path("010_div_mod.smt2"), ZERO_SEED, only="DIV_MOD")
+
+def test_div_mod_001():
+    # urem by a constant
+    assert common(get_path("011_div_mod.smt2"), ZERO_SEED, only="DIV_MOD")
+
+def test_div_mod_002():
+    # alignment mask
+    assert common(get_path("012_div_mod.smt2"), ZERO_SEED, only="DIV_MOD")
+
+def test_div_mod_003():
+    # sdiv with a negative quotient
+    assert common(get_path("013_div_mod.smt2"), ZERO_SEED, only="DIV_MOD")
+
+def run_with_metrics(tmp_path, query, env=None, args=()):
+    # the counters exported through Z3FUZZ_METRICS
+    metrics_file = str(tmp_path / "metrics.prom")
+    env = dict(os.environ) if env is None else dict(env)
+    env["Z3FUZZ_METRICS"] = metrics_file
+    cmd = [FUZZY_BIN, "--notui", "-q", query, "-s", ZERO_SEED] + list(args)
+    out = subprocess.check_output(cmd, env=env)
+
+    values = dict()
+    with open(metrics_file, "r") as fin:
+        for line in fin:
+            if line.startswith("#") or not line.strip():
+                continue
+            name, value = line.split()
+            values[name] = int(value)
+    return b"SAT" in out, values
+
+def test_metrics_notify(tmp_path):
+    # the counters updated by z3fuzz_notify_constraint are exported too
+    _, values = run_with_metrics(tmp_path, get_path("009_metrics.smt2"))
+    assert values["z3fuzz_num_range_constraints_total"] > 0
+
+def test_micro_sat_000(tmp_path):
+    # non-linear over a slice of four bytes
+    is_sat, values = run_with_metrics(
+        tmp_path, get_path("014_micro_sat.smt2"), only_phase_env("MICRO_SAT"))
+    assert is_sat
+    assert values["z3fuzz_micro_sat_total"] == 1
+
+def test_micro_sat_001(tmp_path):
+    # the branch condition contradicts pi on the slice
+    is_sat, values = run_with_metrics(
+        tmp_path, get_path("015_micro_sat.smt2"), only_phase_env("MICRO_SAT"))
+    assert not is_sat
+    assert values["z3fuzz_micro_sat_unsat_total"] == 1
+    # the branch condition alone is SAT: z3fuzz_get_optimistic_sol() has a
+    # solution for the clients that fall back on it
+    assert values["z3fuzz_opt_sat_total"] == 1
+
+def test_lookup_tables(tmp_path):
+    # a byte subterm with an udiv is tabulated, the result does not change
+    for skip in ["0", "1"]:
+        env = only_phase_env("BRUTE_FORCE")
+        env["Z3FUZZ_SKIP_LOOKUP_TABLES"] = skip
+        out_dir = tmp_path / skip
+        out_dir.mkdir()
+        is_sat, values = run_with_metrics(
+            out_dir, get_path("016_lookup_tables.smt2"), env)
+        assert is_sat
+        built = values["z3fuzz_num_lookup_tables_total"]
+        assert built > 0 if skip == "0" else built == 0
+
+def test_unique_candidates(tmp_path):
+    # the byte brute force does not hash its candidates, unless a checkpoint
+    # of the branch records them: same result and same evaluations
+    res = dict()
+    for skip in ["0", "1"]:
+        env = only_phase_env("BRUTE_FORCE")
+        env["Z3FUZZ_SKIP_BRANCH_CHECKPOINTS"] = skip
+        out_dir = tmp_path / skip
+        out_dir.mkdir()
+        is_sat, values = run_with_metrics(
+            out_dir, get_path("016_lookup_tables.smt2"), env)
+        res[skip] = (is_sat, values["z3fuzz_num_evaluate_total"])
+        unhashed = values["z3fuzz_num_unhashed_evaluate_total"]
+        assert unhashed > 0 if skip == "1" else unhashed == 0
+    assert res["0"] == res["1"] and res["0"][0]
+
+def range_pruning_evaluations(tmp_path, query):
+    # same result with and without pruning, and the number of evaluations
+    # of the brute force phase for both
+    res = dict()
+    for skip in ["0", "1"]:
+        env = only_phase_env("BRUTE_FORCE")
+        env["Z3FUZZ_SKIP_RANGE_PRUNING"] = skip
+        out_dir = tmp_path / skip
+        out_dir.mkdir()
+        is_sat, values = run_with_metrics(out_dir, get_path(query), env)
+        res[skip] = (is_sat, values["z3fuzz_num_evaluate_total"])
+    assert res["0"][0] == res["1"][0]
+    return res["0"][0], res["0"][1], res["1"][1]
+
+def test_range_pruning_000(tmp_path):
+    # only the values above 0xe0 are candidates
+    is_sat, pruned, full = range_pruning_evaluations(
+        tmp_path, "017_range_pruning.smt2")
+    assert is_sat
+    assert pruned * 10 < full
+
+def test_range_pruning_001(tmp_path):
+    # false on the whole range
+    is_sat, pruned, full = range_pruning_evaluations(
+        tmp_path, "018_range_pruning.smt2")
+    assert not is_sat
+    assert pruned * 10 < full
+
+def test_range_box(tmp_path):
+    # two 16-bit groups in ranges, with a bound on their sum: the box of the
+    # ranges is sampled as a whole, the conjuncts one at a time are UNKNOWN
+    query = get_path("020_range_box.smt2")
+    assert common(query, ZERO_SEED, only="RANGE_BOX")
+    env = dict(os.environ)
+    env["Z3FUZZ_SKIP_RANGE_BOX"] = "1"
+    is_sat, _ = run_with_metrics(tmp_path, query, env)
+    assert not is_sat
+    is_sat, values = run_with_metrics(tmp_path, query)
+    assert is_sat
+    assert values["z3fuzz_range_box_total"] == 1
+
+def test_branch_checkpoints(tmp_path):
+    # the same hard branch three times, pi fixes one of its bytes: the
+    # repeats resume from the checkpoint (also after the aggressive
+    # optimistic pass, that runs as no optimistic solution is found)
+    env = dict(os.environ)
+    env["Z3FUZZ_SKIP_MICRO_SAT"] = "1"
+    is_sat, values = run_with_metrics(
+        tmp_path, get_path("019_checkpoint.smt2"), env)
+    assert not is_sat
+    assert values["z3fuzz_branch_checkpoint_resumes_total"] == 2
+
+def random_condition(rnd, depth):
+    # the shapes fused by the fast evaluator: multi-byte loads, compare
+    # with a constant, ite selects and extensions, mixed with plain ops
+    def const(width):
+        return "#x%0*x" % (width // 4, rnd.getrandbits(width))
+
+    def load(width):
+        n = width // 8
+        first = rnd.randrange(0, 9 - n)
+        idx = list(range(first, first + n))
+        if rnd.random() < 0.5:
+            idx.reverse()
+        if n == 1:
+            return "k!%d" % idx[0]
+        return "(concat %s)" % " ".join("k!%d" % i for i in idx)
+
+    def term(width, depth):
+        choice = rnd.randrange(8) if depth > 0 else 0
+        if choice == 0:
+            return load(width)
+        if choice == 1 and width > 8:
+            w = 8 * rnd.randrange(1, width // 8)
+            ext = rnd.choice(["zero_extend", "sign_extend"])
+            return "((_ %s %d) %s)" % (ext, width - w, term(w, depth - 1))
+        if choice == 2:
+            return "(ite %s %s %s)" % (cond(depth - 1), const(width),
+                                       const(width))
+        if choice == 3 and width < 64:
+            w = width + 8 * rnd.randrange(1, (64 - width) // 8 + 1)
+            lo = rnd.randrange(0, w - width + 1)
+            return "((_ extract %d %d) %s)" % (lo + width - 1, lo,
+                                               term(w, depth - 1))
+        op = rnd.choice(["bvadd", "bvsub", "bvmul", "bvand", "bvor", "bvxor",
+                         "bvshl", "bvlshr", "bvashr", "bvnot"])
+        if op == "bvnot":
+            return "(bvnot %s)" % term(width, depth - 1)
+        other = const(width) if rnd.random() < 0.5 else term(width,
+                                                             depth - 1)
+        return "(%s %s %s)" % (op, term(width, depth - 1), other)
+
+    def cond(depth):
+        choice = rnd.randrange(6) if depth > 0 else 0
+        if choice == 4:
+            return "(not %s)" % cond(depth - 1)
+        if choice == 5:
+            return "(or %s %s)" % (cond(depth - 1), cond(depth - 1))
+        width = rnd.choice([8, 16, 32, 64])
+        op = rnd.choice(["=", "bvult", "bvule", "bvugt", "bvuge", "bvslt",
+                         "bvsle", "bvsgt", "bvsge"])
+        a, b = term(width, depth), const(width)
+        if rnd.random() < 0.3:
+            b = term(width, depth)
+        elif rnd.random() < 0.5:
+            a, b = b, a
+        return "(%s %s %s)" % (op, a, b)
+
+    return cond(depth)
+
+def test_fast_eval_differential(tmp_path):
+    # every fast evaluation is checked against model_eval, a mismatch
+    # aborts the solver
+    rnd = random.Random(106)
+    query = tmp_path / "fast_eval.smt2"
+    seed = tmp_path / "seed.bin"
+    with open(str(query), "w") as fout:
+        for i in range(8):
+            fout.write("(declare-const k!%d (_ BitVec 8))\n" % i)
+        for _ in range(1000):
+            fout.write("(assert %s)\n" % random_condition(rnd, 3))
+    with open(str(seed), "wb") as fout:
+        fout.write(bytes(rnd.getrandbits(8) for _ in range(8)))
+
+    env = only_phase_env("DETERMINISTIC")
+    env["Z3FUZZ_CHECK_FAST_EVAL"] = "1"
+    cmd = [FUZZY_BIN, "--notui", "-q", str(query), "-s", str(seed)]
+    out = subprocess.check_output(cmd, env=env)
+    assert out.count(b"SAT") + out.count(b"UNKNOWN") == 1000
+
+def test_fuzzy_expr_eval():
+    # fz_eval() against Z3 on random expressions
+    subprocess.check_call([FUZZY_EXPR_TEST, "eval"])
+
+def test_fuzzy_expr_solver():
+    subprocess.check_call([FUZZY_EXPR_TEST, "solver"])
+
+def test_fuzzy_expr_compare():
+    # the native solver against z3fuzz on the same branch conditions
+    subprocess.check_call([FUZZY_EXPR_TEST, "compare"])
+
+def test_havoc_parallel(tmp_path):
+    # the havoc workers find a solution...
+    env = only_phase_env("HAVOC")
+    env["Z3FUZZ_THREADS"] = "4"
+    is_sat, values = run_with_metrics(
+        tmp_path, get_path("021_havoc.smt2"), env)
+    assert is_sat
+    assert values["z3fuzz_havoc_total"] == 1
+    # ...and the candidate filter drops the ones already tried by any of
+    # them: 16 walks on the byte of a branch havoc cannot satisfy, every
+    # query evaluates the seed outside of the workers
+    is_sat, values = run_with_metrics(
+        tmp_path, get_path("022_havoc.smt2"), env)
+    assert not is_sat
+    filtered = (values["z3fuzz_num_evaluate_total"] -
+                values["z3fuzz_num_fast_evaluate_total"] - 16)
+    assert filtered > 0
+
+def test_cluster():
+    # queries on two branch conditions, interleaved: the clustered order
+    # gives the same results, printed in the file order
+    cmd = [FUZZY_BIN, "--notui", "-q", get_path("023_cluster.smt2"),
+           "-s", ZERO_SEED]
+    outs = []
+    for extra in [[], ["--cluster"]]:
+        out = subprocess.check_output(cmd + extra).decode()
+        outs.append([l.split(",")[0] for l in out.splitlines()
+                     if l.startswith("SAT") or l.startswith("UNKNOWN")])
+    assert outs[0] == outs[1]
+    assert outs[0].count("SAT") == 2
+
+def test_fork_metrics(tmp_path):
+    # the queries solved by the forked workers are in the metrics of the
+    # parent, as if it solved them
+    query = get_path("023_cluster.smt2")
+    _, values = run_with_metrics(tmp_path, query)
+    _, fork_values = run_with_metrics(tmp_path, query, args=["--fork"])
+    assert fork_values["z3fuzz_queries_total"] == 5
+    for name in ["z3fuzz_queries_total", "z3fuzz_num_sat_total",
+                 "z3fuzz_opt_sat_total"]:
+        assert values[name] == fork_values[name]
+
+def test_thread_pool():
+    # 11k submissions, nested ones and cancellation
+    subprocess.check_call([THREAD_POOL_TEST])
+
+@pytest.mark.parametrize("query", ["002_arithm.smt2", "003_arithm.smt2"])
+def test_threads(query):
+    # the gradient descent trajectories run on the thread pool
+    env = only_phase_env("GRADIENT_DESCEND")
+    env["Z3FUZZ_THREADS"] = "4"
+    cmd = [FUZZY_BIN, "--notui", "-q", get_path(query), "-s", ZERO_SEED]
+    assert b"SAT" in subprocess.check_output(cmd, env=env)
+
+def test_buffer_api():
+    # seed from memory and testcases added through z3fuzz_add_testcase()
+    subprocess.check_call([BUFFER_API_TEST])
+
+def test_clone():
+    # a query solved on a context, on its clone and on a translated clone
+    subprocess.check_call([CLONE_TEST])
+
+@pytest.mark.parametrize("threads", ["1", "4"])
+def test_progressive(threads):
+    # increasing depths of the optimistic solutions and early stop, also
+    # with the callback called by the workers of the parallel phases
+    env = dict(os.environ)
+    env["Z3FUZZ_THREADS"] = threads
+    subprocess.check_call([PROGRESSIVE_TEST], env=env)
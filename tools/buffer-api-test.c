@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "z3-fuzzy.h"
+
+// Checks of the in-memory API: a seed read from a buffer must match the one
+// read from a file, and the testcases added with z3fuzz_add_testcase() must
+// be used by the reuse phase (the only phase enabled here).
+
+#define SEED_SIZE 4
+#define TIMEOUT 1000
+
+#define CHECK(x, mex...)                                                       \
+    do {                                                                       \
+        if (!(x)) {                                                            \
+            fprintf(stderr, "[-] " mex);                                       \
+            fprintf(stderr, "\n");                                             \
+            exit(1);                                                           \
+        }                                                                      \
+    } while (0)
+
+static const char* skip_flags[] = {
+    "Z3FUZZ_SKIP_NOTIFY",
+    "Z3FUZZ_SKIP_INPUT_TO_STATE",
+    "Z3FUZZ_SKIP_SIMPLE_MATH",
+    "Z3FUZZ_SKIP_INPUT_TO_INPUT",
+    "Z3FUZZ_SKIP_INPUT_TO_STATE_EXTENDED",
+    "Z3FUZZ_SKIP_BRUTE_FORCE",
+    "Z3FUZZ_SKIP_RANGE_BRUTE_FORCE",
+    "Z3FUZZ_SKIP_RANGE_BRUTE_FORCE_OPT",
+    "Z3FUZZ_SKIP_RANGE_BOX",
+    "Z3FUZZ_SKIP_DETERMINISTIC",
+    "Z3FUZZ_SKIP_HAVOC",
+    "Z3FUZZ_SKIP_GRADIENT_DESCEND",
+    "Z3FUZZ_SKIP_MICRO_SAT",
+    "Z3FUZZ_SKIP_DIV_MOD",
+};
+
+static Z3_ast mk_byte(Z3_context ctx, unsigned i)
+{
+    return Z3_mk_const(ctx, Z3_mk_int_symbol(ctx, i), Z3_mk_bv_sort(ctx, 8));
+}
+
+// concat(k!0, ..., k!3) == expected
+static Z3_ast mk_input_eq(Z3_context ctx, unsigned char const* expected)
+{
+    Z3_sort  bv8   = Z3_mk_bv_sort(ctx, 8);
+    Z3_ast   input = mk_byte(ctx, 0);
+    Z3_ast   value = Z3_mk_unsigned_int(ctx, expected[0], bv8);
+    unsigned i;
+    for (i = 1; i < SEED_SIZE; ++i) {
+        input = Z3_mk_concat(ctx, input, mk_byte(ctx, i));
+        value = Z3_mk_concat(ctx, value,
+                             Z3_mk_unsigned_int(ctx, expected[i], bv8));
+    }
+    return Z3_mk_eq(ctx, input, value);
+}
+
+// the seed is loaded if a query that only the seed satisfies is SAT in seed
+static void check_seed(fuzzy_ctx_t* fctx, unsigned char const* expected)
+{
+    unsigned char const* proof;
+    unsigned long        proof_size;
+
+    CHECK(fctx->n_symbols == SEED_SIZE, "%lu input symbols", fctx->n_symbols);
+    CHECK(z3fuzz_query_check_light(fctx, Z3_mk_true(fctx->z3_ctx),
+                                   mk_input_eq(fctx->z3_ctx, expected), &proof,
+                                   &proof_size),
+          "the seed does not satisfy the query");
+    CHECK(fctx->stats.sat_in_seed == 1, "not SAT in seed");
+    CHECK(proof_size == SEED_SIZE && memcmp(proof, expected, SEED_SIZE) == 0,
+          "wrong seed");
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned char seed[SEED_SIZE]     = {0, 0, 0, 0};
+    unsigned char testcase[SEED_SIZE] = {'A', 'B', 'C', 'D'};
+    unsigned char partial[2]          = {0x40, 0x41};
+    unsigned char const* proof;
+    unsigned long        proof_size;
+    unsigned             i;
+
+    for (i = 0; i < sizeof(skip_flags) / sizeof(skip_flags[0]); ++i)
+        setenv(skip_flags[i], "1", 1);
+    setenv("Z3FUZZ_SKIP_REUSE", "0", 1);
+
+    Z3_config  cfg = Z3_mk_config();
+    Z3_context ctx = Z3_mk_context(cfg);
+    Z3_del_config(cfg);
+
+    // the same seed, from a file and from a buffer
+    char  seed_filename[] = "/tmp/buffer-api-test-XXXXXX";
+    int   fd              = mkstemp(seed_filename);
+    CHECK(fd >= 0, "mkstemp() failed");
+    CHECK(write(fd, testcase, SEED_SIZE) == SEED_SIZE, "write() failed");
+    close(fd);
+
+    fuzzy_ctx_t* fctx = z3fuzz_create(ctx, seed_filename, TIMEOUT);
+    unlink(seed_filename);
+    check_seed(fctx, testcase);
+    z3fuzz_free(fctx);
+    free(fctx);
+
+    fctx = z3fuzz_create_from_buffer(ctx, testcase, SEED_SIZE, TIMEOUT);
+    check_seed(fctx, testcase);
+    z3fuzz_free(fctx);
+    free(fctx);
+
+    fuzzy_ctx_t init_from_buf;
+    z3fuzz_init_from_buffer(&init_from_buf, ctx, testcase, SEED_SIZE, NULL,
+                            NULL, TIMEOUT);
+    check_seed(&init_from_buf, testcase);
+    z3fuzz_free(&init_from_buf);
+    printf("[+] seed from buffer checks passed\n");
+
+    // a testcase added from memory makes the reuse phase succeed
+    fctx         = z3fuzz_create_from_buffer(ctx, seed, SEED_SIZE, TIMEOUT);
+    Z3_ast query = mk_input_eq(ctx, testcase);
+    CHECK(!z3fuzz_query_check_light(fctx, Z3_mk_true(ctx), query, &proof,
+                                    &proof_size),
+          "SAT without the testcase");
+
+    z3fuzz_add_testcase(fctx, testcase, SEED_SIZE);
+    CHECK(z3fuzz_query_check_light(fctx, Z3_mk_true(ctx), query, &proof,
+                                   &proof_size),
+          "UNKNOWN with the testcase");
+    CHECK(proof_size == SEED_SIZE && memcmp(proof, testcase, SEED_SIZE) == 0,
+          "wrong proof");
+    CHECK(fctx->stats.reuse == 1, "reuse count %lu", fctx->stats.reuse);
+
+    // a shorter testcase, seen through an assignment registered before it
+    Z3_ast sum = Z3_mk_bvadd(ctx, mk_byte(ctx, 0), mk_byte(ctx, 1));
+    z3fuzz_add_assignment(fctx, SEED_SIZE, sum);
+    z3fuzz_add_testcase(fctx, partial, sizeof(partial));
+    query = Z3_mk_eq(ctx, mk_byte(ctx, SEED_SIZE),
+                     Z3_mk_unsigned_int(ctx, 0x81, Z3_mk_bv_sort(ctx, 8)));
+    CHECK(z3fuzz_query_check_light(fctx, Z3_mk_true(ctx), query, &proof,
+                                   &proof_size),
+          "UNKNOWN with the shorter testcase");
+    CHECK(proof[0] == partial[0] && proof[1] == partial[1], "wrong proof");
+    CHECK(fctx->stats.reuse == 2, "reuse count %lu", fctx->stats.reuse);
+    printf("[+] add testcase checks passed\n");
+
+    z3fuzz_free(fctx);
+    free(fctx);
+    Z3_del_context(ctx);
+    return 0;
+}
@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "z3-fuzzy.h"
+
+// Checks of z3fuzz_clone(): the same query is solved on a context, on its
+// clone in the same Z3 context and on a clone translated to another Z3
+// context. The clones carry the constraints notified to the source, and
+// they do not share state with it. Then, the contexts share the info of the
+// query through the process-wide ast_info cache.
+
+#define SEED_SIZE 4
+#define TIMEOUT 1000
+
+#define CHECK(x, mex...)                                                       \
+    do {                                                                       \
+        if (!(x)) {                                                            \
+            fprintf(stderr, "[-] " mex);                                       \
+            fprintf(stderr, "\n");                                             \
+            exit(1);                                                           \
+        }                                                                      \
+    } while (0)
+
+static Z3_ast mk_byte(Z3_context ctx, unsigned i)
+{
+    return Z3_mk_const(ctx, Z3_mk_int_symbol(ctx, i), Z3_mk_bv_sort(ctx, 8));
+}
+
+static Z3_ast mk_val(Z3_context ctx, unsigned v)
+{
+    return Z3_mk_unsigned_int(ctx, v, Z3_mk_bv_sort(ctx, 8));
+}
+
+static void solve(fuzzy_ctx_t* fctx, Z3_ast pi, Z3_ast branch,
+                  const char* name)
+{
+    Z3_context           ctx = fctx->z3_ctx;
+    unsigned char const* proof;
+    unsigned long        proof_size;
+    unsigned char        values[SEED_SIZE];
+
+    CHECK(z3fuzz_query_check_light(fctx, pi, branch, &proof, &proof_size),
+          "%s: UNKNOWN", name);
+    CHECK(proof_size == SEED_SIZE, "%s: proof size %lu", name, proof_size);
+
+    // the proof satisfies pi and the branch condition
+    memcpy(values, proof, SEED_SIZE);
+    Z3_ast args[2] = {pi, branch};
+    CHECK(z3fuzz_evaluate_expression(fctx, Z3_mk_and(ctx, 2, args), values),
+          "%s: wrong proof", name);
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned char seed[SEED_SIZE] = {0x20, 0, 0, 0};
+
+    // the configuration is read once, by the first context
+    setenv("Z3FUZZ_USE_SHARED_AST_INFO_CACHE", "1", 1);
+
+    Z3_config  cfg = Z3_mk_config();
+    Z3_context ctx = Z3_mk_context(cfg);
+
+    // k!0 < 0x10 is notified, the branch condition needs k!0 + k!1 == 0x42
+    fuzzy_ctx_t* fctx = z3fuzz_create_from_buffer(ctx, seed, SEED_SIZE,
+                                                  TIMEOUT);
+    Z3_ast pi     = Z3_mk_bvult(ctx, mk_byte(ctx, 0), mk_val(ctx, 0x10));
+    Z3_ast branch = Z3_mk_eq(
+        ctx, Z3_mk_bvadd(ctx, mk_byte(ctx, 0), mk_byte(ctx, 1)),
+        mk_val(ctx, 0x42));
+    z3fuzz_notify_constraint(fctx, pi);
+
+    fuzzy_ctx_t* same_ctx = z3fuzz_clone(fctx, ctx);
+    solve(fctx, pi, branch, "source");
+    solve(same_ctx, pi, branch, "clone");
+
+    Z3_context   other     = Z3_mk_context(cfg);
+    fuzzy_ctx_t* other_ctx = z3fuzz_clone(fctx, other);
+    solve(other_ctx, Z3_translate(ctx, pi, other),
+          Z3_translate(ctx, branch, other), "translated clone");
+    CHECK(other_ctx->n_symbols == fctx->n_symbols, "%lu symbols",
+          other_ctx->n_symbols);
+
+    // the source outlives its clones
+    z3fuzz_free(same_ctx);
+    free(same_ctx);
+    z3fuzz_free(other_ctx);
+    free(other_ctx);
+    solve(fctx, pi, branch, "source after the clones");
+    printf("[+] clone checks passed\n");
+    z3fuzz_free(fctx);
+    free(fctx);
+
+    // a new context in another Z3 context finds the info of the same query
+    // in the shared cache, and solves a query on other inputs
+    fctx = z3fuzz_create_from_buffer(ctx, seed, SEED_SIZE, TIMEOUT);
+    solve(fctx, pi, branch, "first context");
+    z3fuzz_free(fctx);
+    free(fctx);
+
+    fctx = z3fuzz_create_from_buffer(other, seed, SEED_SIZE, TIMEOUT);
+    Z3_ast other_branch = Z3_mk_eq(
+        other, Z3_mk_bvadd(other, mk_byte(other, 0), mk_byte(other, 2)),
+        mk_val(other, 0x42));
+    solve(fctx, Z3_translate(ctx, pi, other), other_branch, "other inputs");
+    unsigned long hits = fctx->stats.ast_info_shared_cache_hits;
+    solve(fctx, Z3_translate(ctx, pi, other),
+          Z3_translate(ctx, branch, other), "second context");
+    CHECK(fctx->stats.ast_info_shared_cache_hits > hits,
+          "no shared cache hits for the same query");
+    printf("[+] shared cache checks passed\n");
+
+    z3fuzz_free(fctx);
+    free(fctx);
+    Z3_del_context(other);
+    Z3_del_context(ctx);
+    Z3_del_config(cfg);
+    return 0;
+}
@@ -0,0 +1,440 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "fuzzy-expr.h"
+#include "fuzzy-expr-z3.h"
+#include "z3-fuzzy.h"
+
+#define NUM_EXPRESSIONS 3000
+#define NUM_INPUTS 8
+#define MAX_DEPTH 5
+#define SEED_SIZE 16
+#define TIMEOUT 1000
+#define NUM_QUERIES 300
+
+#define CHECK(x, mex...)                                                       \
+    do {                                                                       \
+        if (!(x)) {                                                            \
+            fprintf(stderr, "[-] " mex);                                       \
+            fprintf(stderr, "\n");                                             \
+            exit(1);                                                           \
+        }                                                                      \
+    } while (0)
+
+static uint64_t rng = 0x9e3779b97f4a7c15UL;
+
+static inline uint64_t next_rand()
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+static inline uint64_t mask(unsigned width)
+{
+    return width == 64 ? (uint64_t)-1 : (1UL << width) - 1;
+}
+
+static inline unsigned rand_width() { return 8 * (1 + next_rand() % 8); }
+
+static fz_expr_t gen_bool(fz_builder_t* b, unsigned depth);
+
+static fz_expr_t gen_bv(fz_builder_t* b, unsigned depth, unsigned width)
+{
+    static const fz_op_t binary_ops[] = {
+        FZ_OP_ADD,  FZ_OP_SUB,  FZ_OP_MUL, FZ_OP_UDIV, FZ_OP_SDIV,
+        FZ_OP_UREM, FZ_OP_SREM, FZ_OP_AND, FZ_OP_OR,   FZ_OP_XOR,
+        FZ_OP_SHL,  FZ_OP_LSHR, FZ_OP_ASHR};
+
+    if (depth == 0 || next_rand() % 5 == 0) {
+        if (next_rand() % 3 == 0)
+            return fz_const(b, next_rand() & mask(width), width);
+        // the bytes of an input group, in any order
+        fz_expr_t e = fz_input(b, next_rand() % NUM_INPUTS);
+        while (fz_node(b, e)->width < width)
+            e = fz_binary(b, FZ_OP_CONCAT, e,
+                          fz_input(b, next_rand() % NUM_INPUTS));
+        return e;
+    }
+
+    unsigned w;
+    switch (next_rand() % 8) {
+        case 0:
+            return fz_unary(b, next_rand() % 2 ? FZ_OP_NOT : FZ_OP_NEG,
+                            gen_bv(b, depth - 1, width));
+        case 1:
+        case 2: {
+            fz_op_t op = binary_ops[next_rand() % (sizeof(binary_ops) /
+                                                   sizeof(fz_op_t))];
+            return fz_binary(b, op, gen_bv(b, depth - 1, width),
+                             gen_bv(b, depth - 1, width));
+        }
+        case 3: {
+            w = width + 8 * (next_rand() % ((FZ_MAX_WIDTH - width) / 8 + 1));
+            unsigned lo = next_rand() % (w - width + 1);
+            return fz_extract(b, gen_bv(b, depth - 1, w), lo + width - 1, lo);
+        }
+        case 4:
+            if (width == 8)
+                return gen_bv(b, depth - 1, width);
+            w = 8 * (1 + next_rand() % (width / 8 - 1));
+            return next_rand() % 2
+                       ? fz_zext(b, gen_bv(b, depth - 1, w), width - w)
+                       : fz_sext(b, gen_bv(b, depth - 1, w), width - w);
+        case 5:
+            if (width == 8)
+                return gen_bv(b, depth - 1, width);
+            w = 8 * (1 + next_rand() % (width / 8 - 1));
+            return fz_binary(b, FZ_OP_CONCAT, gen_bv(b, depth - 1, w),
+                             gen_bv(b, depth - 1, width - w));
+        case 6:
+            return fz_ite(b, gen_bool(b, depth - 1),
+                          gen_bv(b, depth - 1, width),
+                          gen_bv(b, depth - 1, width));
+        default:
+            // small shift amounts are more interesting
+            return fz_binary(
+                b, next_rand() % 2 ? FZ_OP_SHL : FZ_OP_ASHR,
+                gen_bv(b, depth - 1, width),
+                fz_const(b, next_rand() % (width + 2), width));
+    }
+}
+
+static fz_expr_t gen_bool(fz_builder_t* b, unsigned depth)
+{
+    static const fz_op_t cmp_ops[] = {FZ_OP_EQ, FZ_OP_ULT, FZ_OP_ULE,
+                                      FZ_OP_SLT, FZ_OP_SLE};
+
+    if (depth == 0)
+        return next_rand() % 2 ? fz_true(b) : fz_false(b);
+
+    unsigned width;
+    switch (next_rand() % 4) {
+        case 0:
+            return fz_unary(b, FZ_OP_BOOL_NOT, gen_bool(b, depth - 1));
+        case 1:
+            return fz_binary(b,
+                             next_rand() % 2 ? FZ_OP_BOOL_AND : FZ_OP_BOOL_OR,
+                             gen_bool(b, depth - 1), gen_bool(b, depth - 1));
+        default:
+            width = rand_width();
+            return fz_binary(b, cmp_ops[next_rand() % 5],
+                             gen_bv(b, depth - 1, width),
+                             gen_bv(b, depth - 1, width));
+    }
+}
+
+// fz_eval() against the evaluation of the translated expression by Z3
+static void test_eval()
+{
+    Z3_config  cfg   = Z3_mk_config();
+    Z3_context ctx   = Z3_mk_context(cfg);
+    Z3_sort    bsort = Z3_mk_bv_sort(ctx, 8);
+    Z3_ast     symbols[NUM_INPUTS];
+    Z3_ast     values[NUM_INPUTS];
+    char       var_name[16];
+    unsigned   i, j;
+
+    for (i = 0; i < NUM_INPUTS; ++i) {
+        int n = snprintf(var_name, sizeof(var_name), "k!%u", i);
+        assert(n > 0 && n < sizeof(var_name) && "symbol name too long");
+        symbols[i] =
+            Z3_mk_const(ctx, Z3_mk_string_symbol(ctx, var_name), bsort);
+        Z3_inc_ref(ctx, symbols[i]);
+    }
+
+    fz_builder_t       b;
+    fz_z3_translator_t t;
+    fz_builder_init(&b);
+    fz_z3_translator_init(&t, &b, ctx, symbols, NUM_INPUTS);
+
+    unsigned char input[NUM_INPUTS];
+    for (i = 0; i < NUM_EXPRESSIONS; ++i) {
+        fz_expr_t e = next_rand() % 2 ? gen_bool(&b, MAX_DEPTH)
+                                      : gen_bv(&b, MAX_DEPTH, rand_width());
+        for (j = 0; j < NUM_INPUTS; ++j) {
+            input[j]  = next_rand() & 0xff;
+            values[j] = Z3_mk_unsigned_int(ctx, input[j], bsort);
+        }
+
+        Z3_ast z = Z3_substitute(ctx, fz_z3_translate(&t, e), NUM_INPUTS,
+                                 symbols, values);
+        z        = Z3_simplify(ctx, z);
+        uint64_t expected;
+        if (fz_node(&b, e)->width == 0)
+            expected = Z3_get_bool_value(ctx, z) == Z3_L_TRUE;
+        else
+            CHECK(Z3_get_numeral_uint64(ctx, z, &expected),
+                  "expression %u is not a numeral after the substitution", i);
+
+        uint64_t res = fz_eval(&b, e, input, NUM_INPUTS);
+        CHECK(res == expected, "expression %u: fz_eval() 0x%lx, Z3 0x%lx\n%s",
+              i, res, expected,
+              Z3_ast_to_string(ctx, fz_z3_translate(&t, e)));
+    }
+    printf("[+] fz_eval(): %u random expressions match Z3\n", NUM_EXPRESSIONS);
+
+    fz_z3_translator_free(&t);
+    fz_builder_free(&b);
+    for (i = 0; i < NUM_INPUTS; ++i)
+        Z3_dec_ref(ctx, symbols[i]);
+    Z3_del_context(ctx);
+    Z3_del_config(cfg);
+}
+
+static unsigned num_values;
+static int      findall_res;
+
+static int findall_callback(unsigned char const* out_bytes,
+                            unsigned long out_bytes_len, unsigned long val)
+{
+    num_values++;
+    return findall_res;
+}
+
+// the native solver, Z3 is not attached
+static void test_solver()
+{
+    unsigned char seed[SEED_SIZE];
+    memset(seed, '0', SEED_SIZE);
+
+    fz_builder_t b;
+    fz_builder_init(&b);
+    fz_solver_t* s = fz_solver_create(&b, seed, SEED_SIZE, TIMEOUT);
+
+    unsigned char const* proof;
+    unsigned long        proof_size;
+    fz_expr_t            in[SEED_SIZE];
+    unsigned             i;
+    for (i = 0; i < SEED_SIZE; ++i)
+        in[i] = fz_input(&b, i);
+    fz_expr_t pi = fz_true(&b);
+
+    // input to state on a little-endian group
+    fz_expr_t le =
+        fz_binary(&b, FZ_OP_CONCAT,
+                  fz_binary(&b, FZ_OP_CONCAT, in[3], in[2]),
+                  fz_binary(&b, FZ_OP_CONCAT, in[1], in[0]));
+    fz_expr_t bc =
+        fz_binary(&b, FZ_OP_EQ, le, fz_const(&b, 0x44434241, 32));
+    CHECK(fz_query_check_light(s, pi, bc, &proof, &proof_size) == 1,
+          "input to state failed");
+    CHECK(proof_size == SEED_SIZE && memcmp(proof, "ABCD", 4) == 0,
+          "wrong input to state proof");
+
+    // 3 * x + 7 == 0x130, brute force
+    bc = fz_binary(
+        &b, FZ_OP_EQ,
+        fz_binary(&b, FZ_OP_ADD,
+                  fz_binary(&b, FZ_OP_MUL, fz_zext(&b, in[5], 8),
+                            fz_const(&b, 3, 16)),
+                  fz_const(&b, 7, 16)),
+        fz_const(&b, 0x130, 16));
+    CHECK(fz_query_check_light(s, pi, bc, &proof, &proof_size) == 1 &&
+              proof[5] == 99,
+          "brute force on one byte failed");
+
+    // two bytes
+    bc = fz_binary(
+        &b, FZ_OP_BOOL_AND,
+        fz_binary(&b, FZ_OP_EQ, fz_binary(&b, FZ_OP_XOR, in[6], in[7]),
+                  fz_const(&b, 0x5a, 8)),
+        fz_binary(&b, FZ_OP_EQ, in[6], fz_const(&b, 0x12, 8)));
+    CHECK(fz_query_check_light(s, pi, bc, &proof, &proof_size) == 1 &&
+              proof[6] == 0x12 && proof[7] == 0x48,
+          "brute force on two bytes failed");
+
+    // unsat
+    bc = fz_binary(&b, FZ_OP_ULT, in[8], fz_const(&b, 0, 8));
+    CHECK(fz_query_check_light(s, pi, bc, &proof, &proof_size) == 0,
+          "unsat query proved");
+
+    // the inputs satisfying pi are preferred
+    bc = fz_unary(&b, FZ_OP_BOOL_NOT,
+                  fz_binary(&b, FZ_OP_EQ, in[13], fz_const(&b, '0', 8)));
+    fz_expr_t pi_z = fz_binary(&b, FZ_OP_EQ, in[13], fz_const(&b, 'z', 8));
+    CHECK(fz_query_check_light(s, pi_z, bc, &proof, &proof_size) == 1 &&
+              proof[13] == 'z',
+          "the proof does not satisfy pi");
+
+    // a notified byte is not mutated anymore
+    fz_notify_constraint(
+        s, fz_binary(&b, FZ_OP_EQ, in[9], fz_const(&b, '0', 8)));
+    bc = fz_binary(&b, FZ_OP_EQ, in[9], fz_const(&b, 'A', 8));
+    CHECK(fz_query_check_light(s, pi, bc, &proof, &proof_size) == 0,
+          "a notified byte has been mutated");
+
+    // maximize and minimize a big-endian group
+    fz_expr_t be = fz_binary(&b, FZ_OP_CONCAT, in[11], in[10]);
+    unsigned long val = fz_maximize(
+        s, fz_binary(&b, FZ_OP_ULT, in[10], fz_const(&b, 0x80, 8)), be,
+        &proof, &proof_size);
+    CHECK(val == 0xff7f && proof[11] == 0xff && proof[10] == 0x7f,
+          "fz_maximize() 0x%lx", val);
+    val = fz_minimize(s,
+                      fz_binary(&b, FZ_OP_ULT, fz_const(&b, 0x10, 8), in[11]),
+                      be, &proof, &proof_size);
+    CHECK(val == 0x1100 && proof[11] == 0x11 && proof[10] == 0,
+          "fz_minimize() 0x%lx", val);
+
+    // find all values
+    fz_expr_t low_bits = fz_binary(&b, FZ_OP_AND, in[12], fz_const(&b, 3, 8));
+    num_values         = 0;
+    findall_res        = FZ_GIVE_NEXT;
+    fz_find_all_values(s, low_bits, pi, findall_callback);
+    CHECK(num_values == 4, "fz_find_all_values() gave %u values", num_values);
+    num_values  = 0;
+    findall_res = FZ_STOP;
+    fz_find_all_values(s, low_bits, pi, findall_callback);
+    CHECK(num_values == 1, "FZ_STOP gave %u values", num_values);
+    num_values  = 0;
+    findall_res = FZ_JUST_LAST;
+    fz_find_all_values(s, low_bits, pi, findall_callback);
+    CHECK(num_values == 2, "FZ_JUST_LAST gave %u values", num_values);
+
+    printf("[+] native solver checks passed\n");
+
+    // the queries that the native search does not prove go to Z3
+    fz_solver_attach_z3(s);
+    bc = fz_binary(&b, FZ_OP_ULT, in[8], fz_const(&b, 0, 8));
+    CHECK(fz_query_check_light(s, pi, bc, &proof, &proof_size) == 0,
+          "unsat query proved by the fallback");
+    le = fz_binary(&b, FZ_OP_EQ, in[14], fz_const(&b, 'a', 8));
+    CHECK(fz_query_check_light(s, pi, le, &proof, &proof_size) == 1 &&
+              proof[14] == 'a',
+          "fz_query_check_light() failed with the fallback attached");
+
+    fz_solver_free(s);
+    fz_builder_free(&b);
+}
+
+// a group of 1 to 4 bytes, in either order
+static fz_expr_t gen_group(fz_builder_t* b, unsigned* width)
+{
+    unsigned n     = 1 + next_rand() % 4;
+    unsigned first = next_rand() % (SEED_SIZE - n + 1);
+    int      le    = next_rand() % 2;
+    unsigned i;
+
+    fz_expr_t e = fz_input(b, le ? first + n - 1 : first);
+    for (i = 1; i < n; ++i)
+        e = fz_binary(b, FZ_OP_CONCAT, e,
+                      fz_input(b, le ? first + n - 1 - i : first + i));
+    *width = 8 * n;
+    return e;
+}
+
+// the shapes of the branch conditions coming from binary tracing
+static fz_expr_t gen_branch(fz_builder_t* b)
+{
+    static const fz_op_t arith_ops[] = {FZ_OP_ADD,  FZ_OP_SUB, FZ_OP_MUL,
+                                        FZ_OP_XOR,  FZ_OP_AND, FZ_OP_UDIV,
+                                        FZ_OP_UREM, FZ_OP_SHL};
+    static const fz_op_t cmp_ops[]   = {FZ_OP_EQ, FZ_OP_ULT, FZ_OP_ULE,
+                                        FZ_OP_SLT, FZ_OP_SLE};
+
+    unsigned  width, width2;
+    fz_expr_t e = gen_group(b, &width);
+    switch (next_rand() % 3) {
+        case 0:
+            break;
+        case 1:
+            e = fz_binary(b, arith_ops[next_rand() % 8], e,
+                          fz_const(b, 1 + next_rand() % 0xff, width));
+            break;
+        default: {
+            fz_expr_t e2 = gen_group(b, &width2);
+            if (width2 < width)
+                e2 = fz_zext(b, e2, width - width2);
+            else if (width2 > width)
+                e2 = fz_extract(b, e2, width - 1, 0);
+            e = fz_binary(b, next_rand() % 2 ? FZ_OP_ADD : FZ_OP_XOR, e, e2);
+        }
+    }
+
+    fz_expr_t bc = fz_binary(b, cmp_ops[next_rand() % 5], e,
+                             fz_const(b, next_rand() & mask(width), width));
+    return next_rand() % 4 == 0 ? fz_unary(b, FZ_OP_BOOL_NOT, bc) : bc;
+}
+
+// the native solver and z3fuzz on the same random queries: the proofs of
+// both must be valid, their success rates are reported
+static void test_compare()
+{
+    unsigned char seed[SEED_SIZE];
+    memset(seed, 0, SEED_SIZE);
+
+    fz_builder_t b;
+    fz_builder_init(&b);
+    fz_solver_t* s = fz_solver_create(&b, seed, SEED_SIZE, TIMEOUT);
+
+    Z3_config          cfg  = Z3_mk_config();
+    Z3_context         ctx  = Z3_mk_context(cfg);
+    fuzzy_ctx_t*       fctx = z3fuzz_create_from_buffer(ctx, seed, SEED_SIZE,
+                                                        TIMEOUT);
+    fz_z3_translator_t t;
+    fz_z3_translator_init(&t, &b, ctx, fctx->symbols, fctx->n_symbols);
+
+    unsigned char const* proof;
+    unsigned long        proof_size;
+    unsigned             i, n_fz = 0, n_z3fuzz = 0, n_both = 0;
+    fz_expr_t            pi = fz_true(&b);
+    for (i = 0; i < NUM_QUERIES; ++i) {
+        fz_expr_t bc = gen_branch(&b);
+
+        int fz_res = fz_query_check_light(s, pi, bc, &proof, &proof_size);
+        CHECK(!fz_res || fz_eval(&b, bc, proof, proof_size),
+              "query %u: wrong proof of the native solver", i);
+
+        int z3fuzz_res = z3fuzz_query_check_light(
+            fctx, fz_z3_translate(&t, pi), fz_z3_translate(&t, bc), &proof,
+            &proof_size);
+        CHECK(!z3fuzz_res || fz_eval(&b, bc, proof, proof_size),
+              "query %u: wrong proof of z3fuzz", i);
+
+        n_fz += fz_res;
+        n_z3fuzz += z3fuzz_res;
+        n_both += fz_res && z3fuzz_res;
+    }
+    printf("[+] %u queries: %u SAT for both, %u only native, %u only z3fuzz\n",
+           NUM_QUERIES, n_both, n_fz - n_both, n_z3fuzz - n_both);
+
+    // the native solver is a reduced one, but it must not drift far
+    CHECK(n_both * 10 >= n_z3fuzz * 9,
+          "the native solver misses %u of the %u queries solved by z3fuzz",
+          n_z3fuzz - n_both, n_z3fuzz);
+
+    fz_z3_translator_free(&t);
+    z3fuzz_free(fctx);
+    free(fctx);
+    Z3_del_context(ctx);
+    Z3_del_config(cfg);
+    fz_solver_free(s);
+    fz_builder_free(&b);
+}
+
+static inline void usage(char* filename)
+{
+    fprintf(stderr, "wrong argv. usage:\n%s [eval|solver|compare]\n",
+            filename);
+    exit(1);
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 2)
+        usage(argv[0]);
+
+    if (argc == 1 || strcmp(argv[1], "eval") == 0)
+        test_eval();
+    if (argc == 1 || strcmp(argv[1], "solver") == 0)
+        test_solver();
+    if (argc == 1 || strcmp(argv[1], "compare") == 0)
+        test_compare();
+    if (argc == 2 && strcmp(argv[1], "eval") != 0 &&
+        strcmp(argv[1], "solver") != 0 && strcmp(argv[1], "compare") != 0)
+        usage(argv[0]);
+    return 0;
+}
@@ -2,15 +2,24 @@
 
 #include <stdlib.h>
 #include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
 #include <sys/time.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
 #include <getopt.h>
 #include "pretty-print.h"
+#include "proof-archive.h"
 #include "z3-fuzzy.h"
 
 #define BOLD(s) "\033[1m\033[37m" s "\033[0m"
 
 #define TIMEOUT 1000
+// path constraints closest to the branch condition in the clustering key
+#define CLUSTER_SUFFIX_SIZE 8
 
 static fuzzy_ctx_t fctx;
 
@@ -234,11 +243,21 @@ static inline void print_status(unsigned long current_query,
 
 static char g_sat_queries_path[500] = {0};
 static char g_proof_path[500]       = {0};
+static char g_archive_path[500]     = {0};
 
 static int g_no_tui            = 0;
 static int g_dump_sat_queries  = 0;
 static int g_dump_proofs       = 0;
 static int g_check_consistency = 1;
+static int g_cluster_queries   = 0;
+static int g_use_archive       = 0;
+static int g_fork_server       = 0;
+
+static unsigned      g_fork_batch   = 1;
+static unsigned long g_fork_timeout = 10 * TIMEOUT; // msec
+static unsigned long g_fork_mem     = 0;            // MB, 0 is unlimited
+
+static proof_archive_t g_archive;
 
 static const char*   short_opt  = "hq:s:o:";
 static struct option long_opt[] = {
@@ -249,8 +268,325 @@ static struct option long_opt[] = {
     {"dsat", no_argument, &g_dump_sat_queries, 1},
     {"dproofs", no_argument, &g_dump_proofs, 1},
     {"notui", no_argument, &g_no_tui, 1},
+    {"cluster", no_argument, &g_cluster_queries, 1},
+    {"archive", no_argument, &g_use_archive, 1},
+    {"fork", no_argument, &g_fork_server, 1},
+    {"fork-batch", required_argument, NULL, 'B'},
+    {"fork-timeout", required_argument, NULL, 'T'},
+    {"fork-mem", required_argument, NULL, 'M'},
     {NULL, 0, NULL, 0}};
 
+typedef struct query_order_t {
+    unsigned long key;
+    unsigned long suffix_key;
+    unsigned      idx;
+} query_order_t;
+
+typedef struct query_result_t {
+    Z3_ast        query;
+    int           is_sat;
+    int           done;
+    unsigned long qtime;
+} query_result_t;
+
+static inline unsigned long mix_id(unsigned long x)
+{
+    x += 0x9e3779b97f4a7c15UL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9UL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebUL;
+    return x ^ (x >> 31);
+}
+
+static void query_locality_key(Z3_ast query, query_order_t* order)
+{
+    // queries on the same branch condition first, then a min-hash of the
+    // last path constraints: the whole path would give most queries of a
+    // file the same minimum, that of the constraints they all start with
+    Z3_ast*  assertions;
+    unsigned n_assertions;
+    order->key        = mix_id(Z3_get_ast_id(fctx.z3_ctx,
+                                             find_branch_condition(query)));
+    order->suffix_key = (unsigned long)-1;
+
+    divide_query_in_assertions(query, &assertions, &n_assertions);
+    unsigned i = n_assertions > CLUSTER_SUFFIX_SIZE
+                     ? n_assertions - CLUSTER_SUFFIX_SIZE
+                     : 0;
+    for (; i < n_assertions; ++i) {
+        unsigned long h = mix_id(Z3_get_ast_id(fctx.z3_ctx, assertions[i]));
+        if (h < order->suffix_key)
+            order->suffix_key = h;
+    }
+    free(assertions);
+}
+
+static int query_order_cmp(const void* a, const void* b)
+{
+    const query_order_t* qa = (const query_order_t*)a;
+    const query_order_t* qb = (const query_order_t*)b;
+    if (qa->key != qb->key)
+        return qa->key < qb->key ? -1 : 1;
+    if (qa->suffix_key != qb->suffix_key)
+        return qa->suffix_key < qb->suffix_key ? -1 : 1;
+    return qa->idx < qb->idx ? -1 : (qa->idx > qb->idx ? 1 : 0);
+}
+
+static inline void emit_query_result(query_result_t* res, unsigned idx,
+                                     FILE* sat_queries_file)
+{
+    if (res->is_sat && g_dump_sat_queries) {
+        if (g_use_archive)
+            proof_archive_add_query(&g_archive, idx, fctx.z3_ctx, res->query);
+        else
+            fprintf(sat_queries_file, "(assert\n%s\n)\n",
+                    Z3_ast_to_string(fctx.z3_ctx, res->query));
+    }
+
+    if (g_no_tui)
+        fprintf(stdout, "%s, %.3lf\n", res->is_sat ? "SAT" : "UNKNOWN",
+                (double)res->qtime / 1000);
+}
+
+static void notify_query(Z3_ast query)
+{
+    Z3_ast*  assertions;
+    unsigned n_assertions, j;
+    divide_query_in_assertions(query, &assertions, &n_assertions);
+    for (j = 0; j < n_assertions; ++j) {
+        assert(assertions[j] != NULL && "null assertion!");
+        z3fuzz_notify_constraint(&fctx, assertions[j]);
+    }
+    free(assertions);
+}
+
+static int check_query(Z3_ast query, unsigned char const** proof,
+                       unsigned long* proof_size)
+{
+    Z3_ast   branch_condition = find_branch_condition(query);
+    Z3_ast*  assertions;
+    unsigned n_assertions;
+
+    Z3_ast query_no_branch;
+    divide_query_in_assertions(query, &assertions, &n_assertions);
+    if (n_assertions > 0)
+        query_no_branch = Z3_mk_and(fctx.z3_ctx, n_assertions, assertions);
+    else
+        query_no_branch = Z3_mk_true(fctx.z3_ctx);
+    free(assertions);
+
+    return z3fuzz_query_check_light(&fctx, query_no_branch, branch_condition,
+                                    proof, proof_size);
+}
+
+// Fork server: the queries are solved by a child of the (initialised)
+// solver, that gets the indexes of the queries from a pipe and sends back
+// the results. A worker that hangs, crashes or runs out of memory only
+// loses its query, the next one is solved by a new fork.
+// The parent replays the notified constraints and publishes the stats of
+// the worker to the metrics. What else the worker learns (the checkpoints
+// of the branches, the caches) is kept only for the --fork-batch queries
+// it serves.
+typedef struct fork_result_t {
+    uint32_t      idx;
+    int32_t       is_sat;
+    uint64_t      proof_size;
+    fuzzy_stats_t stats;
+} fork_result_t;
+
+typedef struct fork_server_t {
+    pid_t          pid;
+    int            req_fd;
+    int            res_fd;
+    unsigned       served;
+    unsigned char* proof;
+    unsigned long  proof_capacity;
+    unsigned long  n_killed;
+} fork_server_t;
+
+static fork_server_t g_fs = {.pid = -1};
+
+static int write_full(int fd, const void* buf, size_t size)
+{
+    const unsigned char* p = (const unsigned char*)buf;
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return 0;
+        p += n;
+        size -= n;
+    }
+    return 1;
+}
+
+static int read_full(int fd, void* buf, size_t size, long timeout)
+{
+    // timeout in msec for the whole read, -1 waits forever
+    unsigned char* p = (unsigned char*)buf;
+    struct timeval start, now;
+    gettimeofday(&start, NULL);
+    while (size > 0) {
+        int wait = -1;
+        if (timeout >= 0) {
+            gettimeofday(&now, NULL);
+            long elapsed = (long)compute_time_msec(&start, &now);
+            if (elapsed >= timeout)
+                return 0;
+            wait = (int)(timeout - elapsed);
+        }
+
+        struct pollfd pfd = {.fd = fd, .events = POLLIN};
+        int           r   = poll(&pfd, 1, wait);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            return 0;
+
+        ssize_t n = read(fd, p, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return 0;
+        p += n;
+        size -= n;
+    }
+    return 1;
+}
+
+static void fork_server_loop(query_result_t* results, int req_fd, int res_fd)
+{
+    uint32_t idx;
+    while (read_full(req_fd, &idx, sizeof(idx), -1)) {
+        unsigned char const* proof      = NULL;
+        unsigned long        proof_size = 0;
+        fork_result_t        r;
+
+        notify_query(results[idx].query);
+        r.idx        = idx;
+        r.is_sat     = check_query(results[idx].query, &proof, &proof_size);
+        r.proof_size = r.is_sat ? proof_size : 0;
+        r.stats      = fctx.stats;
+        if (!write_full(res_fd, &r, sizeof(r)) ||
+            !write_full(res_fd, proof, r.proof_size))
+            break;
+    }
+    _exit(0);
+}
+
+static int fork_server_start(query_result_t* results)
+{
+    int req[2], res[2];
+    if (pipe(req) != 0)
+        return 0;
+    if (pipe(res) != 0) {
+        close(req[0]);
+        close(req[1]);
+        return 0;
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(req[0]);
+        close(req[1]);
+        close(res[0]);
+        close(res[1]);
+        return 0;
+    }
+
+    if (pid == 0) {
+        close(req[1]);
+        close(res[0]);
+        // the output of the worker would interleave with the one of the
+        // parent
+        if (freopen("/dev/null", "w", stdout) == NULL)
+            _exit(1);
+        if (g_fork_mem > 0) {
+            struct rlimit rl;
+            rl.rlim_cur = rl.rlim_max = (rlim_t)g_fork_mem << 20;
+            setrlimit(RLIMIT_AS, &rl);
+        }
+        fork_server_loop(results, req[0], res[1]);
+    }
+
+    close(req[0]);
+    close(res[1]);
+    g_fs.pid    = pid;
+    g_fs.req_fd = req[1];
+    g_fs.res_fd = res[0];
+    g_fs.served = 0;
+    return 1;
+}
+
+static void fork_server_stop(int kill_worker)
+{
+    if (g_fs.pid <= 0)
+        return;
+
+    if (kill_worker)
+        kill(g_fs.pid, SIGKILL);
+    // otherwise, the worker exits when its request pipe is closed
+    close(g_fs.req_fd);
+    close(g_fs.res_fd);
+    waitpid(g_fs.pid, NULL, 0);
+    g_fs.pid = -1;
+}
+
+static int fork_server_check(query_result_t* results, unsigned idx,
+                             unsigned char const** proof,
+                             unsigned long*        proof_size)
+{
+    uint32_t       req = idx;
+    fork_result_t  r;
+    fuzzy_stats_t  stats_before;
+    struct timeval start, stop;
+
+    if (g_fs.pid <= 0 && !fork_server_start(results)) {
+        fprintf(stderr, "ERROR: unable to fork the solver worker\n");
+        exit(1);
+    }
+
+    gettimeofday(&start, NULL);
+    if (!write_full(g_fs.req_fd, &req, sizeof(req)) ||
+        !read_full(g_fs.res_fd, &r, sizeof(r), g_fork_timeout) ||
+        r.idx != idx)
+        goto KILL_WORKER;
+
+    if (r.proof_size > g_fs.proof_capacity) {
+        g_fs.proof = (unsigned char*)realloc(g_fs.proof, r.proof_size);
+        assert(g_fs.proof != NULL && "realloc failed");
+        g_fs.proof_capacity = r.proof_size;
+    }
+    if (!read_full(g_fs.res_fd, g_fs.proof, r.proof_size, g_fork_timeout))
+        goto KILL_WORKER;
+
+    gettimeofday(&stop, NULL);
+
+    // the next workers are forked from here: replay the constraints of the
+    // query so that they do not lose what this one has learnt
+    stats_before = fctx.stats;
+    notify_query(results[idx].query);
+    fctx.stats = r.stats;
+    z3fuzz_publish_query_stats(&fctx, &stats_before,
+                               compute_time_msec(&start, &stop));
+
+    if (++g_fs.served >= g_fork_batch)
+        fork_server_stop(0);
+
+    *proof      = g_fs.proof;
+    *proof_size = r.proof_size;
+    return r.is_sat;
+
+KILL_WORKER:
+    fork_server_stop(1);
+    g_fs.n_killed++;
+    *proof      = NULL;
+    *proof_size = 0;
+    return 0;
+}
+
 static inline void usage(char* filename)
 {
     fprintf(stderr,
@@ -263,8 +599,27 @@ static inline void usage(char* filename)
             "  --dsat                    dump sat queries\n"
             "  --dproofs                 dump sat proofs\n"
             "  --notui                   no text UI\n"
+            "  --cluster                 solve queries sharing the branch "
+            "condition\n"
+            "                            and the last path constraints "
+            "together\n"
+            "                            (results keep the file order)\n"
+            "  --archive                 store dumped proofs and queries in "
+            "an indexed\n"
+            "                            archive (see proof-archive-extract)\n"
+            "  --fork                    solve the queries in forked workers "
+            "that are\n"
+            "                            killed if they hang or crash\n"
+            "  --fork-batch N            queries solved by a worker before "
+            "a new fork\n"
+            "                            (default 1)\n"
+            "  --fork-timeout MS         kill a worker that does not answer "
+            "in MS msec\n"
+            "                            (default %u)\n"
+            "  --fork-mem MB             memory limit of a worker (default "
+            "unlimited)\n"
             "\n",
-            filename);
+            filename, 10 * TIMEOUT);
 }
 
 int main(int argc, char* argv[])
@@ -293,6 +648,15 @@ int main(int argc, char* argv[])
             case 'o':
                 output_dir = optarg;
                 break;
+            case 'B':
+                g_fork_batch = strtoul(optarg, NULL, 10);
+                break;
+            case 'T':
+                g_fork_timeout = strtoul(optarg, NULL, 10);
+                break;
+            case 'M':
+                g_fork_mem = strtoul(optarg, NULL, 10);
+                break;
             default:
                 usage(argv[0]);
         }
@@ -325,7 +689,17 @@ int main(int argc, char* argv[])
                      "%s/sat-queries.smt2", output_dir);
         assert(n > 0 && n < sizeof(g_sat_queries_path) &&
                "snprintf failed (sat_queries)");
+        n = snprintf(g_archive_path, sizeof(g_archive_path), "%s/results.fza",
+                     output_dir);
+        assert(n > 0 && n < sizeof(g_archive_path) &&
+               "snprintf failed (archive)");
     }
+    g_use_archive &= g_dump_sat_queries || g_dump_proofs;
+    if (g_fork_batch == 0)
+        g_fork_batch = 1;
+    // a dead worker must not kill us while we write its request
+    if (g_fork_server)
+        signal(SIGPIPE, SIG_IGN);
 
     Z3_config            cfg = Z3_mk_config();
     Z3_context           ctx = Z3_mk_context(cfg);
@@ -347,11 +721,25 @@ int main(int argc, char* argv[])
     }
 
     FILE* sat_queries_file = NULL;
-    if (g_dump_sat_queries) {
+    if (g_dump_sat_queries && !g_use_archive) {
         sat_queries_file = fopen(g_sat_queries_path, "w");
         setvbuf(sat_queries_file, NULL, _IONBF, 0);
     }
 
+    if (g_use_archive) {
+        testcase_t*    seed       = &fctx.testcases.data[0];
+        unsigned char* seed_bytes = (unsigned char*)malloc(seed->testcase_len);
+        assert(seed_bytes != NULL && "malloc failed");
+        for (i = 0; i < seed->testcase_len; ++i)
+            seed_bytes[i] = (unsigned char)seed->values[i];
+        if (!proof_archive_open(&g_archive, g_archive_path, seed_bytes,
+                                seed->testcase_len)) {
+            fprintf(stderr, "ERROR: unable to open %s\n", g_archive_path);
+            exit(1);
+        }
+        free(seed_bytes);
+    }
+
     if (!g_no_tui) {
         pp_init();
     }
@@ -369,29 +757,42 @@ int main(int argc, char* argv[])
 
     unsigned long num_queries = 0, sat_queries = 0;
     num_queries = Z3_ast_vector_size(ctx, queries);
+
+    query_result_t* results =
+        (query_result_t*)calloc(num_queries, sizeof(query_result_t));
+    query_order_t* order =
+        (query_order_t*)malloc(sizeof(query_order_t) * num_queries);
+    assert(results != NULL && order != NULL && "malloc failed");
     for (i = 0; i < num_queries; ++i) {
         Z3_ast query = Z3_ast_vector_get(ctx, queries, i);
         query        = Z3_substitute(ctx, query, fctx.n_symbols, str_symbols,
                               fctx.symbols);
-        Z3_ast   branch_condition = find_branch_condition(query);
-        Z3_ast*  assertions;
-        unsigned n_assertions;
-
-        Z3_ast query_no_branch;
-        divide_query_in_assertions(query, &assertions, &n_assertions);
-        if (n_assertions > 0)
-            query_no_branch = Z3_mk_and(fctx.z3_ctx, n_assertions, assertions);
-        else
-            query_no_branch = Z3_mk_true(fctx.z3_ctx);
+        Z3_inc_ref(ctx, query);
+        results[i].query    = query;
+        order[i].idx        = i;
+        order[i].key        = 0;
+        order[i].suffix_key = 0;
+        if (g_cluster_queries)
+            query_locality_key(query, &order[i]);
+    }
+    // clustered queries reuse the caches of the library, the results are
+    // still emitted in the original order
+    if (g_cluster_queries)
+        qsort(order, num_queries, sizeof(query_order_t), query_order_cmp);
+
+    unsigned long k, next_to_emit = 0;
+    for (k = 0; k < num_queries; ++k) {
+        i            = order[k].idx;
+        Z3_ast query = results[i].query;
+        int    is_sat, j;
 
         gettimeofday(&start, NULL);
-        int j;
-        for (j = 0; j < n_assertions; ++j) {
-            assert(assertions[j] != NULL && "null assertion!");
-            z3fuzz_notify_constraint(&fctx, assertions[j]);
+        if (g_fork_server)
+            is_sat = fork_server_check(results, i, &proof, &proof_size);
+        else {
+            notify_query(query);
+            is_sat = check_query(query, &proof, &proof_size);
         }
-        int is_sat = z3fuzz_query_check_light(
-            &fctx, query_no_branch, branch_condition, &proof, &proof_size);
         gettimeofday(&stop, NULL);
         elapsed_time += compute_time_msec(&start, &stop);
 
@@ -399,7 +800,9 @@ int main(int argc, char* argv[])
             sat_queries += 1;
             elapsed_time_fast_sat += compute_time_msec(&start, &stop);
 
-            if (g_dump_proofs) {
+            if (g_dump_proofs && g_use_archive)
+                proof_archive_add_proof(&g_archive, i, proof, proof_size);
+            else if (g_dump_proofs) {
                 n = snprintf(g_proof_path, sizeof(g_proof_path),
                              "%s/proof_%02u.bin", output_dir, i);
                 assert(n > 0 && n < sizeof(g_proof_path) &&
@@ -408,11 +811,6 @@ int main(int argc, char* argv[])
                 z3fuzz_dump_proof(&fctx, g_proof_path, proof, proof_size);
             }
 
-            if (g_dump_sat_queries) {
-                fprintf(sat_queries_file, "(assert\n%s\n)\n",
-                        Z3_ast_to_string(ctx, query));
-            }
-
             if (g_check_consistency) {
                 testcase_t* curr_t    = &fctx.testcases.data[0];
                 uint64_t*   tmp_proof = malloc(sizeof(uint64_t) * proof_size);
@@ -424,19 +822,30 @@ int main(int argc, char* argv[])
                 free(tmp_proof);
             }
         }
-        free(assertions);
-
-        if (!g_no_tui) {
-            print_status(i, num_queries);
-        } else {
-            unsigned long qtime = compute_time_msec(&start, &stop);
-            fprintf(stdout, "%s, %.3lf\n", is_sat ? "SAT" : "UNKNOWN",
-                    (double)qtime / 1000);
+
+        results[i].is_sat = is_sat;
+        results[i].qtime  = compute_time_msec(&start, &stop);
+        results[i].done   = 1;
+        while (next_to_emit < num_queries && results[next_to_emit].done) {
+            emit_query_result(&results[next_to_emit], next_to_emit,
+                              sat_queries_file);
+            next_to_emit++;
         }
+
+        if (!g_no_tui)
+            print_status(k, num_queries);
     }
 
+    fork_server_stop(0);
+    free(g_fs.proof);
+
+    for (i = 0; i < num_queries; ++i)
+        Z3_dec_ref(ctx, results[i].query);
+    free(results);
+    free(order);
+
     if (!g_no_tui) {
-        print_status(i, num_queries);
+        print_status(k, num_queries);
 
         printf("\n"
                "num queries:      %lu\n"
@@ -444,13 +853,18 @@ int main(int argc, char* argv[])
                "elaps time:       %.3lf s\n"
                "elaps time sat:   %.3lf s\n"
                "elaps par:        %.3lf s\n"
-               "elaps time + par: %.3lf s\n",
+               "elaps time + par: %.3lf s\n"
+               "killed workers:   %lu\n",
                num_queries, sat_queries, (double)elapsed_time / 1000,
                (double)elapsed_time_fast_sat / 1000,
                (double)elapsed_time_parsing / 1000,
-               (double)(elapsed_time + elapsed_time_parsing) / 1000);
+               (double)(elapsed_time + elapsed_time_parsing) / 1000,
+               g_fs.n_killed);
     }
 
+    if (g_use_archive)
+        proof_archive_close(&g_archive);
+
     Z3_ast_vector_dec_ref(ctx, queries);
     free(str_symbols);
     free(fdecl_cache);
@@ -458,7 +872,7 @@ int main(int argc, char* argv[])
     Z3_del_config(cfg);
     Z3_del_context(ctx);
 
-    if (g_dump_sat_queries) {
+    if (g_dump_sat_queries && !g_use_archive) {
         fclose(sat_queries_file);
     }
     return 0;
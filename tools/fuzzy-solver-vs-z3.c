@@ -81,7 +81,9 @@ static inline void dump_flip_info()
             ,
             fctx.stats.input_to_state, fctx.stats.input_to_state_ext,
             fctx.stats.brute_force + fctx.stats.range_brute_force +
-                fctx.stats.range_brute_force_opt + fctx.stats.simple_math,
+                fctx.stats.range_brute_force_opt + fctx.stats.range_box +
+                fctx.stats.micro_sat + fctx.stats.simple_math +
+                fctx.stats.div_mod,
             fctx.stats.gradient_descend,
             fctx.stats.flip1 + fctx.stats.flip2 + fctx.stats.flip4 +
                 fctx.stats.flip8 + fctx.stats.flip16 + fctx.stats.flip32 +
@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "z3-fuzzy.h"
+
+// Checks of z3fuzz_query_check_light_progressive(): the callback sees the
+// optimistic solutions with strictly increasing depths, each one satisfying
+// the branch condition, and the search ends when the callback asks for it.
+
+#define SEED_SIZE 4
+#define TIMEOUT 1000
+#define MAX_CALLS 64
+
+#define CHECK(x, mex...)                                                       \
+    do {                                                                       \
+        if (!(x)) {                                                            \
+            fprintf(stderr, "[-] " mex);                                       \
+            fprintf(stderr, "\n");                                             \
+            exit(1);                                                           \
+        }                                                                      \
+    } while (0)
+
+static fuzzy_ctx_t* fctx;
+static Z3_ast       branch;
+static unsigned     num_calls;
+static unsigned     num_final_calls;
+static unsigned     last_depth;
+static unsigned     stop_at;
+
+static unsigned char proofs[MAX_CALLS][SEED_SIZE];
+
+static fuzzy_findall_res_t callback(unsigned char const* proof,
+                                    unsigned long proof_size, unsigned depth,
+                                    int is_sat)
+{
+    CHECK(proof_size == SEED_SIZE, "proof size %lu", proof_size);
+    if (is_sat) {
+        num_final_calls++;
+        return Z3FUZZ_GIVE_NEXT;
+    }
+
+    // the library cannot be called from here: the proofs are checked after
+    // the search
+    CHECK(num_calls < MAX_CALLS, "more than %u optimistic solutions",
+          MAX_CALLS);
+    CHECK(num_calls == 0 || depth > last_depth, "depth %u after %u", depth,
+          last_depth);
+    CHECK(num_final_calls == 0, "optimistic solution after the final one");
+    memcpy(proofs[num_calls], proof, SEED_SIZE);
+
+    last_depth = depth;
+    return ++num_calls == stop_at ? Z3FUZZ_STOP : Z3FUZZ_GIVE_NEXT;
+}
+
+static Z3_ast mk_byte(Z3_context ctx, unsigned i)
+{
+    return Z3_mk_const(ctx, Z3_mk_int_symbol(ctx, i), Z3_mk_bv_sort(ctx, 8));
+}
+
+static Z3_ast mk_val(Z3_context ctx, unsigned v)
+{
+    return Z3_mk_unsigned_int(ctx, v, Z3_mk_bv_sort(ctx, 8));
+}
+
+static int solve(Z3_ast query, unsigned stop)
+{
+    unsigned char const* proof;
+    unsigned long        proof_size;
+    unsigned             i;
+
+    num_calls       = 0;
+    num_final_calls = 0;
+    stop_at         = stop;
+    int res = z3fuzz_query_check_light_progressive(fctx, query, branch, &proof,
+                                                   &proof_size, callback);
+
+    // every optimistic solution satisfies the branch condition
+    for (i = 0; i < num_calls; ++i)
+        CHECK(z3fuzz_evaluate_expression(fctx, branch, proofs[i]),
+              "optimistic solution %u does not satisfy the branch condition",
+              i);
+    return res;
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned char seed[SEED_SIZE] = {0, 0, 0, 0};
+
+    Z3_config  cfg = Z3_mk_config();
+    Z3_context ctx = Z3_mk_context(cfg);
+    Z3_del_config(cfg);
+
+    // the branch condition is k!0 + k!1 == 0x42. The conjuncts of the query
+    // before it are satisfied one after the other by its solutions, but
+    // k!2 == 0x01 is not: k!2 is not an input of the branch condition
+    fctx   = z3fuzz_create_from_buffer(ctx, seed, SEED_SIZE, TIMEOUT);
+    branch = Z3_mk_eq(ctx, Z3_mk_bvadd(ctx, mk_byte(ctx, 0), mk_byte(ctx, 1)),
+                      mk_val(ctx, 0x42));
+    Z3_ast args[] = {
+        Z3_mk_bvugt(ctx, mk_byte(ctx, 0), mk_val(ctx, 0x00)),
+        Z3_mk_bvugt(ctx, mk_byte(ctx, 1), mk_val(ctx, 0x00)),
+        Z3_mk_bvult(ctx, mk_byte(ctx, 0), mk_val(ctx, 0x20)),
+        Z3_mk_eq(ctx, mk_byte(ctx, 2), mk_val(ctx, 0x01)),
+        branch,
+    };
+    Z3_ast hard_query = Z3_mk_and(ctx, 5, args);
+    Z3_ast sat_query  = Z3_mk_and(ctx, 3, args);
+    Z3_ast sat_args[] = {sat_query, branch};
+    sat_query         = Z3_mk_and(ctx, 2, sat_args);
+
+    // the whole search: increasing depths, no final proof
+    CHECK(!solve(hard_query, 0), "k!2 == 0x01 satisfied");
+    CHECK(num_calls > 1, "%u optimistic solutions", num_calls);
+    printf("[+] %u optimistic solutions, max depth %u\n", num_calls,
+           last_depth);
+
+    // the search stops at the first optimistic solution
+    CHECK(!solve(hard_query, 1), "SAT after a stop");
+    CHECK(num_calls == 1, "%u optimistic solutions after a stop", num_calls);
+
+    // a SAT query ends with a final call
+    CHECK(solve(sat_query, 0), "UNKNOWN query");
+    CHECK(num_final_calls == 1, "%u final calls", num_final_calls);
+    printf("[+] progressive checks passed\n");
+
+    z3fuzz_free(fctx);
+    free(fctx);
+    Z3_del_context(ctx);
+    return 0;
+}
@@ -0,0 +1,170 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <getopt.h>
+#include <sys/stat.h>
+#include "proof-archive.h"
+
+static int g_list = 0;
+
+static const char*   short_opt  = "ha:o:i:";
+static struct option long_opt[] = {{"help", no_argument, NULL, 'h'},
+                                   {"archive", required_argument, NULL, 'a'},
+                                   {"out", required_argument, NULL, 'o'},
+                                   {"index", required_argument, NULL, 'i'},
+                                   {"list", no_argument, &g_list, 1},
+                                   {NULL, 0, NULL, 0}};
+
+static inline void usage(char* filename)
+{
+    fprintf(stderr,
+            "Usage: %s [OPTIONS]\n"
+            "  -h, --help                print this help and exit\n"
+            "  -a, --archive             archive written by fuzzy-solver "
+            "--archive (required)\n"
+            "  -o, --out                 output directory\n"
+            "  -i, --index               extract only the records of this "
+            "query\n"
+            "\n"
+            "  --list                    list the records and exit\n"
+            "\n",
+            filename);
+}
+
+static int extract_record(proof_archive_reader_t* r, pa_record_header_t* h,
+                          pa_buffer_t* payload, const char* output_dir,
+                          FILE* sat_queries_file)
+{
+    if (g_list) {
+        fprintf(stdout, "%u, %s, %u bytes\n", h->query_idx,
+                h->kind == PA_RECORD_PROOF ? "proof" : "query", h->size);
+        return 1;
+    }
+
+    if (h->kind == PA_RECORD_QUERY)
+        return proof_archive_print_query(h, payload, sat_queries_file);
+
+    pa_buffer_t proof = {0};
+    if (!proof_archive_decode_proof(r, h, payload, &proof)) {
+        pa_buffer_free(&proof);
+        return 0;
+    }
+
+    // same layout of fuzzy-solver --dproofs
+    char proof_path[500];
+    int  n = snprintf(proof_path, sizeof(proof_path), "%s/proof_%02u.bin",
+                      output_dir, h->query_idx);
+    assert(n > 0 && n < sizeof(proof_path) && "unable to dump proof");
+
+    FILE* fp = fopen(proof_path, "wb");
+    assert(fp != NULL && "unable to open the proof file");
+    fwrite(proof.data, 1, proof.size, fp);
+    fclose(fp);
+    pa_buffer_free(&proof);
+    return 1;
+}
+
+int main(int argc, char* argv[])
+{
+    char* archive_filename = NULL;
+    char* output_dir       = NULL;
+    long  query_idx        = -1;
+    int   opt;
+    int   option_index = 0;
+
+    while ((opt = getopt_long(argc, argv, short_opt, long_opt,
+                              &option_index)) != -1) {
+        switch (opt) {
+            case 0:
+                break;
+            case 'h':
+                usage(argv[0]);
+                exit(0);
+            case 'a':
+                archive_filename = optarg;
+                break;
+            case 'o':
+                output_dir = optarg;
+                break;
+            case 'i':
+                query_idx = strtol(optarg, NULL, 10);
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+
+    if (archive_filename == NULL || (output_dir == NULL && !g_list)) {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    struct stat sb;
+    if (output_dir != NULL &&
+        (stat(output_dir, &sb) != 0 || !S_ISDIR(sb.st_mode))) {
+        fprintf(stderr, "ERROR: %s is not a valid directory\n", output_dir);
+        exit(1);
+    }
+
+    proof_archive_reader_t r;
+    if (!proof_archive_reader_open(&r, archive_filename)) {
+        fprintf(stderr, "ERROR: unable to open %s\n", archive_filename);
+        exit(1);
+    }
+
+    FILE* sat_queries_file = NULL;
+    if (!g_list) {
+        char path[500];
+        int  n = snprintf(path, sizeof(path), "%s/sat-queries.smt2",
+                          output_dir);
+        assert(n > 0 && n < sizeof(path) && "snprintf failed (sat_queries)");
+        sat_queries_file = fopen(path, "w");
+        assert(sat_queries_file != NULL && "unable to open sat-queries.smt2");
+    }
+
+    pa_record_header_t h;
+    pa_buffer_t        payload   = {0};
+    unsigned long      n_records = 0, n_errors = 0;
+    if (query_idx >= 0) {
+        // look up the records of the query in the index
+        char index_path[512];
+        int  n = snprintf(index_path, sizeof(index_path), "%s.idx",
+                          archive_filename);
+        assert(n > 0 && n < sizeof(index_path) && "archive path too long");
+        FILE* index = fopen(index_path, "rb");
+        if (index == NULL) {
+            fprintf(stderr, "ERROR: unable to open %s\n", index_path);
+            exit(1);
+        }
+
+        pa_index_entry_t entry;
+        while (fread(&entry, sizeof(entry), 1, index) == 1) {
+            if (entry.query_idx != (uint32_t)query_idx)
+                continue;
+            if (!proof_archive_reader_seek(&r, entry.offset) ||
+                !proof_archive_reader_next(&r, &h, &payload) ||
+                !extract_record(&r, &h, &payload, output_dir,
+                                sat_queries_file))
+                n_errors++;
+            n_records++;
+        }
+        fclose(index);
+    } else {
+        while (proof_archive_reader_next(&r, &h, &payload)) {
+            if (!extract_record(&r, &h, &payload, output_dir,
+                                sat_queries_file))
+                n_errors++;
+            n_records++;
+        }
+    }
+
+    if (!g_list)
+        fprintf(stderr, "extracted %lu records (%lu malformed)\n", n_records,
+                n_errors);
+
+    pa_buffer_free(&payload);
+    proof_archive_reader_close(&r);
+    if (sat_queries_file != NULL)
+        fclose(sat_queries_file);
+    return n_errors > 0;
+}
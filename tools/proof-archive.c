@@ -0,0 +1,858 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "proof-archive.h"
+
+#define PA_NODE_APP 0       // name, int parameters, arguments
+#define PA_NODE_BV 1        // width, value
+#define PA_NODE_BV_WIDE 2   // width, value as a decimal string
+#define PA_NODE_CONST_INT 3 // input symbol (k!<n>)
+#define PA_NODE_CONST 4     // name
+
+#define PA_LOG(x...) fprintf(stderr, "[proof-archive] " x)
+
+// ************* buffers *************
+
+void pa_buffer_free(pa_buffer_t* b)
+{
+    free(b->data);
+    b->data     = NULL;
+    b->size     = 0;
+    b->capacity = 0;
+}
+
+static void pa_buffer_reserve(pa_buffer_t* b, uint64_t n)
+{
+    if (b->size + n <= b->capacity)
+        return;
+    uint64_t capacity = b->capacity ? b->capacity : 64;
+    while (capacity < b->size + n)
+        capacity *= 2;
+    b->data = (unsigned char*)realloc(b->data, capacity);
+    assert(b->data != NULL && "pa_buffer_reserve() failed realloc");
+    b->capacity = capacity;
+}
+
+static void pa_buffer_append(pa_buffer_t* b, const void* data, uint64_t n)
+{
+    pa_buffer_reserve(b, n);
+    memcpy(b->data + b->size, data, n);
+    b->size += n;
+}
+
+static void pa_buffer_put_varint(pa_buffer_t* b, uint64_t v)
+{
+    pa_buffer_reserve(b, 10);
+    while (v >= 0x80) {
+        b->data[b->size++] = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    b->data[b->size++] = (unsigned char)v;
+}
+
+static int pa_get_varint(const pa_buffer_t* b, uint64_t* pos, uint64_t* v)
+{
+    uint64_t res   = 0;
+    unsigned shift = 0;
+    while (*pos < b->size && shift < 64) {
+        unsigned char c = b->data[(*pos)++];
+        res |= (uint64_t)(c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            *v = res;
+            return 1;
+        }
+        shift += 7;
+    }
+    return 0;
+}
+
+static int pa_get_bytes(const pa_buffer_t* b, uint64_t* pos, uint64_t n,
+                        const unsigned char** data)
+{
+    if (n > b->size - *pos)
+        return 0;
+    *data = b->data + *pos;
+    *pos += n;
+    return 1;
+}
+
+// ************* writer *************
+
+static void pa_write_record(proof_archive_t* pa, pa_pending_t* p)
+{
+    pa_index_entry_t entry = {.kind      = p->header.kind,
+                              .query_idx = p->header.query_idx,
+                              .offset    = pa->offset};
+
+    if (fwrite(&p->header, sizeof(pa_record_header_t), 1, pa->archive) != 1 ||
+        fwrite(p->payload, 1, p->header.size, pa->archive) !=
+            p->header.size ||
+        fwrite(&entry, sizeof(pa_index_entry_t), 1, pa->index) != 1)
+        PA_LOG("write failed (query %u)\n", p->header.query_idx);
+    pa->offset += sizeof(pa_record_header_t) + p->header.size;
+}
+
+static void* pa_writer_loop(void* arg)
+{
+    proof_archive_t* pa = (proof_archive_t*)arg;
+
+    pthread_mutex_lock(&pa->lock);
+    while (1) {
+        if (pa->count == 0) {
+            if (pa->closing)
+                break;
+            // idle: make what we have visible to readers
+            pthread_mutex_unlock(&pa->lock);
+            fflush(pa->archive);
+            fflush(pa->index);
+            pthread_mutex_lock(&pa->lock);
+            while (pa->count == 0 && !pa->closing)
+                pthread_cond_wait(&pa->not_empty, &pa->lock);
+            continue;
+        }
+
+        pa_pending_t p = pa->queue[pa->head];
+        pa->head       = (pa->head + 1) % PA_QUEUE_SIZE;
+        pa->count--;
+        pthread_cond_signal(&pa->not_full);
+        pthread_mutex_unlock(&pa->lock);
+
+        pa_write_record(pa, &p);
+        free(p.payload);
+
+        pthread_mutex_lock(&pa->lock);
+    }
+    pthread_mutex_unlock(&pa->lock);
+    return NULL;
+}
+
+static void pa_enqueue(proof_archive_t* pa, uint32_t kind, uint32_t encoding,
+                       uint32_t query_idx, pa_buffer_t* payload)
+{
+    assert(payload->size <= UINT32_MAX && "pa_enqueue() record too big");
+
+    pthread_mutex_lock(&pa->lock);
+    while (pa->count == PA_QUEUE_SIZE)
+        pthread_cond_wait(&pa->not_full, &pa->lock);
+
+    // the writer thread takes the ownership of the payload
+    pa_pending_t* p     = &pa->queue[(pa->head + pa->count) % PA_QUEUE_SIZE];
+    p->header.kind      = kind;
+    p->header.encoding  = encoding;
+    p->header.query_idx = query_idx;
+    p->header.size      = (uint32_t)payload->size;
+    p->payload          = payload->data;
+    pa->count++;
+    pthread_cond_signal(&pa->not_empty);
+    pthread_mutex_unlock(&pa->lock);
+}
+
+int proof_archive_open(proof_archive_t* pa, const char* path,
+                       const unsigned char* seed, uint64_t seed_len)
+{
+    char index_path[512];
+    int  n = snprintf(index_path, sizeof(index_path), "%s.idx", path);
+    if (n <= 0 || n >= sizeof(index_path))
+        return 0;
+
+    pa->archive = fopen(path, "wb");
+    pa->index   = fopen(index_path, "wb");
+    if (pa->archive == NULL || pa->index == NULL) {
+        PA_LOG("unable to open %s\n", path);
+        if (pa->archive != NULL)
+            fclose(pa->archive);
+        if (pa->index != NULL)
+            fclose(pa->index);
+        return 0;
+    }
+
+    uint32_t magic   = PA_MAGIC;
+    uint32_t version = PA_VERSION;
+    fwrite(&magic, sizeof(magic), 1, pa->archive);
+    fwrite(&version, sizeof(version), 1, pa->archive);
+    fwrite(&seed_len, sizeof(seed_len), 1, pa->archive);
+    fwrite(seed, 1, seed_len, pa->archive);
+    pa->offset = sizeof(magic) + sizeof(version) + sizeof(seed_len) + seed_len;
+
+    pa->seed = (unsigned char*)malloc(seed_len);
+    assert(pa->seed != NULL && "proof_archive_open() failed malloc");
+    memcpy(pa->seed, seed, seed_len);
+    pa->seed_len = seed_len;
+
+    pa->head    = 0;
+    pa->count   = 0;
+    pa->closing = 0;
+    pthread_mutex_init(&pa->lock, NULL);
+    pthread_cond_init(&pa->not_empty, NULL);
+    pthread_cond_init(&pa->not_full, NULL);
+    if (pthread_create(&pa->writer, NULL, pa_writer_loop, pa) != 0) {
+        PA_LOG("unable to start the writer thread\n");
+        pthread_mutex_destroy(&pa->lock);
+        pthread_cond_destroy(&pa->not_empty);
+        pthread_cond_destroy(&pa->not_full);
+        fclose(pa->archive);
+        fclose(pa->index);
+        free(pa->seed);
+        pa->seed = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+void proof_archive_close(proof_archive_t* pa)
+{
+    pthread_mutex_lock(&pa->lock);
+    pa->closing = 1;
+    pthread_cond_signal(&pa->not_empty);
+    pthread_mutex_unlock(&pa->lock);
+    pthread_join(pa->writer, NULL);
+
+    pthread_mutex_destroy(&pa->lock);
+    pthread_cond_destroy(&pa->not_empty);
+    pthread_cond_destroy(&pa->not_full);
+    fclose(pa->archive);
+    fclose(pa->index);
+    free(pa->seed);
+    pa->seed = NULL;
+}
+
+static inline unsigned char pa_seed_byte(const unsigned char* seed,
+                                         uint64_t seed_len, uint64_t i)
+{
+    return i < seed_len ? seed[i] : 0;
+}
+
+void proof_archive_add_proof(proof_archive_t* pa, uint32_t query_idx,
+                             const unsigned char* proof, uint64_t proof_size)
+{
+    // proofs are mostly the seed with a few bytes patched: store the runs
+    // that differ, as (gap from the previous run, length, bytes)
+    pa_buffer_t b = {0};
+    pa_buffer_put_varint(&b, proof_size);
+
+    uint64_t i = 0, last = 0;
+    while (i < proof_size) {
+        if (proof[i] == pa_seed_byte(pa->seed, pa->seed_len, i)) {
+            i++;
+            continue;
+        }
+        uint64_t start = i;
+        while (i < proof_size &&
+               proof[i] != pa_seed_byte(pa->seed, pa->seed_len, i))
+            i++;
+        pa_buffer_put_varint(&b, start - last);
+        pa_buffer_put_varint(&b, i - start);
+        pa_buffer_append(&b, proof + start, i - start);
+        last = i;
+    }
+
+    uint32_t encoding = PA_ENCODING_DELTA;
+    if (b.size >= proof_size) {
+        b.size   = 0;
+        encoding = PA_ENCODING_RAW;
+        pa_buffer_append(&b, proof, proof_size);
+    }
+    pa_enqueue(pa, PA_RECORD_PROOF, encoding, query_idx, &b);
+}
+
+// ************* query DAG *************
+
+typedef struct pa_ast_map_t {
+    uint64_t* keys; // ast id + 1, 0 is a free slot
+    uint32_t* values;
+    uint64_t  capacity;
+    uint64_t  size;
+} pa_ast_map_t;
+
+static void pa_ast_map_init(pa_ast_map_t* m, uint64_t capacity)
+{
+    m->keys     = (uint64_t*)calloc(capacity, sizeof(uint64_t));
+    m->values   = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+    m->capacity = capacity;
+    m->size     = 0;
+    assert(m->keys != NULL && m->values != NULL &&
+           "pa_ast_map_init() failed malloc");
+}
+
+static void pa_ast_map_free(pa_ast_map_t* m)
+{
+    free(m->keys);
+    free(m->values);
+}
+
+static uint32_t* pa_ast_map_slot(pa_ast_map_t* m, uint64_t key, int* found)
+{
+    uint64_t i = (key * 0x9e3779b97f4a7c15UL) & (m->capacity - 1);
+    while (m->keys[i] != 0 && m->keys[i] != key + 1)
+        i = (i + 1) & (m->capacity - 1);
+    *found = m->keys[i] != 0;
+    if (!*found)
+        m->keys[i] = key + 1;
+    return &m->values[i];
+}
+
+static void pa_ast_map_set(pa_ast_map_t* m, uint64_t key, uint32_t value)
+{
+    if (2 * (m->size + 1) > m->capacity) {
+        pa_ast_map_t bigger;
+        pa_ast_map_init(&bigger, m->capacity * 2);
+        uint64_t i;
+        int      found;
+        for (i = 0; i < m->capacity; ++i)
+            if (m->keys[i] != 0)
+                *pa_ast_map_slot(&bigger, m->keys[i] - 1, &found) =
+                    m->values[i];
+        bigger.size = m->size;
+        pa_ast_map_free(m);
+        *m = bigger;
+    }
+    int       found;
+    uint32_t* slot = pa_ast_map_slot(m, key, &found);
+    *slot          = value;
+    if (!found)
+        m->size++;
+}
+
+static int pa_ast_map_get(pa_ast_map_t* m, uint64_t key, uint32_t* value)
+{
+    uint64_t i = (key * 0x9e3779b97f4a7c15UL) & (m->capacity - 1);
+    while (m->keys[i] != 0) {
+        if (m->keys[i] == key + 1) {
+            *value = m->values[i];
+            return 1;
+        }
+        i = (i + 1) & (m->capacity - 1);
+    }
+    return 0;
+}
+
+typedef struct pa_names_t {
+    const char** names;
+    unsigned     size;
+    unsigned     capacity;
+} pa_names_t;
+
+static unsigned pa_names_get(pa_names_t* t, const char* name)
+{
+    // few distinct operators per query, a linear scan is fine
+    unsigned i;
+    for (i = 0; i < t->size; ++i)
+        if (strcmp(t->names[i], name) == 0)
+            return i;
+
+    if (t->size == t->capacity) {
+        t->capacity = t->capacity ? t->capacity * 2 : 32;
+        t->names =
+            (const char**)realloc(t->names, t->capacity * sizeof(char*));
+        assert(t->names != NULL && "pa_names_get() failed realloc");
+    }
+    // Z3 symbol strings are short lived
+    t->names[t->size] = strdup(name);
+    return t->size++;
+}
+
+static void pa_names_free(pa_names_t* t)
+{
+    unsigned i;
+    for (i = 0; i < t->size; ++i)
+        free((char*)t->names[i]);
+    free(t->names);
+}
+
+static int pa_encode_node(Z3_context ctx, Z3_ast e, uint32_t id,
+                          pa_ast_map_t* ids, pa_names_t* names,
+                          pa_buffer_t* nodes)
+{
+    switch (Z3_get_ast_kind(ctx, e)) {
+        case Z3_NUMERAL_AST: {
+            Z3_sort sort = Z3_get_sort(ctx, e);
+            if (Z3_get_sort_kind(ctx, sort) != Z3_BV_SORT)
+                return 0;
+            uint64_t v;
+            if (Z3_get_numeral_uint64(ctx, e, &v)) {
+                pa_buffer_put_varint(nodes, PA_NODE_BV);
+                pa_buffer_put_varint(nodes, Z3_get_bv_sort_size(ctx, sort));
+                pa_buffer_put_varint(nodes, v);
+            } else {
+                Z3_string s = Z3_get_numeral_string(ctx, e);
+                pa_buffer_put_varint(nodes, PA_NODE_BV_WIDE);
+                pa_buffer_put_varint(nodes, Z3_get_bv_sort_size(ctx, sort));
+                pa_buffer_put_varint(nodes, strlen(s));
+                pa_buffer_append(nodes, s, strlen(s));
+            }
+            return 1;
+        }
+        case Z3_APP_AST: {
+            Z3_app       app    = Z3_to_app(ctx, e);
+            Z3_func_decl decl   = Z3_get_app_decl(ctx, app);
+            Z3_symbol    symbol = Z3_get_decl_name(ctx, decl);
+            unsigned     n_args = Z3_get_app_num_args(ctx, app);
+
+            if (Z3_get_decl_kind(ctx, decl) == Z3_OP_UNINTERPRETED &&
+                n_args == 0) {
+                if (Z3_get_symbol_kind(ctx, symbol) == Z3_INT_SYMBOL) {
+                    pa_buffer_put_varint(nodes, PA_NODE_CONST_INT);
+                    pa_buffer_put_varint(nodes,
+                                         Z3_get_symbol_int(ctx, symbol));
+                } else {
+                    pa_buffer_put_varint(nodes, PA_NODE_CONST);
+                    pa_buffer_put_varint(
+                        nodes,
+                        pa_names_get(names, Z3_get_symbol_string(ctx, symbol)));
+                }
+                return 1;
+            }
+            if (Z3_get_symbol_kind(ctx, symbol) != Z3_STRING_SYMBOL)
+                return 0;
+
+            unsigned n_params = Z3_get_decl_num_parameters(ctx, decl);
+            unsigned i;
+            for (i = 0; i < n_params; ++i)
+                if (Z3_get_decl_parameter_kind(ctx, decl, i) !=
+                    Z3_PARAMETER_INT)
+                    return 0;
+
+            pa_buffer_put_varint(nodes, PA_NODE_APP);
+            pa_buffer_put_varint(
+                nodes, pa_names_get(names, Z3_get_symbol_string(ctx, symbol)));
+            pa_buffer_put_varint(nodes, n_params);
+            for (i = 0; i < n_params; ++i)
+                pa_buffer_put_varint(
+                    nodes, Z3_get_decl_int_parameter(ctx, decl, i));
+            pa_buffer_put_varint(nodes, n_args);
+            for (i = 0; i < n_args; ++i) {
+                uint32_t arg_id;
+                int      found = pa_ast_map_get(
+                    ids, Z3_get_ast_id(ctx, Z3_get_app_arg(ctx, app, i)),
+                    &arg_id);
+                assert(found && "pa_encode_node() argument not encoded");
+                // backward reference
+                pa_buffer_put_varint(nodes, id - arg_id);
+            }
+            return 1;
+        }
+        default:
+            // quantifiers and bound variables
+            return 0;
+    }
+}
+
+static int pa_encode_dag(Z3_context ctx, Z3_ast query, pa_buffer_t* out)
+{
+    pa_ast_map_t ids;
+    pa_names_t   names   = {0};
+    pa_buffer_t  nodes   = {0};
+    uint32_t     n_nodes = 0;
+    int          res     = 1;
+
+    pa_ast_map_init(&ids, 1024);
+
+    // iterative post order visit, the stack holds (ast, next child)
+    Z3_ast*   stack          = (Z3_ast*)malloc(sizeof(Z3_ast) * 64);
+    unsigned* stack_child    = (unsigned*)malloc(sizeof(unsigned) * 64);
+    unsigned  stack_size     = 0;
+    unsigned  stack_capacity = 64;
+    assert(stack != NULL && stack_child != NULL &&
+           "pa_encode_dag() failed malloc");
+
+    stack[0]       = query;
+    stack_child[0] = 0;
+    stack_size     = 1;
+    while (stack_size > 0) {
+        Z3_ast   e = stack[stack_size - 1];
+        uint32_t tmp;
+        if (pa_ast_map_get(&ids, Z3_get_ast_id(ctx, e), &tmp)) {
+            stack_size--;
+            continue;
+        }
+
+        unsigned n_args = 0;
+        if (Z3_get_ast_kind(ctx, e) == Z3_APP_AST)
+            n_args = Z3_get_app_num_args(ctx, Z3_to_app(ctx, e));
+        if (stack_child[stack_size - 1] < n_args) {
+            Z3_ast child = Z3_get_app_arg(ctx, Z3_to_app(ctx, e),
+                                          stack_child[stack_size - 1]++);
+            if (stack_size == stack_capacity) {
+                stack_capacity *= 2;
+                stack =
+                    (Z3_ast*)realloc(stack, sizeof(Z3_ast) * stack_capacity);
+                stack_child = (unsigned*)realloc(
+                    stack_child, sizeof(unsigned) * stack_capacity);
+                assert(stack != NULL && stack_child != NULL &&
+                       "pa_encode_dag() failed realloc");
+            }
+            stack[stack_size]       = child;
+            stack_child[stack_size] = 0;
+            stack_size++;
+            continue;
+        }
+
+        if (!pa_encode_node(ctx, e, n_nodes, &ids, &names, &nodes)) {
+            res = 0;
+            break;
+        }
+        pa_ast_map_set(&ids, Z3_get_ast_id(ctx, e), n_nodes++);
+        stack_size--;
+    }
+
+    if (res) {
+        unsigned i;
+        pa_buffer_put_varint(out, names.size);
+        for (i = 0; i < names.size; ++i) {
+            pa_buffer_put_varint(out, strlen(names.names[i]));
+            pa_buffer_append(out, names.names[i], strlen(names.names[i]));
+        }
+        // the root is the last node
+        pa_buffer_put_varint(out, n_nodes);
+        pa_buffer_append(out, nodes.data, nodes.size);
+    }
+
+    free(stack);
+    free(stack_child);
+    pa_buffer_free(&nodes);
+    pa_names_free(&names);
+    pa_ast_map_free(&ids);
+    return res;
+}
+
+void proof_archive_add_query(proof_archive_t* pa, uint32_t query_idx,
+                             Z3_context ctx, Z3_ast query)
+{
+    // the encoding needs the Z3 context, hence it is done by the caller
+    pa_buffer_t b = {0};
+    if (pa_encode_dag(ctx, query, &b)) {
+        pa_enqueue(pa, PA_RECORD_QUERY, PA_ENCODING_DAG, query_idx, &b);
+        return;
+    }
+
+    b.size      = 0;
+    Z3_string s = Z3_ast_to_string(ctx, query);
+    pa_buffer_append(&b, "(assert\n", 8);
+    pa_buffer_append(&b, s, strlen(s));
+    pa_buffer_append(&b, "\n)\n", 3);
+    pa_enqueue(pa, PA_RECORD_QUERY, PA_ENCODING_TEXT, query_idx, &b);
+}
+
+// ************* reader *************
+
+int proof_archive_reader_open(proof_archive_reader_t* r, const char* path)
+{
+    r->archive = fopen(path, "rb");
+    r->seed    = NULL;
+    if (r->archive == NULL)
+        return 0;
+
+    uint32_t magic, version;
+    if (fread(&magic, sizeof(magic), 1, r->archive) != 1 ||
+        fread(&version, sizeof(version), 1, r->archive) != 1 ||
+        magic != PA_MAGIC || version != PA_VERSION ||
+        fread(&r->seed_len, sizeof(r->seed_len), 1, r->archive) != 1) {
+        PA_LOG("%s is not a proof archive\n", path);
+        fclose(r->archive);
+        return 0;
+    }
+
+    r->seed = (unsigned char*)malloc(r->seed_len ? r->seed_len : 1);
+    assert(r->seed != NULL && "proof_archive_reader_open() failed malloc");
+    if (fread(r->seed, 1, r->seed_len, r->archive) != r->seed_len) {
+        PA_LOG("%s is truncated\n", path);
+        proof_archive_reader_close(r);
+        return 0;
+    }
+    return 1;
+}
+
+int proof_archive_reader_seek(proof_archive_reader_t* r, uint64_t offset)
+{
+    return fseek(r->archive, (long)offset, SEEK_SET) == 0;
+}
+
+int proof_archive_reader_next(proof_archive_reader_t* r,
+                              pa_record_header_t* header, pa_buffer_t* payload)
+{
+    if (fread(header, sizeof(pa_record_header_t), 1, r->archive) != 1)
+        return 0;
+
+    payload->size = 0;
+    pa_buffer_reserve(payload, header->size);
+    if (fread(payload->data, 1, header->size, r->archive) != header->size) {
+        // the last record is still being written
+        return 0;
+    }
+    payload->size = header->size;
+    return 1;
+}
+
+void proof_archive_reader_close(proof_archive_reader_t* r)
+{
+    fclose(r->archive);
+    free(r->seed);
+    r->archive = NULL;
+    r->seed    = NULL;
+}
+
+int proof_archive_decode_proof(proof_archive_reader_t*   r,
+                               const pa_record_header_t* header,
+                               const pa_buffer_t* payload, pa_buffer_t* proof)
+{
+    proof->size = 0;
+    if (header->encoding == PA_ENCODING_RAW) {
+        pa_buffer_append(proof, payload->data, payload->size);
+        return 1;
+    }
+    if (header->encoding != PA_ENCODING_DELTA)
+        return 0;
+
+    uint64_t pos = 0, proof_size;
+    if (!pa_get_varint(payload, &pos, &proof_size))
+        return 0;
+
+    uint64_t i;
+    pa_buffer_reserve(proof, proof_size);
+    for (i = 0; i < proof_size; ++i)
+        proof->data[i] = pa_seed_byte(r->seed, r->seed_len, i);
+    proof->size = proof_size;
+
+    uint64_t last = 0;
+    while (pos < payload->size) {
+        uint64_t             gap, len;
+        const unsigned char* bytes;
+        if (!pa_get_varint(payload, &pos, &gap) ||
+            !pa_get_varint(payload, &pos, &len) ||
+            !pa_get_bytes(payload, &pos, len, &bytes) ||
+            last + gap + len > proof_size)
+            return 0;
+        memcpy(proof->data + last + gap, bytes, len);
+        last += gap + len;
+    }
+    return 1;
+}
+
+typedef struct pa_node_t {
+    uint32_t tag;
+    uint32_t uses;
+    uint64_t value;  // name, symbol or bv value
+    uint32_t width;  // of bv values
+    uint64_t params; // position in the payload
+    uint32_t n_params;
+    uint64_t args; // position in the payload
+    uint32_t n_args;
+} pa_node_t;
+
+typedef struct pa_dag_t {
+    const pa_buffer_t* payload;
+    char**             names;
+    uint64_t           n_names;
+    pa_node_t*         nodes;
+    uint64_t           n_nodes;
+} pa_dag_t;
+
+static int pa_skip_varints(const pa_buffer_t* b, uint64_t* pos, uint64_t n)
+{
+    uint64_t v;
+    while (n--)
+        if (!pa_get_varint(b, pos, &v))
+            return 0;
+    return 1;
+}
+
+static int pa_decode_dag(const pa_buffer_t* payload, pa_dag_t* dag)
+{
+    uint64_t pos = 0, i, j;
+    dag->payload = payload;
+    dag->names   = NULL;
+    dag->nodes   = NULL;
+    dag->n_names = 0;
+    dag->n_nodes = 0;
+
+    uint64_t n_names;
+    if (!pa_get_varint(payload, &pos, &n_names) || n_names > payload->size)
+        return 0;
+    dag->names = (char**)calloc(n_names + 1, sizeof(char*));
+    assert(dag->names != NULL && "pa_decode_dag() failed malloc");
+    for (i = 0; i < n_names; ++i) {
+        uint64_t             len;
+        const unsigned char* s;
+        if (!pa_get_varint(payload, &pos, &len) ||
+            !pa_get_bytes(payload, &pos, len, &s))
+            return 0;
+        dag->names[i] = strndup((const char*)s, len);
+        dag->n_names++;
+    }
+
+    uint64_t n_nodes;
+    if (!pa_get_varint(payload, &pos, &n_nodes) || n_nodes == 0 ||
+        n_nodes > payload->size)
+        return 0;
+    dag->nodes = (pa_node_t*)calloc(n_nodes, sizeof(pa_node_t));
+    assert(dag->nodes != NULL && "pa_decode_dag() failed malloc");
+    for (i = 0; i < n_nodes; ++i) {
+        pa_node_t* node = &dag->nodes[i];
+        uint64_t   tag, v, len;
+        if (!pa_get_varint(payload, &pos, &tag))
+            return 0;
+        node->tag = (uint32_t)tag;
+        switch (tag) {
+            case PA_NODE_APP:
+                if (!pa_get_varint(payload, &pos, &node->value) ||
+                    node->value >= dag->n_names ||
+                    !pa_get_varint(payload, &pos, &v))
+                    return 0;
+                node->n_params = (uint32_t)v;
+                node->params   = pos;
+                if (!pa_skip_varints(payload, &pos, node->n_params) ||
+                    !pa_get_varint(payload, &pos, &v))
+                    return 0;
+                node->n_args = (uint32_t)v;
+                node->args   = pos;
+                for (j = 0; j < node->n_args; ++j) {
+                    if (!pa_get_varint(payload, &pos, &v) || v == 0 || v > i)
+                        return 0;
+                    dag->nodes[i - v].uses++;
+                }
+                break;
+            case PA_NODE_BV:
+                if (!pa_get_varint(payload, &pos, &v) ||
+                    !pa_get_varint(payload, &pos, &node->value))
+                    return 0;
+                node->width = (uint32_t)v;
+                break;
+            case PA_NODE_BV_WIDE: {
+                const unsigned char* s;
+                if (!pa_get_varint(payload, &pos, &v) ||
+                    !pa_get_varint(payload, &pos, &len))
+                    return 0;
+                node->width = (uint32_t)v;
+                node->args  = pos;
+                node->value = len;
+                if (!pa_get_bytes(payload, &pos, len, &s))
+                    return 0;
+                break;
+            }
+            case PA_NODE_CONST_INT:
+                if (!pa_get_varint(payload, &pos, &node->value))
+                    return 0;
+                break;
+            case PA_NODE_CONST:
+                if (!pa_get_varint(payload, &pos, &node->value) ||
+                    node->value >= dag->n_names)
+                    return 0;
+                break;
+            default:
+                return 0;
+        }
+        dag->n_nodes++;
+    }
+    return 1;
+}
+
+static void pa_free_dag(pa_dag_t* dag)
+{
+    uint64_t i;
+    for (i = 0; i < dag->n_names; ++i)
+        free(dag->names[i]);
+    free(dag->names);
+    free(dag->nodes);
+}
+
+static inline int pa_is_bound(pa_node_t* node)
+{
+    // shared applications are bound by a let, leaves are printed inline
+    return node->uses > 1 && node->tag == PA_NODE_APP && node->n_args > 0;
+}
+
+// 0 if the payload is truncated or malformed
+static int pa_print_node(pa_dag_t* dag, uint64_t id, int bind, FILE* out)
+{
+    pa_node_t* node = &dag->nodes[id];
+
+    if (!bind && pa_is_bound(node)) {
+        fprintf(out, "?x%lu", id);
+        return 1;
+    }
+
+    uint64_t pos, v, j;
+    switch (node->tag) {
+        case PA_NODE_BV:
+            fprintf(out, "(_ bv%lu %u)", node->value, node->width);
+            break;
+        case PA_NODE_BV_WIDE:
+            fprintf(out, "(_ bv%.*s %u)", (int)node->value,
+                    (const char*)dag->payload->data + node->args, node->width);
+            break;
+        case PA_NODE_CONST_INT:
+            fprintf(out, "k!%lu", node->value);
+            break;
+        case PA_NODE_CONST:
+            fprintf(out, "%s", dag->names[node->value]);
+            break;
+        case PA_NODE_APP:
+            if (node->n_args > 0)
+                fprintf(out, "(");
+            if (node->n_params > 0) {
+                fprintf(out, "(_ %s", dag->names[node->value]);
+                pos = node->params;
+                for (j = 0; j < node->n_params; ++j) {
+                    if (!pa_get_varint(dag->payload, &pos, &v))
+                        return 0;
+                    fprintf(out, " %lu", v);
+                }
+                fprintf(out, ")");
+            } else
+                fprintf(out, "%s", dag->names[node->value]);
+            pos = node->args;
+            for (j = 0; j < node->n_args; ++j) {
+                if (!pa_get_varint(dag->payload, &pos, &v) || v == 0 ||
+                    v > id)
+                    return 0;
+                fprintf(out, " ");
+                if (!pa_print_node(dag, id - v, 0, out))
+                    return 0;
+            }
+            if (node->n_args > 0)
+                fprintf(out, ")");
+            break;
+    }
+    return 1;
+}
+
+int proof_archive_print_query(const pa_record_header_t* header,
+                              const pa_buffer_t* payload, FILE* out)
+{
+    if (header->encoding == PA_ENCODING_TEXT) {
+        fwrite(payload->data, 1, payload->size, out);
+        return 1;
+    }
+    if (header->encoding != PA_ENCODING_DAG)
+        return 0;
+
+    pa_dag_t dag;
+    if (!pa_decode_dag(payload, &dag)) {
+        pa_free_dag(&dag);
+        return 0;
+    }
+
+    uint64_t i, n_lets = 0;
+    fprintf(out, "(assert\n");
+    for (i = 0; i + 1 < dag.n_nodes; ++i) {
+        if (!pa_is_bound(&dag.nodes[i]))
+            continue;
+        fprintf(out, "(let ((?x%lu ", i);
+        if (!pa_print_node(&dag, i, 1, out)) {
+            pa_free_dag(&dag);
+            return 0;
+        }
+        fprintf(out, "))\n");
+        n_lets++;
+    }
+    if (!pa_print_node(&dag, dag.n_nodes - 1, 1, out)) {
+        pa_free_dag(&dag);
+        return 0;
+    }
+    for (i = 0; i < n_lets; ++i)
+        fprintf(out, ")");
+    fprintf(out, "\n)\n");
+
+    pa_free_dag(&dag);
+    return 1;
+}
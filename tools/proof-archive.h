@@ -0,0 +1,97 @@
+#ifndef PROOF_ARCHIVE_H
+#define PROOF_ARCHIVE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <z3.h>
+
+// Append-only archive of the results of fuzzy-solver. A proof is stored as
+// the runs of bytes that differ from the seed, a SAT query as its DAG in
+// post order. Records are encoded by the caller and written by a
+// background thread. Every record gets an entry in a separate index
+// (<archive>.idx) that maps it to its offset in the archive.
+
+#define PA_MAGIC 0x41505a46 // "FZPA"
+#define PA_VERSION 1
+#define PA_QUEUE_SIZE 256
+
+#define PA_RECORD_PROOF 0
+#define PA_RECORD_QUERY 1
+
+#define PA_ENCODING_RAW 0   // proof bytes, as they are
+#define PA_ENCODING_DELTA 1 // proof runs that differ from the seed
+#define PA_ENCODING_DAG 2   // query DAG
+#define PA_ENCODING_TEXT 3  // query in SMT2, if the DAG cannot encode it
+
+typedef struct pa_record_header_t {
+    uint32_t kind;
+    uint32_t encoding;
+    uint32_t query_idx;
+    uint32_t size; // of the payload
+} pa_record_header_t;
+
+typedef struct pa_index_entry_t {
+    uint32_t kind;
+    uint32_t query_idx;
+    uint64_t offset; // of the record header
+} pa_index_entry_t;
+
+typedef struct pa_buffer_t {
+    unsigned char* data;
+    uint64_t       size;
+    uint64_t       capacity;
+} pa_buffer_t;
+
+typedef struct pa_pending_t {
+    pa_record_header_t header;
+    unsigned char*     payload;
+} pa_pending_t;
+
+typedef struct proof_archive_t {
+    FILE*          archive;
+    FILE*          index;
+    uint64_t       offset;
+    unsigned char* seed;
+    uint64_t       seed_len;
+
+    // records waiting for the writer thread
+    pa_pending_t    queue[PA_QUEUE_SIZE];
+    unsigned        head;
+    unsigned        count;
+    int             closing;
+    pthread_t       writer;
+    pthread_mutex_t lock;
+    pthread_cond_t  not_empty;
+    pthread_cond_t  not_full;
+} proof_archive_t;
+
+typedef struct proof_archive_reader_t {
+    FILE*          archive;
+    unsigned char* seed;
+    uint64_t       seed_len;
+} proof_archive_reader_t;
+
+int  proof_archive_open(proof_archive_t* pa, const char* path,
+                        const unsigned char* seed, uint64_t seed_len);
+void proof_archive_add_proof(proof_archive_t* pa, uint32_t query_idx,
+                             const unsigned char* proof, uint64_t proof_size);
+void proof_archive_add_query(proof_archive_t* pa, uint32_t query_idx,
+                             Z3_context ctx, Z3_ast query);
+void proof_archive_close(proof_archive_t* pa);
+
+int  proof_archive_reader_open(proof_archive_reader_t* r, const char* path);
+int  proof_archive_reader_seek(proof_archive_reader_t* r, uint64_t offset);
+int  proof_archive_reader_next(proof_archive_reader_t* r,
+                               pa_record_header_t*     header,
+                               pa_buffer_t*            payload);
+int  proof_archive_decode_proof(proof_archive_reader_t*   r,
+                                const pa_record_header_t* header,
+                                const pa_buffer_t* payload, pa_buffer_t* proof);
+int  proof_archive_print_query(const pa_record_header_t* header,
+                               const pa_buffer_t* payload, FILE* out);
+void proof_archive_reader_close(proof_archive_reader_t* r);
+
+void pa_buffer_free(pa_buffer_t* b);
+
+#endif
@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "thread-pool.h"
+
+// Stress test of the thread pool, meant to be built with -fsanitize=thread
+// too: external and nested submissions, the per-worker scratch space and
+// the cooperative cancellation.
+
+#define NUM_WORKERS 4
+#define NUM_ROUNDS 10
+#define NUM_TASKS 1000
+#define CHILD_EVERY 10
+#define INPUT_SIZE 64
+#define SPIN_LIMIT 100000000UL
+
+#define CHECK(x, mex...)                                                       \
+    do {                                                                       \
+        if (!(x)) {                                                            \
+            fprintf(stderr, "[-] " mex);                                       \
+            fprintf(stderr, "\n");                                             \
+            exit(1);                                                           \
+        }                                                                      \
+    } while (0)
+
+static long     executed;
+static long     bad_worker;
+static long     per_worker[TP_MAX_WORKERS];
+static uint64_t results[NUM_TASKS + NUM_TASKS / CHILD_EVERY];
+
+static void child_task(tp_worker_t* w, void* arg)
+{
+    uint64_t* out = (uint64_t*)arg;
+    *out          = tp_rand(w) | 1;
+    __atomic_add_fetch(&executed, 1, __ATOMIC_RELAXED);
+}
+
+static void task(tp_worker_t* w, void* arg)
+{
+    unsigned long i = (unsigned long)arg;
+
+    if (thread_pool_current_worker() != w || w->input_size < INPUT_SIZE)
+        __atomic_add_fetch(&bad_worker, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&per_worker[w->id], 1, __ATOMIC_RELAXED);
+
+    // the scratch space is private to the worker
+    unsigned long k;
+    for (k = 0; k < INPUT_SIZE; ++k)
+        w->input[k] = i;
+    unsigned char* buf = (unsigned char*)tp_arena_alloc(w, 1 + i % 4096);
+    memset(buf, i & 0xff, 1 + i % 4096);
+    for (k = 0; k < INPUT_SIZE; ++k)
+        if (w->input[k] != i)
+            __atomic_add_fetch(&bad_worker, 1, __ATOMIC_RELAXED);
+
+    results[i] = i + 1;
+    if (i % CHILD_EVERY == 0)
+        thread_pool_submit(w->pool, child_task,
+                           &results[NUM_TASKS + i / CHILD_EVERY]);
+    __atomic_add_fetch(&executed, 1, __ATOMIC_RELAXED);
+}
+
+static void spinning_task(tp_worker_t* w, void* arg)
+{
+    unsigned long n = 0;
+    while (!thread_pool_cancelled(w) && n < SPIN_LIMIT)
+        n++;
+    if (n == SPIN_LIMIT)
+        __atomic_add_fetch(&bad_worker, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&executed, 1, __ATOMIC_RELAXED);
+}
+
+int main(int argc, char* argv[])
+{
+    thread_pool_t pool;
+    unsigned long i;
+    unsigned      round;
+
+    CHECK(thread_pool_init(&pool, NUM_WORKERS, INPUT_SIZE, 0),
+          "thread_pool_init() failed");
+    CHECK(thread_pool_current_worker() == NULL,
+          "the main thread is not a worker");
+
+    for (round = 0; round < NUM_ROUNDS; ++round) {
+        executed = 0;
+        memset(results, 0, sizeof(results));
+        for (i = 0; i < NUM_TASKS; ++i)
+            thread_pool_submit(&pool, task, (void*)i);
+        thread_pool_wait(&pool);
+
+        CHECK(executed == NUM_TASKS + NUM_TASKS / CHILD_EVERY,
+              "round %u: %ld tasks executed", round, executed);
+        for (i = 0; i < NUM_TASKS; ++i)
+            CHECK(results[i] == i + 1, "round %u: task %lu not run", round, i);
+        for (i = NUM_TASKS; i < NUM_TASKS + NUM_TASKS / CHILD_EVERY; ++i)
+            CHECK(results[i] != 0, "round %u: nested task not run", round);
+    }
+    CHECK(bad_worker == 0, "%ld tasks saw a wrong worker state", bad_worker);
+
+    unsigned n_busy = 0;
+    for (i = 0; i < NUM_WORKERS; ++i)
+        n_busy += per_worker[i] > 0;
+    printf("[+] %d tasks run by %u workers\n",
+           NUM_ROUNDS * (NUM_TASKS + NUM_TASKS / CHILD_EVERY), n_busy);
+
+    // cancellation: the tasks stop before the spin limit
+    executed = 0;
+    for (i = 0; i < 2 * NUM_WORKERS; ++i)
+        thread_pool_submit(&pool, spinning_task, NULL);
+    thread_pool_cancel(&pool);
+    thread_pool_wait(&pool);
+    CHECK(executed == 2 * NUM_WORKERS && bad_worker == 0,
+          "cancellation not observed");
+    CHECK(!__atomic_load_n(&pool.cancelled, __ATOMIC_RELAXED),
+          "thread_pool_wait() did not clear the cancellation");
+
+    // the pool is usable after a cancellation
+    executed = 0;
+    thread_pool_submit(&pool, child_task, &results[0]);
+    thread_pool_wait(&pool);
+    CHECK(executed == 1, "task lost after a cancellation");
+    printf("[+] cancellation checks passed\n");
+
+    thread_pool_free(&pool);
+    return 0;
+}